@@ -45,6 +45,8 @@
 
 #include <algorithm>
 #include <chrono>  // NOLINT (gRPC requires this)
+#include <condition_variable>  // NOLINT
+#include <deque>
 #include <mutex>  // NOLINT
 #include <set>
 #include <string>
@@ -63,6 +65,7 @@
 #include "src/main/cpp/util/file.h"
 #include "src/main/cpp/util/file_platform.h"
 #include "src/main/cpp/util/logging.h"
+#include "src/main/cpp/util/md5.h"
 #include "src/main/cpp/util/numbers.h"
 #include "src/main/cpp/util/port.h"
 #include "src/main/cpp/util/strings.h"
@@ -206,7 +209,34 @@ static BlazeServer *blaze_server;
 // call exit(2) or _exit(2) (attributed with ATTRIBUTE_NORETURN) meaning we have
 // to delete the objects before those.
 
+// Returns the time in microseconds on a monotonic clock.
+static uint64_t GetMicrosecondsMonotonic() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Records the time spent between its construction and its destruction as a
+// startup phase of the client, for --client_profile. Phases are always
+// recorded, since some of them run before the startup options are parsed, but
+// only written out if a profile was requested.
+class ProfilePhase {
+ public:
+  explicit ProfilePhase(const char *name)
+      : name_(name), start_us_(GetMicrosecondsMonotonic()) {}
+
+  ~ProfilePhase() {
+    uint64_t end_us = GetMicrosecondsMonotonic();
+    globals->profile_phases.push_back(
+        {name_, start_us_ - globals->client_start_us, end_us - start_us_});
+  }
+
+ private:
+  const char *name_;
+  const uint64_t start_us_;
+};
+
 uint64_t BlazeServer::AcquireLock() {
+  ProfilePhase profile_phase("AcquireLock");
   return blaze::AcquireLock(
       globals->options->output_base, globals->options->batch,
       globals->options->block_for_lock, &blaze_lock_);
@@ -228,6 +258,9 @@ class GrpcBlazeServer : public BlazeServer {
  private:
   enum CancelThreadAction { NOTHING, JOIN, CANCEL, COMMAND_ID_RECEIVED };
 
+  // The outcome of a call checking whether the server is alive.
+  enum ProbeResult { RESPONDED, UNAVAILABLE, UNRESPONSIVE };
+
   std::unique_ptr<command_server::CommandServer::Stub> client_;
   std::string request_cookie_;
   std::string response_cookie_;
@@ -244,7 +277,12 @@ class GrpcBlazeServer : public BlazeServer {
   // actions from.
   blaze_util::IPipe *pipe_;
 
-  bool TryConnect(command_server::CommandServer::Stub* client);
+  ProbeResult TryConnect(command_server::CommandServer::Stub* client,
+                         int timeout_ms);
+  ProbeResult ProbeHealth(command_server::CommandServer::Stub* client,
+                          int timeout_ms, bool verbose);
+  bool WaitForBusyServer(command_server::CommandServer::Stub* client,
+                         const std::string& server_dir);
   void CancelThread();
   void SendAction(CancelThreadAction action);
   void SendCancelMessage();
@@ -268,15 +306,45 @@ void debug_log(const char* format, ...) {
   fflush(stderr);
 }
 
-// A devtools_ijar::ZipExtractorProcessor to extract the InstallKeyFile
+// Writes the recorded startup phases to the file given by --client_profile,
+// if any, in the Chrome trace event format. A "Startup" phase covers the
+// whole client startup until now. Failing to write the profile is not fatal.
+static void WriteClientProfile() {
+  if (globals->options->client_profile.empty()) {
+    return;
+  }
+  uint64_t now_us = GetMicrosecondsMonotonic() - globals->client_start_us;
+  string pid = GetProcessIdAsString();
+  string trace = "{\"traceEvents\":[\n";
+  trace += "{\"name\":\"Startup\",\"cat\":\"client\",\"ph\":\"X\","
+           "\"ts\":0,\"dur\":" + ToString(now_us) + ",\"pid\":" + pid +
+           ",\"tid\":0}";
+  for (const auto &phase : globals->profile_phases) {
+    trace += ",\n{\"name\":\"" + string(phase.name) +
+             "\",\"cat\":\"client\",\"ph\":\"X\",\"ts\":" +
+             ToString(phase.start_us) + ",\"dur\":" +
+             ToString(phase.duration_us) + ",\"pid\":" + pid +
+             ",\"tid\":0}";
+  }
+  trace += "\n],\"displayTimeUnit\":\"ms\"}\n";
+  if (!blaze_util::WriteFile(trace, globals->options->client_profile)) {
+    fprintf(stderr,
+            "Warning: could not write the client profile to '%s': %s\n",
+            globals->options->client_profile.c_str(), strerror(errno));
+  }
+}
+
+// A devtools_ijar::ZipExtractorProcessor to list the embedded files and
+// extract the InstallKeyFile
 class GetInstallKeyFileProcessor : public devtools_ijar::ZipExtractorProcessor {
  public:
   explicit GetInstallKeyFileProcessor(string *install_base_key)
       : install_base_key_(install_base_key) {}
 
+  // Called for every file by ZipExtractor::ListAll().
   virtual bool Accept(const char *filename, const devtools_ijar::u4 attr) {
     globals->extracted_binaries.push_back(filename);
-    return strcmp(filename, "install_base_key") == 0;
+    return false;
   }
 
   virtual void Process(const char *filename, const devtools_ijar::u4 attr,
@@ -297,8 +365,11 @@ class GetInstallKeyFileProcessor : public devtools_ijar::ZipExtractorProcessor {
 
 // Returns the install base (the root concatenated with the contents of the file
 // 'install_base_key' contained as a ZIP entry in the Blaze binary); as a side
-// effect, it also populates the extracted_binaries global variable.
+// effect, it also populates the extracted_binaries global variable. Only the
+// central directory of the zip and the install_base_key entry are read, not
+// the whole binary.
 static string GetInstallBase(const string &root, const string &self_path) {
+  ProfilePhase profile_phase("GetInstallBase");
   GetInstallKeyFileProcessor processor(&globals->install_md5);
   std::unique_ptr<devtools_ijar::ZipExtractor> extractor(
       devtools_ijar::ZipExtractor::Create(self_path.c_str(), &processor));
@@ -307,7 +378,8 @@ static string GetInstallBase(const string &root, const string &self_path) {
         "\nFailed to open %s as a zip file: (%d) %s",
         globals->options->product_name.c_str(), errno, strerror(errno));
   }
-  if (extractor->ProcessAll() < 0) {
+  if (extractor->ListAll() < 0 ||
+      extractor->ProcessEntry("install_base_key") < 0) {
     die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
         "\nFailed to extract install_base_key: %s", extractor->GetError());
   }
@@ -334,9 +406,12 @@ string GetEmbeddedBinariesRoot(const string &install_base) {
   return blaze_util::JoinPath(install_base, "_embedded_binaries");
 }
 
-// Returns the JVM command argument array.
-static vector<string> GetArgumentArray() {
-  vector<string> result;
+// Adds the arguments of the JVM running the server to "result", up to and
+// including its jar. The heap of the JVM is dumped to "heap_dump_dir" when it
+// runs out of memory.
+static void AddJvmArguments(const string &heap_dump_dir,
+                            vector<string> *result_ptr) {
+  vector<string> &result = *result_ptr;
 
   // e.g. A Blaze server process running in ~/src/build_root (where there's a
   // ~/src/build_root/WORKSPACE file) will appear in ps(1) as "blaze(src)".
@@ -350,8 +425,7 @@ static vector<string> GetArgumentArray() {
       &result);
 
   result.push_back("-XX:+HeapDumpOnOutOfMemoryError");
-  string heap_crash_path = globals->options->output_base;
-  result.push_back("-XX:HeapDumpPath=" + ConvertPath(heap_crash_path));
+  result.push_back("-XX:HeapDumpPath=" + ConvertPath(heap_dump_dir));
 
   result.push_back("-Xverify:none");
 
@@ -405,8 +479,12 @@ static vector<string> GetArgumentArray() {
   globals->options->AddJVMArgumentSuffix(real_install_dir,
                                         globals->extracted_binaries[0],
                                         &result);
+}
+
+// Adds the Blaze startup options of the server to "result".
+static void AddStartupArguments(vector<string> *result_ptr) {
+  vector<string> &result = *result_ptr;
 
-  // JVM arguments are complete. Now pass in Blaze startup options.
   // Note that we always use the --flag=ARG form (instead of the --flag ARG one)
   // so that BlazeRuntime#splitStartupOptions has an easy job.
 
@@ -482,6 +560,19 @@ static vector<string> GetArgumentArray() {
     result.push_back("--use_custom_exit_code_on_abrupt_exit=false");
   }
 
+  // The client places the server, see SetServerPlacement(). These are only
+  // passed so that the server is restarted when they change.
+  if (!globals->options->server_cpus.empty()) {
+    result.push_back("--server_cpus=" + globals->options->server_cpus);
+  }
+  if (globals->options->server_numa_node >= 0) {
+    result.push_back("--server_numa_node=" +
+                     ToString(globals->options->server_numa_node));
+  }
+  if (!globals->options->server_cgroup.empty()) {
+    result.push_back("--server_cgroup=" + globals->options->server_cgroup);
+  }
+
   // This is only for Blaze reporting purposes; the real interpretation of the
   // jvm flags occurs when we set up the java command line.
   if (globals->options->host_jvm_debug) {
@@ -510,7 +601,7 @@ static vector<string> GetArgumentArray() {
   // The option sources are transmitted in the following format:
   // --option_sources=option1:source1:option2:source2:...
   string option_sources = "--option_sources=";
-  first = true;
+  bool first = true;
   for (const auto& it : globals->options->option_sources) {
     if (!first) {
       option_sources += ":";
@@ -522,6 +613,14 @@ static vector<string> GetArgumentArray() {
   }
 
   result.push_back(option_sources);
+}
+
+// Returns the JVM command argument array.
+static vector<string> GetArgumentArray() {
+  vector<string> result;
+  AddJvmArguments(globals->options->output_base, &result);
+  // JVM arguments are complete. Now pass in Blaze startup options.
+  AddStartupArguments(&result);
   return result;
 }
 
@@ -555,6 +654,19 @@ static string GetArgumentString(const vector<string>& argument_array) {
   return result;
 }
 
+// Returns true if "address", the contents of a command_port file, is on
+// localhost.
+static bool IsLocalhostAddress(const string &address) {
+  static const char *kLocalhostPrefixes[] = {
+      "127.0.0.1:", "[0:0:0:0:0:0:0:1]:", "[::1]:", NULL};
+  for (const char **prefix = kLocalhostPrefixes; *prefix != NULL; prefix++) {
+    if (address.compare(0, strlen(*prefix), *prefix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // Do a chdir into the workspace, and die if it fails.
 static void GoToWorkspace(const WorkspaceLayout* workspace_layout) {
   if (workspace_layout->InWorkspace(globals->workspace) &&
@@ -564,9 +676,46 @@ static void GoToWorkspace(const WorkspaceLayout* workspace_layout) {
   }
 }
 
+// Name of the file of the output base caching the version of the JVM, see
+// GetCachedJvmVersion(). It holds the path of the JVM binary, its stamp (see
+// blaze_util::GetFileStamp) and its version, one per line.
+static const char kJvmVersionCache[] = "jvm_version";
+
+// Returns GetJvmVersion(java_exe), but only runs the JVM if it changed since
+// its version was cached in the output base, as starting it to print its
+// version takes hundreds of milliseconds.
+static string GetCachedJvmVersion(const string &java_exe) {
+  string stamp;
+  if (!blaze_util::GetFileStamp(java_exe, &stamp)) {
+    return GetJvmVersion(java_exe);
+  }
+
+  string cache_file =
+      blaze_util::JoinPath(globals->options->output_base, kJvmVersionCache);
+  string key = java_exe + "\n" + stamp + "\n";
+  string cache;
+  if (blaze_util::ReadFile(cache_file, &cache) &&
+      cache.compare(0, key.size(), key) == 0 && cache.size() > key.size()) {
+    return cache.substr(key.size());
+  }
+
+  string version = GetJvmVersion(java_exe);
+  if (!version.empty()) {
+    // Write the cache atomically, so that it is never read half-written.
+    string tmp_cache_file =
+        cache_file + ".tmp." + blaze::GetProcessIdAsString();
+    if (!blaze_util::WriteFile(key + version, tmp_cache_file) ||
+        rename(tmp_cache_file.c_str(), cache_file.c_str()) == -1) {
+      blaze_util::UnlinkPath(tmp_cache_file);
+    }
+  }
+  return version;
+}
+
 // Check the java version if a java version specification is bundled. On
 // success, returns the executable path of the java command.
 static void VerifyJavaVersionAndSetJvm() {
+  ProfilePhase profile_phase("VerifyJavaVersion");
   string exe = globals->options->GetJvm();
 
   string version_spec_file = blaze_util::JoinPath(
@@ -575,7 +724,11 @@ static void VerifyJavaVersionAndSetJvm() {
   if (blaze_util::ReadFile(version_spec_file, &version_spec)) {
     blaze_util::StripWhitespace(&version_spec);
     // A version specification is given, get version of java.
-    string jvm_version = GetJvmVersion(exe);
+    string jvm_version;
+    {
+      ProfilePhase profile_phase("GetJvmVersion");
+      jvm_version = GetCachedJvmVersion(exe);
+    }
 
     // Compare that jvm_version is found and at least the one specified.
     if (jvm_version.size() == 0) {
@@ -593,6 +746,118 @@ static void VerifyJavaVersionAndSetJvm() {
   globals->jvm_path = exe;
 }
 
+// Directory of the install base with the class-data sharing (CDS) archives of
+// the server. It is next to the embedded binaries rather than under them, so
+// that the install manifest doesn't cover it. The JVM maps the classes of an
+// archive instead of loading and verifying them from the deploy jar, which
+// makes the server start faster. An archive is only valid for the JVM that
+// generated it, so the files are named after the MD5 of the JVM and its
+// version:
+//   <key>.jsa              the archive
+//   <key>.failed           the archive couldn't be generated, don't retry
+//   <key>.log              the output of the JVM generating the archive
+//   <key>.classlist.<pid>  classes loaded by a server started without archive
+//   <key>.classlist        the classes the last archive was generated from
+static const char kServerCdsDir[] = "_server_cds";
+
+// Class-data sharing for application classes is available without extra flags
+// since JDK 11; JDK 10 also needs -XX:+UseAppCDS, which later JDKs ignore with
+// a warning.
+static const char kServerCdsMinJavaVersion[] = "11";
+
+// Returns the path of the CDS files of the server without their extension, or
+// the empty string if class-data sharing is disabled or not supported.
+static string GetServerCdsPrefix() {
+  if (!globals->options->server_cds) {
+    return "";
+  }
+  string jvm_version = GetCachedJvmVersion(globals->jvm_path);
+  if (jvm_version.empty() ||
+      !CheckJavaVersionIsAtLeast(jvm_version, kServerCdsMinJavaVersion)) {
+    return "";
+  }
+
+  unsigned char buf[blaze_util::Md5Digest::kDigestLength];
+  blaze_util::Md5Digest digest;
+  digest.Update(globals->jvm_path.c_str(), globals->jvm_path.size() + 1);
+  digest.Update(jvm_version.data(), jvm_version.size());
+  digest.Finish(buf);
+  return blaze_util::JoinPath(
+      blaze_util::JoinPath(globals->options->install_base, kServerCdsDir),
+      digest.String());
+}
+
+// Adds the flags that make the JVM use the CDS archive of the server to
+// "args", right after the program name. If there is no archive yet and
+// "record_classes" is set, the JVM records the classes it loads instead, see
+// GenerateServerCdsArchive(). These flags aren't in GetArgumentArray(), so
+// that a running server isn't restarted when the archive appears.
+static void AddServerCdsArguments(bool record_classes, vector<string> *args) {
+  string prefix = GetServerCdsPrefix();
+  if (prefix.empty() || blaze_util::PathExists(prefix + ".failed")) {
+    return;
+  }
+
+  vector<string> flags;
+  if (blaze_util::PathExists(prefix + ".jsa")) {
+    // An unusable archive is ignored.
+    flags.push_back("-Xshare:auto");
+    flags.push_back("-XX:SharedArchiveFile=" +
+                    blaze::ConvertPath(prefix + ".jsa"));
+  } else if (record_classes &&
+             blaze_util::MakeDirectories(blaze_util::Dirname(prefix), 0755)) {
+    globals->server_cds_class_list =
+        prefix + ".classlist." + GetProcessIdAsString();
+    flags.push_back("-XX:DumpLoadedClassList=" +
+                    blaze::ConvertPath(globals->server_cds_class_list));
+  }
+  args->insert(args->begin() + 1, flags.begin(), flags.end());
+}
+
+// Generates the CDS archive of the server in the background, from the classes
+// the server started by this client loaded so far, that is, the ones it needs
+// to start up. The archive is written under a temporary name and renamed into
+// place once complete, so that concurrent clients only see complete archives.
+static void GenerateServerCdsArchive() {
+  string prefix = GetServerCdsPrefix();
+  string class_list = globals->server_cds_class_list;
+  // The server is still writing to the list, so it may end in the middle of a
+  // line.
+  string classes;
+  bool has_classes = blaze_util::ReadFile(class_list, &classes);
+  blaze_util::UnlinkPath(class_list);
+  size_t end = classes.rfind('\n');
+  if (prefix.empty() || !has_classes || end == string::npos) {
+    return;
+  }
+  // Renamed into place, so that a JVM generating an archive concurrently
+  // reads either the old list or the new one.
+  string dump_class_list = prefix + ".classlist";
+  string tmp_class_list = class_list + ".tmp";
+  if (!blaze_util::WriteFile(classes.substr(0, end + 1), tmp_class_list) ||
+      rename(tmp_class_list.c_str(), dump_class_list.c_str()) == -1) {
+    blaze_util::UnlinkPath(tmp_class_list);
+    return;
+  }
+
+  string archive = prefix + ".jsa";
+  string tmp_archive = archive + ".tmp." + GetProcessIdAsString();
+  vector<string> args;
+  args.push_back("java");
+  args.push_back("-Xshare:dump");
+  args.push_back("-XX:SharedClassListFile=" +
+                 blaze::ConvertPath(dump_class_list));
+  args.push_back("-XX:SharedArchiveFile=" + blaze::ConvertPath(tmp_archive));
+  args.push_back("-cp");
+  args.push_back(blaze::ConvertPath(blaze_util::JoinPath(
+      GetEmbeddedBinariesRoot(globals->options->install_base),
+      globals->extracted_binaries[0])));
+  if (!ExecuteDetached(globals->jvm_path, args, prefix + ".log", tmp_archive,
+                       archive, prefix + ".failed")) {
+    debug_log("Cannot generate the CDS archive %s", archive.c_str());
+  }
+}
+
 // Starts the Blaze server.  Returns a readable fd connected to the server.
 // This is currently used only to detect liveness.
 static void StartServer(const WorkspaceLayout* workspace_layout,
@@ -616,6 +881,7 @@ static void StartServer(const WorkspaceLayout* workspace_layout,
 
   string exe = globals->options->GetExe(globals->jvm_path,
                                         globals->extracted_binaries[0]);
+  AddServerCdsArguments(true, &jvm_args_vector);
   // Go to the workspace before we daemonize, so
   // we can still print errors to the terminal.
   GoToWorkspace(workspace_layout);
@@ -624,6 +890,312 @@ static void StartServer(const WorkspaceLayout* workspace_layout,
                 server_startup);
 }
 
+// With --server_pool_size=N, the client keeps N servers pre-started in
+// <output_user_root>/server_pool/<key>, where the key covers everything a
+// server can't change once its JVM runs: the JVM arguments (thus the install
+// base) and the working directory (see SendServerRequest()). Each pooled server
+// waits in a slot directory of its own for a Claim call, and exits after
+// --max_idle_secs if none comes. A client that would start a server for its
+// output base claims one instead: it takes the slot directory over, moves the
+// files identifying the server to its server directory and sends the startup
+// options of the output base, after which the server serves it as if the
+// client had started it. The pool is refilled once the client is connected.
+static const char kServerPoolSlotPrefix[] = "slot-";
+
+// Files of a pool slot directory, see ExecuteDaemon() and GrpcServerImpl.
+static const char *kServerPoolSlotFiles[] = {
+    kServerPidFile, "server.starttime", "jvm.out", "command_port",
+    "request_cookie", "response_cookie", NULL};
+
+// Returns the JVM arguments of the pooled servers. They are the ones of the
+// server of the output base, except that the heap is dumped in the pool.
+static vector<string> GetServerPoolJvmArguments() {
+  vector<string> result;
+  AddJvmArguments(
+      blaze_util::JoinPath(globals->options->output_user_root, "server_pool"),
+      &result);
+  return result;
+}
+
+static string GetServerPoolDir(const vector<string> &jvm_args) {
+  unsigned char buf[blaze_util::Md5Digest::kDigestLength];
+  blaze_util::Md5Digest digest;
+  // Include the terminating NULs, so that the key is unambiguous.
+  digest.Update(globals->workspace.c_str(), globals->workspace.size() + 1);
+  for (const auto &arg : jvm_args) {
+    digest.Update(arg.c_str(), arg.size() + 1);
+  }
+  // Pooled servers are placed by the client that starts them.
+  string placement = globals->options->server_cpus + '\0' +
+                     ToString(globals->options->server_numa_node) + '\0' +
+                     globals->options->server_cgroup;
+  digest.Update(placement.c_str(), placement.size() + 1);
+  digest.Finish(buf);
+  return blaze_util::JoinPath(
+      blaze_util::JoinPath(globals->options->output_user_root, "server_pool"),
+      digest.String());
+}
+
+class ServerPoolSlotCollector : public blaze_util::DirectoryEntryConsumer {
+ public:
+  explicit ServerPoolSlotCollector(vector<string> *slots) : slots_(slots) {}
+
+  void Consume(const string &name, bool is_directory) override {
+    if (is_directory &&
+        blaze_util::Basename(name).compare(
+            0, strlen(kServerPoolSlotPrefix), kServerPoolSlotPrefix) == 0) {
+      slots_->push_back(name);
+    }
+  }
+
+ private:
+  vector<string> *slots_;
+};
+
+static vector<string> GetServerPoolSlots(const string &pool_dir) {
+  vector<string> result;
+  if (blaze_util::IsDirectory(pool_dir)) {
+    ServerPoolSlotCollector collector(&result);
+    blaze_util::ForEachDirectoryEntry(pool_dir, &collector);
+  }
+  return result;
+}
+
+static void RemoveServerPoolSlot(const string &slot_dir) {
+  for (const char **file = kServerPoolSlotFiles; *file != NULL; file++) {
+    blaze_util::UnlinkPath(blaze_util::JoinPath(slot_dir, *file));
+  }
+  remove(slot_dir.c_str());
+}
+
+// How long a pool slot directory may go without a PID file. The daemonized
+// server writes it right after FillServerPool() creates the directory.
+static const int64_t kServerPoolSlotStartupSecs = 60;
+
+// Returns true if the server of the pool slot directory "slot_dir" is gone. A
+// pooled server removes its slot when it exits unclaimed, but not when it dies,
+// e.g. before it even serves the Claim call.
+static bool IsServerPoolSlotDead(const string &slot_dir) {
+  int server_pid = GetServerPid(slot_dir);
+  if (server_pid > 0) {
+    return !IsServerProcessAlive(server_pid, slot_dir);
+  }
+  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
+  int64_t age;
+  return mtime->GetAgeSeconds(slot_dir, &age) &&
+         age > kServerPoolSlotStartupSecs;
+}
+
+// Removes the pool slot directory "slot_dir" of the pool directory "pool_dir"
+// if its server is gone. Returns true if it was.
+static bool RemoveDeadServerPoolSlot(const string &pool_dir,
+                                     const string &slot_dir) {
+  if (!IsServerPoolSlotDead(slot_dir)) {
+    return false;
+  }
+  // Take the slot over first, like ClaimPooledServer(), so that no other
+  // client claims or removes it meanwhile.
+  string dead_dir =
+      blaze_util::JoinPath(pool_dir, "dead-" + GetProcessIdAsString());
+  if (rename(slot_dir.c_str(), dead_dir.c_str()) == -1) {
+    return false;
+  }
+  debug_log("Removing server pool slot %s, its server is gone",
+            slot_dir.c_str());
+  RemoveServerPoolSlot(dead_dir);
+  return true;
+}
+
+// Starts servers in the server pool of the install base and workspace until
+// there are --server_pool_size of them. Counts the servers still starting,
+// too, but removes the slots of the servers that are gone. Must be called from
+// the workspace, like StartServer().
+static void FillServerPool() {
+  vector<string> jvm_args = GetServerPoolJvmArguments();
+  string pool_dir = GetServerPoolDir(jvm_args);
+  if (!blaze_util::MakeDirectories(pool_dir, 0700)) {
+    debug_log("Cannot create server pool directory %s", pool_dir.c_str());
+    return;
+  }
+
+  int missing = globals->options->server_pool_size;
+  for (const auto &slot_dir : GetServerPoolSlots(pool_dir)) {
+    if (!RemoveDeadServerPoolSlot(pool_dir, slot_dir)) {
+      missing--;
+    }
+  }
+  string exe = globals->options->GetExe(globals->jvm_path,
+                                        globals->extracted_binaries[0]);
+  string slot_prefix = blaze_util::JoinPath(
+      pool_dir, kServerPoolSlotPrefix + GetProcessIdAsString() + "-");
+  for (int i = 0; missing > 0; i++) {
+    string slot_dir = slot_prefix + ToString(i);
+    if (blaze_util::PathExists(slot_dir)) {
+      continue;
+    }
+    if (!blaze_util::MakeDirectories(slot_dir, 0700)) {
+      debug_log("Cannot create server pool slot %s", slot_dir.c_str());
+      return;
+    }
+
+    // The pooled server only parses its startup options once claimed.
+    vector<string> args(jvm_args);
+    args.push_back("--server_pool_slot=" + blaze::ConvertPath(slot_dir));
+    args.push_back("--max_idle_secs=" +
+                   ToString(globals->options->max_idle_secs));
+    AddServerCdsArguments(false, &args);
+    BlazeServerStartup *server_startup;
+    ExecuteDaemon(exe, args, blaze_util::JoinPath(slot_dir, "jvm.out"),
+                  slot_dir, &server_startup);
+    delete server_startup;
+    missing--;
+  }
+}
+
+// A server claimed from the server pool. Its pipe is held by the client that
+// started it, so its liveness is checked by its PID instead, and it doesn't
+// report its readiness. It answered the Claim call, so it is already listening.
+class ClaimedServerStartup : public BlazeServerStartup {
+ public:
+  explicit ClaimedServerStartup(int pid) : pid_(pid), tried_(false) {}
+
+  bool IsStillAlive() override {
+    return VerifyServerProcess(pid_, globals->options->output_base,
+                               globals->options->install_base);
+  }
+
+  bool WaitUntilReady(int timeout_ms) override {
+    // Connect right away the first time. Don't spin if that fails.
+    if (tried_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+    }
+    tried_ = true;
+    return true;
+  }
+
+ private:
+  const int pid_;
+  bool tried_;
+};
+
+// Copies the file "name" of the pool slot directory "slot_dir" to the server
+// directory.
+static bool CopyServerFile(const string &slot_dir, const string &server_dir,
+                           const string &name) {
+  string content;
+  return blaze_util::ReadFile(blaze_util::JoinPath(slot_dir, name),
+                              &content) &&
+         blaze_util::WriteFile(content,
+                               blaze_util::JoinPath(server_dir, name));
+}
+
+// Sends the Claim call to the pooled server of the slot directory "slot_dir".
+// Returns true if the server accepted the startup options.
+static bool SendClaimRequest(const string &slot_dir,
+                             const vector<string> &startup_args) {
+  string port;
+  string request_cookie;
+  string response_cookie;
+  if (!blaze_util::ReadFile(blaze_util::JoinPath(slot_dir, "command_port"),
+                            &port) ||
+      !IsLocalhostAddress(port) ||
+      !blaze_util::ReadFile(blaze_util::JoinPath(slot_dir, "request_cookie"),
+                            &request_cookie) ||
+      !blaze_util::ReadFile(blaze_util::JoinPath(slot_dir, "response_cookie"),
+                            &response_cookie)) {
+    return false;
+  }
+
+  std::unique_ptr<command_server::CommandServer::Stub> client(
+      command_server::CommandServer::NewStub(
+          grpc::CreateChannel(port, grpc::InsecureChannelCredentials())));
+  grpc::ClientContext context;
+  context.set_deadline(
+      std::chrono::system_clock::now() +
+      std::chrono::seconds(globals->options->connect_timeout_secs));
+
+  command_server::ClaimRequest request;
+  command_server::ClaimResponse response;
+  request.set_cookie(request_cookie);
+  for (const auto &arg : startup_args) {
+    request.add_startup_arg(arg);
+  }
+
+  grpc::Status status = client->Claim(&context, request, &response);
+  if (!status.ok() || response.cookie() != response_cookie) {
+    debug_log("Claiming the server in %s failed: %s", slot_dir.c_str(),
+              status.error_message().c_str());
+    return false;
+  }
+
+  return true;
+}
+
+// Claims a server from the server pool for the output base. Returns false if
+// there was no server to claim, in which case the client starts one.
+static bool ClaimPooledServer(const WorkspaceLayout *workspace_layout,
+                              BlazeServerStartup **server_startup) {
+  string pool_dir = GetServerPoolDir(GetServerPoolJvmArguments());
+  vector<string> slots = GetServerPoolSlots(pool_dir);
+  if (slots.empty()) {
+    return false;
+  }
+
+  string server_dir =
+      blaze_util::JoinPath(globals->options->output_base, "server");
+  string claimed_dir =
+      blaze_util::JoinPath(pool_dir, "claimed-" + GetProcessIdAsString());
+  vector<string> startup_args;
+  AddStartupArguments(&startup_args);
+  for (const auto &slot_dir : slots) {
+    // The server writes its port file once it serves the Claim call. Renaming
+    // the slot directory takes the server over from other clients and from
+    // FillServerPool(); the server doesn't use it once claimed.
+    if (!blaze_util::PathExists(
+            blaze_util::JoinPath(slot_dir, "command_port"))) {
+      RemoveDeadServerPoolSlot(pool_dir, slot_dir);
+      continue;
+    }
+    if (rename(slot_dir.c_str(), claimed_dir.c_str()) == -1) {
+      continue;
+    }
+
+    // The server reads its PID file from the server directory once claimed,
+    // so it has to be there first. The start time file only exists on some
+    // platforms, see VerifyServerProcess().
+    int server_pid = GetServerPid(claimed_dir);
+    CopyServerFile(claimed_dir, server_dir, "server.starttime");
+    bool claimed =
+        server_pid > 0 &&
+        CopyServerFile(claimed_dir, server_dir, kServerPidFile) &&
+        SendClaimRequest(claimed_dir, startup_args);
+    // The server keeps writing to its log, so move it rather than copy it.
+    rename(blaze_util::JoinPath(claimed_dir, "jvm.out").c_str(),
+           globals->jvm_log_file.c_str());
+    RemoveServerPoolSlot(claimed_dir);
+
+    if (claimed) {
+      if (globals->restart_reason == NO_RESTART) {
+        globals->restart_reason = NO_DAEMON;
+      }
+      blaze_util::WriteFile(GetArgumentString(GetArgumentArray()),
+                            blaze_util::JoinPath(server_dir, "cmdline"));
+      GoToWorkspace(workspace_layout);
+      *server_startup = new ClaimedServerStartup(server_pid);
+      return true;
+    }
+
+    if (server_pid > 0 &&
+        VerifyServerProcess(server_pid, globals->options->output_base,
+                            globals->options->install_base)) {
+      KillServerProcess(server_pid);
+    }
+    blaze_util::UnlinkPath(blaze_util::JoinPath(server_dir, kServerPidFile));
+  }
+
+  return false;
+}
+
 // Replace this process with blaze in standalone/batch mode.
 // The batch mode blaze process handles the command and exits.
 //
@@ -637,6 +1209,7 @@ static void StartStandalone(const WorkspaceLayout* workspace_layout,
 
   // Wall clock time since process startup.
   globals->startup_time = GetMillisecondsSinceProcessStart();
+  WriteClientProfile();
 
   if (VerboseLogging()) {
     fprintf(stderr, "Starting %s in batch mode.\n",
@@ -671,6 +1244,7 @@ static void StartStandalone(const WorkspaceLayout* workspace_layout,
 
   string exe = globals->options->GetExe(globals->jvm_path,
                                        globals->extracted_binaries[0]);
+  AddServerCdsArguments(false, &jvm_args_vector);
   ExecuteProgram(exe, jvm_args_vector);
   pdie(blaze_exit_code::INTERNAL_ERROR, "execv of '%s' failed", exe.c_str());
 }
@@ -709,6 +1283,22 @@ static int GetServerPid(const string &server_dir) {
   return result;
 }
 
+// How long to wait for the server to report that it is ready before checking
+// that it is still alive and printing a progress dot.
+static const int kServerStartupPollMs = 100;
+
+// How often to try to connect to a server that didn't report its readiness.
+static const int kServerUnreadyConnectMs = 1000;
+
+// Prints the output of the server that died while starting up, and exits.
+static void ServerStartupFailed() {
+  fprintf(stderr, "\nunexpected pipe read status: %s\n"
+      "Server presumed dead. Now printing '%s':\n",
+      strerror(errno), globals->jvm_log_file.c_str());
+  WriteFileToStderrOrDie(globals->jvm_log_file.c_str());
+  exit(blaze_exit_code::INTERNAL_ERROR);
+}
+
 // Starts up a new server and connects to it. Exits if it didn't work not.
 static void StartServerAndConnect(const WorkspaceLayout* workspace_layout,
                                   BlazeServer *server) {
@@ -733,9 +1323,9 @@ static void StartServerAndConnect(const WorkspaceLayout* workspace_layout,
 
   // If we couldn't connect to the server check if there is still a PID file
   // and if so, kill the server that wrote it. This can happen e.g. if the
-  // server is in a GC pause and therefore cannot respond to ping requests and
-  // having two server instances running in the same output base is a
-  // disaster.
+  // server is stuck, or too busy collecting garbage to respond for a long
+  // time (see GrpcBlazeServer::WaitForBusyServer()), and having two server
+  // instances running in the same output base is a disaster.
   int server_pid = GetServerPid(server_dir);
   if (server_pid > 0) {
     if (VerifyServerProcess(server_pid, globals->options->output_base,
@@ -748,24 +1338,59 @@ static void StartServerAndConnect(const WorkspaceLayout* workspace_layout,
 
   SetScheduling(globals->options->batch_cpu_scheduling,
                 globals->options->io_nice_level);
+  SetServerPlacement(globals->options->server_cpus,
+                     globals->options->server_numa_node,
+                     globals->options->server_cgroup);
 
   BlazeServerStartup* server_startup;
-  StartServer(workspace_layout, &server_startup);
+  {
+    ProfilePhase profile_phase("StartServer");
+    if (globals->options->server_pool_size == 0 ||
+        !ClaimPooledServer(workspace_layout, &server_startup)) {
+      StartServer(workspace_layout, &server_startup);
+    }
+  }
 
   // Give the server two minutes to start up. That's enough to connect with a
   // debugger.
   auto try_until_time(
       std::chrono::system_clock::now() + std::chrono::seconds(120));
+  // Only try to connect once the server reports that it is ready, instead of
+  // reading its files and setting up a channel every time. Still try once in a
+  // while in case the report gets lost.
+  auto next_attempt_time(std::chrono::system_clock::now() +
+                         std::chrono::milliseconds(kServerUnreadyConnectMs));
   bool had_to_wait = false;
   while (std::chrono::system_clock::now() < try_until_time) {
-    auto next_attempt_time(
-        std::chrono::system_clock::now() + std::chrono::milliseconds(100));
+    if (!server_startup->WaitUntilReady(kServerStartupPollMs) &&
+        std::chrono::system_clock::now() < next_attempt_time) {
+      had_to_wait = true;
+      if (!globals->options->client_debug) {
+        fputc('.', stderr);
+        fflush(stderr);
+      }
+      if (!server_startup->IsStillAlive()) {
+        ServerStartupFailed();
+      }
+      continue;
+    }
+
+    next_attempt_time = std::chrono::system_clock::now() +
+                        std::chrono::milliseconds(kServerUnreadyConnectMs);
     if (server->Connect()) {
       if (had_to_wait && !globals->options->client_debug) {
         fputc('\n', stderr);
         fflush(stderr);
       }
       delete server_startup;
+      if (!globals->server_cds_class_list.empty()) {
+        ProfilePhase profile_phase("GenerateServerCdsArchive");
+        GenerateServerCdsArchive();
+      }
+      if (globals->options->server_pool_size > 0) {
+        ProfilePhase profile_phase("FillServerPool");
+        FillServerPool();
+      }
       return;
     }
 
@@ -775,120 +1400,335 @@ static void StartServerAndConnect(const WorkspaceLayout* workspace_layout,
       fflush(stderr);
     }
 
-    std::this_thread::sleep_until(next_attempt_time);
     if (!server_startup->IsStillAlive()) {
-      fprintf(stderr, "\nunexpected pipe read status: %s\n"
-          "Server presumed dead. Now printing '%s':\n",
-          strerror(errno), globals->jvm_log_file.c_str());
-      WriteFileToStderrOrDie(globals->jvm_log_file.c_str());
-      exit(blaze_exit_code::INTERNAL_ERROR);
+      ServerStartupFailed();
     }
   }
   die(blaze_exit_code::INTERNAL_ERROR,
       "\nError: couldn't connect to server after 120 seconds.");
 }
 
+// Maximum number of threads extracting the embedded data files.
+static const unsigned int kMaxExtractionThreads = 8;
+
+// A devtools_ijar::ZipExtractorProcessor listing the directories containing
+// the files of the blaze zip, without extracting anything.
+class ListBlazeZipDirectoriesProcessor
+    : public devtools_ijar::ZipExtractorProcessor {
+ public:
+  explicit ListBlazeZipDirectoriesProcessor(const string &embedded_binaries)
+      : embedded_binaries_(embedded_binaries) {}
+
+  virtual bool Accept(const char *filename, const devtools_ijar::u4 attr) {
+    if (!devtools_ijar::zipattr_is_dir(attr)) {
+      directories_.insert(blaze_util::Dirname(
+          blaze_util::JoinPath(embedded_binaries_, filename)));
+    }
+    return false;
+  }
+
+  virtual void Process(const char *filename, const devtools_ijar::u4 attr,
+                       const devtools_ijar::u1 *data, const size_t size) {}
+
+  const set<string> &directories() const { return directories_; }
+
+ private:
+  const string embedded_binaries_;
+  set<string> directories_;
+};
+
 // A devtools_ijar::ZipExtractorProcessor to extract the files from the blaze
-// zip.
+// zip, once their directories exist. Several of them can extract the zip in
+// parallel, each one extracting the files whose index modulo `shards` is
+// `shard`.
 class ExtractBlazeZipProcessor : public devtools_ijar::ZipExtractorProcessor {
  public:
-  explicit ExtractBlazeZipProcessor(const string &embedded_binaries)
-      : embedded_binaries_(embedded_binaries) {}
+  ExtractBlazeZipProcessor(const string &embedded_binaries,
+                           blaze_util::IFileMtime *mtime,
+                           unsigned int shard, unsigned int shards)
+      : embedded_binaries_(embedded_binaries),
+        mtime_(mtime),
+        shard_(shard),
+        shards_(shards),
+        next_index_(0) {}
 
   virtual bool Accept(const char *filename, const devtools_ijar::u4 attr) {
-    return !devtools_ijar::zipattr_is_dir(attr);
+    if (devtools_ijar::zipattr_is_dir(attr)) {
+      return false;
+    }
+    return next_index_++ % shards_ == shard_;
   }
 
   virtual void Process(const char *filename, const devtools_ijar::u4 attr,
                        const devtools_ijar::u1 *data, const size_t size) {
     string path = blaze_util::JoinPath(embedded_binaries_, filename);
-    if (!blaze_util::MakeDirectories(blaze_util::Dirname(path), 0777)) {
-      pdie(blaze_exit_code::INTERNAL_ERROR,
-           "couldn't create '%s'", path.c_str());
-    }
 
-    if (!blaze_util::WriteFile(data, size, path)) {
+    // Set the time to a distantly futuristic value so we can observe
+    // tampering. Note that keeping a static, deterministic timestamp, such as
+    // the default timestamp set by unzip (1970-01-01) and using that to detect
+    // tampering is not enough, because we also need the timestamp to change
+    // between Bazel releases so that the metadata cache knows that the files
+    // may have changed. This is essential for the correctness of actions that
+    // use embedded binaries as artifacts.
+    if (!mtime_->WriteFileInDistantFuture(data, size, path)) {
       die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
           "\nFailed to write zipped file \"%s\": %s", path.c_str(),
           strerror(errno));
     }
+    extracted_files_.push_back(path);
   }
 
+  const vector<string> &extracted_files() const { return extracted_files_; }
+
  private:
   const string embedded_binaries_;
+  blaze_util::IFileMtime *mtime_;
+  const unsigned int shard_;
+  const unsigned int shards_;
+  unsigned int next_index_;
+  vector<string> extracted_files_;
 };
 
-// Actually extracts the embedded data files into the tree whose root
-// is 'embedded_binaries'.
-static void ActuallyExtractData(const string &argv0,
-                                const string &embedded_binaries) {
-  ExtractBlazeZipProcessor processor(embedded_binaries);
-  if (!blaze_util::MakeDirectories(embedded_binaries, 0777)) {
-    pdie(blaze_exit_code::INTERNAL_ERROR, "couldn't create '%s'",
-         embedded_binaries.c_str());
-  }
-
-  fprintf(stderr, "Extracting %s installation...\n",
-          globals->options->product_name.c_str());
+// Runs `processor` on the entries of the blaze zip. If `list_only` is true,
+// only the central directory is read and Process() is never called.
+static void ProcessBlazeZip(const string &argv0,
+                            devtools_ijar::ZipExtractorProcessor *processor,
+                            bool list_only) {
   std::unique_ptr<devtools_ijar::ZipExtractor> extractor(
-      devtools_ijar::ZipExtractor::Create(argv0.c_str(), &processor));
+      devtools_ijar::ZipExtractor::Create(argv0.c_str(), processor));
   if (extractor.get() == NULL) {
     die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
         "\nFailed to open %s as a zip file: (%d) %s",
         globals->options->product_name.c_str(), errno, strerror(errno));
   }
-  if (extractor->ProcessAll() < 0) {
+  int result = list_only ? extractor->ListAll() : extractor->ProcessAll();
+  if (result < 0) {
     die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
         "\nFailed to extract %s as a zip file: %s",
         globals->options->product_name.c_str(), extractor->GetError());
   }
+}
 
-  // Set the timestamps of the extracted files to the future and make sure (or
-  // at least as sure as we can...) that the files we have written are actually
-  // on the disk.
+// Name of the manifest of the installation base, next to _embedded_binaries.
+// It lists a stamp of each embedded file and of each directory containing them
+// (see blaze_util::GetPathStamps), so that ExtractData() can check that an
+// existing installation base is intact, including against in-place edits, with
+// one stat call per file relative to a single directory descriptor. Its first
+// line is the MD5 digest of the rest of the manifest.
+static const char kInstallManifest[] = "_install_manifest";
+
+// Computes the install manifest, without its digest, of the embedded files
+// extracted under `embedded_binaries`. Returns false if the files could not be
+// stamped.
+static bool GetInstallManifestBody(const string &embedded_binaries,
+                                   string *body) {
+  vector<string> files;
+  set<string> directories;
+  for (const auto &it : globals->extracted_binaries) {
+    if (it.empty() || it.back() == '/') {
+      continue;  // Directory entries of the zip file.
+    }
+    files.push_back(it);
+    string directory = blaze_util::Dirname(it);
+    directories.insert(directory.empty() ? "." : directory);
+  }
+  std::sort(files.begin(), files.end());
 
-  vector<string> extracted_files;
+  vector<string> paths(directories.begin(), directories.end());
+  size_t directory_count = paths.size();
+  paths.insert(paths.end(), files.begin(), files.end());
+  vector<string> stamps;
+  if (!blaze_util::GetPathStamps(embedded_binaries, paths, &stamps)) {
+    return false;
+  }
+  body->clear();
+  for (size_t i = 0; i < paths.size(); i++) {
+    *body += (i < directory_count ? "d " : "f ") + stamps[i] + " " + paths[i] +
+             "\n";
+  }
+  return true;
+}
 
-  // Walks the temporary directory recursively and collects full file paths.
-  blaze_util::GetAllFilesUnder(embedded_binaries, &extracted_files);
+static string GetInstallManifestDigest(const string &body) {
+  unsigned char buf[blaze_util::Md5Digest::kDigestLength];
+  blaze_util::Md5Digest digest;
+  digest.Update(body.data(), body.size());
+  digest.Finish(buf);
+  return digest.String();
+}
 
-  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
-  set<string> synced_directories;
-  for (const auto &it : extracted_files) {
-    const char *extracted_path = it.c_str();
-
-    // Set the time to a distantly futuristic value so we can observe tampering.
-    // Note that keeping a static, deterministic timestamp, such as the default
-    // timestamp set by unzip (1970-01-01) and using that to detect tampering is
-    // not enough, because we also need the timestamp to change between Bazel
-    // releases so that the metadata cache knows that the files may have
-    // changed. This is essential for the correctness of actions that use
-    // embedded binaries as artifacts.
-    if (!mtime.get()->SetToDistantFuture(it)) {
-      pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-           "failed to set timestamp on '%s'", extracted_path);
-    }
+// Writes the manifest of the installation base `install_dir` whose embedded
+// files are extracted under `embedded_binaries`. Returns false on failure.
+static bool WriteInstallManifest(const string &install_dir,
+                                 const string &embedded_binaries) {
+  string body;
+  if (!GetInstallManifestBody(embedded_binaries, &body)) {
+    return false;
+  }
+  // Write the manifest atomically, as another client may be reading it.
+  string manifest = blaze_util::JoinPath(install_dir, kInstallManifest);
+  string tmp_manifest = manifest + ".tmp." + blaze::GetProcessIdAsString();
+  if (!blaze_util::WriteFile(GetInstallManifestDigest(body) + "\n" + body,
+                             tmp_manifest) ||
+      rename(tmp_manifest.c_str(), manifest.c_str()) == -1) {
+    blaze_util::UnlinkPath(tmp_manifest);
+    return false;
+  }
+  return true;
+}
+
+// Returns true if the manifest of the installation base `install_dir` is
+// intact and matches the current state of its directories.
+static bool VerifyInstallManifest(const string &install_dir,
+                                  const string &embedded_binaries) {
+  string manifest;
+  if (!blaze_util::ReadFile(
+          blaze_util::JoinPath(install_dir, kInstallManifest), &manifest)) {
+    return false;
+  }
+  string body;
+  if (!GetInstallManifestBody(embedded_binaries, &body)) {
+    return false;
+  }
+  return manifest == GetInstallManifestDigest(body) + "\n" + body;
+}
 
-    blaze_util::SyncFile(it);
+// Calls blaze_util::SyncFile on each of `paths`, using up to `threads`
+// threads.
+static void SyncFiles(const vector<string> &paths, unsigned int threads) {
+  vector<std::thread> syncers;
+  for (unsigned int i = 0; i < threads; i++) {
+    syncers.push_back(std::thread([&paths, i, threads]() {
+      for (size_t j = i; j < paths.size(); j += threads) {
+        blaze_util::SyncFile(paths[j]);
+      }
+    }));
+  }
+  for (auto &syncer : syncers) {
+    syncer.join();
+  }
+}
 
-    string directory = blaze_util::Dirname(extracted_path);
+// Actually extracts the embedded data files into the tree whose root
+// is 'embedded_binaries'.
+static void ActuallyExtractData(const string &argv0,
+                                const string &embedded_binaries) {
+  if (!blaze_util::MakeDirectories(embedded_binaries, 0777)) {
+    pdie(blaze_exit_code::INTERNAL_ERROR, "couldn't create '%s'",
+         embedded_binaries.c_str());
+  }
+
+  fprintf(stderr, "Extracting %s installation...\n",
+          globals->options->product_name.c_str());
+
+  // Create all the directories first, so that the files can then be written
+  // in any order.
+  ListBlazeZipDirectoriesProcessor directories(embedded_binaries);
+  ProcessBlazeZip(argv0, &directories, true);
+  for (const auto &directory : directories.directories()) {
+    if (!blaze_util::MakeDirectories(directory, 0777)) {
+      pdie(blaze_exit_code::INTERNAL_ERROR,
+           "couldn't create '%s'", directory.c_str());
+    }
+  }
+
+  // Every thread reads the zip with its own extractor, so that the files are
+  // decompressed in parallel as well.
+  unsigned int threads = std::min(
+      std::max(std::thread::hardware_concurrency(), 1u),
+      kMaxExtractionThreads);
+  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
+  vector<std::unique_ptr<ExtractBlazeZipProcessor>> processors;
+  for (unsigned int i = 0; i < threads; i++) {
+    processors.push_back(std::unique_ptr<ExtractBlazeZipProcessor>(
+        new ExtractBlazeZipProcessor(embedded_binaries, mtime.get(), i,
+                                     threads)));
+  }
+  vector<std::thread> extractors;
+  for (const auto &processor : processors) {
+    extractors.push_back(
+        std::thread(ProcessBlazeZip, argv0, processor.get(), false));
+  }
+  for (auto &extractor : extractors) {
+    extractor.join();
+  }
+
+  // If this fails, ExtractData() will check every file of the installation
+  // base instead of its manifest.
+  string install_dir = blaze_util::Dirname(embedded_binaries);
+  bool has_manifest = WriteInstallManifest(install_dir, embedded_binaries);
+
+  // Make sure (or at least as sure as we can...) that the files we have
+  // written are actually on the disk before the installation is renamed into
+  // place. If the whole file system can't be synced at once, sync every file,
+  // then every directory in between them and embedded_binaries.
+  if (!blaze::SyncFileSystem(embedded_binaries)) {
+    vector<string> extracted_files;
+    if (has_manifest) {
+      extracted_files.push_back(
+          blaze_util::JoinPath(install_dir, kInstallManifest));
+    }
+    for (const auto &processor : processors) {
+      extracted_files.insert(extracted_files.end(),
+                             processor->extracted_files().begin(),
+                             processor->extracted_files().end());
+    }
+    SyncFiles(extracted_files, threads);
 
-    // Now walk up until embedded_binaries and sync every directory in between.
     // synced_directories is used to avoid syncing the same directory twice.
     // The !directory.empty() and !blaze_util::IsRootDirectory(directory)
     // conditions are not strictly needed, but it makes this loop more robust,
     // because otherwise, if due to some glitch, directory was not under
     // embedded_binaries, it would get into an infinite loop.
-    while (directory != embedded_binaries &&
-           synced_directories.count(directory) == 0 && !directory.empty() &&
-           !blaze_util::IsRootDirectory(directory)) {
-      blaze_util::SyncFile(directory);
-      synced_directories.insert(directory);
-      directory = blaze_util::Dirname(directory);
+    set<string> synced_directories;
+    for (string directory : directories.directories()) {
+      while (directory != embedded_binaries &&
+             synced_directories.count(directory) == 0 && !directory.empty() &&
+             !blaze_util::IsRootDirectory(directory)) {
+        synced_directories.insert(directory);
+        directory = blaze_util::Dirname(directory);
+      }
     }
+    SyncFiles(vector<string>(synced_directories.begin(),
+                             synced_directories.end()),
+              threads);
+    blaze_util::SyncFile(embedded_binaries);
   }
+}
 
-  blaze_util::SyncFile(embedded_binaries);
+// Checks that every embedded file of the installation base is present and
+// has its timestamp in the future. Dies if not.
+static void VerifyInstalledFiles(const string &real_install_dir) {
+  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
+  for (const auto& it : globals->extracted_binaries) {
+    string path = blaze_util::JoinPath(real_install_dir, it);
+    // Check that the file exists and is readable.
+    if (blaze_util::IsDirectory(path)) {
+      continue;
+    }
+    if (!blaze_util::CanReadFile(path)) {
+      die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+          "Error: corrupt installation: file '%s' missing."
+          " Please remove '%s' and try again.",
+          path.c_str(), globals->options->install_base.c_str());
+    }
+    // Check that the timestamp is in the future. A past timestamp would
+    // indicate that the file has been tampered with.
+    // See ActuallyExtractData().
+    bool is_in_future = false;
+    if (!mtime.get()->GetIfInDistantFuture(path, &is_in_future)) {
+      die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+          "Error: could not retrieve mtime of file '%s'. "
+          "Please remove '%s' and try again.",
+          path.c_str(), globals->options->install_base.c_str());
+    }
+    if (!is_in_future) {
+      die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+          "Error: corrupt installation: file '%s' "
+          "modified.  Please remove '%s' and try again.",
+          path.c_str(), globals->options->install_base.c_str());
+    }
+  }
 }
 
 // Installs Blaze by extracting the embedded data files, iff necessary.
@@ -896,9 +1736,11 @@ static void ActuallyExtractData(const string &argv0,
 // no-one has modified the extracted files beneath this directory once
 // it is in place. Concurrency during extraction is handled by
 // extracting in a tmp dir and then renaming it into place where it
-// becomes visible automically at the new path.
+// becomes visible automically at the new path. An existing installation
+// is checked against its manifest, see kInstallManifest.
 // Populates globals->extracted_binaries with their extracted locations.
 static void ExtractData(const string &self_path) {
+  ProfilePhase profile_phase("ExtractData");
   // If the install dir doesn't exist, create it, if it does, we know it's good.
   if (!blaze_util::PathExists(globals->options->install_base)) {
     uint64_t st = GetMillisecondsMonotonic();
@@ -930,40 +1772,188 @@ static void ExtractData(const string &self_path) {
           globals->options->install_base.c_str());
     }
 
-    std::unique_ptr<blaze_util::IFileMtime> mtime(
-        blaze_util::CreateFileMtime());
     string real_install_dir = blaze_util::JoinPath(
         globals->options->install_base,
         "_embedded_binaries");
-    for (const auto& it : globals->extracted_binaries) {
-      string path = blaze_util::JoinPath(real_install_dir, it);
-      // Check that the file exists and is readable.
-      if (blaze_util::IsDirectory(path)) {
-        continue;
-      }
-      if (!blaze_util::CanReadFile(path)) {
-        die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-            "Error: corrupt installation: file '%s' missing."
-            " Please remove '%s' and try again.",
-            path.c_str(), globals->options->install_base.c_str());
+    bool manifest_verified =
+        VerifyInstallManifest(globals->options->install_base, real_install_dir);
+    if (!manifest_verified || globals->options->full_install_base_verification) {
+      VerifyInstalledFiles(real_install_dir);
+      if (!manifest_verified) {
+        // The files are intact, so record their current state to take the
+        // fast path next time.
+        WriteInstallManifest(globals->options->install_base, real_install_dir);
       }
-      // Check that the timestamp is in the future. A past timestamp would
-      // indicate that the file has been tampered with.
-      // See ActuallyExtractData().
-      bool is_in_future = false;
-      if (!mtime.get()->GetIfInDistantFuture(path, &is_in_future)) {
-        die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-            "Error: could not retrieve mtime of file '%s'. "
-            "Please remove '%s' and try again.",
-            path.c_str(), globals->options->install_base.c_str());
+    }
+  }
+}
+
+// Every version of the client extracts its own install base to the install
+// user root, <output_user_root>/install, and an interrupted ExtractData()
+// leaves its temporary install base there. The client removes them in a
+// detached process, at most once a day, so that it never delays a command.
+
+// Name of the log file of the install user root garbage collection. Its
+// modification time is when it last started.
+static const char kInstallGcLogFile[] = "gc.log";
+
+// How often the install user root is garbage collected. Also the age of the
+// temporary install bases it removes: extracting one doesn't take that long.
+static const int64_t kInstallGcIntervalSecs = 24 * 3600;
+
+// Number of threads removing an install base.
+static const int kInstallGcThreads = 4;
+
+// Name of the file of an install base whose modification time is when a client
+// last used it. Outputs bases can be anywhere (--output_base), so their
+// "install" symlinks don't tell which install bases are still in use.
+static const char kInstallBaseLastUsedFile[] = "_last_used";
+
+// How often a client updates the last used stamp of its install base.
+static const int64_t kInstallBaseStampIntervalSecs = 3600;
+
+// Records that the install base is in use, so that the garbage collection of
+// the install user root leaves it alone. Only does it once an hour, to not add
+// a write to every command.
+static void StampInstallBase() {
+  string stamp = blaze_util::JoinPath(globals->options->install_base,
+                                      kInstallBaseLastUsedFile);
+  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
+  int64_t age;
+  if (mtime->GetAgeSeconds(stamp, &age) && age >= 0 &&
+      age < kInstallBaseStampIntervalSecs) {
+    return;
+  }
+  if (!mtime->SetToNow(stamp) && !blaze_util::WriteFile("", stamp)) {
+    debug_log("Cannot stamp the install base %s",
+              globals->options->install_base.c_str());
+  }
+}
+
+// Returns how many seconds ago "install_base" was last used, from its last
+// used stamp or, for install bases of older clients that don't have one, from
+// its modification time.
+static bool GetInstallBaseAgeSeconds(blaze_util::IFileMtime *mtime,
+                                     const string &install_base,
+                                     int64_t *age) {
+  return mtime->GetAgeSeconds(
+             blaze_util::JoinPath(install_base, kInstallBaseLastUsedFile),
+             age) ||
+         mtime->GetAgeSeconds(install_base, age);
+}
+
+class DirectoryCollector : public blaze_util::DirectoryEntryConsumer {
+ public:
+  explicit DirectoryCollector(vector<string> *dirs) : dirs_(dirs) {}
+
+  void Consume(const string &name, bool is_directory) override {
+    if (is_directory) {
+      dirs_->push_back(name);
+    }
+  }
+
+ private:
+  vector<string> *dirs_;
+};
+
+// Removes the install bases of "install_user_root" that no output base of the
+// output user root links to and that weren't used for
+// --install_base_max_age_days (see StampInstallBase()), and the temporary
+// install bases older than a day. Runs in a detached process, see
+// StartInstallBaseGc().
+static void GarbageCollectInstallBases(const string &install_user_root) {
+  SetScheduling(true, 7);
+
+  std::set<string> used_install_bases;
+  used_install_bases.insert(
+      blaze_util::Basename(globals->options->install_base));
+  vector<string> output_bases;
+  DirectoryCollector output_base_collector(&output_bases);
+  blaze_util::ForEachDirectoryEntry(globals->options->output_user_root,
+                                    &output_base_collector);
+  for (const auto &output_base : output_bases) {
+    string install_base;
+    if (ReadDirectorySymlink(blaze_util::JoinPath(output_base, "install"),
+                             &install_base)) {
+      used_install_bases.insert(blaze_util::Basename(install_base));
+    }
+  }
+
+  vector<string> install_bases;
+  DirectoryCollector install_base_collector(&install_bases);
+  blaze_util::ForEachDirectoryEntry(install_user_root, &install_base_collector);
+  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
+  int64_t max_age =
+      static_cast<int64_t>(globals->options->install_base_max_age_days) *
+      24 * 3600;
+  for (const auto &install_base : install_bases) {
+    string name = blaze_util::Basename(install_base);
+    bool is_temporary = name.find(".tmp.") != string::npos;
+    int64_t age;
+    if (used_install_bases.count(name) > 0 ||
+        (!is_temporary && max_age == 0) ||
+        !(is_temporary ? mtime->GetAgeSeconds(install_base, &age)
+                       : GetInstallBaseAgeSeconds(mtime.get(), install_base,
+                                                  &age)) ||
+        age < (is_temporary ? kInstallGcIntervalSecs : max_age)) {
+      continue;
+    }
+
+    // Move an install base out of the way first, so that a client never uses
+    // it half-removed: it extracts it again instead. If this process is
+    // interrupted, the next one removes the temporary install base.
+    string path = install_base;
+    if (!is_temporary) {
+      path = install_base + ".tmp." + GetProcessIdAsString();
+      if (rename(install_base.c_str(), path.c_str()) == -1) {
+        fprintf(stderr, "Cannot move %s out of the way: %s\n",
+                install_base.c_str(), strerror(errno));
+        continue;
       }
-      if (!is_in_future) {
-        die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
-            "Error: corrupt installation: file '%s' "
-            "modified.  Please remove '%s' and try again.",
-            path.c_str(), globals->options->install_base.c_str());
+      // A client may have stamped it just before it was moved.
+      int64_t moved_age;
+      if (GetInstallBaseAgeSeconds(mtime.get(), path, &moved_age) &&
+          moved_age < max_age) {
+        if (rename(path.c_str(), install_base.c_str()) == -1) {
+          fprintf(stderr, "Cannot move %s back: %s\n", path.c_str(),
+                  strerror(errno));
+        }
+        continue;
       }
     }
+    fprintf(stderr, "Removing %s install base %s (%d days old)\n",
+            is_temporary ? "temporary" : "unused", install_base.c_str(),
+            static_cast<int>(age / (24 * 3600)));
+    if (!blaze_util::RemoveRecursively(path, kInstallGcThreads)) {
+      fprintf(stderr, "Cannot remove %s completely\n", path.c_str());
+    }
+  }
+}
+
+// Starts garbage collecting the install user root in the background if it
+// wasn't in the last day. This needs RunDetached(), so it doesn't happen on
+// Windows.
+static void StartInstallBaseGc() {
+  string install_user_root =
+      blaze_util::JoinPath(globals->options->output_user_root, "install");
+  string log_file = blaze_util::JoinPath(install_user_root, kInstallGcLogFile);
+  std::unique_ptr<blaze_util::IFileMtime> mtime(blaze_util::CreateFileMtime());
+  int64_t age;
+  if (!blaze_util::IsDirectory(install_user_root) ||
+      (mtime->GetAgeSeconds(log_file, &age) && age >= 0 &&
+       age < kInstallGcIntervalSecs)) {
+    return;
+  }
+
+  // Truncating the log file tells the other clients that this one does it.
+  if (!blaze_util::WriteFile("", log_file)) {
+    return;
+  }
+  ProfilePhase profile_phase("StartInstallBaseGc");
+  if (!RunDetached(log_file, [install_user_root]() {
+        GarbageCollectInstallBases(install_user_root);
+      })) {
+    debug_log("Cannot garbage collect %s", install_user_root.c_str());
   }
 }
 
@@ -1011,6 +2001,7 @@ static bool ServerNeedsToBeKilled(const vector<string>& args1,
 
 // Kills the running Blaze server, if any, if the startup options do not match.
 static void KillRunningServerIfDifferentStartupOptions(BlazeServer* server) {
+  ProfilePhase profile_phase("CheckServerStartupOptions");
   if (!server->Connected()) {
     return;
   }
@@ -1045,6 +2036,7 @@ static void KillRunningServerIfDifferentStartupOptions(BlazeServer* server) {
 // This function requires that the installation be complete, and the
 // server lock acquired.
 static void EnsureCorrectRunningVersion(BlazeServer* server) {
+  ProfilePhase profile_phase("EnsureCorrectRunningVersion");
   // Read the previous installation's semaphore symlink in output_base. If the
   // target dirs don't match, or if the symlink was not present, then kill any
   // running servers. Lastly, symlink to our installation so others know which
@@ -1130,6 +2122,7 @@ static ATTRIBUTE_NORETURN void SendServerRequest(
 
   // Wall clock time since process startup.
   globals->startup_time = GetMillisecondsSinceProcessStart();
+  WriteClientProfile();
 
   SignalHandler::Get().Install(globals, CancelServer);
   SignalHandler::Get().PropagateSignalOrExit(server->Communicate());
@@ -1137,6 +2130,7 @@ static ATTRIBUTE_NORETURN void SendServerRequest(
 
 // Parse the options, storing parsed values in globals.
 static void ParseOptions(int argc, const char *argv[]) {
+  ProfilePhase profile_phase("ParseOptions");
   string error;
   blaze_exit_code::ExitCode parse_exit_code =
       globals->option_processor->ParseOptions(argc, argv, globals->workspace,
@@ -1149,6 +2143,7 @@ static void ParseOptions(int argc, const char *argv[]) {
 
 // Compute the globals globals->cwd and globals->workspace.
 static void ComputeWorkspace(const WorkspaceLayout* workspace_layout) {
+  ProfilePhase profile_phase("ComputeWorkspace");
   globals->cwd = blaze_util::MakeCanonical(blaze_util::GetCwd().c_str());
   if (globals->cwd.empty()) {
     pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
@@ -1163,6 +2158,7 @@ static void ComputeWorkspace(const WorkspaceLayout* workspace_layout) {
 // globals->lockfile, globals->jvm_log_file.
 static void ComputeBaseDirectories(const WorkspaceLayout* workspace_layout,
                                    const string &self_path) {
+  ProfilePhase profile_phase("ComputeBaseDirectories");
   // Only start a server when in a workspace because otherwise we won't do more
   // than emit a help message.
   if (!workspace_layout->InWorkspace(globals->workspace)) {
@@ -1318,6 +2314,7 @@ int Main(int argc, const char *argv[], WorkspaceLayout* workspace_layout,
   blaze_util::SetLogHandler(std::move(log_handler));
 
   globals = new GlobalVariables(option_processor);
+  globals->client_start_us = GetMicrosecondsMonotonic();
   blaze::SetupStdStreams();
 
   // Must be done before command line parsing.
@@ -1328,7 +2325,11 @@ int Main(int argc, const char *argv[], WorkspaceLayout* workspace_layout,
   debug_log("Debug logging active");
 
   CheckEnvironment();
-  blaze::CreateSecureOutputRoot(globals->options->output_user_root);
+  {
+    ProfilePhase profile_phase("CreateSecureOutputRoot");
+    blaze::CreateSecureOutputRoot(globals->options->output_user_root);
+  }
+  globals->option_processor->WriteRcCache();
 
   const string self_path = GetSelfPath();
   ComputeBaseDirectories(workspace_layout, self_path);
@@ -1341,6 +2342,8 @@ int Main(int argc, const char *argv[], WorkspaceLayout* workspace_layout,
   WarnFilesystemType(globals->options->output_base);
 
   ExtractData(self_path);
+  StampInstallBase();
+  StartInstallBaseGc();
   VerifyJavaVersionAndSetJvm();
 
   blaze_server->Connect();
@@ -1350,6 +2353,9 @@ int Main(int argc, const char *argv[], WorkspaceLayout* workspace_layout,
   if (globals->options->batch) {
     SetScheduling(globals->options->batch_cpu_scheduling,
                   globals->options->io_nice_level);
+    SetServerPlacement(globals->options->server_cpus,
+                       globals->options->server_numa_node,
+                       globals->options->server_cgroup);
     StartStandalone(workspace_layout, blaze_server);
   } else {
     SendServerRequest(workspace_layout, blaze_server);
@@ -1377,38 +2383,169 @@ GrpcBlazeServer::~GrpcBlazeServer() {
   pipe_ = NULL;
 }
 
-bool GrpcBlazeServer::TryConnect(command_server::CommandServer::Stub* client) {
+// How long the client waits for the first ping of a server. Most servers
+// respond within milliseconds; the others are waited for with
+// WaitForBusyServer().
+static const int kFirstPingTimeoutMs = 500;
+
+// The longest deadline of the health probes of WaitForBusyServer(). Since the
+// probes are queued by a busy server, it doesn't need to be longer.
+static const int kMaxHealthProbeTimeoutMs = 8000;
+
+// How much CPU time a server that doesn't respond must use, relative to the
+// wall time, for WaitForBusyServer() to consider it busy rather than stuck.
+// An idle JVM uses much less, a JVM collecting garbage at least a core.
+static const int kMinBusyServerCpuPercent = 10;
+
+// How long WaitForBusyServer() waits for a busy server at most.
+static const int kMaxBusyServerWaitSecs = 120;
+
+// How often to check whether a server that was asked to shut down is gone.
+static const int kMinShutdownPollMs = 50;
+static const int kMaxShutdownPollMs = 1000;
+
+GrpcBlazeServer::ProbeResult GrpcBlazeServer::TryConnect(
+    command_server::CommandServer::Stub* client, int timeout_ms) {
+  ProfilePhase profile_phase("TryConnect");
   grpc::ClientContext context;
-  context.set_deadline(
-      std::chrono::system_clock::now() +
-      std::chrono::seconds(connect_timeout_secs_));
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::milliseconds(timeout_ms));
 
   command_server::PingRequest request;
   command_server::PingResponse response;
   request.set_cookie(request_cookie_);
 
-  debug_log("Trying to connect to server (timeout: %d secs)...",
-      connect_timeout_secs_);
+  debug_log("Trying to connect to server (timeout: %d ms)...", timeout_ms);
   grpc::Status status = client->Ping(&context, request, &response);
 
+  if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+    debug_log("Server did not respond within %d ms", timeout_ms);
+    return UNRESPONSIVE;
+  }
   if (!status.ok() || response.cookie() != response_cookie_) {
     debug_log("Connection to server failed: %s",
         status.error_message().c_str());
-    return false;
+    return UNAVAILABLE;
   }
 
-  return true;
+  return RESPONDED;
+}
+
+// Like TryConnect(), but also reports how busy the server is if it responds:
+// with debug_log(), or to the user if `verbose` is true.
+GrpcBlazeServer::ProbeResult GrpcBlazeServer::ProbeHealth(
+    command_server::CommandServer::Stub* client, int timeout_ms,
+    bool verbose) {
+  ProfilePhase profile_phase("ProbeHealth");
+  grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::milliseconds(timeout_ms));
+
+  command_server::HealthRequest request;
+  command_server::HealthResponse response;
+  request.set_cookie(request_cookie_);
+
+  debug_log("Probing the health of the server (timeout: %d ms)...",
+            timeout_ms);
+  grpc::Status status = client->Health(&context, request, &response);
+
+  if (status.error_code() == grpc::StatusCode::UNIMPLEMENTED) {
+    // A server of an older version. It's replaced anyway, see
+    // EnsureCorrectRunningVersion().
+    return TryConnect(client, timeout_ms);
+  }
+  if (status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED) {
+    debug_log("Server did not respond within %d ms", timeout_ms);
+    return UNRESPONSIVE;
+  }
+  if (!status.ok() || response.cookie() != response_cookie_) {
+    debug_log("Connection to server failed: %s",
+        status.error_message().c_str());
+    return UNAVAILABLE;
+  }
+
+  int gc_percent = response.uptime_millis() > 0
+      ? static_cast<int>(100 * response.gc_time_millis() /
+                         response.uptime_millis())
+      : 0;
+  int heap_percent = response.max_heap_bytes() > 0
+      ? static_cast<int>(100 * response.used_heap_bytes() /
+                         response.max_heap_bytes())
+      : 0;
+  if (verbose) {
+    fprintf(stderr,
+            "Server responded (%d calls running, %d%% of its time spent "
+            "collecting garbage, %d%% of its heap used).\n",
+            response.running_calls(), gc_percent, heap_percent);
+  } else {
+    debug_log("Server responded (%d calls running, %d%% of its time spent "
+              "collecting garbage, %d%% of its heap used)",
+              response.running_calls(), gc_percent, heap_percent);
+  }
+  return RESPONDED;
+}
+
+// Waits for a server that didn't respond to the first ping in time, probing
+// it with increasing deadlines. It is given up on once it neither responded
+// nor used CPU time for --connect_timeout_secs, e.g. if it is stuck, but
+// waited for while it uses CPU time, e.g. collecting garbage, up to
+// kMaxBusyServerWaitSecs: killing a busy server only makes the next command
+// slower. Returns true if the server responded.
+bool GrpcBlazeServer::WaitForBusyServer(
+    command_server::CommandServer::Stub* client, const string& server_dir) {
+  ProfilePhase profile_phase("WaitForBusyServer");
+  int server_pid = GetServerPid(server_dir);
+  int64_t cpu_time_ms =
+      server_pid > 0 ? GetProcessCpuTimeMillis(server_pid) : -1;
+  uint64_t start_ms = GetMillisecondsMonotonic();
+  uint64_t sample_ms = start_ms;
+  uint64_t last_busy_ms = start_ms;
+  bool reported_busy = false;
+  int timeout_ms = kFirstPingTimeoutMs;
+  while (true) {
+    timeout_ms = std::min(2 * timeout_ms, kMaxHealthProbeTimeoutMs);
+    ProbeResult result = ProbeHealth(client, timeout_ms, reported_busy);
+    if (result != UNRESPONSIVE) {
+      return result == RESPONDED;
+    }
+
+    uint64_t now_ms = GetMillisecondsMonotonic();
+    int64_t new_cpu_time_ms =
+        server_pid > 0 ? GetProcessCpuTimeMillis(server_pid) : -1;
+    if (cpu_time_ms >= 0 && new_cpu_time_ms >= 0 &&
+        100 * (new_cpu_time_ms - cpu_time_ms) >=
+            kMinBusyServerCpuPercent *
+                static_cast<int64_t>(now_ms - sample_ms)) {
+      last_busy_ms = now_ms;
+      if (!reported_busy) {
+        fprintf(stderr,
+                "Server (pid=%d) is busy, e.g. collecting garbage. Waiting "
+                "for it to respond...\n", server_pid);
+        reported_busy = true;
+      }
+    }
+    cpu_time_ms = new_cpu_time_ms;
+    sample_ms = now_ms;
+
+    if (now_ms - last_busy_ms >= connect_timeout_secs_ * 1000ULL) {
+      debug_log("Server neither responded nor used CPU time for %d secs",
+                connect_timeout_secs_);
+      return false;
+    }
+    if (now_ms - start_ms >= kMaxBusyServerWaitSecs * 1000ULL) {
+      debug_log("Server did not respond for %d secs", kMaxBusyServerWaitSecs);
+      return false;
+    }
+  }
 }
 
 bool GrpcBlazeServer::Connect() {
   assert(!connected_);
+  ProfilePhase profile_phase("Connect");
 
   std::string server_dir =
       blaze_util::JoinPath(globals->options->output_base, "server");
   std::string port;
-  std::string ipv4_prefix = "127.0.0.1:";
-  std::string ipv6_prefix_1 = "[0:0:0:0:0:0:0:1]:";
-  std::string ipv6_prefix_2 = "[::1]:";
 
   if (!blaze_util::ReadFile(blaze_util::JoinPath(server_dir, "command_port"),
                             &port)) {
@@ -1416,9 +2553,7 @@ bool GrpcBlazeServer::Connect() {
   }
 
   // Make sure that we are being directed to localhost
-  if (port.compare(0, ipv4_prefix.size(), ipv4_prefix)
-      && port.compare(0, ipv6_prefix_1.size(), ipv6_prefix_1)
-      && port.compare(0, ipv6_prefix_2.size(), ipv6_prefix_2)) {
+  if (!IsLocalhostAddress(port)) {
     return false;
   }
 
@@ -1432,12 +2567,35 @@ bool GrpcBlazeServer::Connect() {
     return false;
   }
 
-  std::shared_ptr<grpc::Channel> channel(grpc::CreateChannel(
-      port, grpc::InsecureChannelCredentials()));
-  std::unique_ptr<command_server::CommandServer::Stub> client(
-      command_server::CommandServer::NewStub(channel));
+  // Prefer the AF_UNIX socket of the server if it has one: it avoids the
+  // handshake and the loopback stack of TCP. Fall back to the TCP port if the
+  // socket is missing (e.g. the server is too old, or the platform doesn't
+  // support it) or doesn't answer.
+  // A server that doesn't respond on the socket is busy or stuck, and
+  // wouldn't respond on the port either.
+  std::unique_ptr<command_server::CommandServer::Stub> client;
+  ProbeResult result = UNAVAILABLE;
+  std::string socket_path = blaze_util::JoinPath(server_dir, kServerSocketFile);
+  if (blaze_util::PathExists(socket_path)) {
+    client = command_server::CommandServer::NewStub(grpc::CreateChannel(
+        "unix:" + socket_path, grpc::InsecureChannelCredentials()));
+    result = TryConnect(client.get(), kFirstPingTimeoutMs);
+    if (result == UNAVAILABLE) {
+      debug_log("Connection to %s failed, falling back to %s",
+                socket_path.c_str(), port.c_str());
+    }
+  }
+
+  if (result == UNAVAILABLE) {
+    client = command_server::CommandServer::NewStub(grpc::CreateChannel(
+        port, grpc::InsecureChannelCredentials()));
+    result = TryConnect(client.get(), kFirstPingTimeoutMs);
+  }
 
-  if (!TryConnect(client.get())) {
+  if (result == UNRESPONSIVE && WaitForBusyServer(client.get(), server_dir)) {
+    result = RESPONDED;
+  }
+  if (result != RESPONDED) {
     return false;
   }
 
@@ -1455,12 +2613,12 @@ bool GrpcBlazeServer::Connect() {
     // happen if someone (e.g. a client or server that's very old and uses an
     // AF_UNIX socket instead of gRPC) deletes the server.pid.txt file.
     KillRunningServer();
-    // Then wait until it actually dies
+    // Then wait until it actually dies, which usually doesn't take long.
+    int poll_ms = kMinShutdownPollMs;
     do {
-      auto next_attempt_time(
-          std::chrono::system_clock::now() + std::chrono::milliseconds(1000));
-      std::this_thread::sleep_until(next_attempt_time);
-    } while (TryConnect(client_.get()));
+      std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms));
+      poll_ms = std::min(2 * poll_ms, kMaxShutdownPollMs);
+    } while (TryConnect(client_.get(), kFirstPingTimeoutMs) == RESPONDED);
 
     return false;
   }
@@ -1585,6 +2743,106 @@ void GrpcBlazeServer::KillRunningServer() {
   connected_ = false;
 }
 
+// The largest chunk of standard output or error the client asks the server to
+// send in a single RunResponse. Bigger chunks mean fewer messages to receive
+// and parse and fewer writes for commands with a lot of output.
+static const int kMaxOutputChunkSize = 1024 * 1024;
+
+// How much output OutputStreamer buffers before Write() blocks.
+static const size_t kMaxPendingOutputBytes = 16 * 1024 * 1024;
+
+// Writes the standard output and error of a command on a separate thread, so
+// that the next responses of the server are received meanwhile. The chunks
+// of the same stream that are pending are written together with a single
+// WriteToStdOutErr() call, and the chunks are moved around, not copied.
+class OutputStreamer {
+ public:
+  OutputStreamer()
+      : pending_bytes_(0),
+        done_(false),
+        broken_stream_(NULL),
+        thread_(&OutputStreamer::Run, this) {}
+
+  ~OutputStreamer() { Finish(); }
+
+  // Queues the content of `data` (which is left empty) to be written to the
+  // standard output if `to_stdout` is true, to the standard error otherwise.
+  // Blocks while too much output is pending.
+  void Write(bool to_stdout, string *data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] {
+      return pending_bytes_ < kMaxPendingOutputBytes;
+    });
+    pending_bytes_ += data->size();
+    pending_.push_back(std::make_pair(to_stdout, string()));
+    pending_.back().second.swap(*data);
+    cond_.notify_all();
+  }
+
+  // Waits until all the output is written.
+  void Finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+      cond_.notify_all();
+    }
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  // Returns the name of the first stream whose reading end was closed, or NULL
+  // if none was.
+  const char *broken_stream() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return broken_stream_;
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cond_.wait(lock, [this] { return done_ || !pending_.empty(); });
+      if (pending_.empty()) {
+        return;
+      }
+
+      bool to_stdout = pending_.front().first;
+      vector<string> chunks;
+      size_t bytes = 0;
+      while (!pending_.empty() && pending_.front().first == to_stdout) {
+        bytes += pending_.front().second.size();
+        chunks.push_back(std::move(pending_.front().second));
+        pending_.pop_front();
+      }
+
+      // Once a pipe is broken, the command is cancelled and its remaining
+      // output is dropped.
+      if (broken_stream_ == NULL) {
+        lock.unlock();
+        bool success = WriteToStdOutErr(chunks, to_stdout);
+        int error = errno;
+        lock.lock();
+        if (!success && error == EPIPE) {
+          broken_stream_ = to_stdout ? "standard output" : "standard error";
+        }
+      }
+      pending_bytes_ -= bytes;
+      cond_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  // Signaled when output is queued or written, and on Finish().
+  std::condition_variable cond_;
+  // The chunks to write, with whether they go to the standard output.
+  std::deque<std::pair<bool, string>> pending_;
+  size_t pending_bytes_;
+  bool done_;
+  const char *broken_stream_;
+  std::thread thread_;
+};
+
 unsigned int GrpcBlazeServer::Communicate() {
   assert(connected_);
 
@@ -1601,6 +2859,7 @@ unsigned int GrpcBlazeServer::Communicate() {
   request.set_cookie(request_cookie_);
   request.set_block_for_lock(globals->options->block_for_lock);
   request.set_client_description("pid=" + blaze::GetProcessIdAsString());
+  request.set_max_output_chunk_size(kMaxOutputChunkSize);
   for (const string& arg : arg_vector) {
     request.add_arg(arg);
   }
@@ -1616,6 +2875,7 @@ unsigned int GrpcBlazeServer::Communicate() {
   blaze::ReleaseLock(&blaze_lock_);
 
   std::thread cancel_thread(&GrpcBlazeServer::CancelThread, this);
+  OutputStreamer output;
   bool command_id_set = false;
   bool pipe_broken = false;
   while (reader->Read(&response)) {
@@ -1624,28 +2884,16 @@ unsigned int GrpcBlazeServer::Communicate() {
       return blaze_exit_code::INTERNAL_ERROR;
     }
 
-    bool pipe_broken_now = false;
-    const char* broken_pipe_name;
-
     if (!response.standard_output().empty()) {
-      size_t size = response.standard_output().size();
-      size_t r = fwrite(response.standard_output().c_str(), 1, size, stdout);
-      if (r < size && errno == EPIPE) {
-        pipe_broken_now = true;
-        broken_pipe_name = "standard output";
-      }
+      output.Write(true, response.mutable_standard_output());
     }
 
     if (!response.standard_error().empty()) {
-      size_t size = response.standard_error().size();
-      size_t r = fwrite(response.standard_error().c_str(), 1, size, stderr);
-      if (r < size && errno == EPIPE) {
-        pipe_broken_now = true;
-        broken_pipe_name = "standard error";
-      }
+      output.Write(false, response.mutable_standard_error());
     }
 
-    if (pipe_broken_now && !pipe_broken) {
+    const char *broken_pipe_name = output.broken_stream();
+    if (broken_pipe_name != NULL && !pipe_broken) {
       pipe_broken = true;
       fprintf(stderr, "\nCannot write to %s; exiting...\n\n", broken_pipe_name);
       Cancel();
@@ -1659,6 +2907,14 @@ unsigned int GrpcBlazeServer::Communicate() {
     }
   }
 
+  // The output may only be found to be broken once it is all written.
+  output.Finish();
+  if (output.broken_stream() != NULL && !pipe_broken) {
+    pipe_broken = true;
+    fprintf(stderr, "\nCannot write to %s; exiting...\n\n",
+            output.broken_stream());
+  }
+
   SendAction(CancelThreadAction::JOIN);
   cancel_thread.join();
 
@@ -40,6 +40,7 @@ using std::vector;
 
 const char kServerPidFile[] = "server.pid.txt";
 const char kServerPidSymlink[] = "server.pid";
+const char kServerSocketFile[] = "command.socket";
 
 string MakeAbsolute(const string &path) {
   // Check if path is already absolute.
@@ -29,6 +29,10 @@ namespace blaze {
 
 extern const char kServerPidFile[];
 
+// Name of the AF_UNIX socket the server listens on in its server directory, in
+// addition to its TCP port, on the platforms that support it.
+extern const char kServerSocketFile[];
+
 // TODO(laszlocsomor) 2016-11-21: remove kServerPidSymlink after 2017-05-01
 // (~half a year from writing this comment). By that time old Bazel clients that
 // used to write PID symlinks will probably no longer be in use.
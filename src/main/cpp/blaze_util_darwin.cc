@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <errno.h>
 #include <libproc.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -139,6 +140,15 @@ void SetScheduling(bool batch_cpu_scheduling, int io_nice_level) {
   // stubbed out so we can compile for Darwin.
 }
 
+void SetServerPlacement(const string& cpus, int numa_node,
+                        const string& cgroup) {
+  if (!cpus.empty() || numa_node >= 0 || !cgroup.empty()) {
+    die(blaze_exit_code::BAD_ARGV,
+        "--server_cpus, --server_numa_node and --server_cgroup are not "
+        "supported on macOS.");
+  }
+}
+
 string GetProcessCWD(int pid) {
   struct proc_vnodepathinfo info = {};
   if (proc_pidinfo(
@@ -148,6 +158,15 @@ string GetProcessCWD(int pid) {
   return string(info.pvi_cdir.vip_path);
 }
 
+int64_t GetProcessCpuTimeMillis(int pid) {
+  struct proc_taskinfo info = {};
+  if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) !=
+      sizeof(info)) {
+    return -1;
+  }
+  return (info.pti_total_user + info.pti_total_system) / 1000000;
+}
+
 bool IsSharedLibrary(const string &filename) {
   return blaze_util::ends_with(filename, ".dylib");
 }
@@ -183,7 +202,8 @@ string GetDefaultHostJavabase() {
   return javabase.substr(0, javabase.length()-1);
 }
 
-void WriteSystemSpecificProcessIdentifier(const string& server_dir) {
+void WriteSystemSpecificProcessIdentifier(const string& server_dir,
+                                          int server_pid) {
 }
 
 bool VerifyServerProcess(
@@ -193,6 +213,11 @@ bool VerifyServerProcess(
   return true;
 }
 
+bool IsServerProcessAlive(int pid, const string& server_dir) {
+  // The PID may have been reused, but at least a dead server is detected.
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
 bool KillServerProcess(int pid) {
   killpg(pid, SIGKILL);
   return true;
@@ -224,4 +249,9 @@ void ExcludePathFromBackup(const string &path) {
   }
 }
 
+// Not supported.
+bool SyncFileSystem(const string& path) {
+  return false;
+}
+
 }   // namespace blaze.
@@ -114,6 +114,15 @@ void SetScheduling(bool batch_cpu_scheduling, int io_nice_level) {
   }
 }
 
+void SetServerPlacement(const string& cpus, int numa_node,
+                        const string& cgroup) {
+  if (!cpus.empty() || numa_node >= 0 || !cgroup.empty()) {
+    die(blaze_exit_code::BAD_ARGV,
+        "--server_cpus, --server_numa_node and --server_cgroup are not "
+        "supported on FreeBSD.");
+  }
+}
+
 string GetProcessCWD(int pid) {
   if (kill(pid, 0) < 0) return "";
   auto procstat = procstat_open_sysctl();
@@ -139,6 +148,21 @@ string GetProcessCWD(int pid) {
   return cwd;
 }
 
+int64_t GetProcessCpuTimeMillis(int pid) {
+  auto procstat = procstat_open_sysctl();
+  unsigned int n;
+  auto p = procstat_getprocs(procstat, KERN_PROC_PID, pid, &n);
+  int64_t result = -1;
+  if (p) {
+    if (n == 1) {
+      result = p->ki_runtime / 1000;  // In microseconds.
+    }
+    procstat_freeprocs(procstat, p);
+  }
+  procstat_close(procstat);
+  return result;
+}
+
 bool IsSharedLibrary(const string &filename) {
   return blaze_util::ends_with(filename, ".so");
 }
@@ -149,7 +173,8 @@ string GetDefaultHostJavabase() {
   return !javahome.empty() ? javahome : "/usr/local/openjdk8";
 }
 
-void WriteSystemSpecificProcessIdentifier(const string& server_dir) {
+void WriteSystemSpecificProcessIdentifier(const string& server_dir,
+                                          int server_pid) {
 }
 
 bool VerifyServerProcess(
@@ -159,6 +184,11 @@ bool VerifyServerProcess(
   return true;
 }
 
+bool IsServerProcessAlive(int pid, const string& server_dir) {
+  // The PID may have been reused, but at least a dead server is detected.
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
 bool KillServerProcess(int pid) {
   killpg(pid, SIGKILL);
   return true;
@@ -168,4 +198,9 @@ bool KillServerProcess(int pid) {
 void ExcludePathFromBackup(const string &path) {
 }
 
+// Not supported.
+bool SyncFileSystem(const string& path) {
+  return false;
+}
+
 }  // namespace blaze
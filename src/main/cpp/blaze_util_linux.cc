@@ -13,9 +13,12 @@
 // limitations under the License.
 
 #include <errno.h>  // errno, ENAMETOOLONG
+#include <fcntl.h>  // open
 #include <limits.h>
 #include <linux/magic.h>
+#include <linux/mempolicy.h>  // MPOL_PREFERRED
 #include <pwd.h>
+#include <sched.h>  // sched_setaffinity
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,6 +26,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/statfs.h>
+#include <sys/syscall.h>  // SYS_set_mempolicy
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -32,6 +36,7 @@
 #include "src/main/cpp/util/exit_code.h"
 #include "src/main/cpp/util/file.h"
 #include "src/main/cpp/util/file_platform.h"
+#include "src/main/cpp/util/numbers.h"
 #include "src/main/cpp/util/port.h"
 #include "src/main/cpp/util/strings.h"
 
@@ -129,6 +134,99 @@ void SetScheduling(bool batch_cpu_scheduling, int io_nice_level) {
   }
 }
 
+// Adds the CPUs of `list`, a list like "0-23,48" as found in
+// /sys/devices/system/node/node*/cpulist, to `cpus`. Returns false if it is
+// malformed.
+static bool ParseCpuList(const string& list, cpu_set_t* cpus) {
+  for (const auto& range : blaze_util::Split(list, ',')) {
+    size_t dash = range.find('-');
+    int first, last;
+    if (!blaze_util::safe_strto32(range.substr(0, dash), &first) ||
+        (dash != string::npos &&
+         !blaze_util::safe_strto32(range.substr(dash + 1), &last))) {
+      return false;
+    }
+    if (dash == string::npos) {
+      last = first;
+    }
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      CPU_SET(cpu, cpus);
+    }
+  }
+  return true;
+}
+
+void SetServerPlacement(const string& cpus, int numa_node,
+                        const string& cgroup) {
+  if (!cpus.empty() || numa_node >= 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (!cpus.empty() && !ParseCpuList(cpus, &cpu_set)) {
+      die(blaze_exit_code::BAD_ARGV, "Invalid CPU list '%s'", cpus.c_str());
+    }
+
+    if (numa_node >= 0) {
+      string cpulist_file = "/sys/devices/system/node/node" +
+                            ToString(numa_node) + "/cpulist";
+      string node_cpus;
+      cpu_set_t node_cpu_set;
+      CPU_ZERO(&node_cpu_set);
+      if (!blaze_util::ReadFile(cpulist_file, &node_cpus) ||
+          !ParseCpuList(node_cpus.substr(0, node_cpus.find('\n')),
+                        &node_cpu_set)) {
+        die(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+            "Cannot read the CPUs of NUMA node %d from %s", numa_node,
+            cpulist_file.c_str());
+      }
+      if (cpus.empty()) {
+        CPU_OR(&cpu_set, &cpu_set, &node_cpu_set);
+      } else {
+        CPU_AND(&cpu_set, &cpu_set, &node_cpu_set);
+      }
+
+      // Prefer rather than require the memory of the node, so that the server
+      // doesn't run out of memory when the node does.
+      unsigned long node_mask[1024 / (8 * sizeof(unsigned long))] = {};
+      size_t max_node = 8 * sizeof(node_mask);
+      if (static_cast<size_t>(numa_node) >= max_node) {
+        die(blaze_exit_code::BAD_ARGV, "Invalid NUMA node %d", numa_node);
+      }
+      node_mask[numa_node / (8 * sizeof(unsigned long))] |=
+          1UL << (numa_node % (8 * sizeof(unsigned long)));
+      // set_mempolicy() reads one bit less than its maxnode argument says.
+      if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, node_mask,
+                  max_node + 1) == -1) {
+        pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+             "set_mempolicy() for NUMA node %d failed", numa_node);
+      }
+    }
+
+    if (CPU_COUNT(&cpu_set) == 0) {
+      die(blaze_exit_code::BAD_ARGV,
+          "No CPU left for the server with --server_cpus=%s and "
+          "--server_numa_node=%d", cpus.c_str(), numa_node);
+    }
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == -1) {
+      pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+           "sched_setaffinity() failed");
+    }
+  }
+
+  if (!cgroup.empty()) {
+    // Writing a PID to cgroup.procs moves that process to the cgroup.
+    string procs_file =
+        blaze_util::JoinPath(blaze_util::JoinPath("/sys/fs/cgroup", cgroup),
+                             "cgroup.procs");
+    if (!blaze_util::WriteFile(ToString(getpid()), procs_file)) {
+      pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+           "Cannot move the server to cgroup %s", cgroup.c_str());
+    }
+  }
+}
+
 string GetProcessCWD(int pid) {
   char server_cwd[PATH_MAX] = {};
   if (readlink(
@@ -140,6 +238,29 @@ string GetProcessCWD(int pid) {
   return string(server_cwd);
 }
 
+int64_t GetProcessCpuTimeMillis(int pid) {
+  string statline;
+  if (!blaze_util::ReadFile("/proc/" + ToString(pid) + "/stat", &statline)) {
+    return -1;
+  }
+
+  // The name of the executable, in parentheses, may contain spaces. The
+  // entries after it start with the third one, the state of the process.
+  size_t name_end = statline.rfind(')');
+  if (name_end == string::npos) {
+    return -1;
+  }
+  vector<string> stat_entries =
+      blaze_util::Split(statline.substr(name_end + 1), ' ');
+  if (stat_entries.size() < 13) {
+    return -1;
+  }
+  // User and system times in clock ticks, the 14th and 15th entries.
+  int64_t ticks = strtoll(stat_entries[11].c_str(), NULL, 10) +
+                  strtoll(stat_entries[12].c_str(), NULL, 10);
+  return ticks * 1000 / sysconf(_SC_CLK_TCK);
+}
+
 bool IsSharedLibrary(const string &filename) {
   return blaze_util::ends_with(filename, ".so");
 }
@@ -214,8 +335,9 @@ static bool GetStartTime(const string& pid, string* start_time) {
   return true;
 }
 
-void WriteSystemSpecificProcessIdentifier(const string& server_dir) {
-  string pid = ToString(getpid());
+void WriteSystemSpecificProcessIdentifier(const string& server_dir,
+                                          int server_pid) {
+  string pid = ToString(server_pid);
 
   string start_time;
   if (!GetStartTime(pid, &start_time)) {
@@ -235,6 +357,10 @@ void WriteSystemSpecificProcessIdentifier(const string& server_dir) {
 // than there are PIDs available within a single jiffy.
 bool VerifyServerProcess(
     int pid, const string& output_base, const string& install_base) {
+  return IsServerProcessAlive(pid, blaze_util::JoinPath(output_base, "server"));
+}
+
+bool IsServerProcessAlive(int pid, const string& server_dir) {
   string start_time;
   if (!GetStartTime(ToString(pid), &start_time)) {
     // Cannot read PID file from /proc . Process died meantime, all is good. No
@@ -244,7 +370,7 @@ bool VerifyServerProcess(
 
   string recorded_start_time;
   bool file_present = blaze_util::ReadFile(
-      blaze_util::JoinPath(output_base, "server/server.starttime"),
+      blaze_util::JoinPath(server_dir, "server.starttime"),
       &recorded_start_time);
 
   // If start time file got deleted, but PID file didn't, assume taht this is an
@@ -272,4 +398,14 @@ bool KillServerProcess(int pid) {
 void ExcludePathFromBackup(const string &path) {
 }
 
+bool SyncFileSystem(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool result = syncfs(fd) == 0;
+  close(fd);
+  return result;
+}
+
 }  // namespace blaze
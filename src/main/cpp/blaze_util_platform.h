@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -74,9 +75,22 @@ uint64_t GetMillisecondsSinceProcessStart();
 // on Linux, so it should only be called when necessary.
 void SetScheduling(bool batch_cpu_scheduling, int io_nice_level);
 
+// Restricts the calling thread, and the processes it starts from now on, to the
+// CPUs in `cpus` (a list like "0-23,48") unless it's empty, and to the CPUs of
+// NUMA node `numa_node`, preferring its memory, unless it's negative. Moves
+// this process to the cgroup v2 `cgroup` (relative to the root of the cgroup
+// file system) unless it's empty. Dies if that fails, or if any of them is set
+// on a platform other than Linux.
+void SetServerPlacement(const std::string& cpus, int numa_node,
+                        const std::string& cgroup);
+
 // Returns the cwd for a process.
 std::string GetProcessCWD(int pid);
 
+// Returns the CPU time (user and system) a process used so far in
+// milliseconds, or -1 if it is not known, e.g. if the process doesn't exist.
+int64_t GetProcessCpuTimeMillis(int pid);
+
 bool IsSharedLibrary(const std::string& filename);
 
 // Return the default path to the JDK used to run Blaze itself
@@ -96,19 +110,51 @@ class BlazeServerStartup {
  public:
   virtual ~BlazeServerStartup() {}
   virtual bool IsStillAlive() = 0;
+
+  // Waits at most "timeout_ms" milliseconds until the server reports that it
+  // is ready to accept connections, or dies. Returns true if the server
+  // reported its readiness, now or before, or if it cannot report it, in which
+  // case this just sleeps: the caller should then try to connect. Returns
+  // false otherwise.
+  virtual bool WaitUntilReady(int timeout_ms) = 0;
 };
 
 // Starts a daemon process with its standard output and standard error
 // redirected to the file "daemon_output". Sets server_startup to an object
-// that can be used to query if the server is still alive. The PID of the
-// daemon started is written into server_dir, both as a symlink (for legacy
-// reasons) and as a file.
+// that can be used to query if the server is still alive and wait until it is
+// ready. Where supported, the daemon is passed the file descriptor it reports
+// its readiness on with --server_ready_fd. The PID of the daemon started is
+// written into server_dir, both as a symlink (for legacy reasons) and as a
+// file. The forked process doesn't allocate memory before running "exe", so
+// this may be called while the client has other threads, e.g. gRPC's.
 void ExecuteDaemon(const std::string& exe,
                    const std::vector<std::string>& args_vector,
                    const std::string& daemon_output,
                    const std::string& server_dir,
                    BlazeServerStartup** server_startup);
 
+// Runs a program in the background, detached from the client, with its
+// standard output and standard error redirected to the file "output". The
+// program writes its result to "tmp_result": once it exits, that file is
+// renamed to "result" if the program succeeded, and otherwise deleted and
+// "failed_marker" created. That is done by a shell of the platform, so no code
+// of the client runs in the detached process, and this may be called while the
+// client has other threads; the client doesn't wait for either. Returns false
+// if the program couldn't be started.
+bool ExecuteDetached(const std::string& exe,
+                     const std::vector<std::string>& args_vector,
+                     const std::string& output, const std::string& tmp_result,
+                     const std::string& result,
+                     const std::string& failed_marker);
+
+// Calls "work" in a process of its own, detached from the client, with its
+// standard output and standard error redirected to the file "output"; the
+// client doesn't wait for it. Only the calling thread exists in that process,
+// so this must not be called while other threads could hold locks. Returns
+// false if the process couldn't be started, or if this isn't supported on this
+// platform.
+bool RunDetached(const std::string& output, const std::function<void()>& work);
+
 // Get the version string from the given java executable. The java executable
 // is supposed to output a string in the form '.*version ".*".*'. This method
 // will return the part in between the two quote or the empty string on failure
@@ -164,6 +210,12 @@ void ReleaseLock(BlazeLock* blaze_lock);
 bool VerifyServerProcess(int pid, const std::string& output_base,
                          const std::string& install_base);
 
+// Returns true if the server process `pid`, whose PID file was written to
+// `server_dir` by ExecuteDaemon(), is still running. Unlike
+// VerifyServerProcess(), this returns false where the platform can tell that
+// no such process exists, even if it can't identify the server for sure.
+bool IsServerProcessAlive(int pid, const std::string& server_dir);
+
 // Kills a server process based on its PID.
 // Returns true if the server process was found and killed.
 // WARNING! This function can be called from a signal handler!
@@ -172,6 +224,12 @@ bool KillServerProcess(int pid);
 // Mark path as being excluded from backups (if supported by operating system).
 void ExcludePathFromBackup(const std::string& path);
 
+// Flushes to disk everything written to the file system containing `path` in a
+// single call (if supported by operating system).
+// Returns false if this is not supported or failed, in which case the caller
+// should sync the files it wrote one by one using blaze_util::SyncFile.
+bool SyncFileSystem(const std::string& path);
+
 // Returns the canonical form of the base dir given a root and a hashable
 // string. The resulting dir is composed of the root + md5(hashable)
 std::string GetHashedBaseDir(const std::string& root,
@@ -191,6 +249,14 @@ void UnsetEnv(const std::string& name);
 // Ensure we have open file descriptors for stdin/stdout/stderr.
 void SetupStdStreams();
 
+// Writes the concatenation of `chunks` to the standard output if `to_stdout`
+// is true, to the standard error otherwise. On POSIX, this writes directly to
+// the file descriptor with as few system calls as possible (a single writev()
+// unless it is interrupted or writes partially). On Windows, this fwrite()s
+// each chunk. Returns false on error, with errno set (to EPIPE if the reading
+// end of a pipe was closed).
+bool WriteToStdOutErr(const std::vector<std::string>& chunks, bool to_stdout);
+
 std::string GetUserName();
 
 // Returns true iff the current terminal is running inside an Emacs.
@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>  // PATH_MAX
+#include <poll.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -22,9 +23,12 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "src/main/cpp/blaze_util.h"
 #include "src/main/cpp/blaze_util_platform.h"
 #include "src/main/cpp/global_variables.h"
@@ -200,18 +204,28 @@ static void Daemonize(const string& daemon_output) {
   (void) dup(STDOUT_FILENO);  // stderr (2>&1)
 }
 
+// Keeps an eye on the server through the reading side of a pipe whose writing
+// side only the server holds: the pipe reaches end-of-file when the server
+// dies. The server writes to the pipe once it accepts connections.
 class PipeBlazeServerStartup : public BlazeServerStartup {
  public:
   PipeBlazeServerStartup(int pipe_fd);
   virtual ~PipeBlazeServerStartup();
   virtual bool IsStillAlive();
+  virtual bool WaitUntilReady(int timeout_ms);
 
  private:
+  // Reads what the server wrote to the pipe. Returns false if the pipe reached
+  // end-of-file.
+  bool ReadPipe();
+
   int pipe_fd;
+  bool ready;
 };
 
 PipeBlazeServerStartup::PipeBlazeServerStartup(int pipe_fd) {
   this->pipe_fd = pipe_fd;
+  this->ready = false;
   if (fcntl(pipe_fd, F_SETFL, O_NONBLOCK | fcntl(pipe_fd, F_GETFL))) {
     pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
          "Failed: fcntl to enable O_NONBLOCK on pipe");
@@ -222,12 +236,38 @@ PipeBlazeServerStartup::~PipeBlazeServerStartup() {
   close(pipe_fd);
 }
 
+bool PipeBlazeServerStartup::ReadPipe() {
+  char buf[64];
+  ssize_t r;
+  while ((r = read(this->pipe_fd, buf, sizeof buf)) > 0) {
+    this->ready = true;
+  }
+  return r == -1 && errno == EAGAIN;
+}
+
 bool PipeBlazeServerStartup::IsStillAlive() {
-  char c;
-  return read(this->pipe_fd, &c, 1) == -1 && errno == EAGAIN;
+  return ReadPipe();
 }
 
-void WriteSystemSpecificProcessIdentifier(const string& server_dir);
+bool PipeBlazeServerStartup::WaitUntilReady(int timeout_ms) {
+  if (this->ready) {
+    // Don't spin if connecting fails although the server is ready.
+    poll(NULL, 0, timeout_ms);
+    return true;
+  }
+
+  struct pollfd pfd = {};
+  pfd.fd = this->pipe_fd;
+  pfd.events = POLLIN;
+  // Returns early with POLLHUP if the server dies.
+  if (poll(&pfd, 1, timeout_ms) > 0) {
+    ReadPipe();
+  }
+  return this->ready;
+}
+
+void WriteSystemSpecificProcessIdentifier(const string& server_dir,
+                                          int server_pid);
 
 void ExecuteDaemon(const string& exe,
                    const std::vector<string>& args_vector,
@@ -237,33 +277,122 @@ void ExecuteDaemon(const string& exe,
   if (pipe(fds)) {
     pdie(blaze_exit_code::INTERNAL_ERROR, "pipe creation failed");
   }
+  // The daemon sends its PID on this pipe, for the client to write it into
+  // server_dir.
+  int pid_fds[2];
+  if (pipe(pid_fds)) {
+    pdie(blaze_exit_code::INTERNAL_ERROR, "pipe creation failed");
+  }
+
+  // The server reports that it accepts connections on the writing side.
+  std::vector<string> args(args_vector);
+  args.push_back("--server_ready_fd=" + ToString(fds[1]));
+  // The client may have other threads (e.g. gRPC's), which could hold locks in
+  // the child, so the child doesn't allocate memory: build everything it needs
+  // before forking.
+  std::vector<char*> argv;
+  for (const string& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(NULL);
+  string exec_error = "Cannot execute " + exe + "\n";
+  if (VerboseLogging()) {
+    string dbg;
+    for (const auto& arg : args) {
+      dbg.append(arg);
+      dbg.append(" ");
+    }
+    fprintf(stderr, "Starting daemon %s:\n  %s\n", exe.c_str(), dbg.c_str());
+  }
+
   int child = fork();
   if (child == -1) {
     pdie(blaze_exit_code::INTERNAL_ERROR, "fork() failed");
   } else if (child > 0) {  // we're the parent
     close(fds[1]);  // parent keeps only the reading side
+    close(pid_fds[1]);
     int unused_status;
     waitpid(child, &unused_status, 0);  // child double-forks
+    int server_pid;
+    ssize_t bytes_read;
+    do {
+      bytes_read = read(pid_fds[0], &server_pid, sizeof(server_pid));
+    } while (bytes_read == -1 && errno == EINTR);
+    close(pid_fds[0]);
+    if (bytes_read != sizeof(server_pid)) {
+      die(blaze_exit_code::INTERNAL_ERROR,
+          "Cannot get the PID of the daemon started for %s",
+          server_dir.c_str());
+    }
+
+    string pid_file = blaze_util::JoinPath(server_dir, kServerPidFile);
+    if (!blaze_util::WriteFile(ToString(server_pid), pid_file)) {
+      pdie(blaze_exit_code::LOCAL_ENVIRONMENTAL_ERROR,
+           "Cannot write PID file %s", pid_file.c_str());
+    }
+    WriteSystemSpecificProcessIdentifier(server_dir, server_pid);
     *server_startup = new PipeBlazeServerStartup(fds[0]);
     return;
-  } else {
-    close(fds[0]);  // child keeps only the writing side
   }
 
+  close(fds[0]);  // child keeps only the writing side
+  close(pid_fds[0]);
   Daemonize(daemon_output);
-  string pid_string = GetProcessIdAsString();
-  string pid_file = blaze_util::JoinPath(server_dir, kServerPidFile);
+  int pid = getpid();
+  (void) write(pid_fds[1], &pid, sizeof(pid));
+  close(pid_fds[1]);
+  execv(exe.c_str(), argv.data());
+  // The output of this ends up in daemon_output.
+  (void) write(STDERR_FILENO, exec_error.data(), exec_error.size());
+  _exit(blaze_exit_code::INTERNAL_ERROR);
+}
 
-  if (!blaze_util::WriteFile(pid_string, pid_file)) {
-    // The exit code does not matter because we are already in the daemonized
-    // server. The output of this operation will end up in jvm.out .
-    pdie(0, "Cannot write PID file");
+bool ExecuteDetached(const string& exe, const std::vector<string>& args_vector,
+                     const string& output, const string& tmp_result,
+                     const string& result, const string& failed_marker) {
+  // The shell runs the program with the arguments after the first four.
+  static const char kScript[] =
+      "tmp=$1 result=$2 failed=$3; shift 3; "
+      "if \"$@\"; then mv -f \"$tmp\" \"$result\" && exit 0; fi; "
+      "rm -f \"$tmp\"; : > \"$failed\"";
+  std::vector<string> sh_args = {"sh",       "-c",   kScript,       "sh",
+                                 tmp_result, result, failed_marker, exe};
+  sh_args.insert(sh_args.end(), args_vector.begin() + 1, args_vector.end());
+  // The client may have other threads, which could hold locks in the child, so
+  // the child doesn't allocate memory: build the argument array before forking.
+  std::vector<char*> argv;
+  for (const string& arg : sh_args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
   }
+  argv.push_back(NULL);
 
-  WriteSystemSpecificProcessIdentifier(server_dir);
+  int child = fork();
+  if (child == -1) {
+    return false;
+  } else if (child > 0) {  // we're the parent
+    int status;
+    waitpid(child, &status, 0);  // child double-forks
+    return WIFEXITED(status) && WEXITSTATUS(status) == blaze_exit_code::SUCCESS;
+  }
 
-  ExecuteProgram(exe, args_vector);
-  pdie(0, "Cannot execute %s", exe.c_str());
+  Daemonize(output);
+  execv("/bin/sh", argv.data());
+  _exit(blaze_exit_code::INTERNAL_ERROR);
+}
+
+bool RunDetached(const string& output, const std::function<void()>& work) {
+  int child = fork();
+  if (child == -1) {
+    return false;
+  } else if (child > 0) {  // we're the parent
+    int status;
+    waitpid(child, &status, 0);  // child double-forks
+    return WIFEXITED(status) && WEXITSTATUS(status) == blaze_exit_code::SUCCESS;
+  }
+
+  Daemonize(output);
+  work();
+  _exit(blaze_exit_code::SUCCESS);
 }
 
 static string RunProgram(const string& exe,
@@ -510,6 +639,41 @@ void ReleaseLock(BlazeLock* blaze_lock) {
   close(blaze_lock->lockfd);
 }
 
+bool WriteToStdOutErr(const vector<string>& chunks, bool to_stdout) {
+  int fd = to_stdout ? STDOUT_FILENO : STDERR_FILENO;
+  vector<struct iovec> iov;
+  iov.reserve(chunks.size());
+  for (const string& chunk : chunks) {
+    if (!chunk.empty()) {
+      iov.push_back({const_cast<char*>(chunk.data()), chunk.size()});
+    }
+  }
+
+  size_t first = 0;
+  while (first < iov.size()) {
+    ssize_t written = writev(fd, &iov[first],
+                             std::min(iov.size() - first,
+                                      static_cast<size_t>(IOV_MAX)));
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    // Skip what was written, which may end in the middle of a chunk.
+    size_t remaining = written;
+    while (remaining > 0 && remaining >= iov[first].iov_len) {
+      remaining -= iov[first].iov_len;
+      first++;
+    }
+    if (remaining > 0) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+      iov[first].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
 string GetUserName() {
   string user = GetEnv("USER");
   if (!user.empty()) {
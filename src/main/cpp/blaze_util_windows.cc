@@ -334,6 +334,15 @@ void SetScheduling(bool batch_cpu_scheduling, int io_nice_level) {
   // TODO(bazel-team): There should be a similar function on Windows.
 }
 
+void SetServerPlacement(const string& cpus, int numa_node,
+                        const string& cgroup) {
+  if (!cpus.empty() || numa_node >= 0 || !cgroup.empty()) {
+    die(blaze_exit_code::BAD_ARGV,
+        "--server_cpus, --server_numa_node and --server_cgroup are not "
+        "supported on Windows.");
+  }
+}
+
 string GetProcessCWD(int pid) {
 #ifdef COMPILER_MSVC
   // TODO(bazel-team) 2016-11-18: decide whether we need this on Windows and
@@ -563,6 +572,12 @@ class DummyBlazeServerStartup : public BlazeServerStartup {
   DummyBlazeServerStartup() {}
   virtual ~DummyBlazeServerStartup() {}
   virtual bool IsStillAlive() { return true; }
+  virtual bool WaitUntilReady(int timeout_ms) {
+    // The server isn't passed a pipe to report its readiness on Windows, so
+    // the client keeps polling by trying to connect.
+    Sleep(timeout_ms);
+    return true;
+  }
 };
 
 void ExecuteDaemon(const string& exe, const std::vector<string>& args_vector,
@@ -1029,6 +1044,28 @@ static bool IsAbsoluteWindowsPath(const string& p) {
   return false;
 }
 
+int64_t GetProcessCpuTimeMillis(int pid) {
+  HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  if (process == NULL) {
+    return -1;
+  }
+
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  bool result = GetProcessTimes(process, &creation_time, &exit_time,
+                                &kernel_time, &user_time);
+  CloseHandle(process);
+  if (!result) {
+    return -1;
+  }
+  ULARGE_INTEGER kernel, user;
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+  // In 100-nanosecond units.
+  return (kernel.QuadPart + user.QuadPart) / 10000;
+}
+
 bool CompareAbsolutePaths(const string& a, const string& b) {
   string a_real = IsAbsoluteWindowsPath(a) ? ConvertPathToPosix(a) : a;
   string b_real = IsAbsoluteWindowsPath(b) ? ConvertPathToPosix(b) : b;
@@ -1042,6 +1079,17 @@ bool VerifyServerProcess(
   return true;
 }
 
+bool IsServerProcessAlive(int pid, const string& server_dir) {
+  // The PID may have been reused, but at least a dead server is detected.
+  HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+  if (process == NULL) {
+    return false;
+  }
+  bool result = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+  CloseHandle(process);
+  return result;
+}
+
 bool KillServerProcess(int pid) {
   HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, pid);
   if (process == NULL) {
@@ -1062,6 +1110,11 @@ bool KillServerProcess(int pid) {
 void ExcludePathFromBackup(const string &path) {
 }
 
+bool SyncFileSystem(const string& path) {
+  // Like blaze_util::SyncFile, this is a no-op on Windows.
+  return true;
+}
+
 string GetHashedBaseDir(const string& root, const string& hashable) {
   // Builds a shorter output base dir name for Windows.
   // This algorithm only uses 1/3 of the bits to get 8-char alphanumeric
@@ -1188,6 +1241,94 @@ void SetupStdStreams() {
 #endif  // COMPILER_MSVC
 }
 
+bool ExecuteDetached(const string& exe, const std::vector<string>& args_vector,
+                     const string& output, const string& tmp_result,
+                     const string& result, const string& failed_marker) {
+  // cmd.exe runs the program and then moves its result into place, so that
+  // nothing of the client has to outlive it.
+  CmdLine program;
+  CreateCommandLine(&program, exe, args_vector);
+  string tmp = "\"" + ConvertPath(tmp_result) + "\"";
+  string script = string(program.cmdline) + " && move /y " + tmp + " \"" +
+                  ConvertPath(result) + "\" >nul || (del /f /q " + tmp +
+                  " 2>nul & type nul > \"" + ConvertPath(failed_marker) + "\")";
+  // With /s, cmd.exe only strips the outermost quotes, whatever the others.
+  string cmdline_str = "cmd.exe /d /s /c \"" + script + "\"";
+  if (cmdline_str.size() >= MAX_CMDLINE_LENGTH) {
+    return false;
+  }
+  CmdLine cmdline;
+  strncpy(cmdline.cmdline, cmdline_str.c_str(), MAX_CMDLINE_LENGTH - 1);
+  cmdline.cmdline[MAX_CMDLINE_LENGTH - 1] = 0;
+
+  wstring woutput;
+  if (!blaze_util::AsWindowsPathWithUncPrefix(output, &woutput)) {
+    return false;
+  }
+  SECURITY_ATTRIBUTES sa;
+  sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+  // The process writes its stdout and stderr to this handle, so it must be
+  // inheritable.
+  sa.bInheritHandle = TRUE;
+  sa.lpSecurityDescriptor = NULL;
+  HANDLE output_file = ::CreateFileW(
+      /* lpFileName */ woutput.c_str(),
+      /* dwDesiredAccess */ GENERIC_WRITE,
+      /* dwShareMode */ FILE_SHARE_READ,
+      /* lpSecurityAttributes */ &sa,
+      /* dwCreationDisposition */ CREATE_ALWAYS,
+      /* dwFlagsAndAttributes */ FILE_ATTRIBUTE_NORMAL,
+      /* hTemplateFile */ NULL);
+  if (output_file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  PROCESS_INFORMATION processInfo = {0};
+  STARTUPINFOA startupInfo = {0};
+  startupInfo.cb = sizeof(startupInfo);
+  startupInfo.hStdInput = INVALID_HANDLE_VALUE;
+  startupInfo.hStdError = output_file;
+  startupInfo.hStdOutput = output_file;
+  startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+  BOOL ok = CreateProcessA(
+      /* lpApplicationName */ NULL,
+      /* lpCommandLine */ cmdline.cmdline,
+      /* lpProcessAttributes */ NULL,
+      /* lpThreadAttributes */ NULL,
+      /* bInheritHandles */ TRUE,
+      /* dwCreationFlags */ DETACHED_PROCESS | CREATE_NEW_PROCESS_GROUP,
+      /* lpEnvironment */ NULL,
+      /* lpCurrentDirectory */ NULL,
+      /* lpStartupInfo */ &startupInfo,
+      /* lpProcessInformation */ &processInfo);
+  CloseHandle(output_file);
+  if (!ok) {
+    return false;
+  }
+  CloseHandle(processInfo.hProcess);
+  CloseHandle(processInfo.hThread);
+  return true;
+}
+
+bool RunDetached(const string& output, const std::function<void()>& work) {
+  // Not supported: without fork(), "work" would have to be done by running the
+  // client again. So the install user root isn't garbage collected on Windows.
+  return false;
+}
+
+bool WriteToStdOutErr(const vector<string>& chunks, bool to_stdout) {
+  // Write through stdio, one chunk at a time, like the client always did on
+  // Windows: the C runtime handles the text mode translation and the console,
+  // which writing to the underlying handle would bypass.
+  FILE* stream = to_stdout ? stdout : stderr;
+  for (const string& chunk : chunks) {
+    if (fwrite(chunk.data(), 1, chunk.size(), stream) < chunk.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 LARGE_INTEGER WindowsClock::GetFrequency() {
   LARGE_INTEGER result;
   if (!QueryPerformanceFrequency(&result)) {
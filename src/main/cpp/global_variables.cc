@@ -23,6 +23,7 @@ GlobalVariables::GlobalVariables(OptionProcessor* option_processor)
       startup_time(0),
       extract_data_time(0),
       command_wait_time(0),
-      restart_reason(NO_RESTART) {}
+      restart_reason(NO_RESTART),
+      client_start_us(0) {}
 
 }  // namespace blaze
@@ -33,6 +33,17 @@ class StartupOptions;
 // Keep in sync with logging.proto.
 enum RestartReason { NO_RESTART = 0, NO_DAEMON, NEW_VERSION, NEW_OPTIONS };
 
+// A phase of the client startup, recorded for --client_profile.
+struct ProfilePhaseEvent {
+  // Name of the phase, e.g. "AcquireLock".
+  const char *name;
+
+  // Start of the phase in microseconds since the client started, and its
+  // duration in microseconds.
+  uint64_t start_us;
+  uint64_t duration_us;
+};
+
 struct GlobalVariables {
   GlobalVariables(OptionProcessor *option_processor);
 
@@ -87,6 +98,18 @@ struct GlobalVariables {
   // MD5 hash of the Blaze binary (includes deploy.jar, extracted binaries, and
   // anything else that ends up under the install_base).
   std::string install_md5;
+
+  // The file the JVM of the server started by this client records the classes
+  // it loads to, if its install base has no class-data sharing archive yet.
+  std::string server_cds_class_list;
+
+  // The time in us, on a monotonic clock, at which the client started. The
+  // recorded profile phases are relative to it.
+  uint64_t client_start_us;
+
+  // The startup phases recorded so far, written to the file given by
+  // --client_profile once the client hands over to the server.
+  std::vector<ProfilePhaseEvent> profile_phases;
 };
 
 }  // namespace blaze
@@ -27,6 +27,8 @@
 #include "src/main/cpp/util/file.h"
 #include "src/main/cpp/util/file_platform.h"
 #include "src/main/cpp/util/logging.h"
+#include "src/main/cpp/util/md5.h"
+#include "src/main/cpp/util/numbers.h"
 #include "src/main/cpp/util/strings.h"
 #include "src/main/cpp/workspace_layout.h"
 
@@ -56,12 +58,13 @@ blaze_exit_code::ExitCode OptionProcessor::RcFile::Parse(
     const WorkspaceLayout* workspace_layout,
     vector<RcFile*>* rcfiles,
     map<string, vector<RcOption> >* rcoptions,
+    vector<string>* startup_messages,
     string* error) {
   list<string> initial_import_stack;
   initial_import_stack.push_back(filename_);
   return Parse(
       workspace, filename_, index_, workspace_layout,
-      rcfiles, rcoptions, &initial_import_stack,
+      rcfiles, rcoptions, startup_messages, &initial_import_stack,
       error);
 }
 
@@ -72,10 +75,17 @@ blaze_exit_code::ExitCode OptionProcessor::RcFile::Parse(
     const WorkspaceLayout* workspace_layout,
     vector<RcFile*>* rcfiles,
     map<string, vector<RcOption> >* rcoptions,
+    vector<string>* startup_messages,
     list<string>* import_stack,
     string* error) {
   string filename(filename_ref);  // file
   BAZEL_LOG(INFO) << "Parsing the RcFile " << filename;
+  // Stamp the file before reading it, so that a change while reading it
+  // invalidates the rc cache.
+  string stamp;
+  if (blaze_util::GetFileStamp(filename, &stamp)) {
+    (*rcfiles)[index]->SetStamp(stamp);
+  }
   string contents;
   if (!blaze_util::ReadFile(filename, &contents)) {
     // We checked for file readability before, so this is unexpected.
@@ -142,7 +152,8 @@ blaze_exit_code::ExitCode OptionProcessor::RcFile::Parse(
       blaze_exit_code::ExitCode parse_exit_code =
         RcFile::Parse(workspace, rcfiles->back()->Filename(),
                       rcfiles->back()->Index(), workspace_layout,
-                      rcfiles, rcoptions, import_stack, error);
+                      rcfiles, rcoptions, startup_messages, import_stack,
+                      error);
       if (parse_exit_code != blaze_exit_code::SUCCESS) {
         return parse_exit_code;
       }
@@ -160,8 +171,12 @@ blaze_exit_code::ExitCode OptionProcessor::RcFile::Parse(
   if (!startup_options.empty()) {
     string startup_args;
     blaze_util::JoinStrings(startup_options, ' ', &startup_args);
-    fprintf(stderr, "INFO: Reading 'startup' options from %s: %s\n",
-            filename.c_str(), startup_args.c_str());
+    string message;
+    blaze_util::StringPrintf(&message,
+                             "INFO: Reading 'startup' options from %s: %s\n",
+                             filename.c_str(), startup_args.c_str());
+    fputs(message.c_str(), stderr);
+    startup_messages->push_back(message);
   }
   return blaze_exit_code::SUCCESS;
 }
@@ -340,22 +355,39 @@ blaze_exit_code::ExitCode OptionProcessor::ParseOptions(
   }
   candidate_blazerc_paths.push_back(user_blazerc_path);
 
-  // Throw away missing files, dedupe candidate blazerc paths, and parse the
-  // blazercs, all while preserving order. Duplicates can arise if e.g. the
-  // binary's path *is* the depot path.
-  set<string> blazerc_paths;
+  // Throw away missing files and dedupe candidate blazerc paths, all while
+  // preserving order. Duplicates can arise if e.g. the binary's path *is* the
+  // depot path.
+  set<string> blazerc_path_set;
+  vector<string> blazerc_paths;
   for (const auto& candidate_blazerc_path : candidate_blazerc_paths) {
     if (!candidate_blazerc_path.empty()
-        && (blazerc_paths.insert(candidate_blazerc_path).second)) {
-      blazercs_.push_back(
-          new RcFile(candidate_blazerc_path, blazercs_.size()));
+        && (blazerc_path_set.insert(candidate_blazerc_path).second)) {
+      blazerc_paths.push_back(candidate_blazerc_path);
+    }
+  }
+
+  // Parse the blazercs, unless the result of parsing them is cached. If it
+  // isn't, WriteRcCache() caches it once the output user root exists.
+  string rc_cache_file =
+      GetRcCacheFile(workspace, blazerc_paths, cmdLine->startup_args);
+  vector<string> startup_messages;
+  if (ReadRcCache(rc_cache_file, &startup_messages)) {
+    for (const auto& message : startup_messages) {
+      fputs(message.c_str(), stderr);
+    }
+  } else {
+    for (const auto& blazerc_path : blazerc_paths) {
+      blazercs_.push_back(new RcFile(blazerc_path, blazercs_.size()));
       blaze_exit_code::ExitCode parse_exit_code =
           blazercs_.back()->Parse(workspace, workspace_layout_, &blazercs_,
-                                  &rcoptions_, error);
+                                  &rcoptions_, &startup_messages, error);
       if (parse_exit_code != blaze_exit_code::SUCCESS) {
         return parse_exit_code;
       }
     }
+    rc_cache_file_ = rc_cache_file;
+    startup_messages_.swap(startup_messages);
   }
 
   blaze_exit_code::ExitCode parse_startup_options_exit_code =
@@ -394,6 +426,198 @@ blaze_exit_code::ExitCode OptionProcessor::ParseOptions(
   return ParseOptions(args, workspace, cwd, error);
 }
 
+// Version of the format of the rc cache files. Change it whenever the format
+// or the way rc files are parsed changes.
+static const char kRcCacheVersion[] = "1";
+
+// Name of the directory of the output user root holding the rc cache files.
+static const char kRcCacheDir[] = "rc_cache";
+
+namespace {
+
+// Reads the fields of an rc cache file in order. Each field is terminated by a
+// NUL character.
+class RcCacheReader {
+ public:
+  explicit RcCacheReader(const string& contents)
+      : contents_(contents), pos_(0) {}
+
+  bool Next(string* field) {
+    size_t end = contents_.find('\0', pos_);
+    if (end == string::npos) {
+      return false;
+    }
+    field->assign(contents_, pos_, end - pos_);
+    pos_ = end + 1;
+    return true;
+  }
+
+  bool NextCount(int* count) {
+    string field;
+    return Next(&field) && blaze_util::safe_strto32(field, count) &&
+           *count >= 0;
+  }
+
+  bool AtEnd() const { return pos_ == contents_.size(); }
+
+ private:
+  const string& contents_;
+  size_t pos_;
+};
+
+// Appends "field" to the contents of an rc cache file. Returns false if it
+// cannot be stored because it contains a NUL character.
+bool AppendRcCacheField(const string& field, string* contents) {
+  if (field.find('\0') != string::npos) {
+    return false;
+  }
+  contents->append(field);
+  contents->push_back('\0');
+  return true;
+}
+
+}  // namespace
+
+string OptionProcessor::GetRcCacheFile(const string& workspace,
+                                       const vector<string>& blazerc_paths,
+                                       const vector<string>& startup_args) {
+  const char* output_user_root =
+      SearchUnaryOption(startup_args, "--output_user_root");
+  string root = output_user_root != NULL
+                    ? MakeAbsolute(output_user_root)
+                    : parsed_startup_options_->output_user_root;
+
+  blaze_util::Md5Digest digest;
+  digest.Update(workspace.data(), workspace.size() + 1);
+  for (const auto& path : blazerc_paths) {
+    digest.Update(path.data(), path.size() + 1);
+  }
+  unsigned char buf[blaze_util::Md5Digest::kDigestLength];
+  digest.Finish(buf);
+  return blaze_util::JoinPath(blaze_util::JoinPath(root, kRcCacheDir),
+                              digest.String());
+}
+
+bool OptionProcessor::ReadRcCache(const string& cache_file,
+                                  vector<string>* startup_messages) {
+  string contents;
+  if (!blaze_util::ReadFile(cache_file, &contents)) {
+    return false;
+  }
+
+  RcCacheReader reader(contents);
+  string version;
+  if (!reader.Next(&version) || version != kRcCacheVersion) {
+    return false;
+  }
+
+  vector<RcFile*> blazercs;
+  map<string, vector<RcOption> > rcoptions;
+  vector<string> messages;
+  int count;
+  bool valid = reader.NextCount(&count);
+  for (int i = 0; valid && i < count; i++) {
+    string filename;
+    string stamp;
+    string current_stamp;
+    valid = reader.Next(&filename) && reader.Next(&stamp) &&
+            blaze_util::GetFileStamp(filename, &current_stamp) &&
+            stamp == current_stamp;
+    if (valid) {
+      blazercs.push_back(new RcFile(filename, i));
+      blazercs.back()->SetStamp(stamp);
+    }
+  }
+
+  valid = valid && reader.NextCount(&count);
+  for (int i = 0; valid && i < count; i++) {
+    string message;
+    valid = reader.Next(&message);
+    if (valid) {
+      messages.push_back(message);
+    }
+  }
+
+  valid = valid && reader.NextCount(&count);
+  for (int i = 0; valid && i < count; i++) {
+    string command;
+    int rcfile_index;
+    string option;
+    valid = reader.Next(&command) && reader.NextCount(&rcfile_index) &&
+            rcfile_index < static_cast<int>(blazercs.size()) &&
+            reader.Next(&option);
+    if (valid) {
+      rcoptions[command].push_back(RcOption(rcfile_index, option));
+    }
+  }
+
+  if (!valid || !reader.AtEnd()) {
+    BAZEL_LOG(INFO) << "Not using the rc cache " << cache_file;
+    for (auto it : blazercs) {
+      delete it;
+    }
+    return false;
+  }
+
+  BAZEL_LOG(INFO) << "Using the rc cache " << cache_file;
+  blazercs_.swap(blazercs);
+  rcoptions_.swap(rcoptions);
+  startup_messages->swap(messages);
+  return true;
+}
+
+void OptionProcessor::WriteRcCache() {
+  if (rc_cache_file_.empty()) {
+    return;
+  }
+
+  string contents;
+  bool valid = AppendRcCacheField(kRcCacheVersion, &contents) &&
+               AppendRcCacheField(ToString(blazercs_.size()), &contents);
+  for (const auto* blazerc : blazercs_) {
+    valid = valid && !blazerc->Stamp().empty() &&
+            AppendRcCacheField(blazerc->Filename(), &contents) &&
+            AppendRcCacheField(blazerc->Stamp(), &contents);
+  }
+
+  valid = valid &&
+          AppendRcCacheField(ToString(startup_messages_.size()), &contents);
+  for (const auto& message : startup_messages_) {
+    valid = valid && AppendRcCacheField(message, &contents);
+  }
+
+  int option_count = 0;
+  for (const auto& it : rcoptions_) {
+    option_count += it.second.size();
+  }
+  valid = valid && AppendRcCacheField(ToString(option_count), &contents);
+  for (const auto& it : rcoptions_) {
+    for (const auto& rcoption : it.second) {
+      valid = valid && AppendRcCacheField(it.first, &contents) &&
+              AppendRcCacheField(ToString(rcoption.rcfile_index()),
+                                 &contents) &&
+              AppendRcCacheField(rcoption.option(), &contents);
+    }
+  }
+
+  // The output user root isn't created here: CreateSecureOutputRoot() checks
+  // its ownership and permissions. The cache may be under another root than
+  // the one of this invocation, if the rc files set --output_user_root, so
+  // only the rc cache directory is created, and only if the root exists.
+  string cache_dir = blaze_util::Dirname(rc_cache_file_);
+  if (!valid || !blaze_util::IsDirectory(blaze_util::Dirname(cache_dir)) ||
+      !blaze_util::MakeDirectories(cache_dir, 0755)) {
+    return;
+  }
+
+  // Write the cache atomically, so that it is never read half-written.
+  string tmp_cache_file = rc_cache_file_ + ".tmp." + GetProcessIdAsString();
+  if (!blaze_util::WriteFile(contents, tmp_cache_file) ||
+      rename(tmp_cache_file.c_str(), rc_cache_file_.c_str()) == -1) {
+    blaze_util::UnlinkPath(tmp_cache_file);
+  }
+}
+
 blaze_exit_code::ExitCode OptionProcessor::ParseStartupOptions(string *error) {
   // Process rcfile startup options
   map< string, vector<RcOption> >::const_iterator it =
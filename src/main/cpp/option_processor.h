@@ -101,6 +101,11 @@ class OptionProcessor {
 
   StartupOptions* GetParsedStartupOptions() const;
 
+  // Caches the result of parsing the rc files, unless ParseOptions() read it
+  // from the cache. Call it once the output user root has been created (see
+  // CreateSecureOutputRoot()).
+  void WriteRcCache();
+
   virtual blaze_exit_code::ExitCode FindUserBlazerc(
       const char* cmdLineRcFile,
       const std::string& workspace, std::string* user_blazerc_file,
@@ -122,13 +127,19 @@ class OptionProcessor {
   class RcFile {
    public:
     RcFile(const std::string& filename, int index);
+    // Parses the file and the files it imports. The messages printed about
+    // the startup options read are appended to "startup_messages".
     blaze_exit_code::ExitCode Parse(
         const std::string& workspace, const WorkspaceLayout* workspace_layout,
         std::vector<RcFile*>* rcfiles,
         std::map<std::string, std::vector<RcOption> >* rcoptions,
-        std::string* error);
+        std::vector<std::string>* startup_messages, std::string* error);
     const std::string& Filename() const { return filename_; }
     const int Index() const { return index_; }
+    // The stamp of the file when it was parsed (see blaze_util::GetFileStamp),
+    // or empty if it couldn't be determined.
+    const std::string& Stamp() const { return stamp_; }
+    void SetStamp(const std::string& stamp) { stamp_ = stamp; }
 
    private:
     static blaze_exit_code::ExitCode Parse(
@@ -136,17 +147,38 @@ class OptionProcessor {
         const int index, const WorkspaceLayout* workspace_layout,
         std::vector<RcFile*>* rcfiles,
         std::map<std::string, std::vector<RcOption> >* rcoptions,
+        std::vector<std::string>* startup_messages,
         std::list<std::string>* import_stack, std::string* error);
 
     std::string filename_;
     int index_;
+    std::string stamp_;
   };
 
   void AddRcfileArgsAndOptions(bool batch, const std::string& cwd);
   blaze_exit_code::ExitCode ParseStartupOptions(std::string* error);
 
+  // Returns the path of the file caching the result of parsing the rc files
+  // "blazerc_paths" (and their imports) for "workspace". It is stored under
+  // the output user root: the output base isn't known yet, as the rc files
+  // can change it.
+  std::string GetRcCacheFile(const std::string& workspace,
+                             const std::vector<std::string>& blazerc_paths,
+                             const std::vector<std::string>& startup_args);
+
+  // Fills blazercs_, rcoptions_ and "startup_messages" from the rc cache file
+  // "cache_file" if none of the rc files it lists changed since it was
+  // written. Returns false, leaving them untouched, otherwise.
+  bool ReadRcCache(const std::string& cache_file,
+                   std::vector<std::string>* startup_messages);
+
   std::vector<RcFile*> blazercs_;
   std::map<std::string, std::vector<RcOption> > rcoptions_;
+  // The rc cache file that WriteRcCache() writes blazercs_, rcoptions_ and
+  // startup_messages_ to, or empty if they were read from it. Nothing is
+  // written if the stamp of an rc file is unknown.
+  std::string rc_cache_file_;
+  std::vector<std::string> startup_messages_;
   std::vector<std::string> args_;
   unsigned int startup_args_;
   std::string command_;
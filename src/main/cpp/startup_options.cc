@@ -40,6 +40,7 @@ StartupOptions::StartupOptions(const WorkspaceLayout* workspace_layout)
 StartupOptions::StartupOptions(const string &product_name,
                                const WorkspaceLayout* workspace_layout)
     : product_name(product_name),
+      full_install_base_verification(false),
       deep_execroot(true),
       block_for_lock(true),
       host_jvm_debug(false),
@@ -56,6 +57,10 @@ StartupOptions::StartupOptions(const string &product_name,
       connect_timeout_secs(10),
       invocation_policy(NULL),
       client_debug(false),
+      server_pool_size(0),
+      server_cds(true),
+      install_base_max_age_days(30),
+      server_numa_node(-1),
       use_custom_exit_code_on_abrupt_exit(true) {
   bool testing = !blaze::GetEnv("TEST_TMPDIR").empty();
   if (testing) {
@@ -82,12 +87,15 @@ StartupOptions::StartupOptions(const string &product_name,
                      "write_command_log",
                      "watchfs",
                      "client_debug",
-                     "use_custom_exit_code_on_abrupt_exit"};
-  unary_options = {"output_base", "install_base",
+                     "use_custom_exit_code_on_abrupt_exit",
+                     "server_cds"};
+  unary_options = {"output_base", "install_base", "install_base_verification",
       "output_user_root", "host_jvm_profile", "host_javabase",
       "host_jvm_args", "bazelrc", "blazerc", "io_nice_level",
       "max_idle_secs", "experimental_oom_more_eagerly_threshold",
-      "command_port", "invocation_policy", "connect_timeout_secs"};
+      "command_port", "invocation_policy", "connect_timeout_secs",
+      "client_profile", "server_pool_size", "install_base_max_age_days",
+      "server_cpus", "server_numa_node", "server_cgroup"};
 }
 
 StartupOptions::~StartupOptions() {}
@@ -220,6 +228,20 @@ blaze_exit_code::ExitCode StartupOptions::ProcessArg(
   } else if (GetNullaryOption(arg, "--nofatal_event_bus_exceptions")) {
     fatal_event_bus_exceptions = false;
     option_sources["fatal_event_bus_exceptions"] = rcfile;
+  } else if ((value = GetUnaryOption(arg, next_arg,
+                                     "--install_base_verification")) != NULL) {
+    if (strcmp(value, "fast") == 0) {
+      full_install_base_verification = false;
+    } else if (strcmp(value, "full") == 0) {
+      full_install_base_verification = true;
+    } else {
+      blaze_util::StringPrintf(error,
+          "Invalid argument to --install_base_verification: '%s'. "
+          "Must be 'fast' or 'full'.",
+          value);
+      return blaze_exit_code::BAD_ARGV;
+    }
+    option_sources["install_base_verification"] = rcfile;
   } else if ((value = GetUnaryOption(arg, next_arg,
                                      "--io_nice_level")) != NULL) {
     if (!blaze_util::safe_strto32(value, &io_nice_level) ||
@@ -270,6 +292,16 @@ blaze_exit_code::ExitCode StartupOptions::ProcessArg(
   } else if (GetNullaryOption(arg, "--nowatchfs")) {
     watchfs = false;
     option_sources["watchfs"] = rcfile;
+  } else if (GetNullaryOption(arg, "--server_cds")) {
+    server_cds = true;
+    option_sources["server_cds"] = rcfile;
+  } else if (GetNullaryOption(arg, "--noserver_cds")) {
+    server_cds = false;
+    option_sources["server_cds"] = rcfile;
+  } else if ((value = GetUnaryOption(arg, next_arg,
+                                     "--client_profile")) != NULL) {
+    client_profile = MakeAbsolute(value);
+    option_sources["client_profile"] = rcfile;
   } else if (GetNullaryOption(arg, "--client_debug")) {
     client_debug = true;
     option_sources["client_debug"] = rcfile;
@@ -293,6 +325,55 @@ blaze_exit_code::ExitCode StartupOptions::ProcessArg(
       return blaze_exit_code::BAD_ARGV;
     }
     option_sources["connect_timeout_secs"] = rcfile;
+  } else if ((value = GetUnaryOption(
+      arg, next_arg, "--server_pool_size")) != NULL) {
+    if (!blaze_util::safe_strto32(value, &server_pool_size) ||
+        server_pool_size < 0 || server_pool_size > 16) {
+      blaze_util::StringPrintf(error,
+          "Invalid argument to --server_pool_size: '%s'.\n"
+          "Must be an integer between 0 and 16.\n",
+          value);
+      return blaze_exit_code::BAD_ARGV;
+    }
+    option_sources["server_pool_size"] = rcfile;
+  } else if ((value = GetUnaryOption(
+      arg, next_arg, "--install_base_max_age_days")) != NULL) {
+    if (!blaze_util::safe_strto32(value, &install_base_max_age_days) ||
+        install_base_max_age_days < 0) {
+      blaze_util::StringPrintf(error,
+          "Invalid argument to --install_base_max_age_days: '%s'.\n"
+          "Must be a non-negative integer.\n",
+          value);
+      return blaze_exit_code::BAD_ARGV;
+    }
+    option_sources["install_base_max_age_days"] = rcfile;
+  } else if ((value = GetUnaryOption(
+      arg, next_arg, "--server_cpus")) != NULL) {
+    server_cpus = value;
+    if (server_cpus.empty() ||
+        server_cpus.find_first_not_of("0123456789,-") != string::npos) {
+      blaze_util::StringPrintf(error,
+          "Invalid argument to --server_cpus: '%s'.\n"
+          "Must be a list of CPUs and CPU ranges, like 0-23,48.\n",
+          value);
+      return blaze_exit_code::BAD_ARGV;
+    }
+    option_sources["server_cpus"] = rcfile;
+  } else if ((value = GetUnaryOption(
+      arg, next_arg, "--server_numa_node")) != NULL) {
+    if (!blaze_util::safe_strto32(value, &server_numa_node) ||
+        server_numa_node < -1) {
+      blaze_util::StringPrintf(error,
+          "Invalid argument to --server_numa_node: '%s'.\n"
+          "Must be a NUMA node number, or -1.\n",
+          value);
+      return blaze_exit_code::BAD_ARGV;
+    }
+    option_sources["server_numa_node"] = rcfile;
+  } else if ((value = GetUnaryOption(
+      arg, next_arg, "--server_cgroup")) != NULL) {
+    server_cgroup = value;
+    option_sources["server_cgroup"] = rcfile;
   } else if ((value = GetUnaryOption(
       arg, next_arg, "--command_port")) != NULL) {
     if (!blaze_util::safe_strto32(value, &command_port) ||
@@ -131,6 +131,12 @@ class StartupOptions {
   // Installation base for a specific release installation.
   std::string install_base;
 
+  // Whether to check the presence and timestamp of every file of an existing
+  // installation base (--install_base_verification=full) rather than only
+  // comparing their stamps with the manifest written when it was extracted
+  // (the default, "fast").
+  bool full_install_base_verification;
+
   // The toplevel directory containing Blaze's output.  When Blaze is
   // run by a test, we use TEST_TMPDIR, simplifying the correct
   // hermetic invocation of Blaze from tests.
@@ -199,7 +205,8 @@ class StartupOptions {
   // gRPC command server.
   int command_port;
 
-  // Connection timeout for each gRPC connection attempt.
+  // How long the client waits for a server that neither responds nor uses CPU
+  // time before giving up on it.
   int connect_timeout_secs;
 
   // Invocation policy proto. May be NULL.
@@ -208,6 +215,35 @@ class StartupOptions {
   // Whether to output addition debugging information in the client.
   bool client_debug;
 
+  // If not empty, the client writes the time spent in each of its startup
+  // phases to this file, as a trace in the Chrome trace event format.
+  std::string client_profile;
+
+  // Number of servers the client keeps pre-started per install base and
+  // workspace, ready to be claimed for an output base that has no server yet.
+  // 0 disables the server pool.
+  int server_pool_size;
+
+  // Whether the JVM of the server uses a class-data sharing archive of the
+  // classes it loads on startup, generated once per install base and JVM.
+  bool server_cds;
+
+  // Install bases of the output user root that no output base of it uses are
+  // removed in the background once unused for this many days. 0 keeps them.
+  int install_base_max_age_days;
+
+  // Only on Linux: the CPUs the server may run on, as a list like "0-23,48",
+  // or "" for all of them.
+  std::string server_cpus;
+
+  // Only on Linux: if not negative, the NUMA node whose CPUs the server runs on
+  // and whose memory it prefers.
+  int server_numa_node;
+
+  // Only on Linux: if not empty, the cgroup v2 the server is moved to, relative
+  // to the root of the cgroup file system, e.g. "build.slice/server1".
+  std::string server_cgroup;
+
   // Whether to check custom file for exit code when the Blaze Server exits
   // abruptly without proper communication over gRPC.
   bool use_custom_exit_code_on_abrupt_exit;
@@ -19,6 +19,7 @@
 #include <time.h>
 
 #include <string>
+#include <vector>
 
 namespace blaze_util {
 
@@ -36,6 +37,11 @@ class IFileMtime {
   // Returns false if querying failed.
   virtual bool GetIfInDistantFuture(const std::string &path, bool *result) = 0;
 
+  // Queries how many seconds ago the file under `path` was last modified.
+  // Returns true if querying succeeded and stores the result in `result`.
+  // Returns false if querying failed.
+  virtual bool GetAgeSeconds(const std::string &path, int64_t *result) = 0;
+
   // Sets the mtime of file under `path` to the current time.
   // Returns true if the mtime was changed successfully.
   virtual bool SetToNow(const std::string &path) = 0;
@@ -45,6 +51,13 @@ class IFileMtime {
   // a decade.
   // Returns true if the mtime was changed successfully.
   virtual bool SetToDistantFuture(const std::string &path) = 0;
+
+  // Writes `size` bytes from `data` into the file under `path`, makes it
+  // executable and sets its mtime to the distant future, opening the file only
+  // once.
+  // Returns false on failure, sets errno.
+  virtual bool WriteFileInDistantFuture(const void *data, size_t size,
+                                        const std::string &path) = 0;
 };
 
 // Creates a platform-specific implementation of `IFileMtime`.
@@ -100,6 +113,30 @@ bool IsRootDirectory(const std::string &path);
 // Returns true if `path` is absolute.
 bool IsAbsolute(const std::string &path);
 
+// Populates `stamps` with a stamp for each of the files or directories `paths`
+// (given relative to `root`), without following symlinks. A stamp changes when
+// the file is replaced, its mode, size or modification time changes, which
+// covers in-place modifications of a file and entries added to, removed from
+// or renamed in a directory. On POSIX, the paths are stat'ed relative to a
+// single open descriptor of `root`.
+// Returns false if any of the paths could not be stat'ed.
+bool GetPathStamps(const std::string &root,
+                   const std::vector<std::string> &paths,
+                   std::vector<std::string> *stamps);
+
+// Populates `stamp` with a stamp of the file `path`, following symlinks. The
+// stamp changes when the file is replaced or its content is modified.
+// Returns false if the file could not be stat'ed, or if this is not supported
+// on the platform.
+bool GetFileStamp(const std::string &path, std::string *stamp);
+
+// Removes `path` and, if it is a directory, everything under it, without
+// following symlinks. The directories of the tree are emptied by up to
+// `max_threads` threads.
+// Returns false if anything could not be removed, or if this is not supported
+// on the platform.
+bool RemoveRecursively(const std::string &path, int max_threads);
+
 // Calls fsync() on the file (or directory) specified in 'file_path'.
 // pdie() if syncing fails.
 void SyncFile(const std::string& path);
@@ -16,12 +16,18 @@
 #include <errno.h>
 #include <dirent.h>  // DIR, dirent, opendir, closedir
 #include <fcntl.h>   // O_RDONLY
+#include <inttypes.h>  // PRIu64
 #include <limits.h>  // PATH_MAX
+#include <stdio.h>  // snprintf
 #include <stdlib.h>  // getenv
 #include <sys/stat.h>
+#include <sys/time.h>  // futimes
 #include <unistd.h>  // access, open, close, fsync
 #include <utime.h>   // utime
 
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "src/main/cpp/util/errors.h"
@@ -266,6 +272,170 @@ bool IsRootDirectory(const string &path) {
 
 bool IsAbsolute(const string &path) { return !path.empty() && path[0] == '/'; }
 
+bool GetPathStamps(const string &root, const std::vector<string> &paths,
+                   std::vector<string> *stamps) {
+  int root_fd = open(root.c_str(), O_RDONLY | O_DIRECTORY);
+  if (root_fd == -1) {
+    return false;
+  }
+  bool result = true;
+  stamps->clear();
+  for (const auto &path : paths) {
+    struct stat buf;
+    if (fstatat(root_fd, path.c_str(), &buf, AT_SYMLINK_NOFOLLOW) == -1) {
+      result = false;
+      break;
+    }
+#if defined(__APPLE__)
+    const struct timespec &mtime = buf.st_mtimespec;
+#else
+    const struct timespec &mtime = buf.st_mtim;
+#endif
+    char stamp[128];
+    snprintf(stamp, sizeof(stamp),
+             "%" PRIu64 ":%o:%" PRIu64 ":%" PRId64 ".%09" PRId64,
+             static_cast<uint64_t>(buf.st_ino),
+             static_cast<unsigned int>(buf.st_mode),
+             static_cast<uint64_t>(buf.st_size),
+             static_cast<int64_t>(mtime.tv_sec),
+             static_cast<int64_t>(mtime.tv_nsec));
+    stamps->push_back(stamp);
+  }
+  close(root_fd);
+  return result;
+}
+
+bool GetFileStamp(const string &path, string *stamp) {
+  struct stat buf;
+  if (stat(path.c_str(), &buf) == -1) {
+    return false;
+  }
+#if defined(__APPLE__)
+  const struct timespec &mtime = buf.st_mtimespec;
+#else
+  const struct timespec &mtime = buf.st_mtim;
+#endif
+  char result[96];
+  snprintf(result, sizeof(result),
+           "%" PRIu64 ":%" PRIu64 ":%" PRId64 ".%09" PRId64,
+           static_cast<uint64_t>(buf.st_ino),
+           static_cast<uint64_t>(buf.st_size),
+           static_cast<int64_t>(mtime.tv_sec),
+           static_cast<int64_t>(mtime.tv_nsec));
+  *stamp = result;
+  return true;
+}
+
+// Removes the entries of the directory `dir` (relative to `root_fd`) that are
+// not directories, and appends the paths of its subdirectories to `subdirs`.
+// Returns false if the directory could not be listed or an entry could not be
+// removed.
+static bool RemoveDirectoryFiles(int root_fd, const string &dir,
+                                 std::vector<string> *subdirs) {
+  int fd = openat(root_fd, dir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+  if (fd == -1) {
+    return false;
+  }
+  DIR *d = fdopendir(fd);
+  if (d == NULL) {
+    close(fd);
+    return false;
+  }
+
+  bool result = true;
+  struct dirent *ent;
+  while ((ent = readdir(d)) != NULL) {
+    if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
+      continue;
+    }
+    bool is_directory;
+    if (ent->d_type == DT_UNKNOWN) {
+      struct stat buf;
+      if (fstatat(fd, ent->d_name, &buf, AT_SYMLINK_NOFOLLOW) == -1) {
+        result = false;
+        continue;
+      }
+      is_directory = S_ISDIR(buf.st_mode);
+    } else {
+      is_directory = (ent->d_type == DT_DIR);
+    }
+
+    if (is_directory) {
+      subdirs->push_back(dir + "/" + ent->d_name);
+    } else if (unlinkat(fd, ent->d_name, 0) == -1) {
+      result = false;
+    }
+  }
+  closedir(d);  // Also closes fd.
+  return result;
+}
+
+bool RemoveRecursively(const string &path, int max_threads) {
+  struct stat buf;
+  if (lstat(path.c_str(), &buf) == -1) {
+    return false;
+  }
+  if (!S_ISDIR(buf.st_mode)) {
+    return unlink(path.c_str()) == 0;
+  }
+  int root_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+  if (root_fd == -1) {
+    return false;
+  }
+
+  // The threads take the directories to empty from `dirs` in the order they
+  // were found, and add the subdirectories they find to it. All the
+  // directories are only removed once empty, deepest first.
+  std::mutex mutex;
+  std::condition_variable found_dirs;
+  std::vector<string> dirs = {"."};
+  size_t next_dir = 0;
+  int busy_threads = 0;
+  bool result = true;
+  auto empty_dirs = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      // Wait for a directory to empty, unless no thread can find one anymore.
+      found_dirs.wait(lock, [&]() {
+        return next_dir < dirs.size() || busy_threads == 0;
+      });
+      if (next_dir == dirs.size()) {
+        return;
+      }
+      string dir = dirs[next_dir++];
+      busy_threads++;
+      lock.unlock();
+
+      std::vector<string> subdirs;
+      bool success = RemoveDirectoryFiles(root_fd, dir, &subdirs);
+
+      lock.lock();
+      busy_threads--;
+      result = result && success;
+      dirs.insert(dirs.end(), subdirs.begin(), subdirs.end());
+      found_dirs.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < max_threads; i++) {
+    threads.push_back(std::thread(empty_dirs));
+  }
+  empty_dirs();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // A directory is always found after its parent.
+  for (size_t i = dirs.size() - 1; i > 0; i--) {
+    if (unlinkat(root_fd, dirs[i].c_str(), AT_REMOVEDIR) == -1) {
+      result = false;
+    }
+  }
+  close(root_fd);
+  return rmdir(path.c_str()) == 0 && result;
+}
+
 void SyncFile(const string& path) {
   const char* file_path = path.c_str();
   int fd = open(file_path, O_RDONLY);
@@ -287,8 +457,11 @@ class PosixFileMtime : public IFileMtime {
         distant_future_({GetFuture(10), GetFuture(10)}) {}
 
   bool GetIfInDistantFuture(const string &path, bool *result) override;
+  bool GetAgeSeconds(const string &path, int64_t *result) override;
   bool SetToNow(const string &path) override;
   bool SetToDistantFuture(const string &path) override;
+  bool WriteFileInDistantFuture(const void *data, size_t size,
+                                const string &path) override;
 
  private:
   // 9 years in the future.
@@ -315,6 +488,15 @@ bool PosixFileMtime::GetIfInDistantFuture(const string &path, bool *result) {
   return true;
 }
 
+bool PosixFileMtime::GetAgeSeconds(const string &path, int64_t *result) {
+  struct stat buf;
+  if (stat(path.c_str(), &buf)) {
+    return false;
+  }
+  *result = static_cast<int64_t>(GetNow()) - buf.st_mtime;
+  return true;
+}
+
 bool PosixFileMtime::SetToNow(const string &path) {
   time_t now(GetNow());
   struct utimbuf times = {now, now};
@@ -325,6 +507,30 @@ bool PosixFileMtime::SetToDistantFuture(const string &path) {
   return Set(path, distant_future_);
 }
 
+bool PosixFileMtime::WriteFileInDistantFuture(const void *data, size_t size,
+                                              const string &path) {
+  UnlinkPath(path);  // We don't care about the success of this.
+  int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0755);  // chmod +x
+  if (fd == -1) {
+    return false;
+  }
+  bool result = WriteTo(
+      [fd](const void *buf, size_t bufsize) { return write(fd, buf, bufsize); },
+      data, size);
+  // Set the mtime through the open file, after the last write.
+  struct timeval times[2] = {{distant_future_.actime, 0},
+                             {distant_future_.modtime, 0}};
+  if (result && futimes(fd, times) == -1) {
+    result = false;
+  }
+  int saved_errno = errno;
+  if (close(fd)) {
+    return false;  // Can fail on NFS.
+  }
+  errno = saved_errno;  // Caller should see errno from write() or futimes().
+  return result;
+}
+
 bool PosixFileMtime::Set(const string &path, const struct utimbuf &mtime) {
   return utime(path.c_str(), &mtime) == 0;
 }
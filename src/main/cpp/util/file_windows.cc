@@ -14,6 +14,8 @@
 #include "src/main/cpp/util/file_platform.h"
 
 #include <ctype.h>  // isalpha
+#include <stdint.h>  // uint64_t
+#include <wchar.h>  // wcscmp
 #include <wctype.h>  // iswalpha
 #include <windows.h>
 
@@ -167,8 +169,11 @@ class WindowsFileMtime : public IFileMtime {
       : near_future_(GetFuture(9)), distant_future_(GetFuture(10)) {}
 
   bool GetIfInDistantFuture(const string& path, bool* result) override;
+  bool GetAgeSeconds(const string& path, int64_t* result) override;
   bool SetToNow(const string& path) override;
   bool SetToDistantFuture(const string& path) override;
+  bool WriteFileInDistantFuture(const void* data, size_t size,
+                                const string& path) override;
 
  private:
   // 9 years in the future.
@@ -178,6 +183,7 @@ class WindowsFileMtime : public IFileMtime {
 
   static FILETIME GetNow();
   static FILETIME GetFuture(WORD years);
+  static bool Get(const string& path, FILETIME* time);
   static bool Set(const string& path, const FILETIME& time);
 };
 
@@ -189,30 +195,8 @@ bool WindowsFileMtime::GetIfInDistantFuture(const string& path, bool* result) {
     *result = false;
     return true;
   }
-  wstring wpath;
-  if (!AsWindowsPathWithUncPrefix(path, &wpath)) {
-    return false;
-  }
-
-  windows_util::AutoHandle handle(::CreateFileW(
-      /* lpFileName */ wpath.c_str(),
-      /* dwDesiredAccess */ GENERIC_READ,
-      /* dwShareMode */ FILE_SHARE_READ,
-      /* lpSecurityAttributes */ NULL,
-      /* dwCreationDisposition */ OPEN_EXISTING,
-      /* dwFlagsAndAttributes */ IsDirectoryW(wpath)
-          ? (FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS)
-          : FILE_ATTRIBUTE_NORMAL,
-      /* hTemplateFile */ NULL));
-  if (handle.handle == INVALID_HANDLE_VALUE) {
-    return false;
-  }
   FILETIME mtime;
-  if (!::GetFileTime(
-          /* hFile */ handle.handle,
-          /* lpCreationTime */ NULL,
-          /* lpLastAccessTime */ NULL,
-          /* lpLastWriteTime */ &mtime)) {
+  if (!Get(path, &mtime)) {
     return false;
   }
 
@@ -226,6 +210,28 @@ bool WindowsFileMtime::GetIfInDistantFuture(const string& path, bool* result) {
   return true;
 }
 
+bool WindowsFileMtime::GetAgeSeconds(const string& path, int64_t* result) {
+  if (path.empty()) {
+    return false;
+  }
+  FILETIME mtime;
+  if (!Get(path, &mtime)) {
+    return false;
+  }
+  FILETIME now = GetNow();
+  ULARGE_INTEGER mtime_value;
+  mtime_value.LowPart = mtime.dwLowDateTime;
+  mtime_value.HighPart = mtime.dwHighDateTime;
+  ULARGE_INTEGER now_value;
+  now_value.LowPart = now.dwLowDateTime;
+  now_value.HighPart = now.dwHighDateTime;
+  // FILETIME counts 100-nanosecond intervals.
+  *result = (static_cast<int64_t>(now_value.QuadPart) -
+             static_cast<int64_t>(mtime_value.QuadPart)) /
+            10000000;
+  return true;
+}
+
 bool WindowsFileMtime::SetToNow(const string& path) {
   return Set(path, GetNow());
 }
@@ -234,6 +240,37 @@ bool WindowsFileMtime::SetToDistantFuture(const string& path) {
   return Set(path, distant_future_);
 }
 
+bool WindowsFileMtime::WriteFileInDistantFuture(const void* data, size_t size,
+                                                const string& path) {
+  return WriteFile(data, size, path) && SetToDistantFuture(path);
+}
+
+bool WindowsFileMtime::Get(const string& path, FILETIME* time) {
+  wstring wpath;
+  if (!AsWindowsPathWithUncPrefix(path, &wpath)) {
+    return false;
+  }
+
+  windows_util::AutoHandle handle(::CreateFileW(
+      /* lpFileName */ wpath.c_str(),
+      /* dwDesiredAccess */ GENERIC_READ,
+      /* dwShareMode */ FILE_SHARE_READ,
+      /* lpSecurityAttributes */ NULL,
+      /* dwCreationDisposition */ OPEN_EXISTING,
+      /* dwFlagsAndAttributes */ IsDirectoryW(wpath)
+          ? (FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS)
+          : FILE_ATTRIBUTE_NORMAL,
+      /* hTemplateFile */ NULL));
+  if (handle.handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  return ::GetFileTime(
+             /* hFile */ handle.handle,
+             /* lpCreationTime */ NULL,
+             /* lpLastAccessTime */ NULL,
+             /* lpLastWriteTime */ time) == TRUE;
+}
+
 bool WindowsFileMtime::Set(const string& path, const FILETIME& time) {
   if (path.empty()) {
     return false;
@@ -899,6 +936,122 @@ bool IsRootDirectory(const string& path) {
 
 bool IsAbsolute(const string& path) { return IsRootOrAbsolute(path, false); }
 
+// Populates `info` with the metadata of the file at `path`, without following
+// junctions and symlinks unless `follow_links` is true.
+// `path` must be a normalized Windows path, with UNC prefix (and absolute) if
+// necessary.
+static bool GetFileInformationW(const wstring& path, bool follow_links,
+                                BY_HANDLE_FILE_INFORMATION* info) {
+  // Only query the metadata of the file.
+  windows_util::AutoHandle handle(::CreateFileW(
+      /* lpFileName */ path.c_str(),
+      /* dwDesiredAccess */ 0,
+      /* dwShareMode */ FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      /* lpSecurityAttributes */ NULL,
+      /* dwCreationDisposition */ OPEN_EXISTING,
+      /* dwFlagsAndAttributes */ follow_links
+          ? FILE_FLAG_BACKUP_SEMANTICS
+          : (FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS),
+      /* hTemplateFile */ NULL));
+  if (handle.handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  return ::GetFileInformationByHandle(handle.handle, info) == TRUE;
+}
+
+static uint64_t ToUint64(DWORD high, DWORD low) {
+  return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+bool GetPathStamps(const string& root, const std::vector<string>& paths,
+                   std::vector<string>* stamps) {
+  stamps->clear();
+  for (const auto& path : paths) {
+    wstring wpath;
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!AsWindowsPathWithUncPrefix(JoinPath(root, path), &wpath) ||
+        !GetFileInformationW(wpath, false, &info)) {
+      return false;
+    }
+    // Like on POSIX, but with the attributes in place of the mode. The last
+    // write time of a directory changes when entries are added to, removed
+    // from or renamed in it.
+    std::ostringstream stamp;
+    stamp << info.dwVolumeSerialNumber << ":"
+          << ToUint64(info.nFileIndexHigh, info.nFileIndexLow) << ":"
+          << info.dwFileAttributes << ":"
+          << ToUint64(info.nFileSizeHigh, info.nFileSizeLow) << ":"
+          << ToUint64(info.ftLastWriteTime.dwHighDateTime,
+                      info.ftLastWriteTime.dwLowDateTime);
+    stamps->push_back(stamp.str());
+  }
+  return true;
+}
+
+bool GetFileStamp(const string& path, string* stamp) {
+  wstring wpath;
+  BY_HANDLE_FILE_INFORMATION info;
+  if (!AsWindowsPathWithUncPrefix(path, &wpath) ||
+      !GetFileInformationW(wpath, true, &info)) {
+    return false;
+  }
+  // The volume serial number and file index identify the file like an inode
+  // number, the last write time is in 100-nanosecond intervals.
+  std::ostringstream result;
+  result << info.dwVolumeSerialNumber << ":"
+         << ToUint64(info.nFileIndexHigh, info.nFileIndexLow) << ":"
+         << ToUint64(info.nFileSizeHigh, info.nFileSizeLow) << ":"
+         << ToUint64(info.ftLastWriteTime.dwHighDateTime,
+                     info.ftLastWriteTime.dwLowDateTime);
+  *stamp = result.str();
+  return true;
+}
+
+// Removes `path` and everything under it like RemoveRecursively(), on the
+// calling thread. `path` must be a normalized Windows path, with UNC prefix
+// (and absolute) if necessary.
+static bool RemoveRecursivelyW(const wstring& path) {
+  DWORD attrs = ::GetFileAttributesW(path.c_str());
+  if (attrs == INVALID_FILE_ATTRIBUTES) {
+    return false;
+  }
+  if (attrs & FILE_ATTRIBUTE_REPARSE_POINT) {
+    // A junction or symlink: remove the link, not what it points to.
+    return UnlinkPathW(path);
+  }
+  if (attrs & FILE_ATTRIBUTE_READONLY) {
+    // DeleteFileW() and RemoveDirectoryW() fail on read-only entries.
+    ::SetFileAttributesW(path.c_str(), attrs & ~FILE_ATTRIBUTE_READONLY);
+  }
+  if (!(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
+    return ::DeleteFileW(path.c_str()) == TRUE;
+  }
+
+  bool result = true;
+  WIN32_FIND_DATAW entry;
+  HANDLE handle = ::FindFirstFileW((path + L"\\*").c_str(), &entry);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  do {
+    if (wcscmp(entry.cFileName, L".") != 0 &&
+        wcscmp(entry.cFileName, L"..") != 0) {
+      result = RemoveRecursivelyW(path + L"\\" + entry.cFileName) && result;
+    }
+  } while (::FindNextFileW(handle, &entry));
+  ::FindClose(handle);
+  return ::RemoveDirectoryW(path.c_str()) == TRUE && result;
+}
+
+bool RemoveRecursively(const string& path, int max_threads) {
+  // The tree is removed on the calling thread.
+  wstring wpath;
+  if (IsDevNull(path) || !AsWindowsPathWithUncPrefix(path, &wpath)) {
+    return false;
+  }
+  return RemoveRecursivelyW(wpath);
+}
+
 void SyncFile(const string& path) {
   // No-op on Windows native; unsupported by Cygwin.
   // fsync always fails on Cygwin with "Permission denied" for some reason.
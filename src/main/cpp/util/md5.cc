@@ -43,18 +43,6 @@
 #include <string.h>  // for memcpy
 #include <stddef.h>  // for ofsetof
 
-#if !_STRING_ARCH_unaligned
-# ifdef _LP64
-#  define UNALIGNED_P(p) (reinterpret_cast<uint64_t>(p) % \
-                          __alignof__(uint32_t) != 0)  // NOLINT
-# else
-#  define UNALIGNED_P(p) (reinterpret_cast<uint32_t>(p) % \
-                          __alignof__(uint32_t) != 0)  // NOLINT
-# endif
-#else
-#  define UNALIGNED_P(p) (0)
-#endif
-
 namespace blaze_util {
 
 using std::string;
@@ -131,14 +119,8 @@ void Md5Digest::Update(const void *buf, unsigned int length) {
       ctx_buffer_len = 0;
     }
 
-    if (UNALIGNED_P(input)) {
-      while (length >= k8Bytes) {
-        memcpy(ctx_buffer, input, k8Bytes);
-        Transform(ctx_buffer, k8Bytes);
-        input += k8Bytes;
-        length -= k8Bytes;
-      }
-    } else if (length >= k8Bytes) {
+    // Transform() reads the input a word at a time whatever its alignment.
+    if (length >= k8Bytes) {
       Transform(input, length & ~k8ByteMask);
       input += length & ~k8ByteMask;
       length &= k8ByteMask;
@@ -198,7 +180,6 @@ void Md5Digest::Transform(
    (as found in Colin Plumbs public domain implementation).  */
 /* #define F(b, c, d) ((b & c) | (~b & d)) */
 #define F(x, y, z) (z ^ (x & (y ^ z)))
-#define G(x, y, z) F (z, x, y)
 #define H(x, y, z) ((x) ^ (y) ^ (z))
 #define I(x, y, z) ((y) ^ ((x) | (~z)))
 
@@ -206,26 +187,34 @@ void Md5Digest::Transform(
 #define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32-(n))))
 
   // FF, GG, HH, and II transformations for rounds 1, 2, 3, and 4.
-  // Rotation is separate from addition to prevent recomputation.
-#define FF(a, b, c, d, s, ac) { \
-      (a) += F((b), (c), (d)) + ((*x_pos++ = *cur_word++)) + \
-          static_cast<uint32_t>(ac); \
+  // Rotation is separate from addition to prevent recomputation. The message
+  // word and the constant are added first: they don't depend on the previous
+  // step, so the processor can add them while that step completes.
+#define FF(a, b, c, d, x, s, ac) { \
+      (a) += (x) + static_cast<uint32_t>(ac); \
+      (a) += F((b), (c), (d)); \
       (a) = ROTATE_LEFT((a), (s)); \
       (a) += (b); \
     }
 
+  // G(b, c, d) is ((b & d) | (c & ~d)). The two terms have no bit in common,
+  // so they can be added instead, and the one not depending on the previous
+  // step (b) added early.
 #define GG(a, b, c, d, x, s, ac) { \
-      (a) += G((b), (c), (d)) + (x) + static_cast<uint32_t>(ac); \
+      (a) += (x) + static_cast<uint32_t>(ac) + ((c) & ~(d)); \
+      (a) += (b) & (d); \
       (a) = ROTATE_LEFT((a), (s)); \
       (a) += (b); \
      }
 #define HH(a, b, c, d, x, s, ac) { \
-      (a) += H((b), (c), (d)) + (x) + static_cast<uint32_t>(ac); \
+      (a) += (x) + static_cast<uint32_t>(ac); \
+      (a) += H((b), (c), (d)); \
       (a) = ROTATE_LEFT((a), (s)); \
       (a) += (b); \
      }
 #define II(a, b, c, d, x, s, ac) { \
-      (a) += I((b), (c), (d)) + (x) + static_cast<uint32_t>(ac); \
+      (a) += (x) + static_cast<uint32_t>(ac); \
+      (a) += I((b), (c), (d)); \
       (a) = ROTATE_LEFT((a), (s)); \
       (a) += (b); \
      }
@@ -241,33 +230,34 @@ void Md5Digest::Transform(
   uint32_t d = state[3];
   uint32_t x[16];
 
-  const uint32_t *cur_word = reinterpret_cast<const uint32_t*>(buffer);
-  const uint32_t *end_word = cur_word + (len / sizeof(uint32_t));
+  const unsigned char *end = buffer + len;
 
-  while (cur_word < end_word) {
-    uint32_t *x_pos = x;
+  for (; buffer < end; buffer += k8Bytes) {
+    // Like the rest of this implementation, this assumes a little-endian
+    // machine. memcpy() compiles to plain loads, aligned or not.
+    memcpy(x, buffer, sizeof(x));
     uint32_t prev_a = a;
     uint32_t prev_b = b;
     uint32_t prev_c = c;
     uint32_t prev_d = d;
 
     // Round 1
-    FF(a, b, c, d, S11, 0xd76aa478);  // 1
-    FF(d, a, b, c, S12, 0xe8c7b756);  // 2
-    FF(c, d, a, b, S13, 0x242070db);  // 3
-    FF(b, c, d, a, S14, 0xc1bdceee);  // 4
-    FF(a, b, c, d, S11, 0xf57c0faf);  // 5
-    FF(d, a, b, c, S12, 0x4787c62a);  // 6
-    FF(c, d, a, b, S13, 0xa8304613);  // 7
-    FF(b, c, d, a, S14, 0xfd469501);  // 8
-    FF(a, b, c, d, S11, 0x698098d8);  // 9
-    FF(d, a, b, c, S12, 0x8b44f7af);  // 10
-    FF(c, d, a, b, S13, 0xffff5bb1);  // 11
-    FF(b, c, d, a, S14, 0x895cd7be);  // 12
-    FF(a, b, c, d, S11, 0x6b901122);  // 13
-    FF(d, a, b, c, S12, 0xfd987193);  // 14
-    FF(c, d, a, b, S13, 0xa679438e);  // 15
-    FF(b, c, d, a, S14, 0x49b40821);  // 16
+    FF(a, b, c, d, x[ 0], S11, 0xd76aa478);  // 1
+    FF(d, a, b, c, x[ 1], S12, 0xe8c7b756);  // 2
+    FF(c, d, a, b, x[ 2], S13, 0x242070db);  // 3
+    FF(b, c, d, a, x[ 3], S14, 0xc1bdceee);  // 4
+    FF(a, b, c, d, x[ 4], S11, 0xf57c0faf);  // 5
+    FF(d, a, b, c, x[ 5], S12, 0x4787c62a);  // 6
+    FF(c, d, a, b, x[ 6], S13, 0xa8304613);  // 7
+    FF(b, c, d, a, x[ 7], S14, 0xfd469501);  // 8
+    FF(a, b, c, d, x[ 8], S11, 0x698098d8);  // 9
+    FF(d, a, b, c, x[ 9], S12, 0x8b44f7af);  // 10
+    FF(c, d, a, b, x[10], S13, 0xffff5bb1);  // 11
+    FF(b, c, d, a, x[11], S14, 0x895cd7be);  // 12
+    FF(a, b, c, d, x[12], S11, 0x6b901122);  // 13
+    FF(d, a, b, c, x[13], S12, 0xfd987193);  // 14
+    FF(c, d, a, b, x[14], S13, 0xa679438e);  // 15
+    FF(b, c, d, a, x[15], S14, 0x49b40821);  // 16
 
     // Round 2
     GG(a, b, c, d, x[ 1], S21, 0xf61e2562);  // 17
@@ -0,0 +1,185 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/util/sha1.h"
+
+#include <string.h>  // for memcpy
+
+namespace blaze_util {
+
+using std::string;
+
+static const unsigned int kBlockBytes = 64;
+static const unsigned int kBlockByteMask = 63;
+
+static const char hex_char[] = "0123456789abcdef";
+
+// SHA-1 is defined on big-endian words; these are byte order independent.
+static inline uint32_t LoadBigEndian32(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void StoreBigEndian32(uint32_t x, unsigned char* p) {
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static inline uint32_t RotateLeft(uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+Sha1Digest::Sha1Digest() {
+  Reset();
+}
+
+void Sha1Digest::Reset() {
+  count = 0;
+  ctx_buffer_len = 0;
+  state[0] = 0x67452301;
+  state[1] = 0xefcdab89;
+  state[2] = 0x98badcfe;
+  state[3] = 0x10325476;
+  state[4] = 0xc3d2e1f0;
+}
+
+void Sha1Digest::Update(const void *buf, unsigned int length) {
+  const unsigned char *input = reinterpret_cast<const unsigned char*>(buf);
+
+  if (ctx_buffer_len != 0) {
+    unsigned int buffer_space_len = kBlockBytes - ctx_buffer_len;
+    if (length < buffer_space_len) {
+      memcpy(ctx_buffer + ctx_buffer_len, input, length);
+      ctx_buffer_len += length;
+      return;
+    }
+    // Copy more bytes to fill the complete buffer
+    memcpy(ctx_buffer + ctx_buffer_len, input, buffer_space_len);
+    Transform(ctx_buffer, kBlockBytes);
+    input += buffer_space_len;
+    length -= buffer_space_len;
+    ctx_buffer_len = 0;
+  }
+
+  // Transform() reads the input a byte at a time whatever its alignment.
+  if (length >= kBlockBytes) {
+    Transform(input, length & ~kBlockByteMask);
+    input += length & ~kBlockByteMask;
+    length &= kBlockByteMask;
+  }
+
+  // Buffer remaining input
+  memcpy(ctx_buffer, input, length);
+  ctx_buffer_len = length;
+}
+
+void Sha1Digest::Finish(unsigned char digest[20]) {
+  uint64_t bits = (count + ctx_buffer_len) << 3;
+
+  // Pad with 0x80 and zeroes, then put the 64-bit message length in *bits*
+  // at the end of the last block, big-endian.
+  unsigned int size = (ctx_buffer_len < 56 ? 64 : 128);
+  ctx_buffer[ctx_buffer_len] = 0x80;
+  memset(ctx_buffer + ctx_buffer_len + 1, 0, size - 8 - ctx_buffer_len - 1);
+  StoreBigEndian32(static_cast<uint32_t>(bits >> 32), ctx_buffer + size - 8);
+  StoreBigEndian32(static_cast<uint32_t>(bits), ctx_buffer + size - 4);
+
+  Transform(ctx_buffer, size);
+  ctx_buffer_len = 0;
+
+  for (int i = 0; i < 5; i++) {
+    StoreBigEndian32(state[i], digest + i * 4);
+  }
+}
+
+void Sha1Digest::Transform(const unsigned char* buffer, unsigned int len) {
+  count += len;
+
+  uint32_t a = state[0];
+  uint32_t b = state[1];
+  uint32_t c = state[2];
+  uint32_t d = state[3];
+  uint32_t e = state[4];
+  // The message schedule, computed on the fly in a 16-word ring.
+  uint32_t w[16];
+
+  const unsigned char *end = buffer + len;
+
+  for (; buffer < end; buffer += kBlockBytes) {
+    for (int i = 0; i < 16; i++) {
+      w[i] = LoadBigEndian32(buffer + i * 4);
+    }
+    uint32_t prev_a = a;
+    uint32_t prev_b = b;
+    uint32_t prev_c = c;
+    uint32_t prev_d = d;
+    uint32_t prev_e = e;
+
+    // The four stages of 20 rounds differ only by their function f and
+    // constant k. The message schedule is extended from round 16 on.
+#define SHA1_ROUND(i, f, k) { \
+      if ((i) >= 16) { \
+        w[(i) & 15] = RotateLeft(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ \
+                                 w[((i) + 2) & 15] ^ w[(i) & 15], 1); \
+      } \
+      uint32_t t = RotateLeft(a, 5) + (f) + e + (k) + w[(i) & 15]; \
+      e = d; \
+      d = c; \
+      c = RotateLeft(b, 30); \
+      b = a; \
+      a = t; \
+    }
+
+    for (int i = 0; i < 20; i++) {
+      SHA1_ROUND(i, d ^ (b & (c ^ d)), 0x5a827999);  // (b & c) | (~b & d)
+    }
+    for (int i = 20; i < 40; i++) {
+      SHA1_ROUND(i, b ^ c ^ d, 0x6ed9eba1);
+    }
+    for (int i = 40; i < 60; i++) {
+      SHA1_ROUND(i, (b & c) | (d & (b | c)), 0x8f1bbcdc);  // majority
+    }
+    for (int i = 60; i < 80; i++) {
+      SHA1_ROUND(i, b ^ c ^ d, 0xca62c1d6);
+    }
+#undef SHA1_ROUND
+
+    a += prev_a;
+    b += prev_b;
+    c += prev_c;
+    d += prev_d;
+    e += prev_e;
+  }
+
+  state[0] = a;
+  state[1] = b;
+  state[2] = c;
+  state[3] = d;
+  state[4] = e;
+}
+
+string Sha1Digest::String() const {
+  string result(kDigestLength * 2, '0');
+  for (int i = 0; i < 5; i++) {
+    for (int j = 0; j < 8; j++) {
+      result[i * 8 + j] = hex_char[(state[i] >> (28 - j * 4)) & 0xf];
+    }
+  }
+  return result;
+}
+
+}  // namespace blaze_util
@@ -0,0 +1,198 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/util/sha256.h"
+
+#include <string.h>  // for memcpy
+
+namespace blaze_util {
+
+using std::string;
+
+static const unsigned int kBlockBytes = 64;
+static const unsigned int kBlockByteMask = 63;
+
+static const char hex_char[] = "0123456789abcdef";
+
+// The round constants: the first 32 bits of the fractional parts of the cube
+// roots of the first 64 primes.
+static const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// SHA-256 is defined on big-endian words; these are byte order independent.
+static inline uint32_t LoadBigEndian32(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static inline void StoreBigEndian32(uint32_t x, unsigned char* p) {
+  p[0] = x >> 24;
+  p[1] = x >> 16;
+  p[2] = x >> 8;
+  p[3] = x;
+}
+
+static inline uint32_t RotateRight(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+Sha256Digest::Sha256Digest() {
+  Reset();
+}
+
+void Sha256Digest::Reset() {
+  count = 0;
+  ctx_buffer_len = 0;
+  state[0] = 0x6a09e667;
+  state[1] = 0xbb67ae85;
+  state[2] = 0x3c6ef372;
+  state[3] = 0xa54ff53a;
+  state[4] = 0x510e527f;
+  state[5] = 0x9b05688c;
+  state[6] = 0x1f83d9ab;
+  state[7] = 0x5be0cd19;
+}
+
+void Sha256Digest::Update(const void *buf, unsigned int length) {
+  const unsigned char *input = reinterpret_cast<const unsigned char*>(buf);
+
+  if (ctx_buffer_len != 0) {
+    unsigned int buffer_space_len = kBlockBytes - ctx_buffer_len;
+    if (length < buffer_space_len) {
+      memcpy(ctx_buffer + ctx_buffer_len, input, length);
+      ctx_buffer_len += length;
+      return;
+    }
+    // Copy more bytes to fill the complete buffer
+    memcpy(ctx_buffer + ctx_buffer_len, input, buffer_space_len);
+    Transform(ctx_buffer, kBlockBytes);
+    input += buffer_space_len;
+    length -= buffer_space_len;
+    ctx_buffer_len = 0;
+  }
+
+  // Transform() reads the input a byte at a time whatever its alignment.
+  if (length >= kBlockBytes) {
+    Transform(input, length & ~kBlockByteMask);
+    input += length & ~kBlockByteMask;
+    length &= kBlockByteMask;
+  }
+
+  // Buffer remaining input
+  memcpy(ctx_buffer, input, length);
+  ctx_buffer_len = length;
+}
+
+void Sha256Digest::Finish(unsigned char digest[32]) {
+  uint64_t bits = (count + ctx_buffer_len) << 3;
+
+  // Pad with 0x80 and zeroes, then put the 64-bit message length in *bits*
+  // at the end of the last block, big-endian.
+  unsigned int size = (ctx_buffer_len < 56 ? 64 : 128);
+  ctx_buffer[ctx_buffer_len] = 0x80;
+  memset(ctx_buffer + ctx_buffer_len + 1, 0, size - 8 - ctx_buffer_len - 1);
+  StoreBigEndian32(static_cast<uint32_t>(bits >> 32), ctx_buffer + size - 8);
+  StoreBigEndian32(static_cast<uint32_t>(bits), ctx_buffer + size - 4);
+
+  Transform(ctx_buffer, size);
+  ctx_buffer_len = 0;
+
+  for (int i = 0; i < 8; i++) {
+    StoreBigEndian32(state[i], digest + i * 4);
+  }
+}
+
+void Sha256Digest::Transform(const unsigned char* buffer, unsigned int len) {
+  count += len;
+
+  uint32_t s[8];
+  memcpy(s, state, sizeof(s));
+  // The message schedule, computed on the fly in a 16-word ring.
+  uint32_t w[16];
+
+  const unsigned char *end = buffer + len;
+
+  for (; buffer < end; buffer += kBlockBytes) {
+    for (int i = 0; i < 16; i++) {
+      w[i] = LoadBigEndian32(buffer + i * 4);
+    }
+    uint32_t a = s[0];
+    uint32_t b = s[1];
+    uint32_t c = s[2];
+    uint32_t d = s[3];
+    uint32_t e = s[4];
+    uint32_t f = s[5];
+    uint32_t g = s[6];
+    uint32_t h = s[7];
+
+    for (int i = 0; i < 64; i++) {
+      if (i >= 16) {
+        uint32_t w15 = w[(i + 1) & 15];
+        uint32_t w2 = w[(i + 14) & 15];
+        uint32_t s0 = RotateRight(w15, 7) ^ RotateRight(w15, 18) ^ (w15 >> 3);
+        uint32_t s1 = RotateRight(w2, 17) ^ RotateRight(w2, 19) ^ (w2 >> 10);
+        w[i & 15] += s0 + w[(i + 9) & 15] + s1;
+      }
+      uint32_t sum1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+      uint32_t choice = g ^ (e & (f ^ g));  // (e & f) | (~e & g)
+      uint32_t t1 = h + sum1 + choice + kRoundConstants[i] + w[i & 15];
+      uint32_t sum0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+      uint32_t majority = (a & b) | (c & (a | b));
+      uint32_t t2 = sum0 + majority;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+    s[5] += f;
+    s[6] += g;
+    s[7] += h;
+  }
+
+  memcpy(state, s, sizeof(s));
+}
+
+string Sha256Digest::String() const {
+  string result(kDigestLength * 2, '0');
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 8; j++) {
+      result[i * 8 + j] = hex_char[(state[i] >> (28 - j * 4)) & 0xf];
+    }
+  }
+  return result;
+}
+
+}  // namespace blaze_util
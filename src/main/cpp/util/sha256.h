@@ -0,0 +1,62 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// Provides a SHA-256 implementation (FIPS 180-4) with the interface of
+// Md5Digest.
+//
+// Like md5.h, this saves us from linking huge OpenSSL library.
+
+#ifndef BAZEL_SRC_MAIN_CPP_UTIL_SHA256_H_
+#define BAZEL_SRC_MAIN_CPP_UTIL_SHA256_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace blaze_util {
+
+class Sha256Digest {
+ public:
+  Sha256Digest();
+
+  // the SHA-256 digest is always 256 bits = 32 bytes
+  static const int kDigestLength = 32;
+
+  // Resets the context so that it can be used to calculate another
+  // SHA-256 digest. The context is in the same state as if it had just
+  // been constructed.
+  void Reset();
+
+  // Add <code>length</code> bytes of <code>buf</code> to the digest.
+  void Update(const void *buf, unsigned int length);
+
+  // Retrieve the computed SHA-256 digest as a 32 byte array.
+  void Finish(unsigned char* digest);
+
+  // Produces a hexadecimal string representation of this digest in the form:
+  // [0-9a-f]{64}
+  std::string String() const;
+
+ private:
+  void Transform(const unsigned char* buffer, unsigned int len);
+
+ private:
+  uint32_t state[8];
+  uint64_t count;                // number of bytes transformed
+  unsigned char ctx_buffer[128];  // input buffer
+  unsigned int ctx_buffer_len;
+};
+
+}  // namespace blaze_util
+
+#endif  // BAZEL_SRC_MAIN_CPP_UTIL_SHA256_H_
@@ -20,10 +20,14 @@ import com.google.devtools.build.lib.util.BlazeClock;
 import com.google.devtools.build.lib.util.Fingerprint;
 import com.google.devtools.build.lib.util.LoggingUtil;
 import com.google.devtools.build.lib.util.VarInt;
+import com.google.devtools.build.lib.vfs.FileSystem;
+import com.google.devtools.build.lib.vfs.FileSystemUtils;
 import com.google.devtools.build.lib.vfs.Path;
 import java.io.IOException;
 import java.io.OutputStream;
 import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.List;
 import java.util.Map;
 import java.util.concurrent.atomic.AtomicBoolean;
 import java.util.logging.Level;
@@ -44,6 +48,8 @@ public class DigestUtils {
   // Object to synchronize on when serializing large file reads.
   private static final Object DIGEST_LOCK = new Object();
   private static final AtomicBoolean MULTI_THREADED_DIGEST = new AtomicBoolean(false);
+  // Files larger than this are digested in exclusive mode, unless MULTI_THREADED_DIGEST is set.
+  private static final long EXCLUSIVE_DIGEST_MIN_SIZE = 4096;
 
   /** Private constructor to prevent instantiation of utility class. */
   private DigestUtils() {}
@@ -106,7 +112,7 @@ public class DigestUtils {
 
     if (digest != null) {
       return digest;
-    } else if (fileSize > 4096 && !MULTI_THREADED_DIGEST.get()) {
+    } else if (fileSize > EXCLUSIVE_DIGEST_MIN_SIZE && !MULTI_THREADED_DIGEST.get()) {
       // We'll have to read file content in order to calculate the digest. In that case
       // it would be beneficial to serialize those calculations since there is a high
       // probability that MD5 will be requested for multiple output files simultaneously.
@@ -119,6 +125,54 @@ public class DigestUtils {
     }
   }
 
+  /**
+   * Gets the digests of many files at once, e.g. of the children of a tree artifact, which file
+   * systems that support it hash concurrently. Like in {@link #getDigestOrFail}, unless
+   * multi-threaded digesting is enabled, files larger than 4K are hashed in exclusive mode, one at
+   * a time, while the small ones are hashed concurrently without the lock.
+   *
+   * @param fs the file system of {@code paths}.
+   * @param paths the files, which don't have a fast digest.
+   * @param sizes the sizes of {@code paths}.
+   * @return the digests, in the order of {@code paths}, with null for the files whose digest
+   *     couldn't be computed. Use {@link #getDigestOrFail} for those, to get the error.
+   */
+  public static byte[][] getDigestsOrNull(FileSystem fs, Path[] paths, long[] sizes) {
+    int parallelism = Runtime.getRuntime().availableProcessors();
+    if (MULTI_THREADED_DIGEST.get()) {
+      return FileSystemUtils.getDigests(fs, paths, parallelism);
+    }
+    List<Path> smallFiles = new ArrayList<>();
+    List<Path> largeFiles = new ArrayList<>();
+    for (int i = 0; i < paths.length; i++) {
+      if (sizes[i] > EXCLUSIVE_DIGEST_MIN_SIZE) {
+        largeFiles.add(paths[i]);
+      } else {
+        smallFiles.add(paths[i]);
+      }
+    }
+    byte[][] smallDigests =
+        FileSystemUtils.getDigests(fs, smallFiles.toArray(new Path[0]), parallelism);
+    byte[][] largeDigests = new byte[0][];
+    if (!largeFiles.isEmpty()) {
+      long startTime = BlazeClock.nanoTime();
+      synchronized (DIGEST_LOCK) {
+        Profiler.instance().logSimpleTask(
+            startTime, ProfilerTask.WAIT, largeFiles.size() + " files");
+        largeDigests = FileSystemUtils.getDigests(fs, largeFiles.toArray(new Path[0]), 1);
+      }
+    }
+
+    byte[][] digests = new byte[paths.length][];
+    int small = 0;
+    int large = 0;
+    for (int i = 0; i < paths.length; i++) {
+      digests[i] =
+          sizes[i] > EXCLUSIVE_DIGEST_MIN_SIZE ? largeDigests[large++] : smallDigests[small++];
+    }
+    return digests;
+  }
+
   /**
    * @param source the byte buffer source.
    * @return the digest from the given buffer.
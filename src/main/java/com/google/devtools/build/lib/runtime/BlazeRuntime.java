@@ -118,6 +118,9 @@ public final class BlazeRuntime {
 
   private static final Logger LOG = Logger.getLogger(BlazeRuntime.class.getName());
 
+  // blaze.cc starts the servers of a server pool with this flag instead of their startup options.
+  private static final String SERVER_POOL_SLOT_FLAG = "--server_pool_slot=";
+
   private final Iterable<BlazeModule> blazeModules;
   private final Map<String, BlazeCommand> commandMap = new LinkedHashMap<>();
   private final Clock clock;
@@ -554,6 +557,10 @@ public final class BlazeRuntime {
   public static void main(Iterable<Class<? extends BlazeModule>> moduleClasses, String[] args) {
     setupUncaughtHandler(args);
     List<BlazeModule> modules = createModules(moduleClasses);
+    if (args.length >= 1 && args[0].startsWith(SERVER_POOL_SLOT_FLAG)) {
+      // Wait in the server pool for a client to send the startup options.
+      args = awaitServerPoolClaim(args);
+    }
     // blaze.cc will put --batch first if the user set it.
     if (args.length >= 1 && args[0].equals("--batch")) {
       // Run Blaze in batch mode.
@@ -767,6 +774,41 @@ public final class BlazeRuntime {
     }
   }
 
+  /**
+   * Waits until a client claims this pooled server and returns the startup options it sent, with
+   * which the server then starts like one started by the client. Exits if no client claims the
+   * server within the --max_idle_secs given by the client.
+   */
+  private static String[] awaitServerPoolClaim(String[] args) {
+    String slotDirectory = args[0].substring(SERVER_POOL_SLOT_FLAG.length());
+    int maxIdleSeconds = 0;
+    for (String arg : args) {
+      if (arg.startsWith("--max_idle_secs=")) {
+        maxIdleSeconds = Integer.parseInt(arg.substring("--max_idle_secs=".length()));
+      }
+    }
+
+    LOG.info("Waiting in server pool slot " + slotDirectory);
+    List<String> startupArgs;
+    try {
+      startupArgs = getRPCServerFactory().awaitClaim(slotDirectory, maxIdleSeconds);
+    } catch (IOException e) {
+      OutErr.SYSTEM_OUT_ERR.printErr("I/O Error: " + e.getMessage());
+      System.exit(ExitCode.LOCAL_ENVIRONMENTAL_ERROR.getNumericExitCode());
+      throw new IllegalStateException(e); // Shouldn't get here.
+    } catch (AbruptExitException e) {
+      OutErr.SYSTEM_OUT_ERR.printErr(e.getMessage());
+      System.exit(e.getExitCode().getNumericExitCode());
+      throw new IllegalStateException(e); // Shouldn't get here.
+    }
+
+    if (startupArgs == null) {
+      LOG.info("Server pool slot " + slotDirectory + " not claimed, exiting");
+      System.exit(ExitCode.SUCCESS.getNumericExitCode());
+    }
+    return startupArgs.toArray(new String[0]);
+  }
+
   /**
    * A main method that does not send email. The return value indicates the desired exit status of
    * the program.
@@ -804,13 +846,16 @@ public final class BlazeRuntime {
     }
   }
 
-  private static FileSystem fileSystemImplementation() {
+  private static FileSystem fileSystemImplementation(PathFragment outputBase) {
     if ("0".equals(System.getProperty("io.bazel.EnableJni"))) {
       // Ignore UnixFileSystem, to be used for bootstrapping.
       return OS.getCurrent() == OS.WINDOWS ? new WindowsFileSystem() : new JavaIoFileSystem();
     }
     // The JNI-based UnixFileSystem is faster, but on Windows it is not available.
-    return OS.getCurrent() == OS.WINDOWS ? new WindowsFileSystem() : new UnixFileSystem();
+    if (OS.getCurrent() == OS.WINDOWS) {
+      return new WindowsFileSystem();
+    }
+    return new UnixFileSystem(outputBase == null ? null : outputBase.getRelative("digest_cache"));
   }
 
   private static Subprocess.Factory subprocessFactoryImplementation() {
@@ -841,20 +886,22 @@ public final class BlazeRuntime {
 
     BlazeServerStartupOptions startupOptions =
         runtime.getStartupOptionsProvider().getOptions(BlazeServerStartupOptions.class);
+    rpcServer[0] = getRPCServerFactory().create(commandExecutor, runtime.getClock(),
+        startupOptions.commandPort, runtime.getServerDirectory(),
+        startupOptions.maxIdleSeconds, startupOptions.serverReadyFd);
+    return rpcServer[0];
+  }
+
+  private static RPCServer.Factory getRPCServerFactory() throws AbruptExitException {
     try {
       // This is necessary so that Bazel kind of works during bootstrapping, at which time the
       // gRPC server is not compiled in so that we don't need gRPC for bootstrapping.
       Class<?> factoryClass = Class.forName(
           "com.google.devtools.build.lib.server.GrpcServerImpl$Factory");
-      RPCServer.Factory factory = (RPCServer.Factory) factoryClass.getConstructor().newInstance();
-      rpcServer[0] = factory.create(commandExecutor, runtime.getClock(),
-          startupOptions.commandPort, runtime.getServerDirectory(),
-          startupOptions.maxIdleSeconds);
-      return rpcServer[0];
+      return (RPCServer.Factory) factoryClass.getConstructor().newInstance();
     } catch (ReflectiveOperationException | IllegalArgumentException e) {
       throw new AbruptExitException("gRPC server not compiled in", ExitCode.BLAZE_INTERNAL_ERROR);
     }
-
   }
 
   private static Function<String, String> sourceFunctionForMap(final Map<String, String> map) {
@@ -954,7 +1001,7 @@ public final class BlazeRuntime {
     }
 
     if (fs == null) {
-      fs = fileSystemImplementation();
+      fs = fileSystemImplementation(outputBase);
     }
 
     Path.setFileSystemForSerialization(fs);
@@ -81,6 +81,17 @@ public class BlazeServerStartupOptions extends OptionsBase {
       help = "This launcher option is intended for use only by tests.")
   public PathFragment installBase;
 
+  @Option(name = "install_base_verification",
+      defaultValue = "fast", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      valueHelp = "{fast,full}",
+      help = "How the client checks that an existing installation base was not modified. 'fast' "
+          + "compares the inode, mode, size and modification time of every installed file and "
+          + "directory with the manifest written when the installation base was extracted, and "
+          + "falls back to 'full' if they changed. 'full' checks the presence and the timestamp "
+          + "of every installed file.")
+  public String installBaseVerification;
+
   /*
    * The installation MD5 - a content hash of the blaze binary (includes the Blaze deploy JAR and
    * any other embedded binaries - anything that ends up in the install_base).
@@ -255,6 +266,13 @@ public class BlazeServerStartupOptions extends OptionsBase {
       help = "Port to start up the gRPC command server on. If 0, let the kernel choose.")
   public int commandPort;
 
+  @Option(name = "server_ready_fd",
+      defaultValue = "-1",
+      category = "undocumented",
+      help = "File descriptor of the pipe on which the server tells the client that started it "
+          + "that it accepts connections. Passed by the client; -1 if none.")
+  public int serverReadyFd;
+
   @Option(name = "product_name",
       defaultValue = "bazel", // NOTE: purely decorative!
       category = "hidden",
@@ -281,12 +299,71 @@ public class BlazeServerStartupOptions extends OptionsBase {
       help = "If true, log debug information from the client to stderr")
   public boolean clientDebug;
 
+  @Option(name = "client_profile",
+      defaultValue = "", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      help = "If set, the client writes the time spent in each of its startup phases to this "
+          + "file, in the Chrome trace event format (viewable in chrome://tracing).")
+  public String clientProfile;
+
   @Option(name = "connect_timeout_secs",
       defaultValue = "10",
       category = "server startup",
-      help = "The amount of time the client waits for each attempt to connect to the server")
+      help = "The amount of time the client waits for a server that neither responds nor uses "
+          + "CPU time before giving up on it. A server that uses CPU time, e.g. because it is "
+          + "collecting garbage, is waited for longer.")
   public int connectTimeoutSecs;
 
+  @Option(name = "server_pool_size",
+      defaultValue = "0", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      help = "The number of servers the client keeps pre-started for this installation and "
+          + "workspace, so that commands in a new output base don't wait for a server to start. "
+          + "Unclaimed servers exit after --max_idle_secs.")
+  public int serverPoolSize;
+
+  @Option(name = "server_cds",
+      defaultValue = "true", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      help = "If true and the JVM supports it (JDK 11 or later), the server uses a class-data "
+          + "sharing archive of the classes it loads on startup, generated in the background "
+          + "after the first server start for each installation and JVM.")
+  public boolean serverCds;
+
+  @Option(name = "install_base_max_age_days",
+      defaultValue = "30", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      help = "The client removes the installations of other versions in the output user root "
+          + "that no output base uses and that were not used for this many days, in the "
+          + "background. 0 keeps them. Not supported on Windows.")
+  public int installBaseMaxAgeDays;
+
+  @Option(name = "server_cpus",
+      defaultValue = "", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      valueHelp = "<cpu list>",
+      help = "Only on Linux; the CPUs the server may run on, as a list of CPUs and CPU ranges "
+          + "like 0-23,48. See 'man 2 sched_setaffinity'. If empty, the server may run on all "
+          + "CPUs.")
+  public String serverCpus;
+
+  @Option(name = "server_numa_node",
+      defaultValue = "-1", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      help = "Only on Linux; if not negative, the server runs on the CPUs of this NUMA node and "
+          + "prefers its memory. See 'man 2 set_mempolicy'. Combined with --server_cpus, the "
+          + "server runs on the CPUs of the node that are in the list.")
+  public int serverNumaNode;
+
+  @Option(name = "server_cgroup",
+      defaultValue = "", // NOTE: purely decorative!  See class docstring.
+      category = "server startup",
+      valueHelp = "<path>",
+      help = "Only on Linux; if not empty, the server is moved to this existing cgroup v2, "
+          + "given relative to /sys/fs/cgroup, e.g. build.slice/server1. The client is moved "
+          + "too, since it starts the server.")
+  public String serverCgroup;
+
   @Option(
     name = "use_custom_exit_code_on_abrupt_exit",
     defaultValue = "true", // NOTE: purely decorative!
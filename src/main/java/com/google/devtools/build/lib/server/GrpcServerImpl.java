@@ -19,6 +19,8 @@ import com.google.common.base.Verify;
 import com.google.common.collect.ImmutableList;
 import com.google.common.collect.ImmutableSet;
 import com.google.common.net.InetAddresses;
+import com.google.common.util.concurrent.Futures;
+import com.google.common.util.concurrent.SettableFuture;
 import com.google.common.util.concurrent.ThreadFactoryBuilder;
 import com.google.common.util.concurrent.Uninterruptibles;
 import com.google.devtools.build.lib.concurrent.ThreadSafety.Immutable;
@@ -26,6 +28,10 @@ import com.google.devtools.build.lib.runtime.BlazeCommandDispatcher.LockingMode;
 import com.google.devtools.build.lib.runtime.CommandExecutor;
 import com.google.devtools.build.lib.server.CommandProtos.CancelRequest;
 import com.google.devtools.build.lib.server.CommandProtos.CancelResponse;
+import com.google.devtools.build.lib.server.CommandProtos.ClaimRequest;
+import com.google.devtools.build.lib.server.CommandProtos.ClaimResponse;
+import com.google.devtools.build.lib.server.CommandProtos.HealthRequest;
+import com.google.devtools.build.lib.server.CommandProtos.HealthResponse;
 import com.google.devtools.build.lib.server.CommandProtos.PingRequest;
 import com.google.devtools.build.lib.server.CommandProtos.PingResponse;
 import com.google.devtools.build.lib.server.CommandProtos.RunRequest;
@@ -33,6 +39,7 @@ import com.google.devtools.build.lib.server.CommandProtos.RunResponse;
 import com.google.devtools.build.lib.util.BlazeClock;
 import com.google.devtools.build.lib.util.Clock;
 import com.google.devtools.build.lib.util.ExitCode;
+import com.google.devtools.build.lib.util.OS;
 import com.google.devtools.build.lib.util.Preconditions;
 import com.google.devtools.build.lib.util.ThreadUtils;
 import com.google.devtools.build.lib.util.io.OutErr;
@@ -44,15 +51,29 @@ import io.grpc.StatusRuntimeException;
 import io.grpc.netty.NettyServerBuilder;
 import io.grpc.stub.ServerCallStreamObserver;
 import io.grpc.stub.StreamObserver;
+import io.netty.channel.DefaultEventLoopGroup;
+import io.netty.channel.EventLoopGroup;
+import io.netty.channel.local.LocalAddress;
+import io.netty.channel.local.LocalServerChannel;
+import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.OutputStream;
 import java.io.PrintWriter;
 import java.io.StringWriter;
+import java.lang.management.GarbageCollectorMXBean;
+import java.lang.management.ManagementFactory;
+import java.lang.management.MemoryUsage;
 import java.net.InetSocketAddress;
 import java.nio.charset.Charset;
+import java.nio.charset.StandardCharsets;
+import java.nio.file.DirectoryStream;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+import java.nio.file.StandardCopyOption;
 import java.security.SecureRandom;
 import java.util.Collections;
 import java.util.HashMap;
+import java.util.List;
 import java.util.Map;
 import java.util.UUID;
 import java.util.concurrent.Exchanger;
@@ -62,10 +83,12 @@ import java.util.concurrent.Executors;
 import java.util.concurrent.Future;
 import java.util.concurrent.LinkedBlockingQueue;
 import java.util.concurrent.TimeUnit;
+import java.util.concurrent.TimeoutException;
 import java.util.concurrent.atomic.AtomicBoolean;
 import java.util.concurrent.atomic.AtomicLong;
 import java.util.concurrent.atomic.AtomicReference;
 import java.util.logging.Logger;
+import javax.annotation.Nullable;
 import javax.annotation.concurrent.GuardedBy;
 
 /**
@@ -78,13 +101,13 @@ import javax.annotation.concurrent.GuardedBy;
  * innards follows.
  *
  * <p>We use the direct executor for gRPC so that it calls our methods directly on its event handler
- * threads (which it creates itself). This is acceptable for {@code ping()} and {@code cancel()}
- * because they run very quickly. For {@code run()}, we transfer the call to our own threads in
- * {@code commandExecutorPool}. We do this instead of setting an executor on the server object
- * because gRPC insists on serializing calls within a single RPC call, which means that the Runnable
- * passed to {@code setOnReadyHandler} doesn't get called while the main RPC method is running,
- * which means we can't use flow control, which we need so that gRPC doesn't buffer an unbounded
- * amount of outgoing data.
+ * threads (which it creates itself). This is acceptable for {@code ping()}, {@code health()} and
+ * {@code cancel()} because they run very quickly. For {@code run()}, we transfer the call to our
+ * own threads in {@code commandExecutorPool}. We do this instead of setting an executor on the
+ * server object because gRPC insists on serializing calls within a single RPC call, which means
+ * that the Runnable passed to {@code setOnReadyHandler} doesn't get called while the main RPC
+ * method is running, which means we can't use flow control, which we need so that gRPC doesn't
+ * buffer an unbounded amount of outgoing data.
  *
  * <p>Two threads are spawned for each command: one that handles the command in {@code
  * commandExecutorPool} and one that streams the result back to the client in {@code
@@ -142,8 +165,14 @@ public class GrpcServerImpl implements RPCServer {
   public static class Factory implements RPCServer.Factory {
     @Override
     public RPCServer create(CommandExecutor commandExecutor, Clock clock, int port,
-      Path serverDirectory, int maxIdleSeconds) throws IOException {
-      return new GrpcServerImpl(commandExecutor, clock, port, serverDirectory, maxIdleSeconds);
+      Path serverDirectory, int maxIdleSeconds, int readyFd) throws IOException {
+      return new GrpcServerImpl(
+          commandExecutor, clock, port, serverDirectory, maxIdleSeconds, readyFd);
+    }
+
+    @Override
+    public List<String> awaitClaim(String slotDirectory, int maxIdleSeconds) throws IOException {
+      return GrpcServerImpl.awaitClaim(Paths.get(slotDirectory), maxIdleSeconds);
     }
   }
 
@@ -382,7 +411,11 @@ public class GrpcServerImpl implements RPCServer {
    */
   @VisibleForTesting
   static class RpcOutputStream extends OutputStream {
-    private static final int CHUNK_SIZE = 8192;
+    // The chunk size for clients that don't ask for a specific one.
+    static final int DEFAULT_CHUNK_SIZE = 8192;
+    // The largest chunk size clients can ask for, well below the default 4MB message size limit of
+    // gRPC.
+    static final int MAX_CHUNK_SIZE = 1024 * 1024;
 
     // Store commandId and responseCookie as ByteStrings to avoid String -> UTF8 bytes conversion
     // for each serialized chunk of output.
@@ -391,18 +424,30 @@ public class GrpcServerImpl implements RPCServer {
 
     private final StreamType type;
     private final GrpcSink sink;
+    private final int chunkSize;
 
-    RpcOutputStream(String commandId, String responseCookie, StreamType type, GrpcSink sink) {
+    RpcOutputStream(
+        String commandId, String responseCookie, StreamType type, GrpcSink sink, int chunkSize) {
       this.commandIdBytes = ByteString.copyFromUtf8(commandId);
       this.responseCookieBytes = ByteString.copyFromUtf8(responseCookie);
       this.type = type;
       this.sink = sink;
+      this.chunkSize = chunkSize;
+    }
+
+    /** Returns the chunk size to use for the output of {@code request}. */
+    static int getChunkSize(RunRequest request) {
+      int requested = request.getMaxOutputChunkSize();
+      if (requested <= 0) {
+        return DEFAULT_CHUNK_SIZE;
+      }
+      return Math.min(requested, MAX_CHUNK_SIZE);
     }
 
     @Override
     public synchronized void write(byte[] b, int off, int inlen) throws IOException {
-      for (int i = 0; i < inlen; i += CHUNK_SIZE) {
-        ByteString input = ByteString.copyFrom(b, off + i, Math.min(CHUNK_SIZE, inlen - i));
+      for (int i = 0; i < inlen; i += chunkSize) {
+        ByteString input = ByteString.copyFrom(b, off + i, Math.min(chunkSize, inlen - i));
         RunResponse.Builder response = RunResponse
             .newBuilder()
             .setCookieBytes(responseCookieBytes)
@@ -489,6 +534,16 @@ public class GrpcServerImpl implements RPCServer {
   private static final String PORT_FILE = "command_port";
   private static final String REQUEST_COOKIE_FILE = "request_cookie";
   private static final String RESPONSE_COOKIE_FILE = "response_cookie";
+  // Keep in sync with kServerSocketFile in the client.
+  @VisibleForTesting
+  static final String SOCKET_FILE = "command.socket";
+  // Enables the socket with --host_jvm_args=-Dbazel.CommandSocket=1. It is off by default until it
+  // is shown to be faster than loopback TCP.
+  @VisibleForTesting
+  static final String SOCKET_PROPERTY = "bazel.CommandSocket";
+
+  // The longest path that fits in sockaddr_un.sun_path (108 bytes on Linux) with its final NUL.
+  private static final int MAX_SOCKET_PATH_LENGTH = 107;
 
   private static final AtomicBoolean runShutdownHooks = new AtomicBoolean(true);
 
@@ -503,16 +558,23 @@ public class GrpcServerImpl implements RPCServer {
   private final String responseCookie;
   private final AtomicLong interruptCounter = new AtomicLong(0);
   private final int maxIdleSeconds;
+  // The file descriptor the client waits on for this server to be ready, or -1.
+  private final int readyFd;
   private final PidFileWatcherThread pidFileWatcherThread;
   private final Path pidFile;
   private final String pidInFile;
 
   private Server server;
+  // The server behind the AF_UNIX socket in the server directory, if any, and the bridge that
+  // forwards the connections of the socket to it. It serves the same service as the TCP one, but
+  // with a lower latency.
+  @Nullable private Server socketServer;
+  @Nullable private LocalSocketBridge socketBridge;
   private final int port;
   boolean serving;
 
   public GrpcServerImpl(CommandExecutor commandExecutor, Clock clock, int port,
-      Path serverDirectory, int maxIdleSeconds) throws IOException {
+      Path serverDirectory, int maxIdleSeconds, int readyFd) throws IOException {
     // server.pid was written in the C++ launcher after fork() but before exec() .
     // The client only accesses the pid file after connecting to the socket
     // which ensures that it gets the correct pid value.
@@ -525,6 +587,7 @@ public class GrpcServerImpl implements RPCServer {
     this.serverDirectory = serverDirectory;
     this.port = port;
     this.maxIdleSeconds = maxIdleSeconds;
+    this.readyFd = readyFd;
     this.serving = false;
 
     this.streamExecutorPool =
@@ -554,6 +617,114 @@ public class GrpcServerImpl implements RPCServer {
     return result.toString();
   }
 
+  /**
+   * Serves the Claim call of a pooled server until a client claims it. The server files are written
+   * to the slot directory like {@link #serve} writes them to the server directory, the port file
+   * last, since the client takes it as the sign that the server is ready to be claimed. The client
+   * renames the slot directory before claiming the server, so it owns these files afterwards.
+   */
+  @VisibleForTesting
+  @Nullable
+  static List<String> awaitClaim(java.nio.file.Path slotDirectory, int maxIdleSeconds)
+      throws IOException {
+    SecureRandom random = new SecureRandom();
+    final String requestCookie = generateCookie(random, 16);
+    final String responseCookie = generateCookie(random, 16);
+    final SettableFuture<List<String>> claim = SettableFuture.create();
+    CommandServerGrpc.CommandServerImplBase poolService =
+        new CommandServerGrpc.CommandServerImplBase() {
+          @Override
+          public void claim(ClaimRequest request, StreamObserver<ClaimResponse> streamObserver) {
+            ClaimResponse.Builder response = ClaimResponse.newBuilder();
+            if (request.getCookie().equals(requestCookie)) {
+              ImmutableList.Builder<String> startupArgs = ImmutableList.builder();
+              for (ByteString arg : request.getStartupArgList()) {
+                startupArgs.add(arg.toString(CHARSET));
+              }
+              // Only the first client gets this server.
+              if (claim.set(startupArgs.build())) {
+                response.setCookie(responseCookie);
+              }
+            }
+
+            streamObserver.onNext(response.build());
+            streamObserver.onCompleted();
+          }
+        };
+
+    // See serve() for why IPv6 is tried first.
+    InetSocketAddress address = new InetSocketAddress("[::1]", 0);
+    Server poolServer;
+    try {
+      poolServer =
+          NettyServerBuilder.forAddress(address)
+              .addService(poolService)
+              .directExecutor()
+              .build()
+              .start();
+    } catch (IOException e) {
+      address = new InetSocketAddress("127.0.0.1", 0);
+      poolServer =
+          NettyServerBuilder.forAddress(address)
+              .addService(poolService)
+              .directExecutor()
+              .build()
+              .start();
+    }
+
+    writeSlotFile(slotDirectory.resolve(REQUEST_COOKIE_FILE), requestCookie);
+    writeSlotFile(slotDirectory.resolve(RESPONSE_COOKIE_FILE), responseCookie);
+    writeSlotFile(
+        slotDirectory.resolve(PORT_FILE),
+        InetAddresses.toUriString(address.getAddress()) + ":" + poolServer.getPort());
+
+    List<String> startupArgs;
+    try {
+      startupArgs =
+          maxIdleSeconds > 0 ? claim.get(maxIdleSeconds, TimeUnit.SECONDS) : claim.get();
+    } catch (TimeoutException e) {
+      // Nobody claimed this server, unless a client did just now. Later clients fail to claim it
+      // and start a server of their own.
+      if (claim.set(null)) {
+        deleteSlotDirectory(slotDirectory);
+      }
+      startupArgs = Futures.getUnchecked(claim);
+    } catch (InterruptedException | ExecutionException e) {
+      throw new IllegalStateException(e);
+    }
+
+    // Let the Claim call complete.
+    poolServer.shutdown();
+    try {
+      poolServer.awaitTermination();
+    } catch (InterruptedException e) {
+      throw new IllegalStateException(e);
+    }
+    return startupArgs;
+  }
+
+  /**
+   * Deletes the slot directory of a pooled server that is about to exit unclaimed, including the
+   * files the client wrote there when it started the server.
+   */
+  private static void deleteSlotDirectory(java.nio.file.Path slotDirectory) {
+    try (DirectoryStream<java.nio.file.Path> files = Files.newDirectoryStream(slotDirectory)) {
+      for (java.nio.file.Path file : files) {
+        Files.deleteIfExists(file);
+      }
+      Files.deleteIfExists(slotDirectory);
+    } catch (IOException e) {
+      // A client may have taken the slot directory over meanwhile; it deletes it then.
+      log.info("Cannot delete server pool slot " + slotDirectory + ": " + e.getMessage());
+    }
+  }
+
+  private static void writeSlotFile(java.nio.file.Path file, String contents) throws IOException {
+    java.nio.file.Path tmpFile = file.resolveSibling(file.getFileName() + ".tmp");
+    Files.write(tmpFile, contents.getBytes(CHARSET));
+    Files.move(tmpFile, file, StandardCopyOption.ATOMIC_MOVE);
+  }
+
   private void startSlowInterruptWatcher(final ImmutableSet<String> commandIds) {
     if (commandIds.isEmpty()) {
       return;
@@ -618,7 +789,7 @@ public class GrpcServerImpl implements RPCServer {
       }
     }
 
-    server.shutdown();
+    shutdownServers();
   }
 
   /**
@@ -684,6 +855,8 @@ public class GrpcServerImpl implements RPCServer {
               .start();
     }
 
+    startSocketServer();
+
     if (maxIdleSeconds > 0) {
       Thread timeoutThread =
           new Thread(
@@ -704,6 +877,7 @@ public class GrpcServerImpl implements RPCServer {
         PORT_FILE, InetAddresses.toUriString(address.getAddress()) + ":" + server.getPort());
     writeServerFile(REQUEST_COOKIE_FILE, requestCookie);
     writeServerFile(RESPONSE_COOKIE_FILE, responseCookie);
+    notifyReady();
 
     try {
       server.awaitTermination();
@@ -713,6 +887,84 @@ public class GrpcServerImpl implements RPCServer {
     }
   }
 
+  /**
+   * Starts serving on an AF_UNIX socket in the server directory, which the client prefers over the
+   * TCP port when present. Does nothing unless enabled with {@link #SOCKET_PROPERTY}, or if the
+   * platform doesn't support it or the socket path is too long, in which case the client only uses
+   * the TCP port.
+   *
+   * <p>The gRPC server listens on an in-process netty address, and a {@link LocalSocketBridge}
+   * forwards the connections of the socket to it. Unlike the netty epoll transport, this works on
+   * every architecture Bazel is built for, e.g. aarch64.
+   */
+  private void startSocketServer() {
+    if (!"1".equals(System.getProperty(SOCKET_PROPERTY)) || OS.getCurrent() != OS.LINUX) {
+      return;
+    }
+
+    Path socketFile = serverDirectory.getChild(SOCKET_FILE);
+    String socketPath = socketFile.getPathString();
+    if (socketPath.getBytes(StandardCharsets.UTF_8).length > MAX_SOCKET_PATH_LENGTH) {
+      log.info("Not listening on " + socketPath + ": the path is too long for a socket");
+      return;
+    }
+
+    // The event loop threads must not keep the server alive once it is shut down.
+    EventLoopGroup eventLoopGroup =
+        new DefaultEventLoopGroup(
+            0, new ThreadFactoryBuilder().setNameFormat("grpc-socket-%d").setDaemon(true).build());
+    LocalAddress address = new LocalAddress(socketPath);
+    Server localServer = null;
+    try {
+      localServer =
+          NettyServerBuilder.forAddress(address)
+              .channelType(LocalServerChannel.class)
+              .bossEventLoopGroup(eventLoopGroup)
+              .workerEventLoopGroup(eventLoopGroup)
+              .addService(commandServer)
+              .directExecutor()
+              .build()
+              .start();
+      // Remove the socket left over by a server that didn't exit cleanly, or bind() fails.
+      socketFile.delete();
+      socketBridge = LocalSocketBridge.start(socketPath, address);
+      socketServer = localServer;
+      deleteAtExit(socketFile, false);
+    } catch (IOException e) {
+      log.info("Not listening on " + socketPath + ": " + e.getMessage());
+      if (localServer != null) {
+        localServer.shutdown();
+      }
+      eventLoopGroup.shutdownGracefully();
+    }
+  }
+
+  private void shutdownServers() {
+    server.shutdown();
+    if (socketServer != null) {
+      socketBridge.shutdown();
+      socketServer.shutdown();
+    }
+  }
+
+  /**
+   * Tells the client that started this server that it can connect now by writing to the pipe it
+   * passed with --server_ready_fd. The client keeps polling if this fails, so errors are only
+   * logged.
+   */
+  private void notifyReady() {
+    if (readyFd < 0) {
+      return;
+    }
+    // Opening /dev/fd/N leaves file descriptor N open: the client detects that the server died
+    // when the pipe is closed.
+    try (OutputStream out = new FileOutputStream("/dev/fd/" + readyFd)) {
+      out.write('\n');
+    } catch (IOException e) {
+      log.info("Cannot notify the client that the server is ready: " + e.getMessage());
+    }
+  }
+
   private void writeServerFile(String name, String contents) throws IOException {
     Path file = serverDirectory.getChild(name);
     FileSystemUtils.writeContentAsLatin1(file, contents);
@@ -806,9 +1058,10 @@ public class GrpcServerImpl implements RPCServer {
             "The client cancelled the command before receiving the command id: " + e.getMessage());
       }
 
+      int chunkSize = RpcOutputStream.getChunkSize(request);
       OutErr rpcOutErr = OutErr.create(
-          new RpcOutputStream(command.id, responseCookie, StreamType.STDOUT, sink),
-          new RpcOutputStream(command.id, responseCookie, StreamType.STDERR, sink));
+          new RpcOutputStream(command.id, responseCookie, StreamType.STDOUT, sink, chunkSize),
+          new RpcOutputStream(command.id, responseCookie, StreamType.STDERR, sink, chunkSize));
 
       exitCode =
           commandExecutor.exec(
@@ -853,7 +1106,7 @@ public class GrpcServerImpl implements RPCServer {
 
     if (commandExecutor.shutdown()) {
       pidFileWatcherThread.signalShutdown();
-      server.shutdown();
+      shutdownServers();
     }
   }
 
@@ -889,6 +1142,37 @@ public class GrpcServerImpl implements RPCServer {
           }
         }
 
+        @Override
+        public void health(
+            HealthRequest healthRequest, StreamObserver<HealthResponse> streamObserver) {
+          Preconditions.checkState(serving);
+
+          try (RunningCommand command = new RunningCommand()) {
+            HealthResponse.Builder response = HealthResponse.newBuilder();
+            if (healthRequest.getCookie().equals(requestCookie)) {
+              synchronized (runningCommands) {
+                // Not counting this call.
+                response.setRunningCalls(runningCommands.size() - 1);
+              }
+              long gcTimeMillis = 0;
+              for (GarbageCollectorMXBean gc : ManagementFactory.getGarbageCollectorMXBeans()) {
+                // -1 if the collector doesn't know.
+                gcTimeMillis += Math.max(gc.getCollectionTime(), 0);
+              }
+              MemoryUsage heap = ManagementFactory.getMemoryMXBean().getHeapMemoryUsage();
+              response
+                  .setCookie(responseCookie)
+                  .setUptimeMillis(ManagementFactory.getRuntimeMXBean().getUptime())
+                  .setGcTimeMillis(gcTimeMillis)
+                  .setUsedHeapBytes(heap.getUsed())
+                  .setMaxHeapBytes(heap.getMax());
+            }
+
+            streamObserver.onNext(response.build());
+            streamObserver.onCompleted();
+          }
+        }
+
         @Override
         public void cancel(
             final CancelRequest request, final StreamObserver<CancelResponse> streamObserver) {
@@ -0,0 +1,290 @@
+// Copyright 2016 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.server;
+
+import com.google.common.util.concurrent.ThreadFactoryBuilder;
+import com.google.devtools.build.lib.unix.LocalSocket;
+import io.netty.bootstrap.Bootstrap;
+import io.netty.buffer.ByteBuf;
+import io.netty.buffer.Unpooled;
+import io.netty.channel.Channel;
+import io.netty.channel.ChannelFuture;
+import io.netty.channel.ChannelHandlerContext;
+import io.netty.channel.ChannelInboundHandlerAdapter;
+import io.netty.channel.DefaultEventLoopGroup;
+import io.netty.channel.EventLoopGroup;
+import io.netty.channel.local.LocalAddress;
+import io.netty.channel.local.LocalChannel;
+import io.netty.util.ReferenceCountUtil;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.Semaphore;
+import java.util.concurrent.ThreadFactory;
+import java.util.logging.Logger;
+
+/**
+ * Serves an AF_UNIX socket by forwarding the bytes of each of its connections to and from a netty
+ * {@link LocalChannel} connected to a server listening on a {@link LocalAddress}, e.g. a gRPC
+ * server.
+ *
+ * <p>This uses the {@link LocalSocket} of the Bazel JNI library instead of a native netty
+ * transport, because the bundled netty only has its epoll library for x86_64.
+ *
+ * <p>Each connection has a reader thread, which reads the socket into direct buffers handed to the
+ * server as they are, and a writer thread, which writes the buffers of the server to the socket in
+ * place when they are direct. Neither blocks the event loop of the channels. At most {@link
+ * #MAX_CONNECTIONS} connections are served at once; the others wait in the backlog.
+ */
+final class LocalSocketBridge {
+
+  private static final Logger log = Logger.getLogger(LocalSocketBridge.class.getName());
+
+  // Same as the backlog of the gRPC server on the TCP port.
+  private static final int BACKLOG = 128;
+  // Each client command uses a single connection, so this is far more than needed.
+  private static final int MAX_CONNECTIONS = 16;
+  private static final int BUFFER_SIZE = 64 * 1024;
+
+  // Tells the writer of a connection that the server closed it. Not Unpooled.EMPTY_BUFFER, which
+  // the server may write.
+  private static final ByteBuf END_OF_STREAM = Unpooled.buffer(0);
+
+  private final LocalSocket socket;
+  private final LocalAddress serverAddress;
+  // Only hands the buffers of the server over to the writers, so one thread is enough.
+  private final EventLoopGroup eventLoopGroup =
+      new DefaultEventLoopGroup(1, daemonThreadFactory("local-socket-bridge-%d"));
+  // Runs the reader and the writer of each connection, so it has at most 2 * MAX_CONNECTIONS
+  // threads.
+  private final ExecutorService connectionExecutor =
+      Executors.newCachedThreadPool(daemonThreadFactory("local-socket-connection-%d"));
+  private final Semaphore connectionPermits = new Semaphore(MAX_CONNECTIONS);
+
+  private LocalSocketBridge(LocalSocket socket, LocalAddress serverAddress) {
+    this.socket = socket;
+    this.serverAddress = serverAddress;
+  }
+
+  private static ThreadFactory daemonThreadFactory(String nameFormat) {
+    return new ThreadFactoryBuilder().setNameFormat(nameFormat).setDaemon(true).build();
+  }
+
+  /**
+   * Creates the socket {@code socketPath} and forwards its connections to {@code serverAddress}
+   * until {@link #shutdown} is called.
+   */
+  static LocalSocketBridge start(String socketPath, LocalAddress serverAddress)
+      throws IOException {
+    final LocalSocketBridge bridge =
+        new LocalSocketBridge(LocalSocket.listen(socketPath, BACKLOG), serverAddress);
+    Thread acceptThread =
+        new Thread(
+            new Runnable() {
+              @Override
+              public void run() {
+                bridge.acceptConnections();
+              }
+            });
+    acceptThread.setName("local-socket-accept");
+    acceptThread.setDaemon(true);
+    acceptThread.start();
+    return bridge;
+  }
+
+  /**
+   * Stops accepting connections. The open connections are closed with the server, which may still
+   * finish its calls, so the connection threads are left running. They are daemon threads.
+   */
+  void shutdown() {
+    try {
+      socket.shutdown();
+    } catch (IOException e) {
+      log.info("Cannot shut down the local socket: " + e.getMessage());
+    }
+  }
+
+  private void acceptConnections() {
+    try {
+      while (true) {
+        connectionPermits.acquireUninterruptibly();
+        final LocalSocket connection;
+        try {
+          connection = socket.accept();
+        } catch (IOException e) {
+          // The socket was shut down.
+          return;
+        }
+        connectionExecutor.execute(
+            new Runnable() {
+              @Override
+              public void run() {
+                try {
+                  forward(connection);
+                } finally {
+                  connectionPermits.release();
+                }
+              }
+            });
+      }
+    } finally {
+      closeQuietly(socket);
+    }
+  }
+
+  /** Forwards the bytes of {@code connection} to the server and back until either side closes. */
+  private void forward(final LocalSocket connection) {
+    final BlockingQueue<ByteBuf> pendingWrites = new LinkedBlockingQueue<>();
+    ChannelFuture connectFuture =
+        new Bootstrap()
+            .group(eventLoopGroup)
+            .channel(LocalChannel.class)
+            .handler(
+                new ChannelInboundHandlerAdapter() {
+                  @Override
+                  public void channelRead(ChannelHandlerContext ctx, Object msg) {
+                    // The writer releases it.
+                    pendingWrites.add((ByteBuf) msg);
+                  }
+
+                  @Override
+                  public void channelInactive(ChannelHandlerContext ctx) {
+                    pendingWrites.add(END_OF_STREAM);
+                  }
+                })
+            .connect(serverAddress)
+            .awaitUninterruptibly();
+    if (!connectFuture.isSuccess()) {
+      log.info("Cannot connect a local socket to the server: " + connectFuture.cause());
+      closeQuietly(connection);
+      return;
+    }
+
+    final Channel channel = connectFuture.channel();
+    final CountDownLatch writerDone = new CountDownLatch(1);
+    connectionExecutor.execute(
+        new Runnable() {
+          @Override
+          public void run() {
+            try {
+              writeAll(connection, channel, pendingWrites);
+            } finally {
+              writerDone.countDown();
+            }
+          }
+        });
+
+    try {
+      while (true) {
+        ByteBuf buf = channel.alloc().directBuffer(BUFFER_SIZE);
+        int length;
+        try {
+          length = connection.read(buf.nioBuffer(buf.writerIndex(), buf.writableBytes()));
+        } catch (IOException e) {
+          buf.release();
+          throw e;
+        }
+        if (length < 0) {
+          buf.release();
+          break;
+        }
+        buf.writerIndex(buf.writerIndex() + length);
+        // The server gets the bytes without a copy, and releases the buffer.
+        channel.writeAndFlush(buf);
+      }
+    } catch (IOException e) {
+      // The client went away.
+    } finally {
+      channel.close().awaitUninterruptibly();
+      // The socket can't be closed while the writer may still use it.
+      try {
+        writerDone.await();
+      } catch (InterruptedException e) {
+        Thread.currentThread().interrupt();
+      }
+      closeQuietly(connection);
+    }
+  }
+
+  /**
+   * Writes the buffers of the server to {@code connection} until the server closes {@code
+   * channel}, then shuts the connection down, so that its reader returns.
+   */
+  private static void writeAll(
+      LocalSocket connection, Channel channel, BlockingQueue<ByteBuf> pendingWrites) {
+    // Holds the bytes of heap buffers, which the native code can't use in place.
+    ByteBuffer copyBuffer = null;
+    boolean clientGone = false;
+    while (true) {
+      ByteBuf buf;
+      try {
+        buf = pendingWrites.take();
+      } catch (InterruptedException e) {
+        // The connection threads are never interrupted.
+        Thread.currentThread().interrupt();
+        break;
+      }
+      if (buf == END_OF_STREAM) {
+        break;
+      }
+      try {
+        if (!clientGone) {
+          for (ByteBuffer nioBuffer : buf.nioBuffers()) {
+            if (nioBuffer.isDirect()) {
+              connection.write(nioBuffer);
+              continue;
+            }
+            if (copyBuffer == null) {
+              copyBuffer = ByteBuffer.allocateDirect(BUFFER_SIZE);
+            }
+            while (nioBuffer.hasRemaining()) {
+              copyBuffer.clear();
+              int length = Math.min(nioBuffer.remaining(), copyBuffer.remaining());
+              ByteBuffer chunk = nioBuffer.duplicate();
+              chunk.limit(chunk.position() + length);
+              copyBuffer.put(chunk);
+              copyBuffer.flip();
+              connection.write(copyBuffer);
+              nioBuffer.position(nioBuffer.position() + length);
+            }
+          }
+        }
+      } catch (IOException e) {
+        // The client went away. The remaining buffers are only released.
+        clientGone = true;
+        channel.close();
+      } finally {
+        ReferenceCountUtil.release(buf);
+      }
+    }
+    try {
+      connection.shutdown();
+    } catch (IOException e) {
+      log.info("Cannot shut down a local socket connection: " + e.getMessage());
+    }
+  }
+
+  private static void closeQuietly(LocalSocket socket) {
+    try {
+      socket.close();
+    } catch (IOException e) {
+      log.info("Cannot close a local socket: " + e.getMessage());
+    }
+  }
+}
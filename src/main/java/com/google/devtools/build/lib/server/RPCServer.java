@@ -17,6 +17,8 @@ import com.google.devtools.build.lib.runtime.CommandExecutor;
 import com.google.devtools.build.lib.util.Clock;
 import com.google.devtools.build.lib.vfs.Path;
 import java.io.IOException;
+import java.util.List;
+import javax.annotation.Nullable;
 
 /**
  * A gRPC server instance.
@@ -29,7 +31,16 @@ public interface RPCServer {
    */
   interface Factory {
     RPCServer create(CommandExecutor commandExecutor, Clock clock, int port, Path serverDirectory,
-        int maxIdleSeconds) throws IOException;
+        int maxIdleSeconds, int readyFd) throws IOException;
+
+    /**
+     * Waits in the slot directory of a server pool until a client claims this server with the
+     * Claim call, and returns the startup options the client sent, or null if no client claimed
+     * the server within {@code maxIdleSeconds} (if positive). Only the pooled server started by
+     * the client with {@code --server_pool_slot} calls this, before it parses its startup options.
+     */
+    @Nullable
+    List<String> awaitClaim(String slotDirectory, int maxIdleSeconds) throws IOException;
   }
 
   /**
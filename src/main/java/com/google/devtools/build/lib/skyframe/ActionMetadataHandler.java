@@ -23,6 +23,7 @@ import com.google.devtools.build.lib.actions.ActionInput;
 import com.google.devtools.build.lib.actions.ActionInputHelper;
 import com.google.devtools.build.lib.actions.Artifact;
 import com.google.devtools.build.lib.actions.Artifact.TreeFileArtifact;
+import com.google.devtools.build.lib.actions.cache.DigestUtils;
 import com.google.devtools.build.lib.actions.cache.Md5Digest;
 import com.google.devtools.build.lib.actions.cache.Metadata;
 import com.google.devtools.build.lib.actions.cache.MetadataHandler;
@@ -37,9 +38,12 @@ import com.google.devtools.build.lib.vfs.RootedPath;
 import com.google.devtools.build.lib.vfs.Symlinks;
 import java.io.FileNotFoundException;
 import java.io.IOException;
+import java.util.ArrayList;
 import java.util.Arrays;
 import java.util.Collection;
 import java.util.Collections;
+import java.util.LinkedHashMap;
+import java.util.List;
 import java.util.Map;
 import java.util.Set;
 import java.util.concurrent.ConcurrentHashMap;
@@ -323,9 +327,10 @@ public class ActionMetadataHandler implements MetadataHandler {
       // By the time we're constructing TreeArtifactValues, use of the metadata handler
       // should be single threaded and there should be no race condition.
       // The current design of ActionMetadataHandler makes this hard to enforce.
-      Set<PathFragment> paths = null;
-      paths = TreeArtifactValue.explodeDirectory(artifact);
-      Set<TreeFileArtifact> diskFiles = ActionInputHelper.asTreeFileArtifacts(artifact, paths);
+      Map<PathFragment, FileStatus> statuses =
+          TreeArtifactValue.explodeDirectoryWithStatus(artifact);
+      Set<TreeFileArtifact> diskFiles =
+          ActionInputHelper.asTreeFileArtifacts(artifact, statuses.keySet());
       if (!diskFiles.equals(registeredContents)) {
         // There might be more than one error here. We first look for missing output files.
         Set<TreeFileArtifact> missingFiles = Sets.difference(registeredContents, diskFiles);
@@ -346,7 +351,7 @@ public class ActionMetadataHandler implements MetadataHandler {
             + ", present in TreeArtifact " + artifact + ", was not registered");
       }
 
-      value = constructTreeArtifactValue(registeredContents);
+      value = constructTreeArtifactValue(registeredContents, statuses);
     } else {
       value = constructTreeArtifactValueFromFilesystem(artifact);
     }
@@ -356,40 +361,73 @@ public class ActionMetadataHandler implements MetadataHandler {
     return value;
   }
 
-  private TreeArtifactValue constructTreeArtifactValue(Collection<TreeFileArtifact> contents)
-      throws IOException {
+  /**
+   * Constructs the value of a tree artifact from its {@code contents}, given the statuses of the
+   * files, not following symbolic links, by their parent-relative paths.
+   */
+  private TreeArtifactValue constructTreeArtifactValue(Collection<TreeFileArtifact> contents,
+      Map<PathFragment, FileStatus> statuses) throws IOException {
     Map<TreeFileArtifact, FileArtifactValue> values =
         Maps.newHashMapWithExpectedSize(contents.size());
+    Map<TreeFileArtifact, FileValue> fileValues = new LinkedHashMap<>();
+    List<TreeFileArtifact> filesToDigest = new ArrayList<>();
 
     for (TreeFileArtifact treeFileArtifact : contents) {
       FileArtifactValue cachedValue = additionalOutputData.get(treeFileArtifact);
-      if (cachedValue == null) {
-        FileValue fileValue = outputArtifactData.get(treeFileArtifact);
-        // This is similar to what's present in getRealMetadataForArtifact, except
-        // we get back the FileValue, not the metadata.
-        // We do not cache exceptions besides nonexistence here, because it is unlikely that the
-        // file will be requested from this cache too many times.
-        if (fileValue == null) {
-          try {
-            fileValue = constructFileValue(treeFileArtifact, /*statNoFollow=*/ null);
-          } catch (FileNotFoundException e) {
-            String errorMessage = String.format(
-                "Failed to resolve relative path %s inside TreeArtifact %s. "
-                + "The associated file is either missing or is an invalid symlink.",
-                treeFileArtifact.getParentRelativePath(),
-                treeFileArtifact.getParent().getExecPathString());
-            throw new IOException(errorMessage, e);
-          }
+      if (cachedValue != null) {
+        values.put(treeFileArtifact, cachedValue);
+        continue;
+      }
+      FileValue fileValue = outputArtifactData.get(treeFileArtifact);
+      // This is similar to what's present in getRealMetadataForArtifact, except
+      // we get back the FileValue, not the metadata.
+      // We do not cache exceptions besides nonexistence here, because it is unlikely that the
+      // file will be requested from this cache too many times.
+      if (fileValue == null) {
+        try {
+          // The file was stat'ed when its directory was read.
+          fileValue = constructFileValue(treeFileArtifact, FileStatusWithDigestAdapter.adapt(
+              statuses.get(treeFileArtifact.getParentRelativePath())));
+        } catch (FileNotFoundException e) {
+          String errorMessage = String.format(
+              "Failed to resolve relative path %s inside TreeArtifact %s. "
+              + "The associated file is either missing or is an invalid symlink.",
+              treeFileArtifact.getParentRelativePath(),
+              treeFileArtifact.getParent().getExecPathString());
+          throw new IOException(errorMessage, e);
         }
+      }
+      fileValues.put(treeFileArtifact, fileValue);
+      if (fileValue.exists() && fileValue.isFile() && fileValue.getDigest() == null) {
+        filesToDigest.add(treeFileArtifact);
+      }
+    }
 
-        // A minor hack: maybeStoreAdditionalData will force the data to be stored
-        // in additionalOutputData.
-        maybeStoreAdditionalData(treeFileArtifact, fileValue, null);
-        cachedValue = Preconditions.checkNotNull(
-            additionalOutputData.get(treeFileArtifact), treeFileArtifact);
+    // Tree artifacts often have many children, so the files without a fast digest are hashed
+    // together, concurrently where the file system supports it, instead of one at a time below.
+    Map<TreeFileArtifact, byte[]> digests = Maps.newHashMapWithExpectedSize(filesToDigest.size());
+    if (filesToDigest.size() > 1) {
+      Path[] paths = new Path[filesToDigest.size()];
+      long[] sizes = new long[paths.length];
+      for (int i = 0; i < paths.length; i++) {
+        paths[i] = filesToDigest.get(i).getPath();
+        sizes[i] = fileValues.get(filesToDigest.get(i)).getSize();
       }
+      byte[][] batch = DigestUtils.getDigestsOrNull(paths[0].getFileSystem(), paths, sizes);
+      for (int i = 0; i < paths.length; i++) {
+        if (batch[i] != null) {
+          digests.put(filesToDigest.get(i), batch[i]);
+        }
+      }
+    }
 
-      values.put(treeFileArtifact, cachedValue);
+    for (Map.Entry<TreeFileArtifact, FileValue> entry : fileValues.entrySet()) {
+      TreeFileArtifact treeFileArtifact = entry.getKey();
+      // A minor hack: maybeStoreAdditionalData will force the data to be stored
+      // in additionalOutputData. Files missing from the batch digest themselves there.
+      maybeStoreAdditionalData(treeFileArtifact, entry.getValue(), digests.get(treeFileArtifact));
+      values.put(treeFileArtifact, Preconditions.checkNotNull(
+          additionalOutputData.get(treeFileArtifact), treeFileArtifact));
     }
 
     return TreeArtifactValue.create(values);
@@ -403,8 +441,7 @@ public class ActionMetadataHandler implements MetadataHandler {
       return TreeArtifactValue.MISSING_TREE_ARTIFACT;
     }
 
-    Set<PathFragment> paths = null;
-    paths = TreeArtifactValue.explodeDirectory(artifact);
+    Map<PathFragment, FileStatus> statuses = TreeArtifactValue.explodeDirectoryWithStatus(artifact);
     // If you're reading tree artifacts from disk while outputDirectoryListings are being injected,
     // something has gone terribly wrong.
     Object previousDirectoryListing =
@@ -413,7 +450,8 @@ public class ActionMetadataHandler implements MetadataHandler {
     Preconditions.checkState(previousDirectoryListing == null,
         "Race condition while constructing TreArtifactValue: %s, %s",
         artifact, previousDirectoryListing);
-    return constructTreeArtifactValue(ActionInputHelper.asTreeFileArtifacts(artifact, paths));
+    return constructTreeArtifactValue(
+        ActionInputHelper.asTreeFileArtifacts(artifact, statuses.keySet()), statuses);
   }
 
   @Override
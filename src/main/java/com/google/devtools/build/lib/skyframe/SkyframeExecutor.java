@@ -1768,6 +1768,11 @@ public abstract class SkyframeExecutor implements WalkableGraphFactory {
     FilesystemValueChecker fsvc =
         new FilesystemValueChecker(Preconditions.checkNotNull(tsgm.get()), lastExecutionTimeRange);
     BatchStat batchStatter = outputService == null ? null : outputService.getBatchStatter();
+    if (batchStatter == null) {
+      // Stats the outputs of each shard of actions at once where the file system supports it.
+      Path execRoot = directories.getExecRoot();
+      batchStatter = execRoot.getFileSystem().getBatchStatter(execRoot);
+    }
     invalidateDirtyActions(fsvc.getDirtyActionValues(memoizingEvaluator.getValues(),
         batchStatter, modifiedOutputFiles));
     modifiedFiles += fsvc.getNumberOfModifiedOutputFiles();
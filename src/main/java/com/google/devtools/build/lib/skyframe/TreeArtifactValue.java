@@ -23,6 +23,7 @@ import com.google.devtools.build.lib.actions.Artifact;
 import com.google.devtools.build.lib.actions.Artifact.TreeFileArtifact;
 import com.google.devtools.build.lib.actions.cache.DigestUtils;
 import com.google.devtools.build.lib.actions.cache.Metadata;
+import com.google.devtools.build.lib.vfs.FileStatus;
 import com.google.devtools.build.lib.vfs.Path;
 import com.google.devtools.build.lib.vfs.PathFragment;
 import com.google.devtools.build.skyframe.SkyValue;
@@ -181,15 +182,20 @@ class TreeArtifactValue implements SkyValue {
   };
 
   private static void explodeDirectory(Artifact treeArtifact,
-      PathFragment pathToExplode, ImmutableSet.Builder<PathFragment> valuesBuilder)
+      PathFragment pathToExplode, ImmutableMap.Builder<PathFragment, FileStatus> valuesBuilder)
       throws IOException {
-    for (Path subpath : treeArtifact.getPath().getRelative(pathToExplode).getDirectoryEntries()) {
+    Path dir = treeArtifact.getPath().getRelative(pathToExplode);
+    // The entries are stat'ed along with the directory, instead of one by one below.
+    for (Map.Entry<String, FileStatus> entry : dir.readdirWithStatus().entrySet()) {
+      Path subpath = dir.getChild(entry.getKey());
+      FileStatus statNoFollow = entry.getValue();
       PathFragment canonicalSubpathFragment =
           pathToExplode.getChild(subpath.getBaseName()).normalize();
-      if (subpath.isDirectory()) {
+      if (statNoFollow.isDirectory()
+          || (statNoFollow.isSymbolicLink() && subpath.isDirectory())) {
         explodeDirectory(treeArtifact,
             pathToExplode.getChild(subpath.getBaseName()), valuesBuilder);
-      } else if (subpath.isSymbolicLink()) {
+      } else if (statNoFollow.isSymbolicLink()) {
         PathFragment linkTarget = subpath.readSymbolicLinkUnchecked();
         if (linkTarget.isAbsolute()) {
           String errorMessage = String.format(
@@ -216,12 +222,9 @@ class TreeArtifactValue implements SkyValue {
             throw new IOException(errorMessage);
           }
         }
-        valuesBuilder.add(canonicalSubpathFragment);
-      } else if (subpath.isFile()) {
-        valuesBuilder.add(canonicalSubpathFragment);
+        valuesBuilder.put(canonicalSubpathFragment, statNoFollow);
       } else {
-        // We shouldn't ever reach here.
-        throw new IllegalStateException("Could not determine type of file " + subpath);
+        valuesBuilder.put(canonicalSubpathFragment, statNoFollow);
       }
     }
   }
@@ -233,7 +236,17 @@ class TreeArtifactValue implements SkyValue {
    *     tree artifact.
    */
   static Set<PathFragment> explodeDirectory(Artifact treeArtifact) throws IOException {
-    ImmutableSet.Builder<PathFragment> explodedDirectory = ImmutableSet.builder();
+    return explodeDirectoryWithStatus(treeArtifact).keySet();
+  }
+
+  /**
+   * Like {@link #explodeDirectory(Artifact)}, but also returns the status of each file, not
+   * following symbolic links, as read along with its directory, so that callers needing the
+   * metadata of the files don't have to stat them again.
+   */
+  static Map<PathFragment, FileStatus> explodeDirectoryWithStatus(Artifact treeArtifact)
+      throws IOException {
+    ImmutableMap.Builder<PathFragment, FileStatus> explodedDirectory = ImmutableMap.builder();
     explodeDirectory(treeArtifact, PathFragment.EMPTY_FRAGMENT, explodedDirectory);
     return explodedDirectory.build();
   }
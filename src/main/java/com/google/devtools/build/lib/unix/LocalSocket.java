@@ -0,0 +1,142 @@
+// Copyright 2016 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package com.google.devtools.build.lib.unix;
+
+import com.google.devtools.build.lib.UnixJniLoader;
+import java.io.Closeable;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * An AF_UNIX stream socket, which the Java SDK doesn't support. It only depends on the JNI library
+ * of Bazel, so it works on every platform Bazel is built for.
+ *
+ * <p>Bytes are read and written in place in direct {@link ByteBuffer}s, so that they aren't copied
+ * between the Java heap and the native code.
+ *
+ * <p>{@link #read} and {@link #accept} block, and may be called concurrently with {@link #write}
+ * and with {@link #shutdown}, which wakes them up. {@link #close} must only be called once no
+ * thread reads or accepts anymore, since the file descriptor may be reused right away.
+ */
+public final class LocalSocket implements Closeable {
+
+  static {
+    if (!"0".equals(System.getProperty("io.bazel.EnableJni"))) {
+      UnixJniLoader.loadJni();
+    }
+  }
+
+  private final int fd;
+  // Guards closed without waiting for writes, so that shutdown() can interrupt them.
+  private final Object closeLock = new Object();
+  private volatile boolean closed;
+
+  private LocalSocket(int fd) {
+    this.fd = fd;
+  }
+
+  /**
+   * Creates a socket at {@code path} and listens on it for connections.
+   *
+   * @throws IOException if the socket can't be created, e.g. if {@code path} exists or is too long
+   */
+  public static LocalSocket listen(String path, int backlog) throws IOException {
+    return new LocalSocket(listen0(path, backlog));
+  }
+
+  /** Connects to the socket listening at {@code path}. */
+  public static LocalSocket connect(String path) throws IOException {
+    return new LocalSocket(connect0(path));
+  }
+
+  /**
+   * Waits for a connection to this listening socket and returns it.
+   *
+   * @throws IOException if accepting fails, e.g. because this socket was shut down
+   */
+  public LocalSocket accept() throws IOException {
+    return new LocalSocket(accept0(fd));
+  }
+
+  /**
+   * Reads up to {@code buffer.remaining()} bytes into the direct {@code buffer} at its position,
+   * and advances it past them. Blocks until at least one byte is available.
+   *
+   * @return the number of bytes read, or -1 at the end of the stream
+   */
+  public int read(ByteBuffer buffer) throws IOException {
+    checkDirect(buffer);
+    int length = read0(fd, buffer, buffer.position(), buffer.remaining());
+    if (length > 0) {
+      buffer.position(buffer.position() + length);
+    }
+    return length;
+  }
+
+  /** Writes the remaining bytes of the direct {@code buffer}, and advances it past them. */
+  public synchronized void write(ByteBuffer buffer) throws IOException {
+    checkDirect(buffer);
+    if (closed) {
+      throw new IOException("Socket closed");
+    }
+    write0(fd, buffer, buffer.position(), buffer.remaining());
+    buffer.position(buffer.limit());
+  }
+
+  /**
+   * Shuts down both directions of the socket, so that blocked {@link #read} and {@link #accept}
+   * calls return, without releasing its file descriptor.
+   */
+  public void shutdown() throws IOException {
+    synchronized (closeLock) {
+      if (!closed) {
+        shutdown0(fd);
+      }
+    }
+  }
+
+  /** Releases the file descriptor of the socket, once the current {@link #write} is done. */
+  @Override
+  public synchronized void close() throws IOException {
+    synchronized (closeLock) {
+      if (!closed) {
+        closed = true;
+        close0(fd);
+      }
+    }
+  }
+
+  private static void checkDirect(ByteBuffer buffer) {
+    if (!buffer.isDirect()) {
+      throw new IllegalArgumentException("Not a direct buffer");
+    }
+  }
+
+  private static native int listen0(String path, int backlog) throws IOException;
+
+  private static native int connect0(String path) throws IOException;
+
+  private static native int accept0(int fd) throws IOException;
+
+  private static native int read0(int fd, ByteBuffer buffer, int position, int length)
+      throws IOException;
+
+  private static native void write0(int fd, ByteBuffer buffer, int position, int length)
+      throws IOException;
+
+  private static native void shutdown0(int fd) throws IOException;
+
+  private static native void close0(int fd) throws IOException;
+}
@@ -15,12 +15,14 @@
 package com.google.devtools.build.lib.unix;
 
 import com.google.common.annotations.VisibleForTesting;
+import com.google.common.base.Preconditions;
 import com.google.common.hash.HashCode;
 import com.google.devtools.build.lib.UnixJniLoader;
 
 import java.io.File;
 import java.io.FileNotFoundException;
 import java.io.IOException;
+import java.nio.charset.StandardCharsets;
 import java.util.logging.Level;
 import java.util.logging.LogManager;
 import java.util.logging.Logger;
@@ -213,6 +215,55 @@ public final class NativePosixFiles {
    */
   public static native ErrnoFileStatus errnoLstat(String path);
 
+  // The layout of the metadata stored by statBatch() for each path, in longs. Keep in sync with
+  // the PackedStat enum of unix_jni.h.
+  /** The errno of the failed stat call (see {@link ErrnoFileStatus}), or 0 if it succeeded. */
+  public static final int PACKED_STAT_ERRNO = 0;
+  /** The st_mode field. */
+  public static final int PACKED_STAT_MODE = 1;
+  /** The st_size field. */
+  public static final int PACKED_STAT_SIZE = 2;
+  /** The modification time, in nanoseconds since the epoch. */
+  public static final int PACKED_STAT_MTIME_NS = 3;
+  /** The status change time, in nanoseconds since the epoch. */
+  public static final int PACKED_STAT_CTIME_NS = 4;
+  /** The st_dev field. */
+  public static final int PACKED_STAT_DEV = 5;
+  /** The st_ino field. */
+  public static final int PACKED_STAT_INO = 6;
+  /** The number of longs stored for each path. */
+  public static final int PACKED_STAT_LONGS = 7;
+
+  /**
+   * Stats many files in a single native call, with statx(2) where available and POSIX stat(2) or
+   * lstat(2) otherwise. Unlike {@link #errnoStat}, no object is allocated per file, which makes
+   * it cheap to check e.g. all the files of an incremental build for changes. The file system
+   * checks the outputs of the previous build for external modifications with it, through
+   * {@link com.google.devtools.build.lib.vfs.FileSystem#getBatchStatter}.
+   *
+   * <p>The metadata of {@code paths[i]} is stored in {@code results} from index {@code i *
+   * PACKED_STAT_LONGS}, laid out as described by the {@code PACKED_STAT_*} constants. If the
+   * stat call failed with an error like ENOENT, only its errno is meaningful.
+   *
+   * @param paths the files to stat.
+   * @param followSymlinks whether to stat the targets of symbolic links rather than the links.
+   * @param results the array to fill, of at least {@code paths.length * PACKED_STAT_LONGS} longs.
+   */
+  public static void statBatch(String[] paths, boolean followSymlinks, long[] results) {
+    Preconditions.checkArgument(
+        results.length >= (long) paths.length * PACKED_STAT_LONGS,
+        "%s longs are too few for %s paths",
+        results.length,
+        paths.length);
+    for (String path : paths) {
+      Preconditions.checkNotNull(path);
+    }
+    statBatchNative(paths, followSymlinks, results);
+  }
+
+  private static native void statBatchNative(
+      String[] paths, boolean followSymlinks, long[] results);
+
   /**
    * Native wrapper around POSIX utime(2) syscall.
    *
@@ -362,6 +413,75 @@ public final class NativePosixFiles {
   private static native Dirents readdir(String path, char typeCode)
       throws IOException;
 
+  /**
+   * A compound return type for {@link #readdirPlus}: the names of the entries of a directory,
+   * with the metadata of each, laid out as for {@link #statBatch}.
+   */
+  public static final class DirentsPlus {
+    private final String[] names;
+    private final long[] stats;
+
+    /** called from JNI, with the Latin-1 names each followed by a NUL */
+    DirentsPlus(byte[] names, long[] stats) {
+      this.names = new String[stats.length / PACKED_STAT_LONGS];
+      this.stats = stats;
+      int start = 0;
+      for (int i = 0; i < this.names.length; i++) {
+        int end = start;
+        while (names[end] != 0) {
+          end++;
+        }
+        this.names[i] = new String(names, start, end - start, StandardCharsets.ISO_8859_1);
+        start = end + 1;
+      }
+    }
+
+    public int size() {
+      return names.length;
+    }
+
+    public String getName(int i) {
+      return names[i];
+    }
+
+    /**
+     * Returns a field of the metadata of the i-th entry, e.g. {@code
+     * getStat(i, PACKED_STAT_MODE)}. If the stat call failed, e.g. with ENOENT because the entry
+     * was deleted in the meantime, only {@code PACKED_STAT_ERRNO} is meaningful.
+     */
+    public long getStat(int i, int field) {
+      return stats[i * PACKED_STAT_LONGS + field];
+    }
+
+    /**
+     * Returns the metadata of all entries, that of the i-th entry starting at {@code
+     * i * PACKED_STAT_LONGS}. The array is not copied and must not be modified.
+     */
+    public long[] getStats() {
+      return stats;
+    }
+  }
+
+  /**
+   * Reads a directory and stats all its entries in a single native call, with statx(2) on the
+   * directory's descriptor where available. This is much cheaper than {@link #readdir} followed
+   * by a stat call for each entry.
+   *
+   * <p>It is only worth it for callers that need the metadata of every entry, like {@link
+   * com.google.devtools.build.lib.vfs.Path#readdirWithStatus}, with which tree artifacts are
+   * read. {@link com.google.devtools.build.lib.vfs.UnixFileSystem#readdir} and hence globbing only
+   * need the entry types, which {@link #readdir} gets from the directory itself, stat-ing only
+   * symbolic links; they would make more system calls with this.
+   *
+   * @param path the directory to read.
+   * @param followSymlinks whether to stat the targets of symbolic links rather than the links.
+   * @return the entries of the directory (excluding "." and "..") in the order they were returned
+   *     by the system, with their metadata.
+   * @throws IOException if the call to opendir failed for any reason.
+   */
+  public static native DirentsPlus readdirPlus(String path, boolean followSymlinks)
+      throws IOException;
+
   /**
    * Native wrapper around POSIX rename(2) syscall.
    *
@@ -422,6 +542,31 @@ public final class NativePosixFiles {
   public static native byte[] lgetxattr(String path, String name)
       throws IOException;
 
+  /**
+   * Native wrapper around Linux setxattr(2) syscall.
+   *
+   * @param path the file whose extended attribute is to be set.
+   * @param name the name of the extended attribute key.
+   * @param value the value of the extended attribute.
+   * @throws UnsupportedOperationException if the file system doesn't support extended attributes
+   *     (ENOTSUP).
+   * @throws IOException if the call failed for any other reason.
+   */
+  public static native void setxattr(String path, String name, byte[] value) throws IOException;
+
+  /**
+   * Native wrapper around Linux lsetxattr(2) syscall. (Like setxattr, but does not follow
+   * symbolic links.)
+   *
+   * @param path the file whose extended attribute is to be set.
+   * @param name the name of the extended attribute key.
+   * @param value the value of the extended attribute.
+   * @throws UnsupportedOperationException if the file system doesn't support extended attributes
+   *     (ENOTSUP).
+   * @throws IOException if the call failed for any other reason.
+   */
+  public static native void lsetxattr(String path, String name, byte[] value) throws IOException;
+
   /**
    * Returns the MD5 digest of the specified file, following symbolic links.
    *
@@ -442,6 +587,115 @@ public final class NativePosixFiles {
     return HashCode.fromBytes(md5sumAsBytes(path));
   }
 
+  /** The digest functions supported by {@link #digestBatch}. */
+  public enum DigestFunction {
+    MD5('m', 16, "user.bazel.digest.md5"),
+    SHA1('s', 20, "user.bazel.digest.sha1"),
+    SHA256('2', 32, "user.bazel.digest.sha256");
+
+    private final char code;
+    private final int digestLength;
+    private final String cacheAttribute;
+
+    private DigestFunction(char code, int digestLength, String cacheAttribute) {
+      this.code = code;
+      this.digestLength = digestLength;
+      this.cacheAttribute = cacheAttribute;
+    }
+
+    /** Returns the length of the digests, in bytes. */
+    public int getDigestLength() {
+      return digestLength;
+    }
+  }
+
+  /**
+   * Computes the digests of many files in a single native call, following symbolic links. The
+   * files are hashed concurrently by up to {@code parallelism} native threads, including the
+   * calling one, and each is read sequentially with large reads.
+   *
+   * <p>The digest of {@code paths[i]} is stored in {@code digests} from index {@code i *
+   * function.getDigestLength()}, and {@code errnos[i]} is set to the errno of the failed open or
+   * read call (e.g. {@link ErrnoFileStatus#ENOENT}), or to 0 if the digest was computed.
+   *
+   * <p>The file system uses this for the files digested together through {@link
+   * com.google.devtools.build.lib.vfs.FileSystemUtils#getDigests}, e.g. the children of a tree
+   * artifact.
+   *
+   * @param paths the files whose digests are required.
+   * @param function the digest function.
+   * @param parallelism the maximum number of threads hashing files.
+   * @param digests the array to fill, of at least {@code paths.length *
+   *     function.getDigestLength()} bytes.
+   * @param errnos the array to fill, of at least {@code paths.length} ints.
+   */
+  public static void digestBatch(
+      String[] paths, DigestFunction function, int parallelism, byte[] digests, int[] errnos) {
+    Preconditions.checkArgument(
+        digests.length >= (long) paths.length * function.getDigestLength(),
+        "%s bytes are too few for %s digests",
+        digests.length,
+        paths.length);
+    Preconditions.checkArgument(
+        errnos.length >= paths.length,
+        "%s ints are too few for %s paths",
+        errnos.length,
+        paths.length);
+    for (String path : paths) {
+      Preconditions.checkNotNull(path);
+    }
+    // Passing enums to native code is possible, but onerous; we use a char instead.
+    digestBatchNative(paths, function.code, parallelism, digests, errnos);
+  }
+
+  private static native void digestBatchNative(
+      String[] paths, char functionCode, int parallelism, byte[] digests, int[] errnos);
+
+  /**
+   * Returns the digest of the specified file, following symbolic links, from a cache in one of
+   * its extended attributes. On a miss, the digest is computed and stored there for the next
+   * calls, including from other servers, unless the file was changed in the meantime or very
+   * recently, or is read-only. The cache is keyed by the size, modification time and inode number
+   * of the file, and is read from and written to the file that was opened to compute the digest.
+   *
+   * <p>Setting an extended attribute needs write permission, and the mode of the file is never
+   * changed to get it. So only writable files, typically source files, are cached; the digests of
+   * read-only files, like action outputs, are computed on every call. See {@link
+   * #getOrComputeDigest(String, DigestFunction, String)} to cache those too.
+   *
+   * <p>Storing the digest is best effort: if the file system doesn't support extended attributes,
+   * this is only as expensive as computing the digest.
+   *
+   * @param path the file whose digest is required.
+   * @param function the digest function.
+   * @return the digest, of {@code function.getDigestLength()} bytes.
+   * @throws IOException if the file can't be read.
+   */
+  public static byte[] getOrComputeDigest(String path, DigestFunction function)
+      throws IOException {
+    return getOrComputeDigestNative(path, function.code, function.cacheAttribute, null);
+  }
+
+  /**
+   * Like {@link #getOrComputeDigest(String, DigestFunction)}, but the digests of large files whose
+   * extended attributes can't be set, e.g. read-only action outputs, are cached in {@code
+   * storeDirectory} instead, which is created if needed. There, a file named after the path holds
+   * the digest, keyed by the size, modification and status change times, device and inode number
+   * of the file. So the file is never modified, and a rebuilt file replaces the entry of the
+   * previous one.
+   *
+   * @param storeDirectory a directory for this cache only, e.g. in the output base.
+   */
+  public static byte[] getOrComputeDigest(
+      String path, DigestFunction function, String storeDirectory) throws IOException {
+    Preconditions.checkNotNull(storeDirectory);
+    return getOrComputeDigestNative(path, function.code, function.cacheAttribute, storeDirectory);
+  }
+
+  private static native byte[] getOrComputeDigestNative(
+      String path, char functionCode, String cacheAttribute, String storeDirectory)
+      throws IOException;
+
   /**
    * Removes entire directory tree. Doesn't follow symlinks.
    *
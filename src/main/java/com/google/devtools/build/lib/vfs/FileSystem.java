@@ -18,6 +18,7 @@ import static java.nio.charset.StandardCharsets.ISO_8859_1;
 
 import com.google.common.annotations.VisibleForTesting;
 import com.google.common.collect.Lists;
+import com.google.common.collect.Maps;
 import com.google.common.hash.Hashing;
 import com.google.common.io.ByteSource;
 import com.google.common.io.CharStreams;
@@ -35,6 +36,8 @@ import java.io.OutputStream;
 import java.nio.file.FileAlreadyExistsException;
 import java.util.Collection;
 import java.util.List;
+import java.util.Map;
+import javax.annotation.Nullable;
 
 /**
  * This interface models a file system using UNIX the naming scheme.
@@ -45,7 +48,8 @@ public abstract class FileSystem {
   /** Type of hash function to use for digesting files. */
   public enum HashFunction {
     MD5(16),
-    SHA1(20);
+    SHA1(20),
+    SHA256(32);
 
     private final int digestSize;
 
@@ -324,6 +328,15 @@ public abstract class FileSystem {
     return getFastDigest(path, DIGEST_FUNCTION);
   }
 
+  /**
+   * Returns a {@link BatchStat} for the paths relative to {@code root}, a path of this file
+   * system, or null if this file system can't stat many paths more cheaply than one at a time.
+   */
+  @Nullable
+  public BatchStat getBatchStatter(Path root) {
+    return null;
+  }
+
   /**
    * Returns whether the given digest is a valid digest for the default digest function.
    */
@@ -344,6 +357,8 @@ public abstract class FileSystem {
         return getMD5Digest(path);
       case SHA1:
         return getSHA1Digest(path);
+      case SHA256:
+        return getSHA256Digest(path);
       default:
         throw new IOException("Unsupported hash function: " + hashFunction);
     }
@@ -388,6 +403,39 @@ public abstract class FileSystem {
     }.hash(Hashing.sha1()).asBytes();
   }
 
+  /**
+   * Returns the SHA-256 digest of the file denoted by {@code path}. See
+   * {@link Path#getSHA256Digest} for specification.
+   */
+  protected byte[] getSHA256Digest(final Path path) throws IOException {
+    return new ByteSource() {
+      @Override
+      public InputStream openStream() throws IOException {
+        return getInputStream(path);
+      }
+    }.hash(Hashing.sha256()).asBytes();
+  }
+
+  /**
+   * Returns the digests of the files denoted by {@code paths}, following symbolic links, for the
+   * default digest function, computed by up to {@code parallelism} threads. See {@link
+   * FileSystemUtils#getDigests} for specification.
+   *
+   * <p>This implementation computes them one at a time. File systems that can hash many files
+   * concurrently in a single call override it.
+   */
+  protected byte[][] getDigests(Path[] paths, int parallelism) {
+    byte[][] digests = new byte[paths.length][];
+    for (int i = 0; i < paths.length; i++) {
+      try {
+        digests[i] = getDigest(paths[i]);
+      } catch (IOException e) {
+        // Left to the caller, which computes the digest on its own to report the error.
+      }
+    }
+    return digests;
+  }
+
   /**
    * Returns true if "path" denotes an existing symbolic link. See
    * {@link Path#isSymbolicLink} for specification.
@@ -683,6 +731,25 @@ public abstract class FileSystem {
     return dirents;
   }
 
+  /**
+   * Returns the names of all entries within the directory {@code path}, each mapped to its
+   * status, not following symbolic links. Entries deleted while the directory is read are left
+   * out. See {@link Path#readdirWithStatus} for specification.
+   *
+   * @throws IOException if there was an error reading the directory entries or their statuses
+   */
+  protected Map<String, FileStatus> readdirWithStatus(Path path) throws IOException {
+    Collection<Path> children = getDirectoryEntries(path);
+    Map<String, FileStatus> statuses = Maps.newLinkedHashMapWithExpectedSize(children.size());
+    for (Path child : children) {
+      FileStatus status = statIfFound(child, false);
+      if (status != null) {
+        statuses.put(child.getBaseName(), status);
+      }
+    }
+    return statuses;
+  }
+
   /**
    * Returns true iff the file represented by {@code path} is readable.
    *
@@ -967,6 +967,24 @@ public class FileSystemUtils {
     return bytes;
   }
 
+  /**
+   * Returns the digests of the files {@code paths} of {@code fs}, following symbolic links, for
+   * the default digest function (see {@link Path#getDigest}). File systems that support it hash
+   * them concurrently with up to {@code parallelism} threads, which is much faster than calling
+   * {@link Path#getDigest} on each when there are many files, e.g. the children of a tree
+   * artifact. It lives here because the batch is a method of the file system, not of a path.
+   *
+   * @return the digests, in the order of {@code paths}, with null for the files whose digest
+   *     couldn't be computed. Callers compute those one by one to report the error.
+   */
+  public static byte[][] getDigests(FileSystem fs, Path[] paths, int parallelism) {
+    Preconditions.checkArgument(parallelism > 0, parallelism);
+    for (Path path : paths) {
+      Preconditions.checkArgument(path.getFileSystem() == fs, "%s is not in %s", path, fs);
+    }
+    return fs.getDigests(paths, parallelism);
+  }
+
   /**
    * Dumps diagnostic information about the specified filesystem to {@code out}.
    * This is the implementation of the filesystem part of the 'blaze dump'
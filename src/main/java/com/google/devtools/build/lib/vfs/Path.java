@@ -33,6 +33,7 @@ import java.lang.ref.ReferenceQueue;
 import java.lang.ref.WeakReference;
 import java.util.Collection;
 import java.util.IdentityHashMap;
+import java.util.Map;
 import java.util.Objects;
 
 /**
@@ -520,6 +521,19 @@ public class Path implements Comparable<Path>, Serializable {
     return fileSystem.readdir(this, followSymlinks.toBoolean());
   }
 
+  /**
+   * Returns the names of all entries within the directory denoted by the current path, each
+   * mapped to its status, as {@link #stat(Symlinks)} with {@code NOFOLLOW} would return it.
+   * Entries deleted while the directory is read are left out. This is cheaper than stat-ing each
+   * of {@link #getDirectoryEntries} on file systems that can read a directory and stat its
+   * entries at once. Note that the order of the returned entries is not guaranteed.
+   *
+   * @throws IOException if there was an error reading the directory entries or their statuses
+   */
+  public Map<String, FileStatus> readdirWithStatus() throws IOException {
+    return fileSystem.readdirWithStatus(this);
+  }
+
   /**
    * Returns a new, immutable collection containing the names of all entities
    * within the directory denoted by the current path, for which the given
@@ -1100,6 +1114,20 @@ public class Path implements Comparable<Path>, Serializable {
     return fileSystem.getSHA1Digest(this);
   }
 
+  /**
+   * Returns the SHA-256 digest of the file denoted by the current path, following
+   * symbolic links.
+   *
+   * <p>This method runs in O(n) time where n is the length of the file, but
+   * certain implementations may be much faster than the worst case.
+   *
+   * @return a new 32-byte array containing the file's SHA-256 digest
+   * @throws IOException if the SHA-256 digest could not be computed for any reason
+   */
+  public byte[] getSHA256Digest() throws IOException {
+    return fileSystem.getSHA256Digest(this);
+  }
+
   /**
    * Returns the digest of the file denoted by the current path,
    * following symbolic links.
@@ -0,0 +1,153 @@
+// Copyright 2016 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+package com.google.devtools.build.lib.vfs;
+
+import com.google.devtools.build.lib.profiler.Profiler;
+import com.google.devtools.build.lib.profiler.ProfilerTask;
+import com.google.devtools.build.lib.unix.ErrnoFileStatus;
+import com.google.devtools.build.lib.unix.NativePosixFiles;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+import javax.annotation.Nullable;
+
+/**
+ * A {@link BatchStat} for a {@link UnixFileSystem}, which stats all the paths of a batch in a
+ * single native call with {@link NativePosixFiles#statBatch}. The results are views of the packed
+ * metadata, so nothing is allocated by the native code per path.
+ *
+ * <p>Digests are never included, as in the statuses of {@link UnixFileSystem}: callers get them
+ * from the file system when they need them.
+ */
+final class UnixBatchStat implements BatchStat {
+
+  private static final Profiler profiler = Profiler.instance();
+
+  private final Path root;
+
+  UnixBatchStat(Path root) {
+    this.root = root;
+  }
+
+  /**
+   * Returns the statuses of {@code paths}, relative to the root of this batch stat, with null for
+   * those that don't exist, like {@link Path#statIfFound}.
+   *
+   * @throws IOException if a path can't be stat'ed for any other reason, e.g. permissions
+   */
+  @Override
+  public List<FileStatusWithDigest> batchStat(
+      boolean includeDigest, boolean includeLinks, Iterable<PathFragment> paths)
+      throws IOException {
+    List<Path> absolutePaths = new ArrayList<>();
+    for (PathFragment path : paths) {
+      absolutePaths.add(root.getRelative(path));
+    }
+    String[] nameArray = new String[absolutePaths.size()];
+    for (int i = 0; i < nameArray.length; i++) {
+      nameArray[i] = absolutePaths.get(i).getPathString();
+    }
+    long[] results = new long[nameArray.length * NativePosixFiles.PACKED_STAT_LONGS];
+    long startTime = Profiler.nanoTimeMaybe();
+    try {
+      NativePosixFiles.statBatch(nameArray, !includeLinks, results);
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_STAT, nameArray.length + " files");
+    }
+
+    List<FileStatusWithDigest> stats = new ArrayList<>(nameArray.length);
+    for (int i = 0; i < nameArray.length; i++) {
+      int offset = i * NativePosixFiles.PACKED_STAT_LONGS;
+      long errno = results[offset + NativePosixFiles.PACKED_STAT_ERRNO];
+      if (errno == 0) {
+        stats.add(new PackedFileStatus(results, offset));
+      } else if (errno == ErrnoFileStatus.ENOENT || errno == ErrnoFileStatus.ENOTDIR) {
+        stats.add(null);
+      } else {
+        // Stats the path again, to throw the proper exception.
+        Symlinks symlinks = includeLinks ? Symlinks.NOFOLLOW : Symlinks.FOLLOW;
+        stats.add(FileStatusWithDigestAdapter.adapt(absolutePaths.get(i).statIfFound(symlinks)));
+      }
+    }
+    return stats;
+  }
+
+  /**
+   * The status of a path at an offset of the results of {@link NativePosixFiles#statBatch} or
+   * {@link NativePosixFiles#readdirPlus}.
+   */
+  static final class PackedFileStatus implements FileStatusWithDigest {
+
+    private final long[] results;
+    private final int offset;
+
+    PackedFileStatus(long[] results, int offset) {
+      this.results = results;
+      this.offset = offset;
+    }
+
+    private int getType() {
+      int mode = (int) results[offset + NativePosixFiles.PACKED_STAT_MODE];
+      return mode & com.google.devtools.build.lib.unix.FileStatus.S_IFMT;
+    }
+
+    // Same as UnixFileSystem.UnixFileStatus.
+
+    @Override
+    public boolean isFile() {
+      return !isDirectory() && !isSymbolicLink();
+    }
+
+    @Override
+    public boolean isSpecialFile() {
+      return isFile() && getType() != com.google.devtools.build.lib.unix.FileStatus.S_IFREG;
+    }
+
+    @Override
+    public boolean isDirectory() {
+      return getType() == com.google.devtools.build.lib.unix.FileStatus.S_IFDIR;
+    }
+
+    @Override
+    public boolean isSymbolicLink() {
+      return getType() == com.google.devtools.build.lib.unix.FileStatus.S_IFLNK;
+    }
+
+    @Override
+    public long getSize() {
+      return results[offset + NativePosixFiles.PACKED_STAT_SIZE];
+    }
+
+    @Override
+    public long getLastModifiedTime() {
+      return Math.floorDiv(results[offset + NativePosixFiles.PACKED_STAT_MTIME_NS], 1000000L);
+    }
+
+    @Override
+    public long getLastChangeTime() {
+      return Math.floorDiv(results[offset + NativePosixFiles.PACKED_STAT_CTIME_NS], 1000000L);
+    }
+
+    @Override
+    public long getNodeId() {
+      return results[offset + NativePosixFiles.PACKED_STAT_INO];
+    }
+
+    @Nullable
+    @Override
+    public byte[] getDigest() {
+      return null;
+    }
+  }
+}
@@ -15,25 +15,59 @@ package com.google.devtools.build.lib.vfs;
 
 import com.google.common.annotations.VisibleForTesting;
 import com.google.common.collect.Lists;
+import com.google.common.collect.Maps;
 import com.google.devtools.build.lib.concurrent.ThreadSafety.ThreadSafe;
 import com.google.devtools.build.lib.profiler.Profiler;
 import com.google.devtools.build.lib.profiler.ProfilerTask;
 import com.google.devtools.build.lib.unix.ErrnoFileStatus;
 import com.google.devtools.build.lib.unix.NativePosixFiles;
 import com.google.devtools.build.lib.unix.NativePosixFiles.Dirents;
+import com.google.devtools.build.lib.unix.NativePosixFiles.DirentsPlus;
 import com.google.devtools.build.lib.unix.NativePosixFiles.ReadTypes;
 import com.google.devtools.build.lib.util.Preconditions;
 import java.io.IOException;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.Collection;
 import java.util.List;
+import java.util.Map;
+import javax.annotation.Nullable;
 
 /**
  * This class implements the FileSystem interface using direct calls to the UNIX filesystem.
  */
 @ThreadSafe
 public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
+  /**
+   * Whether the digests of files are cached, so that unchanged files aren't hashed again after a
+   * server restart. There are two caches: writable files, like source files, keep their digests
+   * in their extended attributes, and large read-only files, like action outputs, in {@link
+   * #digestCacheDirectory}. Enabled with --host_jvm_args=-Dbazel.DigestCache=1.
+   */
+  private static final boolean CACHE_DIGESTS =
+      "1".equals(System.getProperty("bazel.DigestCache"));
+
+  // The directory caching the digests of read-only files, or null to not cache them.
+  @Nullable private final String digestCacheDirectory;
+
   public UnixFileSystem() {
+    this(null);
+  }
+
+  /**
+   * Creates a file system that caches the digests of read-only files in {@code
+   * digestCacheDirectory}, e.g. in the output base, if digest caching is enabled.
+   */
+  public UnixFileSystem(@Nullable PathFragment digestCacheDirectory) {
+    this.digestCacheDirectory =
+        digestCacheDirectory == null ? null : digestCacheDirectory.getPathString();
+  }
+
+  private byte[] getOrComputeDigest(String name, NativePosixFiles.DigestFunction function)
+      throws IOException {
+    return digestCacheDirectory == null
+        ? NativePosixFiles.getOrComputeDigest(name, function)
+        : NativePosixFiles.getOrComputeDigest(name, function, digestCacheDirectory);
   }
 
   /**
@@ -155,6 +189,36 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     }
   }
 
+  /**
+   * Reads the directory and stats its entries in a single native call, with {@link
+   * NativePosixFiles#readdirPlus}, instead of one call per entry. The statuses are views of the
+   * packed metadata, as for {@link UnixBatchStat}.
+   */
+  @Override
+  protected Map<String, FileStatus> readdirWithStatus(Path path) throws IOException {
+    String name = path.getPathString();
+    DirentsPlus dirents;
+    long startTime = Profiler.nanoTimeMaybe();
+    try {
+      dirents = NativePosixFiles.readdirPlus(name, false);
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_DIR, name);
+    }
+    Map<String, FileStatus> statuses = Maps.newLinkedHashMapWithExpectedSize(dirents.size());
+    for (int i = 0; i < dirents.size(); i++) {
+      long errno = dirents.getStat(i, NativePosixFiles.PACKED_STAT_ERRNO);
+      if (errno == 0) {
+        statuses.put(dirents.getName(i),
+            new UnixBatchStat.PackedFileStatus(dirents.getStats(),
+                i * NativePosixFiles.PACKED_STAT_LONGS));
+      } else if (errno != ErrnoFileStatus.ENOENT) {
+        // Stats the entry again, to throw the proper exception.
+        statuses.put(dirents.getName(i), stat(path.getChild(dirents.getName(i)), false));
+      }
+    }
+    return statuses;
+  }
+
   @Override
   protected FileStatus stat(Path path, boolean followSymlinks) throws IOException {
     return statInternal(path, followSymlinks);
@@ -225,6 +289,12 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     }
   }
 
+  @Override
+  public BatchStat getBatchStatter(Path root) {
+    Preconditions.checkArgument(root.getFileSystem() == this, root);
+    return new UnixBatchStat(root);
+  }
+
   @Override
   protected boolean isReadable(Path path) throws IOException {
     return (statInternal(path, true).getPermissions() & 0400) != 0;
@@ -403,12 +473,73 @@ public class UnixFileSystem extends AbstractFileSystemWithCustomStat {
     String name = path.toString();
     long startTime = Profiler.nanoTimeMaybe();
     try {
+      if (CACHE_DIGESTS) {
+        return getOrComputeDigest(name, NativePosixFiles.DigestFunction.MD5);
+      }
       return NativePosixFiles.md5sum(name).asBytes();
     } finally {
       profiler.logSimpleTask(startTime, ProfilerTask.VFS_MD5, name);
     }
   }
 
+  @Override
+  protected byte[] getSHA1Digest(Path path) throws IOException {
+    if (CACHE_DIGESTS) {
+      return getOrComputeDigest(path.toString(), NativePosixFiles.DigestFunction.SHA1);
+    }
+    return super.getSHA1Digest(path);
+  }
+
+  @Override
+  protected byte[] getSHA256Digest(Path path) throws IOException {
+    if (CACHE_DIGESTS) {
+      return getOrComputeDigest(path.toString(), NativePosixFiles.DigestFunction.SHA256);
+    }
+    return super.getSHA256Digest(path);
+  }
+
+  @Override
+  protected byte[][] getDigests(Path[] paths, int parallelism) {
+    if (CACHE_DIGESTS || paths.length < 2) {
+      // Files with cached digests are not hashed at all, which beats hashing them concurrently.
+      return super.getDigests(paths, parallelism);
+    }
+    NativePosixFiles.DigestFunction function;
+    switch (getDigestFunction()) {
+      case MD5:
+        function = NativePosixFiles.DigestFunction.MD5;
+        break;
+      case SHA1:
+        function = NativePosixFiles.DigestFunction.SHA1;
+        break;
+      case SHA256:
+        function = NativePosixFiles.DigestFunction.SHA256;
+        break;
+      default:
+        return super.getDigests(paths, parallelism);
+    }
+    String[] names = new String[paths.length];
+    for (int i = 0; i < paths.length; i++) {
+      names[i] = paths[i].toString();
+    }
+    int digestLength = function.getDigestLength();
+    byte[] digests = new byte[paths.length * digestLength];
+    int[] errnos = new int[paths.length];
+    long startTime = Profiler.nanoTimeMaybe();
+    try {
+      NativePosixFiles.digestBatch(names, function, parallelism, digests, errnos);
+    } finally {
+      profiler.logSimpleTask(startTime, ProfilerTask.VFS_MD5, paths.length + " files");
+    }
+    byte[][] result = new byte[paths.length][];
+    for (int i = 0; i < paths.length; i++) {
+      if (errnos[i] == 0) {
+        result[i] = Arrays.copyOfRange(digests, i * digestLength, (i + 1) * digestLength);
+      }
+    }
+    return result;
+  }
+
   @Override
   protected void createFSDependentHardLink(Path linkPath, Path originalPath)
       throws IOException {
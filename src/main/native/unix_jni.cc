@@ -22,21 +22,32 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 #include <utime.h>
 
+#include <algorithm>
+#include <atomic>
 #include <string>
+#include <system_error>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "src/main/native/macros.h"
 #include "src/main/cpp/util/md5.h"
 #include "src/main/cpp/util/port.h"
+#include "src/main/cpp/util/sha1.h"
+#include "src/main/cpp/util/sha256.h"
 
 using blaze_util::Md5Digest;
+using blaze_util::Sha1Digest;
+using blaze_util::Sha256Digest;
 
 ////////////////////////////////////////////////////////////////////////
 // Latin1 <--> java.lang.String conversion functions.
@@ -462,6 +473,95 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_errnoLstat(JNIEnv *env,
   return ::StatCommon(env, path, portable_lstat, false);
 }
 
+// Stats `name` into `result`, laid out as described by PackedStat, with
+// statx(2) where available. `name` is relative to `dir`, or to the working
+// directory if `dir` is NULL, and `dirfd` must be the descriptor of `dir` (or
+// AT_FDCWD). Returns the errno of the failed call, or 0.
+static int StatPacked(const char *dir, int dirfd, const char *name,
+                      bool follow_symlinks, jlong *result) {
+  static bool statx_unavailable = false;  // note: harmless race condition
+  int r;
+  // Whether statx failed with EPERM, which seccomp filters that don't know
+  // statx (like the default one of older Docker versions) make it fail with.
+  bool statx_denied = false;
+  if (!statx_unavailable) {
+    while ((r = portable_statx_packed(dirfd, name, follow_symlinks, result)) ==
+               -1 &&
+           errno == EINTR) { }
+    if (r == 0) {
+      return 0;
+    } else if (errno == ENOSYS) {
+      statx_unavailable = true;
+    } else if (errno == EPERM) {
+      statx_denied = true;
+    } else {
+      return errno;
+    }
+  }
+
+  // Not portable_fstatat(), which cannot lstat everywhere.
+  std::string path = dir == NULL ? name : std::string(dir) + "/" + name;
+  portable_stat_struct statbuf;
+  while ((r = follow_symlinks ? portable_stat(path.c_str(), &statbuf)
+                              : portable_lstat(path.c_str(), &statbuf)) == -1 &&
+         errno == EINTR) { }
+  if (r == -1) {
+    return errno;
+  }
+  // stat(2) succeeding where statx failed with EPERM means that statx is
+  // blocked, not that the file may not be stat-ed.
+  if (statx_denied) {
+    statx_unavailable = true;
+  }
+  result[PACKED_STAT_MODE] = statbuf.st_mode;
+  result[PACKED_STAT_SIZE] = statbuf.st_size;
+  result[PACKED_STAT_MTIME_NS] =
+      StatSeconds(statbuf, STAT_MTIME) * 1000000000LL +
+      StatNanoSeconds(statbuf, STAT_MTIME);
+  result[PACKED_STAT_CTIME_NS] =
+      StatSeconds(statbuf, STAT_CTIME) * 1000000000LL +
+      StatNanoSeconds(statbuf, STAT_CTIME);
+  result[PACKED_STAT_DEV] = statbuf.st_dev;
+  result[PACKED_STAT_INO] = statbuf.st_ino;
+  return 0;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    statBatchNative
+ * Signature: ([Ljava/lang/String;Z[J)V
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_statBatchNative(
+    JNIEnv *env, jclass clazz, jobjectArray paths, jboolean follow_symlinks,
+    jlongArray results) {
+  jsize count = env->GetArrayLength(paths);
+  // Filled locally and copied once, so that no JNI call but the ones to get
+  // the paths happens between the stat calls.
+  std::vector<jlong> packed(static_cast<size_t>(count) * PACKED_STAT_LONGS);
+  for (jsize i = 0; i < count; i++) {
+    jstring path = static_cast<jstring>(env->GetObjectArrayElement(paths, i));
+    const char *path_chars = GetStringLatin1Chars(env, path);
+    if (path_chars == NULL) {
+      return;  // pending exception
+    }
+    jlong *result = &packed[static_cast<size_t>(i) * PACKED_STAT_LONGS];
+    result[PACKED_STAT_ERRNO] =
+        StatPacked(NULL, AT_FDCWD, path_chars, follow_symlinks, result);
+    // EACCES ENOENT ENOTDIR ELOOP ENAMETOOLONG -> errno in the result
+    // EFAULT ENOMEM                            -> RuntimeException
+    bool thrown = PostRuntimeException(env, result[PACKED_STAT_ERRNO],
+                                       path_chars);
+    ::ReleaseStringLatin1Chars(path_chars);
+    // Don't overflow the local reference table with big batches.
+    env->DeleteLocalRef(path);
+    if (thrown) {
+      return;
+    }
+  }
+  env->SetLongArrayRegion(results, 0, packed.size(), packed.data());
+}
+
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
  * Method:    utime
@@ -667,6 +767,105 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdir(JNIEnv *env,
   return NewDirents(env, names_obj, types_obj);
 }
 
+static jobject NewDirentsPlus(JNIEnv *env,
+                              jbyteArray names,
+                              jlongArray stats) {
+  static jclass dirents_plus_class = NULL;
+  if (dirents_plus_class == NULL) {  // note: harmless race condition
+    jclass local = env->FindClass(
+        "com/google/devtools/build/lib/unix/NativePosixFiles$DirentsPlus");
+    CHECK(local != NULL);
+    dirents_plus_class = static_cast<jclass>(env->NewGlobalRef(local));
+  }
+
+  static jmethodID ctor = NULL;
+  if (ctor == NULL) {  // note: harmless race condition
+    ctor = env->GetMethodID(dirents_plus_class, "<init>", "([B[J)V");
+    CHECK(ctor != NULL);
+  }
+
+  return env->NewObject(dirents_plus_class, ctor, names, stats);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    readdirPlus
+ * Signature: (Ljava/lang/String;Z)Lcom/google/devtools/build/lib/unix/NativePosixFiles$DirentsPlus;
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_readdirPlus(
+    JNIEnv *env, jclass clazz, jstring path, jboolean follow_symlinks) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  if (path_chars == NULL) {
+    return NULL;  // pending exception
+  }
+  DIR *dirh;
+  while ((dirh = ::opendir(path_chars)) == NULL && errno == EINTR) { }
+  if (dirh == NULL) {
+    // EACCES EMFILE ENFILE ENOENT ENOTDIR -> IOException
+    // ENOMEM                              -> OutOfMemoryError
+    ::PostFileException(env, errno, path_chars);
+    ReleaseStringLatin1Chars(path_chars);
+    return NULL;
+  }
+  int fd = dirfd(dirh);
+
+  // The names, each followed by a NUL, and PACKED_STAT_LONGS jlongs for each.
+  std::string names;
+  std::vector<jlong> stats;
+  for (;;) {
+    // See readdir above.
+    errno = 0;
+    struct dirent *entry = ::readdir(dirh);
+    if (entry == NULL) {
+      if (errno == 0) break;  // EOF
+      if (errno == EINTR) continue;  // interrupted by a signal
+      if (errno == EIO) continue;  // glibc returns this on transient errors
+      ::PostFileException(env, errno, path_chars);
+      ::closedir(dirh);
+      ReleaseStringLatin1Chars(path_chars);
+      return NULL;
+    }
+    // Omit . and .. from results.
+    if (entry->d_name[0] == '.') {
+      if (entry->d_name[1] == '\0') continue;
+      if (entry->d_name[1] == '.' && entry->d_name[2] == '\0') continue;
+    }
+    names.append(entry->d_name, strlen(entry->d_name) + 1);
+    stats.resize(stats.size() + PACKED_STAT_LONGS);
+    jlong *result = &stats[stats.size() - PACKED_STAT_LONGS];
+    // The entry may also have been deleted since, which is reported as ENOENT.
+    result[PACKED_STAT_ERRNO] = StatPacked(path_chars, fd, entry->d_name,
+                                           follow_symlinks, result);
+    if (PostRuntimeException(env, result[PACKED_STAT_ERRNO], entry->d_name)) {
+      ::closedir(dirh);
+      ReleaseStringLatin1Chars(path_chars);
+      return NULL;
+    }
+  }
+
+  if (::closedir(dirh) < 0 && errno != EINTR) {
+    ::PostFileException(env, errno, path_chars);
+    ReleaseStringLatin1Chars(path_chars);
+    return NULL;
+  }
+  ReleaseStringLatin1Chars(path_chars);
+
+  jbyteArray names_obj = env->NewByteArray(names.size());
+  if (names_obj == NULL) {
+    return NULL;  // pending exception
+  }
+  env->SetByteArrayRegion(names_obj, 0, names.size(),
+                          reinterpret_cast<const jbyte *>(names.data()));
+  jlongArray stats_obj = env->NewLongArray(stats.size());
+  if (stats_obj == NULL) {
+    return NULL;  // pending exception
+  }
+  env->SetLongArrayRegion(stats_obj, 0, stats.size(), stats.data());
+  return NewDirentsPlus(env, names_obj, stats_obj);
+}
+
 /*
  * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
  * Method:    rename
@@ -804,43 +1003,186 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_lgetxattr(JNIEnv *env,
   return ::getxattr_common(env, path, name, ::portable_lgetxattr);
 }
 
+typedef int setxattr_func(const char *path, const char *name,
+                          const void *value, size_t size);
+
+static void setxattr_common(JNIEnv *env,
+                            jstring path,
+                            jstring name,
+                            jbyteArray value,
+                            setxattr_func setxattr) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  const char *name_chars = GetStringLatin1Chars(env, name);
+  jsize size = env->GetArrayLength(value);
+  std::vector<jbyte> value_bytes(size);
+  env->GetByteArrayRegion(value, 0, size, value_bytes.data());
+  int r;
+  while ((r = setxattr(path_chars, name_chars, value_bytes.data(), size)) ==
+             -1 &&
+         errno == EINTR) { }
+  if (r == -1) {
+    // ENOTSUP -> UnsupportedOperationException
+    if (!PostRuntimeException(env, errno, path_chars)) {
+      ::PostFileException(env, errno, path_chars);
+    }
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  ReleaseStringLatin1Chars(name_chars);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    setxattr
+ * Signature: (Ljava/lang/String;Ljava/lang/String;[B)V
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_setxattr(
+    JNIEnv *env, jclass clazz, jstring path, jstring name, jbyteArray value) {
+  ::setxattr_common(env, path, name, value, ::portable_setxattr);
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    lsetxattr
+ * Signature: (Ljava/lang/String;Ljava/lang/String;[B)V
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_lsetxattr(
+    JNIEnv *env, jclass clazz, jstring path, jstring name, jbyteArray value) {
+  ::setxattr_common(env, path, name, value, ::portable_lsetxattr);
+}
+
 
 // Computes MD5 digest of "file", writes result in "result", which
 // must be of length Md5Digest::kDigestLength.  Returns zero on success, or
 // -1 (and sets errno) otherwise.
-static int md5sumAsBytes(const char *file,
-                         jbyte result[Md5Digest::kDigestLength]) {
-  Md5Digest digest;
-  // OPT: Using a 32k buffer would give marginally better performance,
-  // but what is the stack size here?
-  jbyte buf[8192];
-  int fd;
-  while ((fd = open(file, O_RDONLY)) == -1 && errno == EINTR) { }
-  if (fd == -1) {
-    return -1;
+// The size of the buffer files are read through to compute their digests.
+// Large reads make fewer system calls, and page alignment lets the kernel copy
+// whole pages.
+static const size_t kDigestBufferSize = 256 * 1024;
+static const size_t kDigestBufferAlignment = 4096;
+
+// A buffer of kDigestBufferSize bytes, or of fewer if out of memory.
+class DigestBuffer {
+ public:
+  DigestBuffer() {
+    void *buf;
+    if (posix_memalign(&buf, kDigestBufferAlignment, kDigestBufferSize) == 0) {
+      data_ = static_cast<char *>(buf);
+      size_ = kDigestBufferSize;
+    } else {
+      data_ = fallback_;
+      size_ = sizeof(fallback_);
+    }
+  }
+
+  DigestBuffer(const DigestBuffer &) = delete;
+  DigestBuffer &operator=(const DigestBuffer &) = delete;
+
+  ~DigestBuffer() {
+    if (data_ != fallback_) {
+      free(data_);
+    }
   }
-  for (ssize_t len = read(fd, buf, arraysize(buf));
+
+  char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  char *data_;
+  size_t size_;
+  char fallback_[8192];
+};
+
+// Like DigestFile, but reads the open file `fd` from its current offset, and
+// doesn't close it.
+template <class Digest>
+static int DigestFd(int fd, const DigestBuffer &buf, jbyte *result) {
+  Digest digest;
+  portable_advise_sequential_read(fd);
+  for (ssize_t len = read(fd, buf.data(), buf.size());
        len != 0;
-       len = read(fd, buf, arraysize(buf))) {
+       len = read(fd, buf.data(), buf.size())) {
     if (len == -1) {
       if (errno == EINTR) {
         continue;
       } else {
-        int read_errno = errno;
-        close(fd);  // prefer read() errors over close().
-        errno = read_errno;
         return -1;
       }
     }
-    digest.Update(buf, len);
+    digest.Update(buf.data(), len);
+  }
+  digest.Finish(reinterpret_cast<unsigned char*>(result));
+  return 0;
+}
+
+// Computes the digest of `file` with `Digest` (e.g. Md5Digest) into `result`,
+// of Digest::kDigestLength bytes, reading it through `buf`. Returns -1 and
+// sets errno on failure.
+template <class Digest>
+static int DigestFile(const char *file, const DigestBuffer &buf,
+                      jbyte *result) {
+  int fd;
+  while ((fd = open(file, O_RDONLY)) == -1 && errno == EINTR) { }
+  if (fd == -1) {
+    return -1;
+  }
+  if (DigestFd<Digest>(fd, buf, result) == -1) {
+    int read_errno = errno;
+    close(fd);  // prefer read() errors over close().
+    errno = read_errno;
+    return -1;
   }
   if (close(fd) < 0 && errno != EINTR) {
     return -1;
   }
-  digest.Finish(reinterpret_cast<unsigned char*>(result));
   return 0;
 }
 
+static int md5sumAsBytes(const char *file,
+                         jbyte result[Md5Digest::kDigestLength]) {
+  DigestBuffer buf;
+  return DigestFile<Md5Digest>(file, buf, result);
+}
+
+// The codes of the functions of NativePosixFiles.DigestFunction. Keep in sync.
+enum DigestFunctionCode {
+  DIGEST_MD5 = 'm',
+  DIGEST_SHA1 = 's',
+  DIGEST_SHA256 = '2',
+};
+
+// The length of the longest digest of a DigestFunctionCode.
+static const size_t kMaxDigestLength = Sha256Digest::kDigestLength;
+
+// Returns the length of the digests of the function `function`, a
+// DigestFunctionCode. Unknown codes are MD5.
+static size_t DigestLength(jchar function) {
+  switch (function) {
+    case DIGEST_SHA1:
+      return Sha1Digest::kDigestLength;
+    case DIGEST_SHA256:
+      return Sha256Digest::kDigestLength;
+    default:
+      return Md5Digest::kDigestLength;
+  }
+}
+
+// Like DigestFile, with the digest function `function`, a DigestFunctionCode.
+static int DigestFileWith(jchar function, const char *file,
+                          const DigestBuffer &buf, jbyte *result) {
+  switch (function) {
+    case DIGEST_SHA1:
+      return DigestFile<Sha1Digest>(file, buf, result);
+    case DIGEST_SHA256:
+      return DigestFile<Sha256Digest>(file, buf, result);
+    default:
+      return DigestFile<Md5Digest>(file, buf, result);
+  }
+}
+
 
 extern "C" JNIEXPORT jbyteArray JNICALL
 Java_com_google_devtools_build_lib_unix_NativePosixFiles_md5sumAsBytes(
@@ -858,6 +1200,323 @@ Java_com_google_devtools_build_lib_unix_NativePosixFiles_md5sumAsBytes(
   return result;
 }
 
+// The value of the extended attributes digests are cached in is this key of
+// the file contents they were computed for, followed by the digest. The status
+// change time isn't part of the key, since setting the attribute changes it.
+struct CachedDigestKey {
+  int64_t size;
+  int64_t mtime_ns;
+  int64_t ino;
+};
+
+static CachedDigestKey GetCachedDigestKey(const portable_stat_struct &statbuf) {
+  CachedDigestKey key;
+  key.size = statbuf.st_size;
+  key.mtime_ns = StatSeconds(statbuf, STAT_MTIME) * 1000000000LL +
+                 StatNanoSeconds(statbuf, STAT_MTIME);
+  key.ino = statbuf.st_ino;
+  return key;
+}
+
+// Files modified this recently aren't cached: they could be modified again
+// without their modification time changing, with a coarse-grained clock.
+static const time_t kMinCachedDigestAgeSecs = 2;
+
+// Stores `value` in the extended attribute `name` of the open file `fd`, whose
+// status is `statbuf`. Setting an attribute needs write permission, so
+// read-only files, like action outputs, aren't cached there rather than having
+// their mode changed under other readers. Returns whether the value was
+// stored.
+static bool StoreCachedDigest(int fd, const portable_stat_struct &statbuf,
+                              const char *name, const void *value,
+                              size_t size) {
+  return (statbuf.st_mode & (S_IWUSR | S_IWGRP | S_IWOTH)) != 0 &&
+         portable_fsetxattr(fd, name, value, size) == 0;
+}
+
+// The digests of files whose extended attributes can't be set, e.g. read-only
+// action outputs, are stored in a directory instead, in a file named after
+// the path of the file and the attribute name. So a rebuilt output replaces
+// the entry of the previous one. The value of the file is this key followed by
+// the digest. The file isn't modified to store it, so its status change time
+// is part of the key.
+struct StoredDigestKey {
+  CachedDigestKey key;
+  int64_t ctime_ns;
+  int64_t dev;
+};
+
+// Smaller files are digested about as fast as their stored digest is read, so
+// they aren't stored. This also keeps the directory small.
+static const int64_t kMinStoredDigestSize = 1 << 20;
+
+static StoredDigestKey GetStoredDigestKey(const portable_stat_struct &statbuf) {
+  StoredDigestKey key;
+  key.key = GetCachedDigestKey(statbuf);
+  key.ctime_ns = StatSeconds(statbuf, STAT_CTIME) * 1000000000LL +
+                 StatNanoSeconds(statbuf, STAT_CTIME);
+  key.dev = statbuf.st_dev;
+  return key;
+}
+
+// Returns the path of the file of `store_dir` that stores the digest of
+// `file` for the attribute `name`.
+static std::string GetStoredDigestPath(const char *store_dir, const char *file,
+                                       const char *name) {
+  Md5Digest md5;
+  // The NUL separates the path from the name.
+  md5.Update(file, strlen(file) + 1);
+  md5.Update(name, strlen(name));
+  unsigned char digest[Md5Digest::kDigestLength];
+  md5.Finish(digest);
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string result = std::string(store_dir) + "/";
+  for (unsigned char c : digest) {
+    result += kHexDigits[c >> 4];
+    result += kHexDigits[c & 0xf];
+  }
+  return result;
+}
+
+// Reads the digest of `length` bytes stored at `path` into `digest` if it was
+// stored for `key`. Returns whether it was.
+static bool ReadStoredDigest(const std::string &path,
+                             const StoredDigestKey &key, jbyte *digest,
+                             size_t length) {
+  int fd;
+  while ((fd = open(path.c_str(), O_RDONLY)) == -1 && errno == EINTR) { }
+  if (fd == -1) {
+    return false;
+  }
+  jbyte value[sizeof(key) + kMaxDigestLength];
+  ssize_t size = sizeof(key) + length;
+  ssize_t r;
+  while ((r = read(fd, value, size)) == -1 && errno == EINTR) { }
+  close(fd);
+  if (r != size || memcmp(value, &key, sizeof(key)) != 0) {
+    return false;
+  }
+  memcpy(digest, value + sizeof(key), length);
+  return true;
+}
+
+// Stores the digest of `length` bytes for `key` at `path`, in `store_dir`,
+// which is created if needed. The file is replaced atomically, so that
+// concurrent readers see either value. Errors are ignored: the cache is best
+// effort.
+static void WriteStoredDigest(const char *store_dir, const std::string &path,
+                              const StoredDigestKey &key, const jbyte *digest,
+                              size_t length) {
+  std::string tmp_template = path + ".XXXXXX";
+  // mkstemp() replaces the Xs of a mutable, NUL-terminated copy.
+  const char *tmp_begin = tmp_template.c_str();
+  const char *tmp_end = tmp_begin + tmp_template.size() + 1;
+  std::vector<char> tmp(tmp_begin, tmp_end);
+  int fd = mkstemp(tmp.data());
+  if (fd == -1 && errno == ENOENT && mkdir(store_dir, 0755) == 0) {
+    tmp.assign(tmp_begin, tmp_end);
+    fd = mkstemp(tmp.data());
+  }
+  if (fd == -1) {
+    return;
+  }
+  jbyte value[sizeof(key) + kMaxDigestLength];
+  memcpy(value, &key, sizeof(key));
+  memcpy(value + sizeof(key), digest, length);
+  ssize_t size = sizeof(key) + length;
+  bool written = write(fd, value, size) == size;
+  if (close(fd) == -1 || !written || rename(tmp.data(), path.c_str()) == -1) {
+    unlink(tmp.data());
+  }
+}
+
+// Returns the digest of `file` with `Digest` in `result`, from its extended
+// attribute `name` or from `store_dir` if the file wasn't changed since it was
+// stored there, or computed and stored otherwise. `store_dir` may be NULL, in
+// which case only the extended attribute is used. Returns -1 and sets errno on
+// failure.
+template <class Digest>
+static int GetOrComputeDigest(const char *file, const char *name,
+                              const char *store_dir, jbyte *result) {
+  int fd;
+  while ((fd = open(file, O_RDONLY)) == -1 && errno == EINTR) { }
+  if (fd == -1) {
+    return -1;
+  }
+  portable_stat_struct before;
+  if (portable_fstat(fd, &before) == -1) {
+    int fstat_errno = errno;
+    close(fd);
+    errno = fstat_errno;
+    return -1;
+  }
+
+  CachedDigestKey key = GetCachedDigestKey(before);
+  jbyte value[sizeof(key) + Digest::kDigestLength];
+  jbyte *digest = value + sizeof(key);
+  // The attribute is read from the open file, so that it belongs to the file
+  // the key is computed for even if `file` is replaced meanwhile.
+  if (portable_fgetxattr(fd, name, value, sizeof(value)) == sizeof(value) &&
+      memcmp(value, &key, sizeof(key)) == 0) {
+    memcpy(result, digest, Digest::kDigestLength);
+    close(fd);
+    return 0;
+  }
+  StoredDigestKey stored_key = GetStoredDigestKey(before);
+  std::string stored_path;
+  if (store_dir != NULL && before.st_size >= kMinStoredDigestSize) {
+    stored_path = GetStoredDigestPath(store_dir, file, name);
+    if (ReadStoredDigest(stored_path, stored_key, result,
+                         Digest::kDigestLength)) {
+      close(fd);
+      return 0;
+    }
+  }
+
+  DigestBuffer buf;
+  if (DigestFd<Digest>(fd, buf, digest) == -1) {
+    int read_errno = errno;
+    close(fd);
+    errno = read_errno;
+    return -1;
+  }
+  memcpy(result, digest, Digest::kDigestLength);
+
+  // Only cache the digest if the file didn't change while it was computed.
+  portable_stat_struct after;
+  if (portable_fstat(fd, &after) == 0) {
+    StoredDigestKey after_key = GetStoredDigestKey(after);
+    if (memcmp(&stored_key, &after_key, sizeof(stored_key)) == 0 &&
+        time(NULL) - StatSeconds(after, STAT_MTIME) >=
+            kMinCachedDigestAgeSecs) {
+      memcpy(value, &key, sizeof(key));
+      if (!StoreCachedDigest(fd, after, name, value, sizeof(value)) &&
+          !stored_path.empty()) {
+        WriteStoredDigest(store_dir, stored_path, stored_key, digest,
+                          Digest::kDigestLength);
+      }
+    }
+  }
+  if (close(fd) < 0 && errno != EINTR) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    getOrComputeDigestNative
+ * Signature: (Ljava/lang/String;CLjava/lang/String;Ljava/lang/String;)[B
+ * Throws:    java.io.IOException
+ */
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_getOrComputeDigestNative(
+    JNIEnv *env, jclass clazz, jstring path, jchar function, jstring name,
+    jstring store_dir) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  const char *name_chars =
+      path_chars == NULL ? NULL : GetStringLatin1Chars(env, name);
+  const char *store_dir_chars = NULL;
+  if (name_chars != NULL && store_dir != NULL) {
+    store_dir_chars = GetStringLatin1Chars(env, store_dir);
+    if (store_dir_chars == NULL) {
+      ReleaseStringLatin1Chars(name_chars);
+      name_chars = NULL;
+    }
+  }
+  if (name_chars == NULL) {
+    ReleaseStringLatin1Chars(path_chars);
+    return NULL;  // pending exception
+  }
+
+  jbyte value[kMaxDigestLength];
+  jsize length = DigestLength(function);
+  int r;
+  switch (function) {
+    case DIGEST_SHA1:
+      r = GetOrComputeDigest<Sha1Digest>(path_chars, name_chars,
+                                         store_dir_chars, value);
+      break;
+    case DIGEST_SHA256:
+      r = GetOrComputeDigest<Sha256Digest>(path_chars, name_chars,
+                                           store_dir_chars, value);
+      break;
+    default:
+      r = GetOrComputeDigest<Md5Digest>(path_chars, name_chars,
+                                        store_dir_chars, value);
+      break;
+  }
+  jbyteArray result = NULL;
+  if (r == 0) {
+    result = env->NewByteArray(length);
+    env->SetByteArrayRegion(result, 0, length, value);
+  } else {
+    ::PostFileException(env, errno, path_chars);
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  ReleaseStringLatin1Chars(name_chars);
+  ReleaseStringLatin1Chars(store_dir_chars);
+  return result;
+}
+
+/*
+ * Class:     com.google.devtools.build.lib.unix.NativePosixFiles
+ * Method:    digestBatchNative
+ * Signature: ([Ljava/lang/String;CI[B[I)V
+ */
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_NativePosixFiles_digestBatchNative(
+    JNIEnv *env, jclass clazz, jobjectArray paths, jchar function,
+    jint parallelism, jbyteArray digests, jintArray errnos) {
+  // The paths are copied first: the JNIEnv can't be used by the workers.
+  jsize count = env->GetArrayLength(paths);
+  std::vector<std::string> files;
+  files.reserve(count);
+  for (jsize i = 0; i < count; i++) {
+    jstring path = static_cast<jstring>(env->GetObjectArrayElement(paths, i));
+    const char *path_chars = GetStringLatin1Chars(env, path);
+    if (path_chars == NULL) {
+      return;  // pending exception
+    }
+    files.push_back(path_chars);
+    ::ReleaseStringLatin1Chars(path_chars);
+    env->DeleteLocalRef(path);
+  }
+
+  size_t digest_length = DigestLength(function);
+  std::vector<jbyte> digest_values(files.size() * digest_length);
+  std::vector<jint> errno_values(files.size());
+  std::atomic<size_t> next_file(0);
+  auto worker = [&]() {
+    DigestBuffer buf;
+    for (size_t i = next_file++; i < files.size(); i = next_file++) {
+      jbyte *result = &digest_values[i * digest_length];
+      int r = DigestFileWith(function, files[i].c_str(), buf, result);
+      errno_values[i] = r == 0 ? 0 : errno;
+    }
+  };
+
+  // The calling thread is one of the workers.
+  size_t threads = std::min(static_cast<size_t>(std::max(parallelism, 1)),
+                            std::max(files.size(), static_cast<size_t>(1)));
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; i++) {
+    try {
+      pool.emplace_back(worker);
+    } catch (const std::system_error &) {
+      break;  // out of threads: the others will do the work.
+    }
+  }
+  worker();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+
+  env->SetByteArrayRegion(digests, 0, digest_values.size(),
+                          digest_values.data());
+  env->SetIntArrayRegion(errnos, 0, errno_values.size(), errno_values.data());
+}
+
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_google_devtools_build_lib_unix_NativePosixSystem_sysctlbynameGetLong(
     JNIEnv *env, jclass clazz, jstring name) {
@@ -870,3 +1529,183 @@ Java_com_google_devtools_build_lib_unix_NativePosixSystem_sysctlbynameGetLong(
   ReleaseStringLatin1Chars(name_chars);
   return (jlong)r;
 }
+
+////////////////////////////////////////////////////////////////////////
+// AF_UNIX stream sockets, see LocalSocket.java.
+
+// Creates an AF_UNIX stream socket at `path` and either connects it or binds
+// it and listens on it. Returns its file descriptor, or -1 after posting an
+// exception.
+static int OpenLocalSocket(JNIEnv *env, jstring path, bool listening,
+                           int backlog) {
+  const char *path_chars = GetStringLatin1Chars(env, path);
+  if (path_chars == NULL) {
+    return -1;
+  }
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path_chars) >= sizeof(addr.sun_path)) {
+    ::PostFileException(env, ENAMETOOLONG, path_chars);
+    ReleaseStringLatin1Chars(path_chars);
+    return -1;
+  }
+  strncpy(addr.sun_path, path_chars, sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    ::PostSystemException(env, errno, "socket", path_chars);
+    ReleaseStringLatin1Chars(path_chars);
+    return -1;
+  }
+  // Don't leak the socket into the processes the server starts.
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  int r;
+  if (listening) {
+    r = bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    if (r == 0) {
+      r = listen(fd, backlog);
+    }
+  } else {
+    while ((r = connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                        sizeof(addr))) == -1 &&
+           errno == EINTR) {
+    }
+  }
+  if (r == -1) {
+    int error = errno;
+    close(fd);
+    fd = -1;
+    ::PostFileException(env, error, path_chars);
+  }
+  ReleaseStringLatin1Chars(path_chars);
+  return fd;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_listen0(JNIEnv *env,
+                                                            jclass clazz,
+                                                            jstring path,
+                                                            jint backlog) {
+  return OpenLocalSocket(env, path, true, backlog);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_connect0(JNIEnv *env,
+                                                             jclass clazz,
+                                                             jstring path) {
+  return OpenLocalSocket(env, path, false, 0);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_accept0(JNIEnv *env,
+                                                            jclass clazz,
+                                                            jint fd) {
+  int client_fd;
+  while ((client_fd = accept(fd, NULL, NULL)) == -1 && errno == EINTR) {
+  }
+  if (client_fd == -1) {
+    int error = errno;
+    ::PostException(env, error, "accept: " + ErrorMessage(error));
+    return -1;
+  }
+  fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+  return client_fd;
+}
+
+// Returns the address of `length` bytes at `position` in the direct `buffer`,
+// or NULL after posting an exception. The bytes are read and written in place,
+// so unlike with a Java array nothing is copied, and nothing is pinned while
+// the socket blocks.
+static jbyte *GetLocalSocketBuffer(JNIEnv *env, jobject buffer, jint position,
+                                   jint length) {
+  jbyte *address =
+      static_cast<jbyte *>(env->GetDirectBufferAddress(buffer));
+  if (address == NULL) {
+    ::PostException(env, EINVAL, "not a direct buffer");
+    return NULL;
+  }
+  if (position < 0 || length < 0 ||
+      position > env->GetDirectBufferCapacity(buffer) - length) {
+    ::PostException(env, EINVAL, "buffer bounds");
+    return NULL;
+  }
+  return address + position;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_read0(JNIEnv *env,
+                                                          jclass clazz,
+                                                          jint fd,
+                                                          jobject buffer,
+                                                          jint position,
+                                                          jint length) {
+  jbyte *data = GetLocalSocketBuffer(env, buffer, position, length);
+  if (data == NULL) {
+    return -1;
+  }
+  ssize_t r;
+  while ((r = read(fd, data, length)) == -1 && errno == EINTR) {
+  }
+  if (r == -1) {
+    int error = errno;
+    ::PostException(env, error, "read: " + ErrorMessage(error));
+    return -1;
+  }
+  if (r == 0 && length > 0) {
+    return -1;  // end of stream
+  }
+  return r;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_write0(JNIEnv *env,
+                                                           jclass clazz,
+                                                           jint fd,
+                                                           jobject buffer,
+                                                           jint position,
+                                                           jint length) {
+  jbyte *data = GetLocalSocketBuffer(env, buffer, position, length);
+  if (data == NULL) {
+    return;
+  }
+#ifdef MSG_NOSIGNAL
+  // Report a closed peer as EPIPE instead of raising SIGPIPE.
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+#endif
+  size_t written = 0;
+  while (written < static_cast<size_t>(length)) {
+    ssize_t r = send(fd, data + written, length - written, flags);
+    if (r == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      int error = errno;
+      ::PostException(env, error, "write: " + ErrorMessage(error));
+      return;
+    }
+    written += r;
+  }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_shutdown0(JNIEnv *env,
+                                                              jclass clazz,
+                                                              jint fd) {
+  // A socket whose peer is gone is not connected anymore, which is fine.
+  if (shutdown(fd, SHUT_RDWR) == -1 && errno != ENOTCONN) {
+    int error = errno;
+    ::PostException(env, error, "shutdown: " + ErrorMessage(error));
+  }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_devtools_build_lib_unix_LocalSocket_close0(JNIEnv *env,
+                                                           jclass clazz,
+                                                           jint fd) {
+  if (close(fd) == -1) {
+    int error = errno;
+    ::PostException(env, error, "close: " + ErrorMessage(error));
+  }
+}
@@ -36,10 +36,12 @@
 typedef struct stat portable_stat_struct;
 #define portable_stat ::stat
 #define portable_lstat ::lstat
+#define portable_fstat ::fstat
 #else
 typedef struct stat64 portable_stat_struct;
 #define portable_stat ::stat64
 #define portable_lstat ::lstat64
+#define portable_fstat ::fstat64
 #endif
 
 #if defined(__FreeBSD__)
@@ -70,6 +72,26 @@ extern std::string ErrorMessage(int error_number);
 int portable_fstatat(int dirfd, char *name, portable_stat_struct *statbuf,
                      int flags);
 
+// The layout of the metadata of a file in the array filled by
+// NativePosixFiles.statBatch(), in jlongs. Keep in sync with the PACKED_STAT_*
+// constants of NativePosixFiles.java.
+enum PackedStat {
+  PACKED_STAT_ERRNO,     // 0 if the metadata is valid
+  PACKED_STAT_MODE,
+  PACKED_STAT_SIZE,
+  PACKED_STAT_MTIME_NS,  // since the epoch
+  PACKED_STAT_CTIME_NS,  // since the epoch
+  PACKED_STAT_DEV,
+  PACKED_STAT_INO,
+  PACKED_STAT_LONGS,
+};
+
+// Runs statx(2) for only the fields of PackedStat, if available, and stores
+// them in `result` (except PACKED_STAT_ERRNO). `name` is relative to `dirfd`,
+// which may be AT_FDCWD. If statx isn't available, sets errno to ENOSYS.
+int portable_statx_packed(int dirfd, const char *name, bool follow_symlinks,
+                          jlong *result);
+
 // Encoding for different timestamps in a struct stat{}.
 enum StatTimes {
   STAT_ATIME,  // access
@@ -83,6 +105,10 @@ int StatSeconds(const portable_stat_struct &statbuf, StatTimes t);
 // Returns nanoseconds from a stat buffer.
 int StatNanoSeconds(const portable_stat_struct &statbuf, StatTimes t);
 
+// Tells the kernel that `fd` will be read sequentially, so that it reads ahead
+// aggressively, if supported (e.g. with posix_fadvise(2)). Errors are ignored.
+void portable_advise_sequential_read(int fd);
+
 // Runs getxattr(2), if available. If not, sets errno to ENOSYS.
 ssize_t portable_getxattr(const char *path, const char *name, void *value,
                           size_t size);
@@ -91,6 +117,21 @@ ssize_t portable_getxattr(const char *path, const char *name, void *value,
 ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
                            size_t size);
 
+// Runs setxattr(2), if available. If not, sets errno to ENOSYS.
+int portable_setxattr(const char *path, const char *name, const void *value,
+                      size_t size);
+
+// Runs fgetxattr(2), if available. If not, sets errno to ENOSYS.
+ssize_t portable_fgetxattr(int fd, const char *name, void *value, size_t size);
+
+// Runs fsetxattr(2), if available. If not, sets errno to ENOSYS.
+int portable_fsetxattr(int fd, const char *name, const void *value,
+                       size_t size);
+
+// Runs lsetxattr(2), if available. If not, sets errno to ENOSYS.
+int portable_lsetxattr(const char *path, const char *name, const void *value,
+                       size_t size);
+
 // Run sysctlbyname(3), only available on darwin
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep);
 
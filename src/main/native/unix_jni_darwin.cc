@@ -77,6 +77,13 @@ int portable_fstatat(
   return r;
 }
 
+int portable_statx_packed(int dirfd, const char *name, bool follow_symlinks,
+                          jlong *result) {
+  // No statx under darwin.
+  errno = ENOSYS;
+  return -1;
+}
+
 int StatSeconds(const portable_stat_struct &statbuf, StatTimes t) {
   switch (t) {
     case STAT_ATIME:
@@ -103,6 +110,11 @@ int StatNanoSeconds(const portable_stat_struct &statbuf, StatTimes t) {
   }
 }
 
+void portable_advise_sequential_read(int fd) {
+  // No posix_fadvise under darwin, but read-ahead can be turned on.
+  fcntl(fd, F_RDAHEAD, 1);
+}
+
 ssize_t portable_getxattr(const char *path, const char *name, void *value,
                           size_t size) {
   return getxattr(path, name, value, size, 0, 0);
@@ -113,6 +125,25 @@ ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
   return getxattr(path, name, value, size, 0, XATTR_NOFOLLOW);
 }
 
+int portable_setxattr(const char *path, const char *name, const void *value,
+                      size_t size) {
+  return setxattr(path, name, value, size, 0, 0);
+}
+
+int portable_lsetxattr(const char *path, const char *name, const void *value,
+                       size_t size) {
+  return setxattr(path, name, value, size, 0, XATTR_NOFOLLOW);
+}
+
+ssize_t portable_fgetxattr(int fd, const char *name, void *value, size_t size) {
+  return fgetxattr(fd, name, value, size, 0, 0);
+}
+
+int portable_fsetxattr(int fd, const char *name, const void *value,
+                       size_t size) {
+  return fsetxattr(fd, name, value, size, 0, 0);
+}
+
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep) {
   return sysctlbyname(name_chars, mibp, sizep, NULL, 0);
 }
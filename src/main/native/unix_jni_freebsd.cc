@@ -44,6 +44,13 @@ int portable_fstatat(int dirfd, char *name, portable_stat_struct *statbuf,
   return fstatat(dirfd, name, statbuf, flags);
 }
 
+int portable_statx_packed(int dirfd, const char *name, bool follow_symlinks,
+                          jlong *result) {
+  // No statx under FreeBSD.
+  errno = ENOSYS;
+  return -1;
+}
+
 int StatSeconds(const portable_stat_struct &statbuf, StatTimes t) {
   switch (t) {
     case STAT_ATIME:
@@ -70,6 +77,10 @@ int StatNanoSeconds(const portable_stat_struct &statbuf, StatTimes t) {
   }
 }
 
+void portable_advise_sequential_read(int fd) {
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
 ssize_t portable_getxattr(const char *path, const char *name, void *value,
                           size_t size) {
   return extattr_get_file(path, EXTATTR_NAMESPACE_SYSTEM, name, value, size);
@@ -80,6 +91,34 @@ ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
   return extattr_get_link(path, EXTATTR_NAMESPACE_SYSTEM, name, value, size);
 }
 
+int portable_setxattr(const char *path, const char *name, const void *value,
+                      size_t size) {
+  // The same namespace as portable_getxattr. extattr_set_file returns the
+  // number of bytes written.
+  ssize_t r =
+      extattr_set_file(path, EXTATTR_NAMESPACE_SYSTEM, name, value, size);
+  return r == -1 ? -1 : 0;
+}
+
+int portable_lsetxattr(const char *path, const char *name, const void *value,
+                       size_t size) {
+  // extattr_set_link returns the number of bytes written.
+  ssize_t r =
+      extattr_set_link(path, EXTATTR_NAMESPACE_SYSTEM, name, value, size);
+  return r == -1 ? -1 : 0;
+}
+
+ssize_t portable_fgetxattr(int fd, const char *name, void *value, size_t size) {
+  return extattr_get_fd(fd, EXTATTR_NAMESPACE_SYSTEM, name, value, size);
+}
+
+int portable_fsetxattr(int fd, const char *name, const void *value,
+                       size_t size) {
+  // extattr_set_fd returns the number of bytes written.
+  ssize_t r = extattr_set_fd(fd, EXTATTR_NAMESPACE_SYSTEM, name, value, size);
+  return r == -1 ? -1 : 0;
+}
+
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep) {
   return sysctlbyname(name_chars, mibp, sizep, NULL, 0);
 }
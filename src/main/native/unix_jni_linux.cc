@@ -15,9 +15,11 @@
 #include "src/main/native/unix_jni.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/xattr.h>
 
 #include <string>
@@ -45,6 +47,33 @@ int portable_fstatat(
   return fstatat64(dirfd, name, statbuf, flags);
 }
 
+int portable_statx_packed(int dirfd, const char *name, bool follow_symlinks,
+                          jlong *result) {
+#ifdef STATX_BASIC_STATS
+  struct statx statxbuf;
+  if (statx(dirfd, name, follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW,
+            STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME | STATX_CTIME |
+                STATX_INO,
+            &statxbuf) == -1) {
+    return -1;
+  }
+  result[PACKED_STAT_MODE] = statxbuf.stx_mode;
+  result[PACKED_STAT_SIZE] = statxbuf.stx_size;
+  result[PACKED_STAT_MTIME_NS] =
+      statxbuf.stx_mtime.tv_sec * 1000000000LL + statxbuf.stx_mtime.tv_nsec;
+  result[PACKED_STAT_CTIME_NS] =
+      statxbuf.stx_ctime.tv_sec * 1000000000LL + statxbuf.stx_ctime.tv_nsec;
+  result[PACKED_STAT_DEV] =
+      makedev(statxbuf.stx_dev_major, statxbuf.stx_dev_minor);
+  result[PACKED_STAT_INO] = statxbuf.stx_ino;
+  return 0;
+#else
+  // The C library is older than statx.
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
 int StatSeconds(const portable_stat_struct &statbuf, StatTimes t) {
   switch (t) {
     case STAT_ATIME:
@@ -73,6 +102,10 @@ int StatNanoSeconds(const portable_stat_struct &statbuf, StatTimes t) {
   return 0;
 }
 
+void portable_advise_sequential_read(int fd) {
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
 ssize_t portable_getxattr(const char *path, const char *name, void *value,
                           size_t size) {
   return ::getxattr(path, name, value, size);
@@ -83,6 +116,25 @@ ssize_t portable_lgetxattr(const char *path, const char *name, void *value,
   return ::lgetxattr(path, name, value, size);
 }
 
+int portable_setxattr(const char *path, const char *name, const void *value,
+                      size_t size) {
+  return ::setxattr(path, name, value, size, 0);
+}
+
+int portable_lsetxattr(const char *path, const char *name, const void *value,
+                       size_t size) {
+  return ::lsetxattr(path, name, value, size, 0);
+}
+
+ssize_t portable_fgetxattr(int fd, const char *name, void *value, size_t size) {
+  return ::fgetxattr(fd, name, value, size);
+}
+
+int portable_fsetxattr(int fd, const char *name, const void *value,
+                       size_t size) {
+  return ::fsetxattr(fd, name, value, size, 0);
+}
+
 int portable_sysctlbyname(const char *name_chars, long *mibp, size_t *sizep) {
   errno = ENOSYS;
   return -1;
@@ -14,10 +14,15 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
 #include <stddef.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <memory>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "src/main/cpp/blaze_util.h"
@@ -226,4 +231,153 @@ TEST_F(BlazeUtilTest, TestSearchUnaryCommandOptionWithoutEquals) {
                    {"bazel", "build", ":target", "--flag=value"}, "--flag"));
 }
 
+TEST_F(BlazeUtilTest, WriteToStdOutErr) {
+  // Redirect the standard output to a pipe, with more data than the pipe can
+  // buffer so that writes are partial.
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  int saved_stdout = dup(STDOUT_FILENO);
+  ASSERT_NE(-1, saved_stdout);
+  ASSERT_NE(-1, dup2(fds[1], STDOUT_FILENO));
+  close(fds[1]);
+  string output;
+  std::thread reader([&output, &fds]() {
+    char buffer[4096];
+    ssize_t r;
+    while ((r = read(fds[0], buffer, sizeof(buffer))) > 0) {
+      output.append(buffer, r);
+    }
+  });
+
+  std::vector<string> chunks = {string(100000, 'a'), "", string(200000, 'b'),
+                                "c"};
+  bool success = WriteToStdOutErr(chunks, true);
+  dup2(saved_stdout, STDOUT_FILENO);
+  close(saved_stdout);
+  reader.join();
+  close(fds[0]);
+
+  ASSERT_TRUE(success);
+  ASSERT_EQ(chunks[0] + chunks[2] + chunks[3], output);
+}
+
+TEST_F(BlazeUtilTest, ExecuteDetached) {
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  ASSERT_NE(nullptr, tmpdir);
+  string output = blaze_util::JoinPath(tmpdir, "detached.out");
+  string tmp_result = blaze_util::JoinPath(tmpdir, "detached.tmp");
+  string result = blaze_util::JoinPath(tmpdir, "detached.result");
+  string failed = blaze_util::JoinPath(tmpdir, "detached.failed");
+  ASSERT_TRUE(ExecuteDetached("/bin/sh",
+                              {"sh", "-c", "echo foo; echo bar > \"$0\"",
+                               tmp_result},
+                              output, tmp_result, result, failed));
+  string tmp_result2 = tmp_result + "2";
+  ASSERT_TRUE(blaze_util::WriteFile("partial", tmp_result2));
+  ASSERT_TRUE(ExecuteDetached("/bin/sh", {"sh", "-c", "exit 1"}, output + "2",
+                              tmp_result2, result + "2", failed + "2"));
+  // Nothing waits for the detached processes, so poll for their results.
+  for (int i = 0; i < 500 && !(blaze_util::PathExists(result) &&
+                               blaze_util::PathExists(failed + "2"));
+       i++) {
+    usleep(10 * 1000);
+  }
+  string contents;
+  ASSERT_TRUE(blaze_util::ReadFile(result, &contents));
+  ASSERT_EQ("bar\n", contents);
+  ASSERT_TRUE(blaze_util::ReadFile(output, &contents));
+  ASSERT_EQ("foo\n", contents);
+  ASSERT_FALSE(blaze_util::PathExists(tmp_result));
+  ASSERT_FALSE(blaze_util::PathExists(failed));
+
+  ASSERT_TRUE(blaze_util::PathExists(failed + "2"));
+  ASSERT_FALSE(blaze_util::PathExists(tmp_result2));
+  ASSERT_FALSE(blaze_util::PathExists(result + "2"));
+}
+
+TEST_F(BlazeUtilTest, ExecuteDaemonWaitUntilReady) {
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  ASSERT_NE(nullptr, tmpdir);
+  string server_dir = blaze_util::JoinPath(tmpdir, "daemon");
+  ASSERT_TRUE(blaze_util::MakeDirectories(server_dir, 0700));
+
+  // The daemon gets --server_ready_fd=<fd> as its last argument, i.e. $0.
+  BlazeServerStartup* server_startup;
+  ExecuteDaemon("/bin/sh",
+                {"sh", "-c",
+                 "fd=${0#--server_ready_fd=}; sleep 1; echo >&$fd; sleep 1"},
+                blaze_util::JoinPath(server_dir, "daemon.out"), server_dir,
+                &server_startup);
+  std::unique_ptr<BlazeServerStartup> cleanup(server_startup);
+
+  ASSERT_FALSE(server_startup->WaitUntilReady(10));
+  ASSERT_TRUE(server_startup->IsStillAlive());
+  ASSERT_TRUE(server_startup->WaitUntilReady(5000));
+  ASSERT_TRUE(server_startup->IsStillAlive());
+  for (int i = 0; i < 500 && server_startup->IsStillAlive(); i++) {
+    usleep(10 * 1000);
+  }
+  ASSERT_FALSE(server_startup->IsStillAlive());
+}
+
+TEST_F(BlazeUtilTest, ExecuteDaemonWritesPidFile) {
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  ASSERT_NE(nullptr, tmpdir);
+  string server_dir = blaze_util::JoinPath(tmpdir, "daemon_pid");
+  ASSERT_TRUE(blaze_util::MakeDirectories(server_dir, 0700));
+  string own_pid_file = blaze_util::JoinPath(server_dir, "own_pid");
+
+  // The client writes the PID file, which must name the daemon itself.
+  BlazeServerStartup* server_startup;
+  ExecuteDaemon("/bin/sh",
+                {"sh", "-c", "echo $$ > " + own_pid_file + ".tmp; mv " +
+                                 own_pid_file + ".tmp " + own_pid_file},
+                blaze_util::JoinPath(server_dir, "daemon.out"), server_dir,
+                &server_startup);
+  std::unique_ptr<BlazeServerStartup> cleanup(server_startup);
+  string pid;
+  ASSERT_TRUE(blaze_util::ReadFile(
+      blaze_util::JoinPath(server_dir, kServerPidFile), &pid));
+
+  for (int i = 0; i < 500 && !blaze_util::PathExists(own_pid_file); i++) {
+    usleep(10 * 1000);
+  }
+  string own_pid;
+  ASSERT_TRUE(blaze_util::ReadFile(own_pid_file, &own_pid));
+  ASSERT_EQ(own_pid, pid + "\n");
+}
+
+TEST_F(BlazeUtilTest, GetProcessCpuTimeMillis) {
+  int64_t cpu_time_ms = GetProcessCpuTimeMillis(getpid());
+  ASSERT_GE(cpu_time_ms, 0);
+  // Use some CPU time, more than the clock tick of the kernel.
+  uint64_t start_ms = GetMillisecondsMonotonic();
+  volatile uint64_t counter = 0;
+  while (GetMillisecondsMonotonic() - start_ms < 200) {
+    counter++;
+  }
+  ASSERT_GT(GetProcessCpuTimeMillis(getpid()), cpu_time_ms);
+
+  ASSERT_EQ(-1, GetProcessCpuTimeMillis(0x7fffffff));
+}
+
+#ifdef __linux__
+TEST_F(BlazeUtilTest, SetServerPlacement) {
+  cpu_set_t original;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(original), &original));
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &original)) {
+    cpu++;
+  }
+
+  SetServerPlacement(ToString(cpu), -1, "");
+  cpu_set_t placed;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(placed), &placed));
+  ASSERT_EQ(1, CPU_COUNT(&placed));
+  ASSERT_TRUE(CPU_ISSET(cpu, &placed));
+
+  ASSERT_EQ(0, sched_setaffinity(0, sizeof(original), &original));
+}
+#endif  // __linux__
+
 }  // namespace blaze
@@ -0,0 +1,154 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/main/cpp/option_processor.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/main/cpp/blaze_util_platform.h"
+#include "src/main/cpp/startup_options.h"
+#include "src/main/cpp/util/file.h"
+#include "src/main/cpp/util/file_platform.h"
+#include "src/main/cpp/workspace_layout.h"
+#include "gtest/gtest.h"
+
+namespace blaze {
+
+using std::string;
+using std::vector;
+
+class OptionProcessorTest : public ::testing::Test {
+ protected:
+  OptionProcessorTest() : workspace_layout_(new WorkspaceLayout()) {}
+
+  void SetUp() override {
+    const char* tmpdir = getenv("TEST_TMPDIR");
+    ASSERT_NE(nullptr, tmpdir);
+    test_dir_ = blaze_util::JoinPath(tmpdir, "option_processor_test");
+    workspace_ = blaze_util::JoinPath(test_dir_, "workspace");
+    output_user_root_ = blaze_util::JoinPath(test_dir_, "root");
+    rc_cache_dir_ = blaze_util::JoinPath(output_user_root_, "rc_cache");
+    rc_ = blaze_util::JoinPath(test_dir_, "bazelrc");
+    imported_rc_ = blaze_util::JoinPath(test_dir_, "imported.bazelrc");
+    ASSERT_TRUE(blaze_util::MakeDirectories(workspace_, 0755));
+    ASSERT_TRUE(blaze_util::MakeDirectories(output_user_root_, 0755));
+    ASSERT_TRUE(blaze_util::WriteFile("import " + imported_rc_ + "\n", rc_));
+    ASSERT_TRUE(
+        blaze_util::WriteFile("startup --max_idle_secs=11\n", imported_rc_));
+  }
+
+  void TearDown() override {
+    // The cache files are named after the paths of the rc files, so they must
+    // not outlive the test.
+    vector<string> files;
+    blaze_util::GetAllFilesUnder(rc_cache_dir_, &files);
+    for (const string& file : files) {
+      blaze_util::UnlinkPath(file);
+    }
+  }
+
+  // Parses the options of a client invocation like the client does,
+  // including writing the rc cache, and returns its --max_idle_secs.
+  int ParseMaxIdleSecs() {
+    OptionProcessor option_processor(
+        workspace_layout_.get(),
+        std::unique_ptr<StartupOptions>(
+            new StartupOptions(workspace_layout_.get())));
+    string error;
+    EXPECT_EQ(blaze_exit_code::SUCCESS,
+              option_processor.ParseOptions(
+                  {"bazel", "--nomaster_bazelrc", "--bazelrc=" + rc_,
+                   "--output_user_root=" + output_user_root_, "build"},
+                  workspace_, workspace_, &error))
+        << error;
+    option_processor.WriteRcCache();
+    return option_processor.GetParsedStartupOptions()->max_idle_secs;
+  }
+
+  // Returns the rc cache files.
+  vector<string> GetRcCacheFiles() {
+    vector<string> files;
+    blaze_util::GetAllFilesUnder(rc_cache_dir_, &files);
+    return files;
+  }
+
+  std::unique_ptr<WorkspaceLayout> workspace_layout_;
+  string test_dir_;
+  string workspace_;
+  string output_user_root_;
+  string rc_cache_dir_;
+  string rc_;
+  string imported_rc_;
+};
+
+TEST_F(OptionProcessorTest, RcCacheIsUsedWhileRcFilesAreUnchanged) {
+  ASSERT_EQ(11, ParseMaxIdleSecs());
+  ASSERT_EQ(1, GetRcCacheFiles().size());
+
+  // Change the imported file without changing its stamp: the inode, size and
+  // modification time stay the same, so the cached options are used.
+  struct stat buf;
+  ASSERT_EQ(0, stat(imported_rc_.c_str(), &buf));
+  ASSERT_TRUE(
+      blaze_util::WriteFile("startup --max_idle_secs=22\n", imported_rc_));
+  struct timespec times[2] = {buf.st_atim, buf.st_mtim};
+  ASSERT_EQ(0, utimensat(AT_FDCWD, imported_rc_.c_str(), times, 0));
+  ASSERT_EQ(11, ParseMaxIdleSecs());
+}
+
+TEST_F(OptionProcessorTest, RcCacheIsInvalidatedByEditingAnImportedRc) {
+  ASSERT_EQ(11, ParseMaxIdleSecs());
+  ASSERT_TRUE(
+      blaze_util::WriteFile("startup --max_idle_secs=333\n", imported_rc_));
+  ASSERT_EQ(333, ParseMaxIdleSecs());
+  // The cache was updated.
+  ASSERT_EQ(1, GetRcCacheFiles().size());
+  ASSERT_EQ(333, ParseMaxIdleSecs());
+}
+
+TEST_F(OptionProcessorTest, CorruptRcCacheIsIgnoredAndRewritten) {
+  ASSERT_EQ(11, ParseMaxIdleSecs());
+  vector<string> cache_files = GetRcCacheFiles();
+  ASSERT_EQ(1, cache_files.size());
+  string contents;
+  ASSERT_TRUE(blaze_util::ReadFile(cache_files[0], &contents));
+
+  // Every truncation of the cache is ignored.
+  for (size_t size = 0; size < contents.size(); size++) {
+    ASSERT_TRUE(blaze_util::WriteFile(contents.substr(0, size),
+                                      cache_files[0]));
+    ASSERT_EQ(11, ParseMaxIdleSecs()) << "truncated to " << size;
+  }
+
+  ASSERT_TRUE(blaze_util::WriteFile("1\0garbage\0", 10, cache_files[0]));
+  ASSERT_EQ(11, ParseMaxIdleSecs());
+  string rewritten;
+  ASSERT_TRUE(blaze_util::ReadFile(cache_files[0], &rewritten));
+  ASSERT_EQ(contents, rewritten);
+}
+
+TEST_F(OptionProcessorTest, RcCacheIsNotWrittenWithoutOutputUserRoot) {
+  output_user_root_ = blaze_util::JoinPath(test_dir_, "missing_root");
+  rc_cache_dir_ = blaze_util::JoinPath(output_user_root_, "rc_cache");
+  ASSERT_EQ(11, ParseMaxIdleSecs());
+  ASSERT_FALSE(blaze_util::PathExists(output_user_root_));
+}
+
+}  // namespace blaze
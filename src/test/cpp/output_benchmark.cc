@@ -0,0 +1,123 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// output_benchmark.cc -- client output streaming throughput benchmark.
+//
+// Measures how fast the client can forward the standard output of a command
+// to a pipe, as it does for e.g. "query --output=proto | consumer", with the
+// former per-response fwrite() path and with blaze::WriteToStdOutErr(), for
+// the server's default and negotiated chunk sizes and for batches of small
+// chunks (as written by OutputStreamer when the server sends many small
+// responses).
+//
+// Usage: output_benchmark [--megabytes N]
+//
+// The standard output of the benchmark is replaced by a pipe drained by a
+// separate thread; results are printed to the standard error.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "src/main/cpp/blaze_util_platform.h"
+
+namespace {
+
+using std::string;
+using std::vector;
+
+// Reads and discards everything written to `fd` until it is closed.
+void Drain(int fd) {
+  vector<char> buffer(1024 * 1024);
+  while (read(fd, buffer.data(), buffer.size()) > 0) {
+  }
+}
+
+// Writes `total` bytes to the standard output in chunks of `chunk_size`
+// bytes, `batch` chunks at a time, and returns the throughput in MB/s.
+double Run(size_t total, size_t chunk_size, size_t batch, bool use_fwrite) {
+  vector<string> chunks(batch, string(chunk_size, 'x'));
+  auto start = std::chrono::steady_clock::now();
+  for (size_t written = 0; written < total; written += chunk_size * batch) {
+    if (use_fwrite) {
+      for (const string& chunk : chunks) {
+        if (fwrite(chunk.data(), 1, chunk.size(), stdout) < chunk.size()) {
+          fprintf(stderr, "fwrite failed: %s\n", strerror(errno));
+          exit(1);
+        }
+      }
+    } else if (!blaze::WriteToStdOutErr(chunks, true)) {
+      fprintf(stderr, "WriteToStdOutErr failed: %s\n", strerror(errno));
+      exit(1);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return total / elapsed.count() / (1024 * 1024);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t megabytes = 1024;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc) {
+      megabytes = strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--megabytes N]\n", argv[0]);
+      return 1;
+    }
+  }
+  size_t total = megabytes * 1024 * 1024;
+
+  int fds[2];
+  if (pipe(fds) == -1 || dup2(fds[1], STDOUT_FILENO) == -1) {
+    fprintf(stderr, "Cannot redirect the standard output: %s\n",
+            strerror(errno));
+    return 1;
+  }
+  close(fds[1]);
+  // Like the client, see blaze::SetupStdStreams().
+  setvbuf(stdout, NULL, _IONBF, 0);
+  std::thread drainer(Drain, fds[0]);
+
+  struct {
+    const char* name;
+    size_t chunk_size;
+    size_t batch;
+    bool use_fwrite;
+  } benchmarks[] = {
+      {"fwrite, 8KB chunks", 8192, 1, true},
+      {"WriteToStdOutErr, 8KB chunks", 8192, 1, false},
+      {"WriteToStdOutErr, 1MB chunks", 1024 * 1024, 1, false},
+      {"fwrite, 512B chunks", 512, 1, true},
+      {"WriteToStdOutErr, 64 x 512B chunks", 512, 64, false},
+  };
+  for (const auto& benchmark : benchmarks) {
+    double throughput = Run(total, benchmark.chunk_size, benchmark.batch,
+                            benchmark.use_fwrite);
+    fprintf(stderr, "%-36s %8.1f MB/s\n", benchmark.name, throughput);
+  }
+
+  close(STDOUT_FILENO);
+  drainer.join();
+  return 0;
+}
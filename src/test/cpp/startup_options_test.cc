@@ -110,4 +110,100 @@ TEST_F(StartupOptionsTest, IsUnaryTest) {
   EXPECT_FALSE(startup_options_->IsUnary("--blazercfooblah"));
 }
 
+TEST_F(StartupOptionsTest, InstallBaseVerificationTest) {
+  EXPECT_FALSE(startup_options_->full_install_base_verification);
+  EXPECT_TRUE(startup_options_->IsUnary("--install_base_verification=full"));
+
+  bool is_space_separated;
+  std::string error;
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--install_base_verification=full",
+                                         "", "", &is_space_separated, &error));
+  EXPECT_TRUE(startup_options_->full_install_base_verification);
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--install_base_verification", "fast",
+                                         "", &is_space_separated, &error));
+  EXPECT_TRUE(is_space_separated);
+  EXPECT_FALSE(startup_options_->full_install_base_verification);
+  EXPECT_EQ(blaze_exit_code::BAD_ARGV,
+            startup_options_->ProcessArg("--install_base_verification=slow",
+                                         "", "", &is_space_separated, &error));
+}
+
+TEST_F(StartupOptionsTest, ClientProfileTest) {
+  EXPECT_EQ("", startup_options_->client_profile);
+  EXPECT_TRUE(startup_options_->IsUnary("--client_profile=/tmp/profile"));
+
+  bool is_space_separated;
+  std::string error;
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--client_profile=/tmp/profile", "",
+                                         "", &is_space_separated, &error));
+  EXPECT_FALSE(is_space_separated);
+  EXPECT_EQ("/tmp/profile", startup_options_->client_profile);
+}
+
+TEST_F(StartupOptionsTest, ServerPoolSizeTest) {
+  EXPECT_EQ(0, startup_options_->server_pool_size);
+  EXPECT_TRUE(startup_options_->IsUnary("--server_pool_size=2"));
+
+  bool is_space_separated;
+  std::string error;
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--server_pool_size=2", "", "",
+                                         &is_space_separated, &error));
+  EXPECT_EQ(2, startup_options_->server_pool_size);
+  EXPECT_EQ(blaze_exit_code::BAD_ARGV,
+            startup_options_->ProcessArg("--server_pool_size=-1", "", "",
+                                         &is_space_separated, &error));
+  EXPECT_EQ(blaze_exit_code::BAD_ARGV,
+            startup_options_->ProcessArg("--server_pool_size=17", "", "",
+                                         &is_space_separated, &error));
+}
+
+TEST_F(StartupOptionsTest, InstallBaseMaxAgeDaysTest) {
+  EXPECT_EQ(30, startup_options_->install_base_max_age_days);
+  EXPECT_TRUE(startup_options_->IsUnary("--install_base_max_age_days=0"));
+
+  bool is_space_separated;
+  std::string error;
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--install_base_max_age_days=0", "",
+                                         "", &is_space_separated, &error));
+  EXPECT_EQ(0, startup_options_->install_base_max_age_days);
+  EXPECT_EQ(blaze_exit_code::BAD_ARGV,
+            startup_options_->ProcessArg("--install_base_max_age_days=-1", "",
+                                         "", &is_space_separated, &error));
+}
+
+TEST_F(StartupOptionsTest, ServerPlacementTest) {
+  EXPECT_EQ("", startup_options_->server_cpus);
+  EXPECT_EQ(-1, startup_options_->server_numa_node);
+  EXPECT_EQ("", startup_options_->server_cgroup);
+  EXPECT_TRUE(startup_options_->IsUnary("--server_cpus=0"));
+  EXPECT_TRUE(startup_options_->IsUnary("--server_numa_node=0"));
+  EXPECT_TRUE(startup_options_->IsUnary("--server_cgroup=build.slice"));
+
+  bool is_space_separated;
+  std::string error;
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--server_cpus=0-23,48", "", "",
+                                         &is_space_separated, &error));
+  EXPECT_EQ("0-23,48", startup_options_->server_cpus);
+  EXPECT_EQ(blaze_exit_code::BAD_ARGV,
+            startup_options_->ProcessArg("--server_cpus=all", "", "",
+                                         &is_space_separated, &error));
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--server_numa_node=1", "", "",
+                                         &is_space_separated, &error));
+  EXPECT_EQ(1, startup_options_->server_numa_node);
+  EXPECT_EQ(blaze_exit_code::BAD_ARGV,
+            startup_options_->ProcessArg("--server_numa_node=-2", "", "",
+                                         &is_space_separated, &error));
+  EXPECT_EQ(blaze_exit_code::SUCCESS,
+            startup_options_->ProcessArg("--server_cgroup=build.slice/server1",
+                                         "", "", &is_space_separated, &error));
+  EXPECT_EQ("build.slice/server1", startup_options_->server_cgroup);
+}
+
 }  // namespace blaze
@@ -13,6 +13,8 @@
 // limitations under the License.
 #include <fcntl.h>
 #include <limits.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -402,6 +404,150 @@ TEST(FilePosixTest, ForEachDirectoryEntry) {
   rmdir(root.c_str());
 }
 
+TEST(FilePosixTest, GetPathStamps) {
+  char* tmpdir_cstr = getenv("TEST_TMPDIR");
+  ASSERT_FALSE(tmpdir_cstr == NULL);
+  string root = JoinPath(tmpdir_cstr, "FilePosixTest.GetPathStamps.root");
+  string dir = JoinPath(root, "dir");
+  string file = JoinPath(dir, "file");
+  ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+  ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+  ASSERT_TRUE(WriteFile("hello", file));
+  // Move the mtimes to the past, so that modifications change them even on
+  // file systems with a coarse timestamp granularity.
+  struct timeval past[2] = {{1000, 0}, {1000, 0}};
+  ASSERT_EQ(0, utimes(file.c_str(), past));
+  ASSERT_EQ(0, utimes(dir.c_str(), past));
+
+  vector<string> stamps;
+  ASSERT_TRUE(GetPathStamps(root, {".", "dir", "dir/file"}, &stamps));
+  ASSERT_EQ(3, stamps.size());
+  vector<string> same_stamps;
+  ASSERT_TRUE(GetPathStamps(root, {".", "dir", "dir/file"}, &same_stamps));
+  ASSERT_EQ(stamps, same_stamps);
+
+  // Modifying a file in place, even keeping its size, changes its stamp but
+  // not the stamp of its directory.
+  int fd = open(file.c_str(), O_WRONLY);
+  ASSERT_NE(-1, fd);
+  ASSERT_EQ(5, write(fd, "HELLO", 5));
+  ASSERT_EQ(0, close(fd));
+  vector<string> new_stamps;
+  ASSERT_TRUE(GetPathStamps(root, {"dir", "dir/file"}, &new_stamps));
+  ASSERT_EQ(stamps[1], new_stamps[0]);
+  ASSERT_NE(stamps[2], new_stamps[1]);
+
+  // So does restoring its modification time after changing its size.
+  ASSERT_TRUE(WriteFile("hello world", file));
+  ASSERT_EQ(0, utimes(file.c_str(), past));
+  ASSERT_TRUE(GetPathStamps(root, {"dir/file"}, &new_stamps));
+  ASSERT_NE(stamps[2], new_stamps[0]);
+
+  // Adding an entry to a directory changes the stamp of the directory.
+  ASSERT_TRUE(CreateEmptyFile(JoinPath(dir, "other_file")));
+  ASSERT_TRUE(GetPathStamps(root, {"dir"}, &new_stamps));
+  ASSERT_NE(stamps[1], new_stamps[0]);
+
+  // Missing files can't be stamped.
+  ASSERT_FALSE(GetPathStamps(root, {"missing"}, &new_stamps));
+  ASSERT_FALSE(GetPathStamps(JoinPath(root, "missing"), {"."}, &new_stamps));
+
+  unlink(file.c_str());
+  unlink(JoinPath(dir, "other_file").c_str());
+  rmdir(dir.c_str());
+  rmdir(root.c_str());
+}
+
+// Returns the exact modification time of the status `buf`.
+static struct timespec GetMtime(const struct stat &buf) {
+#if defined(__APPLE__)
+  return buf.st_mtimespec;
+#else
+  return buf.st_mtim;
+#endif
+}
+
+TEST(FilePosixTest, GetFileStamp) {
+  char* tmpdir_cstr = getenv("TEST_TMPDIR");
+  ASSERT_FALSE(tmpdir_cstr == NULL);
+  string file = JoinPath(tmpdir_cstr, "FilePosixTest.GetFileStamp.file");
+  string link = JoinPath(tmpdir_cstr, "FilePosixTest.GetFileStamp.link");
+  ASSERT_TRUE(CreateEmptyFile(file));
+  ASSERT_EQ(0, symlink(file.c_str(), link.c_str()));
+
+  string stamp;
+  ASSERT_TRUE(GetFileStamp(file, &stamp));
+  string same_stamp;
+  ASSERT_TRUE(GetFileStamp(file, &same_stamp));
+  ASSERT_EQ(stamp, same_stamp);
+  // Symlinks are followed.
+  ASSERT_TRUE(GetFileStamp(link, &same_stamp));
+  ASSERT_EQ(stamp, same_stamp);
+
+  // The stamp is the inode number, size and modification time of the file.
+  // Growing the file changes it, even if the exact modification time is
+  // restored.
+  struct stat buf;
+  ASSERT_EQ(0, stat(file.c_str(), &buf));
+  int fd = open(file.c_str(), O_WRONLY);
+  ASSERT_NE(-1, fd);
+  ASSERT_EQ(5, write(fd, "hello", 5));
+  ASSERT_EQ(0, close(fd));
+  struct timespec times[2] = {{0, UTIME_OMIT}, GetMtime(buf)};
+  ASSERT_EQ(0, utimensat(AT_FDCWD, file.c_str(), times, 0));
+  string new_stamp;
+  ASSERT_TRUE(GetFileStamp(file, &new_stamp));
+  ASSERT_NE(stamp, new_stamp);
+
+  // Replacing the file with one of the same size and modification time
+  // changes it too.
+  ASSERT_TRUE(GetFileStamp(file, &stamp));
+  ASSERT_EQ(0, stat(file.c_str(), &buf));
+  string other = JoinPath(tmpdir_cstr, "FilePosixTest.GetFileStamp.other");
+  fd = open(other.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_NE(-1, fd);
+  ASSERT_EQ(5, write(fd, "world", 5));
+  ASSERT_EQ(0, close(fd));
+  struct timespec same_times[2] = {{0, UTIME_OMIT}, GetMtime(buf)};
+  ASSERT_EQ(0, utimensat(AT_FDCWD, other.c_str(), same_times, 0));
+  // Keeps the old file alive, so that its inode number isn't reused.
+  string old = JoinPath(tmpdir_cstr, "FilePosixTest.GetFileStamp.old");
+  ASSERT_EQ(0, ::link(file.c_str(), old.c_str()));
+  ASSERT_EQ(0, rename(other.c_str(), file.c_str()));
+  ASSERT_TRUE(GetFileStamp(file, &new_stamp));
+  ASSERT_NE(stamp, new_stamp);
+  unlink(old.c_str());
+
+  ASSERT_FALSE(GetFileStamp(JoinPath(tmpdir_cstr, "missing"), &new_stamp));
+
+  unlink(link.c_str());
+  unlink(file.c_str());
+}
+
+TEST(FilePosixTest, RemoveRecursively) {
+  char* tmpdir_cstr = getenv("TEST_TMPDIR");
+  ASSERT_FALSE(tmpdir_cstr == NULL);
+  string root = JoinPath(tmpdir_cstr, "FilePosixTest.RemoveRecursively.root");
+  string outside =
+      JoinPath(tmpdir_cstr, "FilePosixTest.RemoveRecursively.outside");
+  ASSERT_TRUE(MakeDirectories(JoinPath(root, "a/b/c"), 0700));
+  ASSERT_TRUE(MakeDirectories(JoinPath(root, "d"), 0700));
+  ASSERT_TRUE(MakeDirectories(outside, 0700));
+  ASSERT_TRUE(CreateEmptyFile(JoinPath(root, "file")));
+  ASSERT_TRUE(CreateEmptyFile(JoinPath(root, "a/b/c/file")));
+  ASSERT_TRUE(CreateEmptyFile(JoinPath(outside, "file")));
+  // Symlinks are removed, not followed.
+  ASSERT_TRUE(Symlink(outside, JoinPath(root, "a/link")));
+
+  ASSERT_TRUE(RemoveRecursively(root, 4));
+  ASSERT_FALSE(PathExists(root));
+  ASSERT_TRUE(PathExists(JoinPath(outside, "file")));
+  ASSERT_FALSE(RemoveRecursively(root, 4));
+
+  unlink(JoinPath(outside, "file").c_str());
+  rmdir(outside.c_str());
+}
+
 TEST(FileTest, IsAbsolute) {
   ASSERT_FALSE(IsAbsolute(""));
   ASSERT_TRUE(IsAbsolute("/"));
@@ -144,4 +144,33 @@ TEST(FileTest, TestMtimeHandling) {
   ASSERT_FALSE(mtime.get()->GetIfInDistantFuture(file, &actual));
 }
 
+TEST(FileTest, TestWriteFileInDistantFuture) {
+  const char* tempdir_cstr = getenv("TEST_TMPDIR");
+  ASSERT_NE(tempdir_cstr, nullptr);
+  ASSERT_NE(tempdir_cstr[0], 0);
+  string tempdir(tempdir_cstr);
+
+  std::unique_ptr<IFileMtime> mtime(CreateFileMtime());
+  string file(JoinPath(tempdir, "future.txt"));
+  ASSERT_TRUE(mtime.get()->WriteFileInDistantFuture("hello", 5, file));
+  bool actual = false;
+  ASSERT_TRUE(mtime.get()->GetIfInDistantFuture(file, &actual));
+  ASSERT_TRUE(actual);
+  string content;
+  ASSERT_TRUE(ReadFile(file, &content));
+  ASSERT_EQ("hello", content);
+
+  // Overwriting the file keeps its mtime in the future.
+  ASSERT_TRUE(mtime.get()->WriteFileInDistantFuture("world", 5, file));
+  ASSERT_TRUE(mtime.get()->GetIfInDistantFuture(file, &actual));
+  ASSERT_TRUE(actual);
+  ASSERT_TRUE(ReadFile(file, &content));
+  ASSERT_EQ("world", content);
+  ASSERT_TRUE(UnlinkPath(file));
+
+  // Writing into a missing directory fails.
+  ASSERT_FALSE(mtime.get()->WriteFileInDistantFuture(
+      "hello", 5, JoinPath(tempdir, "no/such/dir/future.txt")));
+}
+
 }  // namespace blaze_util
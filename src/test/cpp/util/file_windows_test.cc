@@ -411,6 +411,34 @@ TEST(FileTest, TestMakeDirectories) {
   ASSERT_EQ(0, rmdir(JoinPath(tmpdir, "dir4").c_str()));
 }
 
+TEST(FileTest, TestGetFileStamp) {
+  string tmpdir;
+  GET_TEST_TMPDIR(tmpdir);
+  string file(JoinPath(tmpdir, "stamped.txt"));
+  FILE* fh = fopen(file.c_str(), "wt");
+  ASSERT_NE(nullptr, fh);
+  ASSERT_LT(0, fprintf(fh, "hello"));
+  fclose(fh);
+
+  string stamp;
+  ASSERT_TRUE(GetFileStamp(file, &stamp));
+  string same_stamp;
+  ASSERT_TRUE(GetFileStamp(file, &same_stamp));
+  ASSERT_EQ(stamp, same_stamp);
+
+  // Changing the size of the file changes its stamp.
+  fh = fopen(file.c_str(), "at");
+  ASSERT_NE(nullptr, fh);
+  ASSERT_LT(0, fprintf(fh, " world"));
+  fclose(fh);
+  string new_stamp;
+  ASSERT_TRUE(GetFileStamp(file, &new_stamp));
+  ASSERT_NE(stamp, new_stamp);
+
+  ASSERT_FALSE(GetFileStamp(JoinPath(tmpdir, "does.not.exist"), &new_stamp));
+  ASSERT_EQ(0, unlink(file.c_str()));
+}
+
 TEST(FileTest, CanAccess) {
   ASSERT_FALSE(CanReadFile("C:/windows/this/should/not/exist/mkay"));
   ASSERT_FALSE(CanExecuteFile("C:/this/should/not/exist/mkay"));
@@ -0,0 +1,105 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// md5_benchmark.cc -- blaze_util::Md5Digest throughput benchmark.
+//
+// Measures how fast Md5Digest hashes 4KB, 1MB and 1GB inputs, starting at an
+// aligned and at an unaligned address. Inputs larger than 1MB are given to
+// Update() 1MB at a time, like md5sumAsBytes() in unix_jni.cc reads a file in
+// pieces. Small inputs are hashed repeatedly, each time with a new digest.
+//
+// Usage: md5_benchmark [--megabytes N]
+//
+// where N (default: 1024) is the amount of data hashed for each input size.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>  // NOLINT
+#include <vector>
+
+#include "src/main/cpp/util/md5.h"
+
+namespace {
+
+using std::vector;
+
+static const size_t kPieceSize = 1024 * 1024;
+
+// Hashes `total` bytes as inputs of `input_size` bytes read from `data` and
+// returns the throughput in MB/s.
+double Run(const unsigned char* data, size_t input_size, size_t total) {
+  unsigned char result[blaze_util::Md5Digest::kDigestLength];
+  unsigned int checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t hashed = 0; hashed < total; hashed += input_size) {
+    blaze_util::Md5Digest digest;
+    for (size_t done = 0; done < input_size; done += kPieceSize) {
+      size_t piece = input_size - done < kPieceSize ? input_size - done
+                                                     : kPieceSize;
+      digest.Update(data, piece);
+    }
+    digest.Finish(result);
+    checksum += result[0];
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  // Keeps the compiler from optimizing the digests away.
+  if (checksum == 0xffffffff) {
+    fprintf(stderr, "unlikely checksum\n");
+  }
+  return total / elapsed.count() / (1024 * 1024);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t megabytes = 1024;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc) {
+      megabytes = strtoul(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--megabytes N]\n", argv[0]);
+      return 1;
+    }
+  }
+  size_t total = megabytes * 1024 * 1024;
+
+  // One more byte to hash from an unaligned address.
+  vector<unsigned char> buffer(kPieceSize + 1);
+  for (size_t i = 0; i < buffer.size(); i++) {
+    buffer[i] = static_cast<unsigned char>(i * 2654435761U >> 24);
+  }
+
+  struct {
+    const char* name;
+    size_t input_size;
+  } sizes[] = {
+      {"4KB", 4096},
+      {"1MB", 1024 * 1024},
+      {"1GB", 1024 * 1024 * 1024},
+  };
+  for (const auto& size : sizes) {
+    // Hash at least one input of each size.
+    size_t size_total = total < size.input_size ? size.input_size : total;
+    for (int offset = 0; offset <= 1; offset++) {
+      double throughput = Run(buffer.data() + offset, size.input_size,
+                              size_total);
+      fprintf(stderr, "%s inputs, %-11s %8.1f MB/s\n", size.name,
+              offset == 0 ? "aligned:" : "unaligned:", throughput);
+    }
+  }
+  return 0;
+}
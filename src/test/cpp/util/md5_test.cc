@@ -11,6 +11,10 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+
+#include <algorithm>
+#include <string>
+
 #include "src/main/cpp/util/md5.h"
 #include "src/main/cpp/util/port.h"
 #include "gtest/gtest.h"
@@ -49,4 +53,21 @@ TEST(BlazeUtil, Basic) {
   }
 }
 
+TEST(BlazeUtil, UnalignedIncrementalUpdates) {
+  // One million 'a', from an unaligned address, in pieces of various sizes.
+  std::string input(1000001, 'a');
+  const unsigned int pieces[] = {1, 3, 63, 64, 65, 1000, 4096, 4097};
+  for (unsigned int piece : pieces) {
+    Md5Digest digest;
+    for (unsigned int done = 0; done < 1000000; done += piece) {
+      unsigned int length = std::min(piece, 1000000 - done);
+      digest.Update(input.data() + 1 + done, length);
+    }
+    unsigned char buf[16];
+    digest.Finish(buf);
+    ASSERT_EQ("7707d6ae4e027c70eea2a935c2296f21", digest.String())
+        << "pieces of " << piece << " bytes";
+  }
+}
+
 }  // namespace blaze_util
@@ -0,0 +1,74 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "src/main/cpp/util/port.h"
+#include "src/main/cpp/util/sha1.h"
+#include "gtest/gtest.h"
+
+namespace blaze_util {
+
+TEST(Sha1DigestTest, Basic) {
+  // The FIPS 180 examples and a few more.
+  const char *strs[] = {
+    "",
+    "a",
+    "abc",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "The quick brown fox jumps over the lazy dog",
+    "12345678901234567890123456789012345678901234567890123456789012345678901234567890"
+  };
+  const char *sha1s[] = {
+    "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+    "86f7e437faa5a7fce15d1ddcb9eaeaea377667b8",
+    "a9993e364706816aba3e25717850c26c9cd0d89d",
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+    "2fd4e1c67a2d28fced849ee1bb76e7391b93eb12",
+    "50abf5706a150990a08b2c5ea40fa0e585554732",
+  };
+  unsigned int n = arraysize(strs);
+  ASSERT_EQ(n, arraysize(sha1s));
+
+  unsigned char buf[Sha1Digest::kDigestLength];
+  Sha1Digest digest;
+  for (unsigned int i = 0; i < n; i++) {
+    digest.Reset();
+    digest.Update(strs[i], strlen(strs[i]));
+    digest.Finish(buf);
+    ASSERT_EQ(sha1s[i], digest.String());
+  }
+}
+
+TEST(Sha1DigestTest, UnalignedIncrementalUpdates) {
+  // One million 'a', from an unaligned address, in pieces of various sizes.
+  std::string input(1000001, 'a');
+  const unsigned int pieces[] = {1, 3, 63, 64, 65, 1000, 4096, 4097};
+  for (unsigned int piece : pieces) {
+    Sha1Digest digest;
+    for (unsigned int done = 0; done < 1000000; done += piece) {
+      unsigned int length = std::min(piece, 1000000 - done);
+      digest.Update(input.data() + 1 + done, length);
+    }
+    unsigned char buf[Sha1Digest::kDigestLength];
+    digest.Finish(buf);
+    ASSERT_EQ("34aa973cd4c4daa4f61eeb2bdbad27316534016f", digest.String())
+        << "pieces of " << piece << " bytes";
+  }
+}
+
+}  // namespace blaze_util
@@ -0,0 +1,76 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "src/main/cpp/util/port.h"
+#include "src/main/cpp/util/sha256.h"
+#include "gtest/gtest.h"
+
+namespace blaze_util {
+
+TEST(Sha256DigestTest, Basic) {
+  // The FIPS 180 examples and a few more.
+  const char *strs[] = {
+    "",
+    "a",
+    "abc",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    "The quick brown fox jumps over the lazy dog",
+    "12345678901234567890123456789012345678901234567890123456789012345678901234567890"
+  };
+  const char *sha256s[] = {
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+    "ca978112ca1bbdcafac231b39a23dc4da786eff8147c4e72b9807785afee48bb",
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+    "d7a8fbb307d7809469ca9abcb0082e4f8d5651e46d3cdb762d02d0bf37c9e592",
+    "f371bc4a311f2b009eef952dd83ca80e2b60026c8e935592d0f9c308453c813e",
+  };
+  unsigned int n = arraysize(strs);
+  ASSERT_EQ(n, arraysize(sha256s));
+
+  unsigned char buf[Sha256Digest::kDigestLength];
+  Sha256Digest digest;
+  for (unsigned int i = 0; i < n; i++) {
+    digest.Reset();
+    digest.Update(strs[i], strlen(strs[i]));
+    digest.Finish(buf);
+    ASSERT_EQ(sha256s[i], digest.String());
+  }
+}
+
+TEST(Sha256DigestTest, UnalignedIncrementalUpdates) {
+  // One million 'a', from an unaligned address, in pieces of various sizes.
+  std::string input(1000001, 'a');
+  const unsigned int pieces[] = {1, 3, 63, 64, 65, 1000, 4096, 4097};
+  for (unsigned int piece : pieces) {
+    Sha256Digest digest;
+    for (unsigned int done = 0; done < 1000000; done += piece) {
+      unsigned int length = std::min(piece, 1000000 - done);
+      digest.Update(input.data() + 1 + done, length);
+    }
+    unsigned char buf[Sha256Digest::kDigestLength];
+    digest.Finish(buf);
+    ASSERT_EQ(
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+        digest.String())
+        << "pieces of " << piece << " bytes";
+  }
+}
+
+}  // namespace blaze_util
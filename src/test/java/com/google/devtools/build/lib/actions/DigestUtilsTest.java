@@ -35,7 +35,9 @@ import org.junit.runner.RunWith;
 import org.junit.runners.JUnit4;
 
 import java.io.IOException;
+import java.util.ArrayList;
 import java.util.Arrays;
+import java.util.List;
 import java.util.concurrent.CountDownLatch;
 import java.util.concurrent.TimeUnit;
 
@@ -135,6 +137,33 @@ public class DigestUtilsTest {
     }
   }
 
+  @Test
+  public void testBatchHashesOnlyLargeFilesOneAtATime() throws Exception {
+    final List<String> calls = new ArrayList<>();
+    FileSystem myfs = new InMemoryFileSystem(BlazeClock.instance()) {
+        @Override
+        protected byte[][] getDigests(Path[] paths, int parallelism) {
+          calls.add(paths.length + " files on " + parallelism + " threads");
+          return super.getDigests(paths, parallelism);
+        }
+    };
+    FileSystem.setDigestFunctionForTesting(HashFunction.MD5);
+    Path[] paths = new Path[4];
+    long[] sizes = {1024, 4097, 4096, 8192};
+    for (int i = 0; i < paths.length; i++) {
+      paths[i] = myfs.getPath("/f" + i + ".dat");
+      FileSystemUtils.writeContentAsLatin1(paths[i], Strings.repeat("a", (int) sizes[i]));
+    }
+
+    byte[][] digests = DigestUtils.getDigestsOrNull(myfs, paths, sizes);
+    for (int i = 0; i < paths.length; i++) {
+      assertArrayEquals(paths[i].getMD5Digest(), digests[i]);
+    }
+    int processors = Runtime.getRuntime().availableProcessors();
+    assertEquals(
+        Arrays.asList("2 files on " + processors + " threads", "2 files on 1 threads"), calls);
+  }
+
   @Test
   public void testRecoverFromMalformedDigest() throws Exception {
     final byte[] malformed = {0, 0, 0};
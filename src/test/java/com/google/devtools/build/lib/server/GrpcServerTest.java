@@ -16,36 +16,67 @@ package com.google.devtools.build.lib.server;
 import static com.google.common.truth.Truth.assertThat;
 import static junit.framework.TestCase.fail;
 import static org.mockito.Matchers.any;
+import static org.mockito.Matchers.anyLong;
+import static org.mockito.Matchers.eq;
 import static org.mockito.Mockito.inOrder;
 import static org.mockito.Mockito.mock;
 import static org.mockito.Mockito.when;
 
 import com.google.common.base.Strings;
+import com.google.common.collect.ImmutableList;
 import com.google.common.util.concurrent.ThreadFactoryBuilder;
 import com.google.common.util.concurrent.Uninterruptibles;
+import com.google.devtools.build.lib.runtime.BlazeCommandDispatcher.LockingMode;
+import com.google.devtools.build.lib.runtime.CommandExecutor;
+import com.google.devtools.build.lib.server.CommandProtos.ClaimRequest;
+import com.google.devtools.build.lib.server.CommandProtos.ClaimResponse;
+import com.google.devtools.build.lib.server.CommandProtos.RunRequest;
 import com.google.devtools.build.lib.server.CommandProtos.RunResponse;
 import com.google.devtools.build.lib.server.GrpcServerImpl.StreamType;
 import com.google.devtools.build.lib.testutil.Suite;
 import com.google.devtools.build.lib.testutil.TestSpec;
 import com.google.devtools.build.lib.testutil.TestThread;
 import com.google.devtools.build.lib.testutil.TestUtils;
+import com.google.devtools.build.lib.util.BlazeClock;
+import com.google.devtools.build.lib.util.OS;
 import com.google.devtools.build.lib.util.Preconditions;
+import com.google.devtools.build.lib.util.io.OutErr;
+import com.google.devtools.build.lib.vfs.FileSystemUtils;
+import com.google.devtools.build.lib.vfs.Path;
+import com.google.devtools.build.lib.vfs.util.FileSystems;
 import com.google.protobuf.ByteString;
+import io.grpc.ManagedChannel;
+import io.grpc.ManagedChannelBuilder;
 import io.grpc.Status;
 import io.grpc.StatusRuntimeException;
+import io.grpc.netty.NettyChannelBuilder;
 import io.grpc.stub.ServerCallStreamObserver;
+import io.netty.channel.EventLoopGroup;
+import io.netty.channel.epoll.Epoll;
+import io.netty.channel.epoll.EpollDomainSocketChannel;
+import io.netty.channel.epoll.EpollEventLoopGroup;
+import io.netty.channel.unix.DomainSocketAddress;
 import java.nio.charset.StandardCharsets;
+import java.nio.file.Files;
+import java.nio.file.Paths;
+import java.util.Iterator;
+import java.util.List;
+import java.util.concurrent.Callable;
 import java.util.concurrent.CountDownLatch;
 import java.util.concurrent.ExecutorService;
 import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
 import java.util.concurrent.TimeUnit;
 import java.util.concurrent.atomic.AtomicBoolean;
 import org.junit.After;
+import org.junit.Assume;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
 import org.junit.runners.JUnit4;
 import org.mockito.InOrder;
+import org.mockito.invocation.InvocationOnMock;
+import org.mockito.stubbing.Answer;
 
 /**
  * Unit tests for the gRPC server.
@@ -305,7 +336,8 @@ public class GrpcServerTest {
     GrpcServerImpl.GrpcSink mockSink = mock(GrpcServerImpl.GrpcSink.class);
     @SuppressWarnings("resource")
     GrpcServerImpl.RpcOutputStream underTest = new GrpcServerImpl.RpcOutputStream(
-        "command_id", "cookie", StreamType.STDOUT, mockSink);
+        "command_id", "cookie", StreamType.STDOUT, mockSink,
+        GrpcServerImpl.RpcOutputStream.DEFAULT_CHUNK_SIZE);
 
     when(mockSink.offer(any(RunResponse.class))).thenReturn(true);
 
@@ -334,4 +366,186 @@ public class GrpcServerTest {
             .setStandardOutput(ByteString.copyFrom(chunk3.getBytes(StandardCharsets.ISO_8859_1)))
             .build());
   }
+
+  @Test
+  public void testRpcOutputStreamChunkSizeIsNegotiated() throws Exception {
+    assertThat(GrpcServerImpl.RpcOutputStream.getChunkSize(RunRequest.getDefaultInstance()))
+        .isEqualTo(GrpcServerImpl.RpcOutputStream.DEFAULT_CHUNK_SIZE);
+    assertThat(
+            GrpcServerImpl.RpcOutputStream.getChunkSize(
+                RunRequest.newBuilder().setMaxOutputChunkSize(65536).build()))
+        .isEqualTo(65536);
+    assertThat(
+            GrpcServerImpl.RpcOutputStream.getChunkSize(
+                RunRequest.newBuilder().setMaxOutputChunkSize(Integer.MAX_VALUE).build()))
+        .isEqualTo(GrpcServerImpl.RpcOutputStream.MAX_CHUNK_SIZE);
+  }
+
+  @Test
+  public void testServesCommandOverSocket() throws Exception {
+    // The server doesn't need epoll, but this gRPC client does. LocalSocketBridgeTest covers the
+    // socket where epoll is unavailable.
+    Assume.assumeTrue(OS.getCurrent() == OS.LINUX && Epoll.isAvailable());
+    final Path serverDirectory =
+        FileSystems.getNativeFileSystem().getPath(TestUtils.tmpDir()).getRelative("server");
+    Path socketFile = serverDirectory.getChild(GrpcServerImpl.SOCKET_FILE);
+    Assume.assumeTrue(socketFile.getPathString().length() <= 107);
+    serverDirectory.createDirectory();
+    FileSystemUtils.writeContentAsLatin1(serverDirectory.getChild("server.pid.txt"), "1234");
+
+    CommandExecutor commandExecutor = mock(CommandExecutor.class);
+    when(commandExecutor.exec(
+            eq(ImmutableList.of("info")),
+            any(OutErr.class),
+            eq(LockingMode.WAIT),
+            eq("socket client"),
+            anyLong()))
+        .thenAnswer(
+            new Answer<Integer>() {
+              @Override
+              public Integer answer(InvocationOnMock invocation) throws Exception {
+                OutErr outErr = (OutErr) invocation.getArguments()[1];
+                outErr.getOutputStream().write("hello".getBytes(StandardCharsets.UTF_8));
+                outErr.getOutputStream().flush();
+                return 42;
+              }
+            });
+    // Shut the server down after the command, so that serve() returns.
+    when(commandExecutor.shutdown()).thenReturn(true);
+
+    final GrpcServerImpl server =
+        new GrpcServerImpl(
+            commandExecutor,
+            BlazeClock.instance(),
+            /*port=*/ 0,
+            serverDirectory,
+            /*maxIdleSeconds=*/ 0,
+            /*readyFd=*/ -1);
+    server.disableShutdownHooks();
+    TestThread serverThread =
+        new TestThread() {
+          @Override
+          public void runTest() throws Exception {
+            server.serve();
+          }
+        };
+    serverThread.setDaemon(true);
+    System.setProperty(GrpcServerImpl.SOCKET_PROPERTY, "1");
+    try {
+      serverThread.start();
+
+      // The socket is bound before the port file is written.
+      Path portFile = serverDirectory.getChild("command_port");
+      while (!portFile.exists()) {
+        Thread.sleep(10);
+      }
+    } finally {
+      System.clearProperty(GrpcServerImpl.SOCKET_PROPERTY);
+    }
+    assertThat(socketFile.exists()).isTrue();
+    String requestCookie =
+        new String(
+            FileSystemUtils.readContentAsLatin1(serverDirectory.getChild("request_cookie")));
+
+    EventLoopGroup eventLoopGroup = new EpollEventLoopGroup(1);
+    ManagedChannel channel =
+        NettyChannelBuilder.forAddress(new DomainSocketAddress(socketFile.getPathString()))
+            .channelType(EpollDomainSocketChannel.class)
+            .eventLoopGroup(eventLoopGroup)
+            .usePlaintext(true)
+            .build();
+    try {
+      Iterator<RunResponse> responses =
+          CommandServerGrpc.newBlockingStub(channel)
+              .run(
+                  RunRequest.newBuilder()
+                      .setCookie(requestCookie)
+                      .setClientDescription("socket client")
+                      .setBlockForLock(true)
+                      .addArg(ByteString.copyFromUtf8("info"))
+                      .build());
+      StringBuilder output = new StringBuilder();
+      RunResponse last = null;
+      while (responses.hasNext()) {
+        last = responses.next();
+        output.append(last.getStandardOutput().toStringUtf8());
+      }
+      assertThat(output.toString()).isEqualTo("hello");
+      assertThat(last.getFinished()).isTrue();
+      assertThat(last.getExitCode()).isEqualTo(42);
+    } finally {
+      channel.shutdownNow();
+      eventLoopGroup.shutdownGracefully();
+    }
+    serverThread.joinAndAssertState(TestUtils.WAIT_TIMEOUT_MILLISECONDS);
+  }
+
+  private static String readSlotFile(java.nio.file.Path slotDirectory, String name)
+      throws Exception {
+    return new String(Files.readAllBytes(slotDirectory.resolve(name)), StandardCharsets.UTF_8);
+  }
+
+  @Test
+  public void testPooledServerIsClaimedOnce() throws Exception {
+    final java.nio.file.Path slotDirectory = Paths.get(TestUtils.tmpDir(), "slot-claim");
+    Files.createDirectories(slotDirectory);
+    Future<List<String>> claim =
+        executor.submit(
+            new Callable<List<String>>() {
+              @Override
+              public List<String> call() throws Exception {
+                return GrpcServerImpl.awaitClaim(slotDirectory, 0);
+              }
+            });
+
+    // The port file is written last.
+    while (!Files.exists(slotDirectory.resolve("command_port"))) {
+      Thread.sleep(10);
+    }
+    String requestCookie = readSlotFile(slotDirectory, "request_cookie");
+    String responseCookie = readSlotFile(slotDirectory, "response_cookie");
+    ManagedChannel channel =
+        ManagedChannelBuilder.forTarget(readSlotFile(slotDirectory, "command_port"))
+            .usePlaintext(true)
+            .build();
+    try {
+      CommandServerGrpc.CommandServerBlockingStub stub =
+          CommandServerGrpc.newBlockingStub(channel);
+      // A client without the cookie can't claim the server.
+      ClaimResponse response =
+          stub.claim(
+              ClaimRequest.newBuilder()
+                  .setCookie("wrong")
+                  .addStartupArg(ByteString.copyFromUtf8("--output_base=/wrong"))
+                  .build());
+      assertThat(response.getCookie()).isEmpty();
+      assertThat(claim.isDone()).isFalse();
+
+      response =
+          stub.claim(
+              ClaimRequest.newBuilder()
+                  .setCookie(requestCookie)
+                  .addStartupArg(ByteString.copyFromUtf8("--output_base=/ob"))
+                  .addStartupArg(ByteString.copyFromUtf8("--nobatch"))
+                  .build());
+      assertThat(response.getCookie()).isEqualTo(responseCookie);
+    } finally {
+      channel.shutdownNow();
+    }
+    assertThat(claim.get(TestUtils.WAIT_TIMEOUT_SECONDS, TimeUnit.SECONDS))
+        .containsExactly("--output_base=/ob", "--nobatch")
+        .inOrder();
+    // The claiming client owns the slot directory from then on.
+    assertThat(Files.exists(slotDirectory)).isTrue();
+  }
+
+  @Test
+  public void testUnclaimedPooledServerRemovesItsSlot() throws Exception {
+    java.nio.file.Path slotDirectory = Paths.get(TestUtils.tmpDir(), "slot-unclaimed");
+    Files.createDirectories(slotDirectory);
+    Files.write(slotDirectory.resolve("jvm.out"), new byte[0]);
+
+    assertThat(GrpcServerImpl.awaitClaim(slotDirectory, 1)).isNull();
+    assertThat(Files.exists(slotDirectory)).isFalse();
+  }
 }
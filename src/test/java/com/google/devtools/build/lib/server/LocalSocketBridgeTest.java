@@ -0,0 +1,126 @@
+// Copyright 2016 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+package com.google.devtools.build.lib.server;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import com.google.devtools.build.lib.testutil.Suite;
+import com.google.devtools.build.lib.testutil.TestSpec;
+import com.google.devtools.build.lib.testutil.TestThread;
+import com.google.devtools.build.lib.testutil.TestUtils;
+import com.google.devtools.build.lib.unix.LocalSocket;
+import com.google.devtools.build.lib.util.OS;
+import io.netty.bootstrap.ServerBootstrap;
+import io.netty.channel.Channel;
+import io.netty.channel.ChannelHandlerContext;
+import io.netty.channel.ChannelInboundHandlerAdapter;
+import io.netty.channel.DefaultEventLoopGroup;
+import io.netty.channel.EventLoopGroup;
+import io.netty.channel.local.LocalAddress;
+import io.netty.channel.local.LocalServerChannel;
+import java.io.File;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.concurrent.atomic.AtomicReference;
+import org.junit.Assume;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+import org.junit.runners.JUnit4;
+
+/**
+ * Tests for {@link LocalSocketBridge}.
+ */
+@TestSpec(size = Suite.SMALL_TESTS)
+@RunWith(JUnit4.class)
+public class LocalSocketBridgeTest {
+
+  @Test
+  public void testForwardsBytesBothWaysAndClosesWithTheServer() throws Exception {
+    Assume.assumeTrue(OS.getCurrent() == OS.LINUX);
+    File socketFile = new File(TestUtils.tmpDir(), "bridge.socket");
+    Assume.assumeTrue(socketFile.getPath().length() <= 107);
+    socketFile.delete();
+
+    // An echo server that remembers its connection.
+    final AtomicReference<Channel> serverConnection = new AtomicReference<>();
+    LocalAddress address = new LocalAddress("local-socket-bridge-test");
+    EventLoopGroup eventLoopGroup = new DefaultEventLoopGroup(1);
+    Channel serverChannel =
+        new ServerBootstrap()
+            .group(eventLoopGroup)
+            .channel(LocalServerChannel.class)
+            .childHandler(
+                new ChannelInboundHandlerAdapter() {
+                  @Override
+                  public void channelActive(ChannelHandlerContext ctx) {
+                    serverConnection.set(ctx.channel());
+                  }
+
+                  @Override
+                  public void channelRead(ChannelHandlerContext ctx, Object msg) {
+                    ctx.writeAndFlush(msg);
+                  }
+                })
+            .bind(address)
+            .sync()
+            .channel();
+
+    LocalSocketBridge bridge = LocalSocketBridge.start(socketFile.getPath(), address);
+    LocalSocket client = LocalSocket.connect(socketFile.getPath());
+    try {
+      byte[] sent = "hello".getBytes(StandardCharsets.UTF_8);
+      assertThat(echo(client, sent)).isEqualTo(sent);
+
+      // More than a buffer of the bridge, so that it is read and written in several parts.
+      byte[] large = new byte[1024 * 1024];
+      for (int i = 0; i < large.length; i++) {
+        large[i] = (byte) (i * 7);
+      }
+      assertThat(echo(client, large)).isEqualTo(large);
+
+      // Closing the connection on the server closes the socket connection.
+      serverConnection.get().close().sync();
+      assertThat(client.read(ByteBuffer.allocateDirect(1))).isEqualTo(-1);
+    } finally {
+      client.close();
+      bridge.shutdown();
+      serverChannel.close().sync();
+      eventLoopGroup.shutdownGracefully();
+    }
+  }
+
+  /** Writes {@code sent} to {@code client} and reads as many bytes back. */
+  private static byte[] echo(final LocalSocket client, byte[] sent) throws Exception {
+    final ByteBuffer out = ByteBuffer.allocateDirect(sent.length);
+    out.put(sent).flip();
+    // Written concurrently, since the echo can't be buffered whole.
+    TestThread writer =
+        new TestThread() {
+          @Override
+          public void runTest() throws Exception {
+            client.write(out);
+          }
+        };
+    writer.start();
+    ByteBuffer in = ByteBuffer.allocateDirect(sent.length);
+    while (in.hasRemaining()) {
+      assertThat(client.read(in)).isGreaterThan(0);
+    }
+    writer.joinAndAssertState(TestUtils.WAIT_TIMEOUT_MILLISECONDS);
+    byte[] received = new byte[sent.length];
+    in.flip();
+    in.get(received);
+    return received;
+  }
+}
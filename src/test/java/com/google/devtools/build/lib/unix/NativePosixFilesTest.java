@@ -16,8 +16,11 @@ package com.google.devtools.build.lib.unix;
 import static com.google.common.truth.Truth.assertThat;
 import static org.junit.Assert.fail;
 
+import com.google.common.base.Strings;
 import com.google.common.collect.ImmutableMap;
 import com.google.common.hash.HashCode;
+import com.google.common.hash.HashFunction;
+import com.google.common.hash.Hashing;
 import com.google.devtools.build.lib.testutil.TestUtils;
 import com.google.devtools.build.lib.vfs.FileSystem;
 import com.google.devtools.build.lib.vfs.FileSystemUtils;
@@ -26,6 +29,14 @@ import com.google.devtools.build.lib.vfs.UnixFileSystem;
 import java.io.File;
 import java.io.FileNotFoundException;
 import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
+import java.util.Collection;
+import java.util.HashMap;
+import java.util.Map;
+import org.junit.Assume;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -75,6 +86,178 @@ public class NativePosixFilesTest {
     }
   }
 
+  private static HashFunction toHashFunction(NativePosixFiles.DigestFunction function) {
+    switch (function) {
+      case MD5:
+        return Hashing.md5();
+      case SHA1:
+        return Hashing.sha1();
+      case SHA256:
+        return Hashing.sha256();
+      default:
+        throw new IllegalArgumentException(function.toString());
+    }
+  }
+
+  @Test
+  public void digestBatch() throws Exception {
+    String[] contents = {"", "hello", Strings.repeat("0123456789", 100000)};
+    String[] paths = new String[contents.length + 1];
+    for (int i = 0; i < contents.length; i++) {
+      Path file = workingDir.getRelative("file" + i);
+      FileSystemUtils.writeContentAsLatin1(file, contents[i]);
+      paths[i] = file.getPathString();
+    }
+    paths[contents.length] = workingDir.getRelative("none").getPathString();
+
+    for (NativePosixFiles.DigestFunction function : NativePosixFiles.DigestFunction.values()) {
+      HashFunction hashFunction = toHashFunction(function);
+      int length = function.getDigestLength();
+      byte[] digests = new byte[paths.length * length];
+      int[] errnos = new int[paths.length];
+      NativePosixFiles.digestBatch(paths, function, 2, digests, errnos);
+      for (int i = 0; i < contents.length; i++) {
+        assertThat(errnos[i]).isEqualTo(0);
+        assertThat(Arrays.copyOfRange(digests, i * length, (i + 1) * length))
+            .isEqualTo(hashFunction.hashString(contents[i], StandardCharsets.ISO_8859_1).asBytes());
+      }
+      assertThat(errnos[contents.length]).isEqualTo(ErrnoFileStatus.ENOENT);
+    }
+  }
+
+  @Test
+  public void getOrComputeDigest() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "hello");
+    // Old enough for the digest to be cached.
+    testFile.setLastModifiedTime(1000000000000L);
+    for (NativePosixFiles.DigestFunction function : NativePosixFiles.DigestFunction.values()) {
+      HashFunction hashFunction = toHashFunction(function);
+      byte[] expected = hashFunction.hashString("hello", StandardCharsets.ISO_8859_1).asBytes();
+      // Computed, then possibly cached, depending on the file system.
+      assertThat(NativePosixFiles.getOrComputeDigest(testFile.getPathString(), function))
+          .isEqualTo(expected);
+      assertThat(NativePosixFiles.getOrComputeDigest(testFile.getPathString(), function))
+          .isEqualTo(expected);
+    }
+
+    FileSystemUtils.writeContentAsLatin1(testFile, "world");
+    testFile.setLastModifiedTime(1000000001000L);
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(), NativePosixFiles.DigestFunction.MD5))
+        .isEqualTo(Hashing.md5().hashString("world", StandardCharsets.ISO_8859_1).asBytes());
+  }
+
+  @Test
+  public void getOrComputeDigestReadsTheCachedDigest() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "hello");
+    testFile.setLastModifiedTime(1000000000000L);
+    FileStatus stat = NativePosixFiles.stat(testFile.getPathString());
+    // The attribute holds the size, modification time and inode number of the file, in native
+    // byte order, followed by the digest.
+    byte[] bogusDigest = new byte[NativePosixFiles.DigestFunction.MD5.getDigestLength()];
+    Arrays.fill(bogusDigest, (byte) 42);
+    ByteBuffer value = ByteBuffer.allocate(3 * 8 + bogusDigest.length);
+    value.order(ByteOrder.nativeOrder());
+    value.putLong(stat.getSize());
+    value.putLong(
+        stat.getLastModifiedTime() * 1000000000L + stat.getFractionalLastModifiedTime());
+    value.putLong(stat.getInodeNumber());
+    value.put(bogusDigest);
+    try {
+      NativePosixFiles.setxattr(testFile.getPathString(), "user.bazel.digest.md5", value.array());
+    } catch (UnsupportedOperationException e) {
+      Assume.assumeNoException("No extended attributes on this file system", e);
+    }
+
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(), NativePosixFiles.DigestFunction.MD5))
+        .isEqualTo(bogusDigest);
+
+    // A changed file is digested again.
+    testFile.setLastModifiedTime(1000000001000L);
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(), NativePosixFiles.DigestFunction.MD5))
+        .isEqualTo(Hashing.md5().hashString("hello", StandardCharsets.ISO_8859_1).asBytes());
+  }
+
+  @Test
+  public void getOrComputeDigestLeavesReadOnlyFilesAlone() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "hello");
+    testFile.setLastModifiedTime(1000000000000L);
+    NativePosixFiles.chmod(testFile.getPathString(), 0444);
+    FileStatus before = NativePosixFiles.stat(testFile.getPathString());
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(), NativePosixFiles.DigestFunction.MD5))
+        .isEqualTo(Hashing.md5().hashString("hello", StandardCharsets.ISO_8859_1).asBytes());
+    // Neither its mode nor its attributes were changed, even temporarily.
+    FileStatus after = NativePosixFiles.stat(testFile.getPathString());
+    assertThat(after.getPermissions()).isEqualTo(0444);
+    assertThat(after.getLastChangeTime()).isEqualTo(before.getLastChangeTime());
+    assertThat(after.getFractionalLastChangeTime())
+        .isEqualTo(before.getFractionalLastChangeTime());
+  }
+
+  @Test
+  public void getOrComputeDigestStoresDigestsOfReadOnlyFilesInDirectory() throws Exception {
+    // Only large files are stored.
+    byte[] content = new byte[2 << 20];
+    Arrays.fill(content, (byte) 'a');
+    FileSystemUtils.writeContent(testFile, content);
+    testFile.setLastModifiedTime(1000000000000L);
+    NativePosixFiles.chmod(testFile.getPathString(), 0444);
+    Path store = workingDir.getRelative("digest_cache");
+    FileSystemUtils.deleteTree(store);
+    byte[] expected = Hashing.md5().hashBytes(content).asBytes();
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(),
+                NativePosixFiles.DigestFunction.MD5,
+                store.getPathString()))
+        .isEqualTo(expected);
+    assertThat(NativePosixFiles.stat(testFile.getPathString()).getPermissions()).isEqualTo(0444);
+
+    // The digest is read from the store: corrupt it to tell.
+    Collection<Path> entries = store.getDirectoryEntries();
+    assertThat(entries).hasSize(1);
+    Path entry = entries.iterator().next();
+    byte[] value = FileSystemUtils.readContent(entry);
+    Arrays.fill(value, value.length - expected.length, value.length, (byte) 0);
+    FileSystemUtils.writeContent(entry, value);
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(),
+                NativePosixFiles.DigestFunction.MD5,
+                store.getPathString()))
+        .isEqualTo(new byte[expected.length]);
+
+    // A changed file is digested again.
+    testFile.setLastModifiedTime(1000000001000L);
+    assertThat(
+            NativePosixFiles.getOrComputeDigest(
+                testFile.getPathString(),
+                NativePosixFiles.DigestFunction.MD5,
+                store.getPathString()))
+        .isEqualTo(expected);
+    NativePosixFiles.chmod(testFile.getPathString(), 0644);
+  }
+
+  @Test
+  public void setxattr() throws Exception {
+    FileSystemUtils.createEmptyFile(testFile);
+    byte[] value = {1, 2, 3};
+    try {
+      NativePosixFiles.setxattr(testFile.getPathString(), "user.bazel.test", value);
+    } catch (UnsupportedOperationException e) {
+      return;  // The file system doesn't support extended attributes.
+    }
+    assertThat(NativePosixFiles.getxattr(testFile.getPathString(), "user.bazel.test"))
+        .isEqualTo(value);
+  }
+
   @Test
   public void throwsFileAccessException() throws Exception {
     FileSystemUtils.createEmptyFile(testFile);
@@ -98,6 +281,84 @@ public class NativePosixFilesTest {
     }
   }
 
+  @Test
+  public void statBatch() throws Exception {
+    FileSystemUtils.writeContentAsLatin1(testFile, "hello");
+    Path link = workingDir.getRelative("link");
+    link.createSymbolicLink(testFile);
+    String[] paths = {
+      testFile.getPathString(), link.getPathString(), workingDir.getRelative("none").getPathString()
+    };
+    long[] results = new long[paths.length * NativePosixFiles.PACKED_STAT_LONGS];
+
+    NativePosixFiles.statBatch(paths, false, results);
+    FileStatus status = NativePosixFiles.stat(paths[0]);
+    assertThat(results[NativePosixFiles.PACKED_STAT_ERRNO]).isEqualTo(0);
+    assertThat(results[NativePosixFiles.PACKED_STAT_MODE])
+        .isEqualTo(0100000 | status.getPermissions());
+    assertThat(results[NativePosixFiles.PACKED_STAT_SIZE]).isEqualTo(5);
+    assertThat(results[NativePosixFiles.PACKED_STAT_MTIME_NS] / 1000000000L)
+        .isEqualTo(status.getLastModifiedTime());
+    assertThat(results[NativePosixFiles.PACKED_STAT_INO]).isEqualTo(status.getInodeNumber());
+    int linked = NativePosixFiles.PACKED_STAT_LONGS;
+    assertThat(results[linked + NativePosixFiles.PACKED_STAT_MODE] & 0170000).isEqualTo(0120000);
+    int none = 2 * NativePosixFiles.PACKED_STAT_LONGS;
+    assertThat(results[none + NativePosixFiles.PACKED_STAT_ERRNO])
+        .isEqualTo(ErrnoFileStatus.ENOENT);
+
+    NativePosixFiles.statBatch(paths, true, results);
+    assertThat(results[linked + NativePosixFiles.PACKED_STAT_INO])
+        .isEqualTo(status.getInodeNumber());
+  }
+
+  @Test
+  public void readdirPlus() throws Exception {
+    Path dir = workingDir.getRelative("dir");
+    dir.createDirectory();
+    FileSystemUtils.writeContentAsLatin1(dir.getRelative("file"), "hello");
+    dir.getRelative("subdir").createDirectory();
+    dir.getRelative("link").createSymbolicLink(dir.getRelative("file"));
+    dir.getRelative("dangling").createSymbolicLink(dir.getRelative("none"));
+
+    NativePosixFiles.DirentsPlus dirents =
+        NativePosixFiles.readdirPlus(dir.getPathString(), false);
+    Map<String, Integer> entries = new HashMap<>();
+    for (int i = 0; i < dirents.size(); i++) {
+      entries.put(dirents.getName(i), i);
+    }
+    assertThat(entries.keySet()).containsExactly("file", "subdir", "link", "dangling");
+    int file = entries.get("file");
+    assertThat(dirents.getStat(file, NativePosixFiles.PACKED_STAT_SIZE)).isEqualTo(5);
+    assertThat(dirents.getStat(file, NativePosixFiles.PACKED_STAT_INO))
+        .isEqualTo(NativePosixFiles.stat(dir.getRelative("file").getPathString()).getInodeNumber());
+    assertThat(dirents.getStat(entries.get("subdir"), NativePosixFiles.PACKED_STAT_MODE) & 0170000)
+        .isEqualTo(0040000);
+    assertThat(dirents.getStat(entries.get("link"), NativePosixFiles.PACKED_STAT_MODE) & 0170000)
+        .isEqualTo(0120000);
+
+    dirents = NativePosixFiles.readdirPlus(dir.getPathString(), true);
+    for (int i = 0; i < dirents.size(); i++) {
+      long errno = dirents.getStat(i, NativePosixFiles.PACKED_STAT_ERRNO);
+      if (dirents.getName(i).equals("dangling")) {
+        assertThat(errno).isEqualTo(ErrnoFileStatus.ENOENT);
+      } else if (dirents.getName(i).equals("link")) {
+        assertThat(errno).isEqualTo(0);
+        assertThat(dirents.getStat(i, NativePosixFiles.PACKED_STAT_SIZE)).isEqualTo(5);
+      }
+    }
+  }
+
+  @Test
+  public void readdirPlusOfMissingDirectory() throws Exception {
+    Path none = workingDir.getRelative("none");
+    try {
+      NativePosixFiles.readdirPlus(none.getPathString(), false);
+      fail("Expected FileNotFoundException, but wasn't thrown.");
+    } catch (FileNotFoundException e) {
+      assertThat(e).hasMessage(none + " (No such file or directory)");
+    }
+  }
+
   @Test
   public void throwsFilePermissionException() throws Exception {
     File foo = new File("/bin");
@@ -33,6 +33,7 @@ import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
 import java.nio.file.FileAlreadyExistsException;
+import java.util.Map;
 import java.util.regex.Matcher;
 import java.util.regex.Pattern;
 import org.junit.After;
@@ -668,6 +669,30 @@ public abstract class FileSystemTest {
     }
   }
 
+  @Test
+  public void testReaddirWithStatus() throws Exception {
+    Path theDirectory = absolutize("foo/");
+    theDirectory.createDirectory();
+    FileSystemUtils.writeContentAsLatin1(absolutize("foo/file"), "hello");
+    absolutize("foo/subdir").createDirectory();
+    if (supportsSymlinks) {
+      absolutize("foo/link").createSymbolicLink(new PathFragment("file"));
+    }
+
+    Map<String, FileStatus> statuses = theDirectory.readdirWithStatus();
+    if (supportsSymlinks) {
+      assertThat(statuses.keySet()).containsExactly("file", "subdir", "link");
+      assertTrue(statuses.get("link").isSymbolicLink());
+    } else {
+      assertThat(statuses.keySet()).containsExactly("file", "subdir");
+    }
+    assertTrue(statuses.get("file").isFile());
+    assertEquals(5, statuses.get("file").getSize());
+    assertEquals(absolutize("foo/file").getLastModifiedTime(),
+        statuses.get("file").getLastModifiedTime());
+    assertTrue(statuses.get("subdir").isDirectory());
+  }
+
   // Test the removal of items
   @Test
   public void testDeleteDirectory() throws Exception {
@@ -1323,6 +1348,18 @@ public abstract class FileSystemTest {
         fp.hexDigestAndReset());
   }
 
+  @Test
+  public void testGetDigests() throws Exception {
+    Path otherFile = xEmptyDirectory.getChild("other");
+    FileSystemUtils.writeContentAsLatin1(xFile, "hello");
+    FileSystemUtils.writeContentAsLatin1(otherFile, "world");
+    byte[][] digests =
+        FileSystemUtils.getDigests(testFS, new Path[] {xFile, xNothing, otherFile}, 2);
+    assertThat(digests[0]).isEqualTo(xFile.getDigest());
+    assertThat(digests[1]).isNull();
+    assertThat(digests[2]).isEqualTo(otherFile.getDigest());
+  }
+
   @Test
   public void testStatFailsFastOnNonExistingFiles() throws Exception {
     try {
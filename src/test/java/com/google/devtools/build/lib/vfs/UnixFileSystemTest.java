@@ -13,11 +13,13 @@
 // limitations under the License.
 package com.google.devtools.build.lib.vfs;
 
+import static org.junit.Assert.assertEquals;
 import static org.junit.Assert.assertFalse;
 import static org.junit.Assert.assertNull;
 import static org.junit.Assert.assertTrue;
 import static org.junit.Assert.fail;
 
+import com.google.common.collect.ImmutableList;
 import com.google.devtools.build.lib.unix.NativePosixFiles;
 
 import org.junit.Test;
@@ -25,6 +27,7 @@ import org.junit.runner.RunWith;
 import org.junit.runners.JUnit4;
 
 import java.io.IOException;
+import java.util.List;
 
 /**
  * Tests for the {@link UnixFileSystem} class.
@@ -79,4 +82,46 @@ public class UnixFileSystemTest extends SymlinkAwareFileSystemTest {
     assertTrue(fifo.stat().isFile());
     assertTrue(fifo.stat().isSpecialFile());
   }
+
+  @Test
+  public void testBatchStat() throws Exception {
+    Path file = absolutize("file");
+    Path link = absolutize("link");
+    FileSystemUtils.writeContentAsLatin1(file, "hello");
+    link.createSymbolicLink(file);
+    BatchStat batchStatter = testFS.getBatchStatter(workingDir);
+    List<FileStatusWithDigest> stats =
+        batchStatter.batchStat(
+            /*includeDigest=*/ false,
+            /*includeLinks=*/ true,
+            ImmutableList.of(
+                new PathFragment("file"),
+                new PathFragment("link"),
+                new PathFragment("xEmptyDirectory"),
+                new PathFragment("file/none"),
+                new PathFragment("none")));
+    assertEquals(5, stats.size());
+
+    FileStatus expected = file.stat(Symlinks.NOFOLLOW);
+    assertTrue(stats.get(0).isFile());
+    assertFalse(stats.get(0).isSpecialFile());
+    assertEquals(expected.getSize(), stats.get(0).getSize());
+    assertEquals(expected.getLastModifiedTime(), stats.get(0).getLastModifiedTime());
+    assertEquals(expected.getLastChangeTime(), stats.get(0).getLastChangeTime());
+    assertEquals(expected.getNodeId(), stats.get(0).getNodeId());
+    assertNull(stats.get(0).getDigest());
+    assertTrue(stats.get(1).isSymbolicLink());
+    assertTrue(stats.get(2).isDirectory());
+    assertNull(stats.get(3));
+    assertNull(stats.get(4));
+
+    // Without links, the link is its target.
+    stats =
+        batchStatter.batchStat(
+            /*includeDigest=*/ false,
+            /*includeLinks=*/ false,
+            ImmutableList.of(new PathFragment("link")));
+    assertTrue(stats.get(0).isFile());
+    assertEquals(expected.getNodeId(), stats.get(0).getNodeId());
+  }
 }
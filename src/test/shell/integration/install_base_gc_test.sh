@@ -0,0 +1,84 @@
+#!/bin/bash
+#
+# Copyright 2017 The Bazel Authors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Test of the garbage collection of the install user root.
+
+# Load the test setup defined in the parent directory
+CURRENT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${CURRENT_DIR}/../integration_test_setup.sh" \
+  || { echo "integration_test_setup.sh not found!" >&2; exit 1; }
+
+install_user_root="${bazel_root}/install"
+
+# Creates an install base named $1 last modified $2 days ago.
+function create_install_base() {
+  mkdir -p "${install_user_root}/$1/_embedded_binaries"
+  touch "${install_user_root}/$1/_embedded_binaries/A-server.jar"
+  touch -d "$2 days ago" "${install_user_root}/$1"
+}
+
+# Runs a command that garbage collects the install user root, and waits until
+# the install bases given as arguments are removed.
+function run_install_base_gc() {
+  rm -f "${install_user_root}/gc.log"
+  bazel --batch info install_base >& $TEST_log || fail "${PRODUCT_NAME} failed"
+  for install_base in "$@"; do
+    for i in $(seq 1 100); do
+      [[ -d "${install_user_root}/${install_base}" ]] || break
+      sleep 0.1
+    done
+  done
+  # Give it the time to wrongly remove the other install bases.
+  sleep 1
+}
+
+function test_unused_install_bases_are_removed() {
+  create_install_base unused 40
+  create_install_base recent 10
+  create_install_base "old.tmp.123" 2
+  run_install_base_gc unused "old.tmp.123"
+  [[ -d "${install_user_root}/unused" ]] && fail "unused install base kept"
+  [[ -d "${install_user_root}/old.tmp.123" ]] &&
+    fail "temporary install base kept"
+  [[ -d "${install_user_root}/recent" ]] || fail "recent install base removed"
+  assert_contains "Removing unused install base .*/unused" \
+    "${install_user_root}/gc.log"
+}
+
+function test_install_base_is_aged_by_its_last_used_stamp() {
+  # The install base of an output base outside of the output user root, which
+  # was extracted long ago and used recently.
+  create_install_base used 40
+  touch "${install_user_root}/used/_last_used"
+  create_install_base stale 40
+  touch -d "40 days ago" "${install_user_root}/stale/_last_used"
+  run_install_base_gc stale
+  [[ -d "${install_user_root}/used" ]] || fail "used install base removed"
+  [[ -d "${install_user_root}/stale" ]] && fail "stale install base kept"
+  true
+}
+
+function test_client_stamps_its_install_base() {
+  bazel --batch info install_base >& $TEST_log || fail "${PRODUCT_NAME} failed"
+  local install_base=$(tail -1 $TEST_log)
+  [[ -f "${install_base}/_last_used" ]] || fail "install base not stamped"
+  touch -d "40 days ago" "${install_base}/_last_used" "${install_base}"
+  bazel --batch info install_base >& $TEST_log || fail "${PRODUCT_NAME} failed"
+  [[ -n "$(find "${install_base}/_last_used" -mmin -60)" ]] ||
+    fail "last used stamp not updated"
+}
+
+run_suite "${PRODUCT_NAME} install base garbage collection test"
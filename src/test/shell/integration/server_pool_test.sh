@@ -0,0 +1,98 @@
+#!/bin/bash
+#
+# Copyright 2017 The Bazel Authors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Test of the pool of pre-started servers (--server_pool_size).
+
+# Load the test setup defined in the parent directory
+CURRENT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${CURRENT_DIR}/../integration_test_setup.sh" \
+  || { echo "integration_test_setup.sh not found!" >&2; exit 1; }
+
+function tear_down() {
+  for output_base in "$TEST_TMPDIR"/pool_ob_*; do
+    [[ -d "$output_base" ]] &&
+      bazel --output_base="$output_base" shutdown >& /dev/null
+  done
+  for pid_file in "$bazel_root"/server_pool/*/slot-*/server.pid.txt; do
+    [[ -f "$pid_file" ]] && kill -9 "$(cat "$pid_file")" >& /dev/null
+  done
+  rm -fr "$bazel_root/server_pool" "$TEST_TMPDIR"/pool_ob_*
+  true
+}
+
+# Prints the pool slot directories, one per line.
+function pool_slots() {
+  ls -d "$bazel_root"/server_pool/*/slot-* 2> /dev/null
+}
+
+# Waits until there is a pool slot whose server serves the Claim call, and
+# prints its directory.
+function wait_for_ready_slot() {
+  for i in $(seq 1 600); do
+    for slot in $(pool_slots); do
+      if [[ -f "$slot/command_port" ]]; then
+        echo "$slot"
+        return 0
+      fi
+    done
+    sleep 0.1
+  done
+  fail "No pooled server became ready"
+}
+
+function server_pid_of() {
+  bazel --server_pool_size=1 --output_base="$TEST_TMPDIR/pool_ob_$1" \
+    info server_pid 2>> $TEST_log
+}
+
+function test_pooled_server_is_claimed_and_pool_refilled() {
+  server_pid_of a > /dev/null || fail "${PRODUCT_NAME} failed"
+  local slot=$(wait_for_ready_slot)
+  local pooled_pid=$(cat "$slot/server.pid.txt")
+
+  # The next output base gets the pooled server...
+  local pid=$(server_pid_of b)
+  [[ "$pid" == "$pooled_pid" ]] ||
+    fail "expected the pooled server $pooled_pid, got $pid"
+  [[ -d "$slot" ]] && fail "slot $slot of the claimed server still exists"
+
+  # ... and the pool is filled again.
+  local new_slot=$(wait_for_ready_slot)
+  [[ "$new_slot" != "$slot" ]] || fail "the pool was not refilled"
+  [[ $(pool_slots | wc -l) -eq 1 ]] || fail "expected a single pool slot"
+}
+
+function test_dead_pooled_server_is_replaced() {
+  server_pid_of a > /dev/null || fail "${PRODUCT_NAME} failed"
+  local slot=$(wait_for_ready_slot)
+  local pooled_pid=$(cat "$slot/server.pid.txt")
+  # A server that dies doesn't remove its slot.
+  rm -f "$slot/command_port"
+  kill -9 "$pooled_pid"
+  while kill -0 "$pooled_pid" 2> /dev/null; do sleep 0.1; done
+
+  local pid=$(server_pid_of b)
+  [[ -n "$pid" && "$pid" != "$pooled_pid" ]] ||
+    fail "expected a new server, got '$pid'"
+  [[ -d "$slot" ]] && fail "slot $slot of the dead server still exists"
+
+  # The dead server doesn't count, so the pool gets a new server.
+  local new_slot=$(wait_for_ready_slot)
+  [[ "$(cat "$new_slot/server.pid.txt")" != "$pooled_pid" ]] ||
+    fail "the pool was not refilled"
+}
+
+run_suite "${PRODUCT_NAME} server pool test"
@@ -37,6 +37,7 @@
 #include <string>
 #include <vector>
 
+#include "third_party/ijar/classfile.h"
 #include "third_party/ijar/common.h"
 
 namespace {
@@ -111,10 +112,12 @@ enum TARGET_TYPE {
 struct Constant;
 
 // TODO(adonovan) these globals are unfortunate
-static std::vector<Constant*>        const_pool_in; // input constant pool
-static std::vector<Constant*>        const_pool_out; // output constant_pool
-static std::set<std::string>         used_class_names;
-static Constant *                    class_name;
+// They are thread-local so that several jars can be stripped concurrently in
+// batch mode (see ijar.cc), each thread working on its own class file.
+static thread_local std::vector<Constant*> const_pool_in;  // input pool
+static thread_local std::vector<Constant*> const_pool_out;  // output pool
+static thread_local std::set<std::string>  used_class_names;
+static thread_local Constant *             class_name;
 
 // Returns the Constant object, given an index into the input constant pool.
 // Note: constant(0) == NULL; this invariant is exploited by the
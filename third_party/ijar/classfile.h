@@ -0,0 +1,35 @@
+// Copyright 2015 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// classfile.h -- classfile parsing and stripping.
+//
+
+#ifndef INCLUDED_THIRD_PARTY_IJAR_CLASSFILE_H
+#define INCLUDED_THIRD_PARTY_IJAR_CLASSFILE_H
+
+#include <stddef.h>
+
+#include "third_party/ijar/common.h"
+
+namespace devtools_ijar {
+
+// Reads a JVM class from classdata_in (of the specified length), and
+// writes out a simplified class to classdata_out, advancing the
+// pointer. Returns true if the class should be kept.
+// The output is never bigger than the input.
+bool StripClass(u1*& classdata_out, const u1* classdata_in, size_t in_length);
+
+}  // namespace devtools_ijar
+
+#endif  // INCLUDED_THIRD_PARTY_IJAR_CLASSFILE_H
@@ -23,6 +23,11 @@ u4 ComputeCrcChecksum(u1* buf, size_t length) { return 0; }
 
 size_t TryDeflate(u1* buf, size_t length) { return 0; }
 
+Compressor::Compressor() {}
+Compressor::~Compressor() {}
+
+size_t Compressor::TryDeflate(u1* buf, size_t length) { return 0; }
+
 Decompressor::Decompressor() {}
 Decompressor::~Decompressor() {}
 
@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 //
-// ijar.cpp -- .jar -> _interface.jar tool.
+// ijar.cc -- .jar -> _interface.jar conversion.
 //
 
 #include <stdio.h>
@@ -20,29 +20,49 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <errno.h>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
+#include "third_party/ijar/classfile.h"
+#include "third_party/ijar/ijar.h"
 #include "third_party/ijar/zip.h"
+#include "third_party/ijar/zlib_client.h"
 
 namespace devtools_ijar {
 
 bool verbose = false;
 
-// Reads a JVM class from classdata_in (of the specified length), and
-// writes out a simplified class to classdata_out, advancing the
-// pointer. Returns true if the class should be kept.
-bool StripClass(u1*& classdata_out, const u1* classdata_in, size_t in_length);
-
 const char* CLASS_EXTENSION = ".class";
 const size_t CLASS_EXTENSION_LENGTH = strlen(CLASS_EXTENSION);
 
+// Runs "worker" on "jobs" threads (or on the calling thread if "jobs" is 1)
+// and waits for all of them to finish.
+void RunOnThreads(int jobs, const std::function<void()>& worker) {
+  if (jobs <= 1) {
+    worker();
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (int i = 0; i < jobs; ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
 // ZipExtractorProcessor that select only .class file and use
 // StripClass to generate an interface class, storing as a new file
 // in the specified ZipBuilder.
 class JarStripperProcessor : public ZipExtractorProcessor {
  public:
-  JarStripperProcessor() {}
-  virtual ~JarStripperProcessor() {}
+  JarStripperProcessor()
+      : buffer_(NULL), buffer_size_(0), compress_(false), jobs_(1) {}
+  virtual ~JarStripperProcessor() { free(buffer_); }
 
   virtual void Process(const char* filename, const u4 attr,
                        const u1* data, const size_t size);
@@ -52,6 +72,25 @@ class JarStripperProcessor : public ZipExtractorProcessor {
   // Not owned by JarStripperProcessor, see SetZipBuilder().
   ZipBuilder* builder;
 
+  // Scratch buffer receiving the stripped classes. It is grown as needed and
+  // reused for every class (and every jar, in batch mode) to avoid a
+  // malloc()/free() pair per class file.
+  u1* buffer_;
+  size_t buffer_size_;
+
+  // Whether to deflate the stripped classes, and on how many threads.
+  bool compress_;
+  int jobs_;
+
+  // A stripped class waiting to be compressed by WritePendingClasses().
+  struct PendingClass {
+    std::string filename;
+    std::vector<u1> data;
+    size_t compressed_length;
+    u4 crc;
+  };
+  std::vector<PendingClass> pending_classes_;
+
  public:
   // Set the ZipBuilder to add the ijar class to the output zip file.
   // This pointer should not be deleted while this class is still in use and
@@ -59,6 +98,20 @@ class JarStripperProcessor : public ZipExtractorProcessor {
   void SetZipBuilder(ZipBuilder* builder) {
     this->builder = builder;
   }
+
+  // Set whether the stripped classes are compressed in the output zip file,
+  // and how many threads may be used to compress them. With more than one
+  // thread, the stripped classes are kept in memory until
+  // WritePendingClasses() compresses them concurrently.
+  void SetCompression(bool compress, int jobs) {
+    compress_ = compress;
+    jobs_ = jobs;
+  }
+
+  // Compress the classes kept in memory for parallel compression and add
+  // them to the output zip file, in the order in which they were processed.
+  // This must be called before finishing the ZipBuilder.
+  void WritePendingClasses();
 };
 
 bool JarStripperProcessor::Accept(const char* filename, const u4 attr) {
@@ -75,24 +128,64 @@ void JarStripperProcessor::Process(const char* filename, const u4 attr,
   if (verbose) {
     fprintf(stderr, "INFO: StripClass: %s\n", filename);
   }
-  u1* buf = reinterpret_cast<u1*>(malloc(size));
-  u1* classdata_out = buf;
+  if (size > buffer_size_) {
+    u1* buffer = reinterpret_cast<u1*>(realloc(buffer_, size));
+    if (buffer == NULL) {
+      fprintf(stderr, "Unable to allocate %zu bytes to strip %s\n", size,
+              filename);
+      abort();
+    }
+    buffer_ = buffer;
+    buffer_size_ = size;
+  }
+  u1* buf = buffer_;
   if (!StripClass(buf, data, size)) {
-    free(classdata_out);
+    return;
+  }
+  if (compress_ && jobs_ > 1) {
+    pending_classes_.push_back(PendingClass());
+    pending_classes_.back().filename = filename;
+    pending_classes_.back().data.assign(buffer_, buf);
     return;
   }
   u1* q = builder->NewFile(filename, 0);
-  size_t out_length = buf - classdata_out;
-  memcpy(q, classdata_out, out_length);
-  builder->FinishFile(out_length);
-  free(classdata_out);
+  size_t out_length = buf - buffer_;
+  memcpy(q, buffer_, out_length);
+  builder->FinishFile(out_length, compress_, compress_);
+}
+
+void JarStripperProcessor::WritePendingClasses() {
+  std::atomic<size_t> next_class(0);
+  RunOnThreads(jobs_, [this, &next_class]() {
+    for (size_t i = next_class++; i < pending_classes_.size();
+         i = next_class++) {
+      PendingClass& pending = pending_classes_[i];
+      size_t length = pending.data.size();
+      pending.crc = ComputeCrcChecksum(pending.data.data(), length);
+      pending.compressed_length = TryDeflate(pending.data.data(), length);
+    }
+  });
+
+  for (const PendingClass& pending : pending_classes_) {
+    u1* q = builder->NewFile(pending.filename.c_str(), 0);
+    memcpy(q, pending.data.data(), pending.compressed_length);
+    if (builder->FinishCompressedFile(pending.compressed_length,
+                                      pending.data.size(), pending.crc) < 0) {
+      fprintf(stderr, "%s\n", builder->GetError());
+      abort();
+    }
+  }
+  pending_classes_.clear();
 }
 
 // Opens "file_in" (a .jar file) for reading, and writes an interface
-// .jar to "file_out".
-void OpenFilesAndProcessJar(const char *file_out, const char *file_in) {
-  JarStripperProcessor processor;
-  std::unique_ptr<ZipExtractor> in(ZipExtractor::Create(file_in, &processor));
+// .jar to "file_out", using "processor" to strip the classes and
+// "decompressor" to inflate the compressed entries of "file_in".
+void OpenFilesAndProcessJar(const char *file_out, const char *file_in,
+                            JarStripperProcessor *processor,
+                            Decompressor *decompressor) {
+  std::unique_ptr<ZipExtractor> in(
+      ZipExtractor::Create(file_in, processor, decompressor));
   if (in.get() == NULL) {
     fprintf(stderr, "Unable to open Zip file %s: %s\n", file_in,
             strerror(errno));
@@ -105,13 +198,14 @@ void OpenFilesAndProcessJar(const char *file_out, const char *file_in) {
             strerror(errno));
     abort();
   }
-  processor.SetZipBuilder(out.get());
+  processor->SetZipBuilder(out.get());
 
   // Process all files in the zip
   if (in->ProcessAll() < 0) {
     fprintf(stderr, "%s\n", in->GetError());
     abort();
   }
+  processor->WritePendingClasses();
 
   // Add dummy file, since javac doesn't like truly empty jars.
   if (out->GetNumberFiles() == 0) {
@@ -132,56 +226,66 @@ void OpenFilesAndProcessJar(const char *file_out, const char *file_in) {
   }
 }
 
-}  // namespace devtools_ijar
-
-//
-// main method
-//
-static void usage() {
-  fprintf(stderr, "Usage: ijar [-v] x.jar [x_interface.jar>]\n");
-  fprintf(stderr, "Creates an interface jar from the specified jar file.\n");
-  exit(1);
+void OpenFilesAndProcessJar(const char *file_out, const char *file_in,
+                            bool compress, int jobs) {
+  JarStripperProcessor processor;
+  processor.SetCompression(compress, jobs);
+  Decompressor decompressor;
+  OpenFilesAndProcessJar(file_out, file_in, &processor, &decompressor);
 }
 
-int main(int argc, char **argv) {
-  const char *filename_in = NULL;
-  const char *filename_out = NULL;
-
-  for (int ii = 1; ii < argc; ++ii) {
-    if (strcmp(argv[ii], "-v") == 0) {
-      devtools_ijar::verbose = true;
-    } else if (filename_in == NULL) {
-      filename_in = argv[ii];
-    } else if (filename_out == NULL) {
-      filename_out = argv[ii];
-    } else {
-      usage();
-    }
-  }
-
-  if (filename_in == NULL) {
-    usage();
+bool ReadBatchFile(const char *batch_file, std::vector<JarPair> *jars) {
+  FILE *fp = fopen(batch_file, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Unable to open batch file %s: %s\n", batch_file,
+            strerror(errno));
+    return false;
   }
-
-  // Guess output filename from input:
-  char filename_out_buf[PATH_MAX];
-  if (filename_out == NULL) {
-    size_t len = strlen(filename_in);
-    if (len > 4 && strncmp(filename_in + len - 4, ".jar", 4) == 0) {
-      strcpy(filename_out_buf, filename_in);
-      strcpy(filename_out_buf + len - 4, "-interface.jar");
-      filename_out = filename_out_buf;
-    } else {
-      fprintf(stderr, "Can't determine output filename since input filename "
-              "doesn't end with '.jar'.\n");
-      return 1;
+  static const char kSeparators[] = " \t\r\n";
+  char line[2 * PATH_MAX + 2];
+  int line_number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), fp) != NULL) {
+    line_number++;
+    char *input = line + strspn(line, kSeparators);
+    if (*input == 0) {
+      continue;
+    }
+    char *input_end = input + strcspn(input, kSeparators);
+    char *output = input_end + strspn(input_end, kSeparators);
+    char *output_end = output + strcspn(output, kSeparators);
+    if (output == output_end || output_end[strspn(output_end, kSeparators)]) {
+      fprintf(stderr, "%s:%d: expected 'input.jar output.jar'\n", batch_file,
+              line_number);
+      ok = false;
+      break;
     }
+    JarPair jar;
+    jar.input.assign(input, input_end - input);
+    jar.output.assign(output, output_end - output);
+    jars->push_back(jar);
   }
+  fclose(fp);
+  return ok;
+}
 
-  if (devtools_ijar::verbose) {
-    fprintf(stderr, "INFO: writing to '%s'.\n", filename_out);
+// Each thread reuses its class stripping state and (de)compression buffers
+// for all the jars it processes. Since the jars are already processed in
+// parallel, each jar is compressed serially by the thread producing it.
+void ProcessJars(const std::vector<JarPair> &jars, bool compress, int jobs) {
+  std::atomic<size_t> next_jar(0);
+  if (jobs > static_cast<int>(jars.size())) {
+    jobs = jars.size();
   }
-
-  devtools_ijar::OpenFilesAndProcessJar(filename_out, filename_in);
-  return 0;
+  RunOnThreads(jobs, [&jars, &next_jar, compress]() {
+    JarStripperProcessor processor;
+    processor.SetCompression(compress, 1);
+    Decompressor decompressor;
+    for (size_t i = next_jar++; i < jars.size(); i = next_jar++) {
+      OpenFilesAndProcessJar(jars[i].output.c_str(), jars[i].input.c_str(),
+                             &processor, &decompressor);
+    }
+  });
 }
+
+}  // namespace devtools_ijar
@@ -0,0 +1,51 @@
+// Copyright 2015 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// ijar.h -- .jar -> _interface.jar conversion.
+//
+
+#ifndef INCLUDED_THIRD_PARTY_IJAR_IJAR_H
+#define INCLUDED_THIRD_PARTY_IJAR_IJAR_H
+
+#include <string>
+#include <vector>
+
+namespace devtools_ijar {
+
+// Opens "file_in" (a .jar file) for reading, and writes an interface
+// .jar to "file_out". If "compress" is true, the classes are compressed in
+// the output using up to "jobs" threads.
+// Aborts on failure.
+void OpenFilesAndProcessJar(const char *file_out, const char *file_in,
+                            bool compress, int jobs);
+
+// An input jar and the interface jar to produce from it.
+struct JarPair {
+  std::string input;
+  std::string output;
+};
+
+// Reads the "input output" pairs of a batch file, one pair per line,
+// separated by whitespace. Empty lines are ignored.
+// Returns false and prints an error message on failure.
+bool ReadBatchFile(const char *batch_file, std::vector<JarPair> *jars);
+
+// Produces the interface jars of all "jars", using up to "jobs" threads. If
+// "compress" is true, the classes are compressed in the output.
+// Aborts on failure.
+void ProcessJars(const std::vector<JarPair> &jars, bool compress, int jobs);
+
+}  // namespace devtools_ijar
+
+#endif  // INCLUDED_THIRD_PARTY_IJAR_IJAR_H
@@ -0,0 +1,107 @@
+// Copyright 2015 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// ijar_main.cc -- .jar -> _interface.jar tool.
+//
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "third_party/ijar/common.h"
+#include "third_party/ijar/ijar.h"
+
+//
+// main method
+//
+static void usage() {
+  fprintf(stderr, "Usage: ijar [-v] [--compress] [-j jobs] x.jar "
+          "[x_interface.jar>]\n");
+  fprintf(stderr, "       ijar [-v] [--compress] [-j jobs] @batch_file\n");
+  fprintf(stderr, "Creates an interface jar from the specified jar file.\n");
+  fprintf(stderr, "In batch mode, batch_file contains one 'x.jar "
+          "x_interface.jar' pair\nper line, and up to 'jobs' jars are "
+          "processed in parallel.\n");
+  fprintf(stderr, "With --compress, the classes of the interface jar are "
+          "deflated, using up to\n'jobs' threads.\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  const char *filename_in = NULL;
+  const char *filename_out = NULL;
+  int jobs = 1;
+  bool compress = false;
+
+  for (int ii = 1; ii < argc; ++ii) {
+    if (strcmp(argv[ii], "-v") == 0) {
+      devtools_ijar::verbose = true;
+    } else if (strcmp(argv[ii], "--compress") == 0) {
+      compress = true;
+    } else if (strcmp(argv[ii], "-j") == 0 && ii + 1 < argc) {
+      jobs = atoi(argv[++ii]);
+      if (jobs < 1) {
+        usage();
+      }
+    } else if (filename_in == NULL) {
+      filename_in = argv[ii];
+    } else if (filename_out == NULL) {
+      filename_out = argv[ii];
+    } else {
+      usage();
+    }
+  }
+
+  if (filename_in == NULL) {
+    usage();
+  }
+
+  if (filename_in[0] == '@') {
+    if (filename_out != NULL) {
+      usage();
+    }
+    std::vector<devtools_ijar::JarPair> jars;
+    if (!devtools_ijar::ReadBatchFile(filename_in + 1, &jars)) {
+      return 1;
+    }
+    devtools_ijar::ProcessJars(jars, compress, jobs);
+    return 0;
+  }
+
+  // Guess output filename from input:
+  char filename_out_buf[PATH_MAX];
+  if (filename_out == NULL) {
+    size_t len = strlen(filename_in);
+    if (len > 4 && strncmp(filename_in + len - 4, ".jar", 4) == 0) {
+      strcpy(filename_out_buf, filename_in);
+      strcpy(filename_out_buf + len - 4, "-interface.jar");
+      filename_out = filename_out_buf;
+    } else {
+      fprintf(stderr, "Can't determine output filename since input filename "
+              "doesn't end with '.jar'.\n");
+      return 1;
+    }
+  }
+
+  if (devtools_ijar::verbose) {
+    fprintf(stderr, "INFO: writing to '%s'.\n", filename_out);
+  }
+
+  devtools_ijar::OpenFilesAndProcessJar(filename_out, filename_in, compress,
+                                        jobs);
+  return 0;
+}
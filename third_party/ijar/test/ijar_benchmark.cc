@@ -0,0 +1,583 @@
+// Copyright 2017 The Bazel Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// ijar_benchmark.cc -- class stripping throughput benchmark.
+//
+// Measures the throughput of StripClass and of the whole jar processing
+// pipeline (OpenFilesAndProcessJar) on a corpus of generated class files,
+// shaped like real-world ones (annotations, generic signatures, inner
+// classes, method bodies, private members), and optionally on the classes
+// and jars given on the command line.
+//
+// Usage: ijar_benchmark [--classes N] [--iterations N] [--tmpdir DIR]
+//                       [x.jar ...]
+//
+// For each benchmark, reports classes/s, MB/s (of input class data) and the
+// number of C++ heap allocations (operator new) per class.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <new>
+#include <string>
+#include <vector>
+
+#include "third_party/ijar/classfile.h"
+#include "third_party/ijar/common.h"
+#include "third_party/ijar/ijar.h"
+#include "third_party/ijar/zip.h"
+
+//
+// Allocation counting
+//
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations++;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) {
+  allocations++;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace devtools_ijar {
+
+//
+// Class file generation
+//
+
+// Writes a class file, interning its constant pool entries.
+class ClassFileWriter {
+ public:
+  ClassFileWriter() : constant_count_(1) {}
+
+  u2 Utf8(const std::string& value) {
+    for (size_t ii = 0; ii < utf8_values_.size(); ++ii) {
+      if (utf8_values_[ii] == value) {
+        return utf8_indices_[ii];
+      }
+    }
+    Put1(&pool_, 1);  // CONSTANT_Utf8
+    Put2(&pool_, value.size());
+    pool_.insert(pool_.end(), value.begin(), value.end());
+    utf8_values_.push_back(value);
+    utf8_indices_.push_back(constant_count_);
+    return constant_count_++;
+  }
+
+  u2 Class(const std::string& name) {
+    u2 name_index = Utf8(name);
+    Put1(&pool_, 7);  // CONSTANT_Class
+    Put2(&pool_, name_index);
+    return constant_count_++;
+  }
+
+  u2 Integer(u4 value) {
+    Put1(&pool_, 3);  // CONSTANT_Integer
+    Put4(&pool_, value);
+    return constant_count_++;
+  }
+
+  u2 Methodref(const std::string& owner, const std::string& name,
+               const std::string& descriptor) {
+    u2 class_index = Class(owner);
+    u2 name_index = Utf8(name);
+    u2 descriptor_index = Utf8(descriptor);
+    Put1(&pool_, 12);  // CONSTANT_NameAndType
+    Put2(&pool_, name_index);
+    Put2(&pool_, descriptor_index);
+    u2 name_and_type_index = constant_count_++;
+    Put1(&pool_, 10);  // CONSTANT_Methodref
+    Put2(&pool_, class_index);
+    Put2(&pool_, name_and_type_index);
+    return constant_count_++;
+  }
+
+  // The class body, after the constant pool.
+  std::vector<u1>* body() { return &body_; }
+
+  std::vector<u1> Finish() {
+    std::vector<u1> result;
+    Put4(&result, 0xCAFEBABE);
+    Put2(&result, 0);   // minor_version
+    Put2(&result, 52);  // major_version (Java 8)
+    Put2(&result, constant_count_);
+    result.insert(result.end(), pool_.begin(), pool_.end());
+    result.insert(result.end(), body_.begin(), body_.end());
+    return result;
+  }
+
+  static void Put1(std::vector<u1>* out, u1 value) { out->push_back(value); }
+  static void Put2(std::vector<u1>* out, u2 value) {
+    out->push_back(value >> 8);
+    out->push_back(value & 0xff);
+  }
+  static void Put4(std::vector<u1>* out, u4 value) {
+    Put2(out, value >> 16);
+    Put2(out, value & 0xffff);
+  }
+
+ private:
+  std::vector<u1> pool_;
+  u2 constant_count_;
+  std::vector<std::string> utf8_values_;
+  std::vector<u2> utf8_indices_;
+  std::vector<u1> body_;
+};
+
+// Appends an attribute whose content is "content".
+static void PutAttribute(ClassFileWriter* writer, std::vector<u1>* out,
+                         const std::string& name,
+                         const std::vector<u1>& content) {
+  ClassFileWriter::Put2(out, writer->Utf8(name));
+  ClassFileWriter::Put4(out, content.size());
+  out->insert(out->end(), content.begin(), content.end());
+}
+
+// Appends a Signature attribute.
+static void PutSignature(ClassFileWriter* writer, std::vector<u1>* out,
+                         const std::string& signature) {
+  std::vector<u1> content;
+  ClassFileWriter::Put2(&content, writer->Utf8(signature));
+  PutAttribute(writer, out, "Signature", content);
+}
+
+// Appends a RuntimeVisibleAnnotations attribute with "count" annotations
+// having a string, an int and a class array element.
+static void PutAnnotations(ClassFileWriter* writer, std::vector<u1>* out,
+                           int seed, int count) {
+  std::vector<u1> content;
+  ClassFileWriter::Put2(&content, count);
+  for (int ii = 0; ii < count; ++ii) {
+    ClassFileWriter::Put2(
+        &content, writer->Utf8("Lbench/annotations/Annotation" +
+                               std::to_string((seed + ii) % 7) + ";"));
+    ClassFileWriter::Put2(&content, 3);  // num_element_value_pairs
+    ClassFileWriter::Put2(&content, writer->Utf8("value"));
+    ClassFileWriter::Put1(&content, 's');
+    ClassFileWriter::Put2(&content,
+                          writer->Utf8("value " + std::to_string(seed)));
+    ClassFileWriter::Put2(&content, writer->Utf8("priority"));
+    ClassFileWriter::Put1(&content, 'I');
+    ClassFileWriter::Put2(&content, writer->Integer(seed * 31 + ii));
+    ClassFileWriter::Put2(&content, writer->Utf8("types"));
+    ClassFileWriter::Put1(&content, '[');
+    ClassFileWriter::Put2(&content, 2);
+    ClassFileWriter::Put1(&content, 'c');
+    ClassFileWriter::Put2(&content, writer->Utf8("Ljava/lang/String;"));
+    ClassFileWriter::Put1(&content, 'c');
+    ClassFileWriter::Put2(&content, writer->Utf8("Ljava/util/Map;"));
+  }
+  PutAttribute(writer, out, "RuntimeVisibleAnnotations", content);
+}
+
+// Appends a Code attribute with "length" bytes of code calling a method, and
+// a LineNumberTable.
+static void PutCode(ClassFileWriter* writer, std::vector<u1>* out, int seed,
+                    int length) {
+  std::vector<u1> content;
+  ClassFileWriter::Put2(&content, 4);  // max_stack
+  ClassFileWriter::Put2(&content, 4);  // max_locals
+  ClassFileWriter::Put4(&content, length);
+  u2 callee = writer->Methodref("bench/Helper" + std::to_string(seed % 13),
+                                "call" + std::to_string(seed % 17),
+                                "(Ljava/lang/String;)V");
+  for (int ii = 0; ii < length / 3; ++ii) {
+    ClassFileWriter::Put1(&content, 0xb8);  // invokestatic
+    ClassFileWriter::Put2(&content, callee);
+  }
+  for (int ii = 0; ii < length % 3; ++ii) {
+    ClassFileWriter::Put1(&content, 0x00);  // nop
+  }
+  ClassFileWriter::Put2(&content, 0);  // exception_table_length
+  ClassFileWriter::Put2(&content, 1);  // attributes_count
+  std::vector<u1> line_numbers;
+  ClassFileWriter::Put2(&line_numbers, length / 8);
+  for (int ii = 0; ii < length / 8; ++ii) {
+    ClassFileWriter::Put2(&line_numbers, ii * 8);  // start_pc
+    ClassFileWriter::Put2(&line_numbers, seed + ii);  // line_number
+  }
+  PutAttribute(writer, &content, "LineNumberTable", line_numbers);
+  PutAttribute(writer, out, "Code", content);
+}
+
+// Generates a class file shaped like a typical application class: generic
+// signatures, annotations, inner classes, constants, private members and
+// method bodies.
+static std::vector<u1> GenerateClass(int index) {
+  ClassFileWriter writer;
+  std::vector<u1>* body = writer.body();
+  std::string name = "bench/pkg" + std::to_string(index % 10) + "/Generated" +
+                     std::to_string(index);
+  const int kInnerClasses = 3;
+  const int kFields = 8;
+  const int kMethods = 16;
+
+  ClassFileWriter::Put2(body, 0x0021);  // ACC_PUBLIC | ACC_SUPER
+  ClassFileWriter::Put2(body, writer.Class(name));
+  ClassFileWriter::Put2(body, writer.Class("java/lang/Object"));
+  ClassFileWriter::Put2(body, 2);  // interfaces_count
+  ClassFileWriter::Put2(body, writer.Class("java/io/Serializable"));
+  ClassFileWriter::Put2(body, writer.Class("java/lang/Comparable"));
+
+  ClassFileWriter::Put2(body, kFields);
+  for (int ii = 0; ii < kFields; ++ii) {
+    std::vector<u1> attributes;
+    int attributes_count = 1;
+    bool is_constant = ii % 4 == 0;
+    // Alternate private and public fields, with a few constants
+    // (public static final).
+    u2 access_flags = ii % 2 ? 0x0002 : 0x0001;  // private or public
+    ClassFileWriter::Put2(body, is_constant ? 0x0019 : access_flags);
+    ClassFileWriter::Put2(body, writer.Utf8("field" + std::to_string(ii)));
+    if (is_constant) {
+      ClassFileWriter::Put2(body, writer.Utf8("I"));
+      std::vector<u1> constant;
+      ClassFileWriter::Put2(&constant, writer.Integer(index * 100 + ii));
+      PutAttribute(&writer, &attributes, "ConstantValue", constant);
+    } else {
+      ClassFileWriter::Put2(body, writer.Utf8("Ljava/util/List;"));
+      PutSignature(&writer, &attributes,
+                   "Ljava/util/List<Ljava/util/Map<Ljava/lang/String;"
+                   "Lbench/pkg" + std::to_string(ii % 10) + "/Generated" +
+                   std::to_string(ii) + ";>;>;");
+      PutAnnotations(&writer, &attributes, index + ii, 1);
+      attributes_count++;
+    }
+    ClassFileWriter::Put2(body, attributes_count);
+    body->insert(body->end(), attributes.begin(), attributes.end());
+  }
+
+  ClassFileWriter::Put2(body, kMethods + 1);
+  for (int ii = 0; ii <= kMethods; ++ii) {
+    std::vector<u1> attributes;
+    int attributes_count = 1;
+    if (ii == kMethods) {
+      ClassFileWriter::Put2(body, 0x0008);  // ACC_STATIC
+      ClassFileWriter::Put2(body, writer.Utf8("<clinit>"));
+      ClassFileWriter::Put2(body, writer.Utf8("()V"));
+    } else {
+      ClassFileWriter::Put2(body, ii % 3 == 2 ? 0x0002 : 0x0001);
+      ClassFileWriter::Put2(body, writer.Utf8("method" + std::to_string(ii)));
+      ClassFileWriter::Put2(body, writer.Utf8("(Ljava/util/Map;"
+                                              "Ljava/lang/Object;)"
+                                              "Ljava/util/List;"));
+      PutSignature(&writer, &attributes,
+                   "<T:Ljava/lang/Object;>(Ljava/util/Map<Ljava/lang/String;"
+                   "TT;>;TT;)Ljava/util/List<+Lbench/pkg" +
+                   std::to_string(ii % 10) + "/Generated" +
+                   std::to_string(ii) + ";>;");
+      std::vector<u1> exceptions;
+      ClassFileWriter::Put2(&exceptions, 1);
+      ClassFileWriter::Put2(&exceptions,
+                            writer.Class("java/io/IOException"));
+      PutAttribute(&writer, &attributes, "Exceptions", exceptions);
+      PutAnnotations(&writer, &attributes, index * kMethods + ii, 2);
+      attributes_count += 3;
+    }
+    PutCode(&writer, &attributes, index + ii,
+            40 + (index * 7 + ii * 13) % 200);
+    ClassFileWriter::Put2(body, attributes_count);
+    body->insert(body->end(), attributes.begin(), attributes.end());
+  }
+
+  std::vector<u1> attributes;
+  std::vector<u1> source_file;
+  ClassFileWriter::Put2(&source_file,
+                        writer.Utf8("Generated" + std::to_string(index) +
+                                    ".java"));
+  PutAttribute(&writer, &attributes, "SourceFile", source_file);
+  PutSignature(&writer, &attributes,
+               "<T:Ljava/lang/Object;>Ljava/lang/Object;"
+               "Ljava/io/Serializable;Ljava/lang/Comparable<TT;>;");
+  PutAnnotations(&writer, &attributes, index, 3);
+  std::vector<u1> inner_classes;
+  ClassFileWriter::Put2(&inner_classes, kInnerClasses);
+  for (int ii = 0; ii < kInnerClasses; ++ii) {
+    std::string inner_name = "Inner" + std::to_string(ii);
+    ClassFileWriter::Put2(&inner_classes,
+                          writer.Class(name + "$" + inner_name));
+    ClassFileWriter::Put2(&inner_classes, writer.Class(name));
+    ClassFileWriter::Put2(&inner_classes, writer.Utf8(inner_name));
+    ClassFileWriter::Put2(&inner_classes, 0x0009);  // ACC_PUBLIC | ACC_STATIC
+  }
+  PutAttribute(&writer, &attributes, "InnerClasses", inner_classes);
+  ClassFileWriter::Put2(body, 4);  // attributes_count
+  body->insert(body->end(), attributes.begin(), attributes.end());
+
+  return writer.Finish();
+}
+
+//
+// Corpus
+//
+
+struct ClassEntry {
+  std::string name;
+  std::vector<u1> data;
+};
+
+// ZipExtractorProcessor collecting the class files of a jar.
+class ClassCollector : public ZipExtractorProcessor {
+ public:
+  explicit ClassCollector(std::vector<ClassEntry>* classes)
+      : classes_(classes) {}
+
+  virtual bool Accept(const char* filename, const u4 attr) {
+    size_t length = strlen(filename);
+    return length > 6 && strcmp(filename + length - 6, ".class") == 0;
+  }
+
+  virtual void Process(const char* filename, const u4 attr, const u1* data,
+                       const size_t size) {
+    ClassEntry entry;
+    entry.name = filename;
+    entry.data.assign(data, data + size);
+    classes_->push_back(entry);
+  }
+
+ private:
+  std::vector<ClassEntry>* classes_;
+};
+
+// Writes "classes" to the jar "filename". Returns false on failure.
+static bool WriteJar(const std::string& filename,
+                     const std::vector<ClassEntry>& classes) {
+  std::vector<const char*> names;
+  for (const ClassEntry& entry : classes) {
+    names.push_back(entry.name.c_str());
+  }
+  u8 size = 22;
+  for (const ClassEntry& entry : classes) {
+    size += entry.data.size() + 88 + 2 * entry.name.size();
+  }
+  ZipBuilder* builder = ZipBuilder::Create(filename.c_str(), size);
+  if (builder == NULL) {
+    return false;
+  }
+  for (const ClassEntry& entry : classes) {
+    u1* q = builder->NewFile(entry.name.c_str(), 0);
+    memcpy(q, entry.data.data(), entry.data.size());
+    builder->FinishFile(entry.data.size(), true);
+  }
+  bool ok = builder->Finish() == 0;
+  delete builder;
+  return ok;
+}
+
+//
+// Benchmarks
+//
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void Report(const char* name, size_t classes, size_t bytes,
+                   size_t allocations_count, double seconds) {
+  fprintf(stdout,
+          "%-32s %8zu classes %10.0f classes/s %8.1f MB/s "
+          "%8.1f allocations/class\n",
+          name, classes, classes / seconds, bytes / seconds / (1 << 20),
+          static_cast<double>(allocations_count) / classes);
+}
+
+// Runs StripClass on every class of "classes", "iterations" times.
+static void BenchmarkStripClass(const char* name,
+                                const std::vector<ClassEntry>& classes,
+                                int iterations) {
+  if (classes.empty()) {
+    return;
+  }
+  size_t max_size = 0;
+  size_t bytes = 0;
+  for (const ClassEntry& entry : classes) {
+    max_size = std::max(max_size, entry.data.size());
+    bytes += entry.data.size();
+  }
+  std::vector<u1> output(max_size);
+
+  size_t allocations_before = allocations;
+  Clock::time_point start = Clock::now();
+  for (int ii = 0; ii < iterations; ++ii) {
+    for (const ClassEntry& entry : classes) {
+      u1* out = output.data();
+      StripClass(out, entry.data.data(), entry.data.size());
+    }
+  }
+  double seconds = SecondsSince(start);
+  Report(name, classes.size() * iterations, bytes * iterations,
+         allocations - allocations_before, seconds);
+}
+
+// Runs OpenFilesAndProcessJar on "jar", which contains "classes",
+// "iterations" times.
+static void BenchmarkJar(const char* name, const std::string& jar,
+                         const std::string& output,
+                         const std::vector<ClassEntry>& classes,
+                         int iterations) {
+  if (classes.empty()) {
+    return;
+  }
+  size_t bytes = 0;
+  for (const ClassEntry& entry : classes) {
+    bytes += entry.data.size();
+  }
+
+  size_t allocations_before = allocations;
+  Clock::time_point start = Clock::now();
+  for (int ii = 0; ii < iterations; ++ii) {
+    OpenFilesAndProcessJar(output.c_str(), jar.c_str(), false, 1);
+  }
+  double seconds = SecondsSince(start);
+  Report(name, classes.size() * iterations, bytes * iterations,
+         allocations - allocations_before, seconds);
+}
+
+// Reads the classes of "jar" into "classes". Returns false on failure.
+static bool ReadJar(const char* jar, std::vector<ClassEntry>* classes) {
+  ClassCollector collector(classes);
+  ZipExtractor* extractor = ZipExtractor::Create(jar, &collector);
+  if (extractor == NULL) {
+    return false;
+  }
+  bool ok = extractor->ProcessAll() == 0;
+  if (!ok) {
+    fprintf(stderr, "%s: %s\n", jar, extractor->GetError());
+  }
+  delete extractor;
+  return ok;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "Usage: ijar_benchmark [--classes N] [--iterations N] "
+          "[--tmpdir DIR] [x.jar ...]\n");
+  exit(1);
+}
+
+int Main(int argc, char** argv) {
+  int class_count = 2000;
+  int iterations = 10;
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  if (tmpdir == NULL) {
+    tmpdir = getenv("TMPDIR");
+  }
+  if (tmpdir == NULL) {
+    tmpdir = "/tmp";
+  }
+  std::vector<const char*> jars;
+  for (int ii = 1; ii < argc; ++ii) {
+    if (strcmp(argv[ii], "--classes") == 0 && ii + 1 < argc) {
+      class_count = atoi(argv[++ii]);
+    } else if (strcmp(argv[ii], "--iterations") == 0 && ii + 1 < argc) {
+      iterations = atoi(argv[++ii]);
+    } else if (strcmp(argv[ii], "--tmpdir") == 0 && ii + 1 < argc) {
+      tmpdir = argv[++ii];
+    } else if (argv[ii][0] == '-') {
+      usage();
+    } else {
+      jars.push_back(argv[ii]);
+    }
+  }
+  if (class_count <= 0 || iterations <= 0) {
+    usage();
+  }
+
+  std::string prefix =
+      std::string(tmpdir) + "/ijar_benchmark." + std::to_string(getpid());
+  std::string output = prefix + "-interface.jar";
+
+  // Generated classes.
+  std::vector<ClassEntry> generated;
+  for (int ii = 0; ii < class_count; ++ii) {
+    ClassEntry entry;
+    entry.name = "bench/Generated" + std::to_string(ii) + ".class";
+    entry.data = GenerateClass(ii);
+    generated.push_back(entry);
+  }
+  std::string generated_jar = prefix + "-generated.jar";
+  if (!WriteJar(generated_jar, generated)) {
+    fprintf(stderr, "Unable to write %s: %s\n", generated_jar.c_str(),
+            strerror(errno));
+    return 1;
+  }
+
+  // Stripped versions of the generated classes, to measure the cost of
+  // processing interface jars.
+  OpenFilesAndProcessJar(output.c_str(), generated_jar.c_str(), false, 1);
+  std::string stripped_jar = prefix + "-stripped.jar";
+  if (rename(output.c_str(), stripped_jar.c_str()) != 0) {
+    fprintf(stderr, "Unable to rename %s: %s\n", output.c_str(),
+            strerror(errno));
+    return 1;
+  }
+  std::vector<ClassEntry> stripped;
+  if (!ReadJar(stripped_jar.c_str(), &stripped)) {
+    return 1;
+  }
+
+  BenchmarkStripClass("StripClass(generated)", generated, iterations);
+  BenchmarkStripClass("StripClass(stripped)", stripped, iterations);
+  BenchmarkJar("ProcessJar(generated)", generated_jar, output, generated,
+               iterations);
+  BenchmarkJar("ProcessJar(stripped)", stripped_jar, output, stripped,
+               iterations);
+
+  // Real-world classes.
+  for (const char* jar : jars) {
+    std::vector<ClassEntry> classes;
+    if (!ReadJar(jar, &classes)) {
+      return 1;
+    }
+    std::string name = std::string("StripClass(") + jar + ")";
+    BenchmarkStripClass(name.c_str(), classes, iterations);
+    name = std::string("ProcessJar(") + jar + ")";
+    BenchmarkJar(name.c_str(), jar, output, classes, iterations);
+  }
+
+  unlink(generated_jar.c_str());
+  unlink(stripped_jar.c_str());
+  unlink(output.c_str());
+  return 0;
+}
+
+}  // namespace devtools_ijar
+
+int main(int argc, char** argv) {
+  return devtools_ijar::Main(argc, argv);
+}
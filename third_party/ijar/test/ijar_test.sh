@@ -540,4 +540,57 @@ function test_central_dir_zip64() {
   $ZIP_COUNT $TEST_TMPDIR/ijar.jar 70000 || fail
 }
 
+function test_batch_mode() {
+  # Check that batch mode produces the same interface jars as processing each
+  # jar separately, both serially and in parallel.
+  $IJAR $TYPEANN2_JAR $TEST_TMPDIR/typeann2.jar || fail "ijar failed"
+  $IJAR $INVOKEDYNAMIC_JAR $TEST_TMPDIR/invokedynamic.jar || fail "ijar failed"
+  $IJAR $METHODPARAM_JAR $TEST_TMPDIR/methodparam.jar || fail "ijar failed"
+
+  for jobs in 1 3; do
+    cat >$TEST_TMPDIR/batch <<EOF
+$TYPEANN2_JAR $TEST_TMPDIR/typeann2-batch.jar
+
+$INVOKEDYNAMIC_JAR   $TEST_TMPDIR/invokedynamic-batch.jar
+$METHODPARAM_JAR $TEST_TMPDIR/methodparam-batch.jar
+EOF
+    $IJAR -j $jobs @$TEST_TMPDIR/batch || fail "ijar -j $jobs failed"
+    for jar in typeann2 invokedynamic methodparam; do
+      cmp $TEST_TMPDIR/$jar.jar $TEST_TMPDIR/$jar-batch.jar ||
+        fail "$jar: batch mode output differs with $jobs jobs"
+    done
+  done
+
+  echo "$TYPEANN2_JAR" >$TEST_TMPDIR/batch
+  $IJAR @$TEST_TMPDIR/batch >& $TEST_log && fail "ijar should have failed"
+  expect_log "expected 'input.jar output.jar'"
+}
+
+function test_compressed_output() {
+  # Check that --compress produces a smaller, valid jar with the same classes,
+  # and that parallel compression does not change the output.
+  $IJAR $TYPEANN2_JAR $TEST_TMPDIR/stored.jar || fail "ijar failed"
+  $IJAR --compress $TYPEANN2_JAR $TEST_TMPDIR/deflated.jar ||
+    fail "ijar --compress failed"
+  $IJAR --compress -j 3 $TYPEANN2_JAR $TEST_TMPDIR/deflated-parallel.jar ||
+    fail "ijar --compress -j 3 failed"
+  cmp $TEST_TMPDIR/deflated.jar $TEST_TMPDIR/deflated-parallel.jar ||
+    fail "parallel compression changed the output"
+
+  [[ $(statfmt $TEST_TMPDIR/deflated.jar) -lt \
+     $(statfmt $TEST_TMPDIR/stored.jar) ]] ||
+    fail "compressed interface jar should be smaller"
+  $UNZIP -tq $TEST_TMPDIR/deflated.jar >& $TEST_log ||
+    fail "compressed interface jar is invalid"
+  $UNZIP -v $TEST_TMPDIR/deflated.jar >& $TEST_log || fail "unzip failed"
+  expect_log "Defl:N"
+
+  mkdir -p $TEST_TMPDIR/stored $TEST_TMPDIR/deflated
+  $UNZIP -q $TEST_TMPDIR/stored.jar -d $TEST_TMPDIR/stored || fail "unzip failed"
+  $UNZIP -q $TEST_TMPDIR/deflated.jar -d $TEST_TMPDIR/deflated ||
+    fail "unzip failed"
+  diff -r $TEST_TMPDIR/stored $TEST_TMPDIR/deflated ||
+    fail "compressed interface jar has different contents"
+}
+
 run_suite "ijar tests"
@@ -168,4 +168,37 @@ function test_zipper_specify_path() {
       || fail "Unzip after zipper output is not expected"
 }
 
+function test_zipper_parallel() {
+  mkdir -p ${TEST_TMPDIR}/test/a/b ${TEST_TMPDIR}/test/c
+  for i in $(seq 1 100); do
+    seq 1 ${i} > ${TEST_TMPDIR}/test/a/b/file${i}
+    echo "file${i}" > ${TEST_TMPDIR}/test/c/file${i}
+  done
+  chmod +x ${TEST_TMPDIR}/test/c/file1
+  touch ${TEST_TMPDIR}/test/empty_file
+  local filelist="$(cd ${TEST_TMPDIR}/test && find . | sed 's|^./||' \
+      | grep -v '^.$')"
+
+  # The zip file must not depend on the number of threads.
+  (cd ${TEST_TMPDIR}/test && $ZIPPER cC ${TEST_TMPDIR}/serial.zip ${filelist})
+  (cd ${TEST_TMPDIR}/test \
+      && $ZIPPER cC ${TEST_TMPDIR}/parallel.zip -j 4 ${filelist})
+  cmp ${TEST_TMPDIR}/serial.zip ${TEST_TMPDIR}/parallel.zip \
+      || fail "Zipper output depends on the number of threads"
+
+  rm -fr ${TEST_TMPDIR}/out
+  mkdir -p ${TEST_TMPDIR}/out
+  (cd ${TEST_TMPDIR}/out && $ZIPPER x ${TEST_TMPDIR}/parallel.zip -j 4)
+  diff -r ${TEST_TMPDIR}/test ${TEST_TMPDIR}/out &> $TEST_log \
+      || fail "Parallel extraction differ from the zipped files"
+
+  rm -fr ${TEST_TMPDIR}/out
+  mkdir -p ${TEST_TMPDIR}/out
+  (cd ${TEST_TMPDIR} && $ZIPPER x parallel.zip -d out -j 4 a/b/file7 c/file1)
+  diff ${TEST_TMPDIR}/test/a/b/file7 ${TEST_TMPDIR}/out/a/b/file7 \
+      &> $TEST_log || fail "Parallel extraction to directory failed"
+  [[ -x ${TEST_TMPDIR}/out/c/file1 ]] || fail "c/file1 is not executable"
+  [[ ! -e ${TEST_TMPDIR}/out/c/file2 ]] || fail "c/file2 was extracted"
+}
+
 run_suite "zipper tests"
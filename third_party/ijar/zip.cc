@@ -81,7 +81,8 @@ static const u4 kDosEpoch = 1 << 21 | 1 << 16;  // January 1, 1980 in DOS time
 //
 class InputZipFile : public ZipExtractor {
  public:
-  InputZipFile(ZipExtractorProcessor *processor, const char* filename);
+  InputZipFile(ZipExtractorProcessor *processor, const char* filename,
+               Decompressor *decompressor);
   virtual ~InputZipFile();
 
   virtual const char* GetError() {
@@ -93,6 +94,8 @@ class InputZipFile : public ZipExtractor {
 
   bool Open();
   virtual bool ProcessNext();
+  virtual int ListAll();
+  virtual int ProcessEntry(const char* filename);
   virtual void Reset();
   virtual size_t GetSize() {
     return input_file_->Length();
@@ -162,6 +165,9 @@ class InputZipFile : public ZipExtractor {
   char errmsg[4*PATH_MAX];
 
   Decompressor *decompressor_;
+  // Whether decompressor_ was allocated by (and must be freed with) this
+  // object, as opposed to being shared with other InputZipFiles.
+  bool owns_decompressor_;
 
   int error(const char *fmt, ...) {
     va_list ap;
@@ -185,8 +191,10 @@ class InputZipFile : public ZipExtractor {
     return 0;
   }
 
-  // Read one entry from input zip file
-  int ProcessLocalFileEntry(size_t compressed_size, size_t uncompressed_size);
+  // Read one entry from input zip file, processing its content if "accept"
+  // is true and skipping it otherwise.
+  int ProcessLocalFileEntry(size_t compressed_size, size_t uncompressed_size,
+                            bool accept);
 
   // Uncompress a file from the archive using zlib. The pointer returned
   // is owned by InputZipFile, so it must not be freed. Advances the input
@@ -224,6 +232,8 @@ class OutputZipFile : public ZipBuilder {
   virtual u1* NewFile(const char* filename, const u4 attr);
   virtual int FinishFile(size_t filelength, bool compress = false,
                          bool compute_crc = false);
+  virtual int FinishCompressedFile(size_t compressed_length,
+                                   size_t uncompressed_length, u4 crc = 0);
   virtual int WriteEmptyFile(const char *filename);
   virtual size_t GetSize() {
     return Offset(q);
@@ -306,10 +316,10 @@ class OutputZipFile : public ZipBuilder {
 
   // Fill in the "compressed size" and "uncompressed size" fields in a local
   // file header previously written by WriteLocalFileHeader().
-  size_t WriteFileSizeInLocalFileHeader(u1 *header_ptr,
-                                        size_t out_length,
-                                        bool compress = false,
-                                        const u4 crc = 0);
+  void WriteFileSizeInLocalFileHeader(u1 *header_ptr,
+                                      size_t compressed_length,
+                                      size_t uncompressed_length,
+                                      const u4 crc = 0);
 };
 
 //
@@ -336,7 +346,8 @@ bool InputZipFile::ProcessNext() {
   }
   u4 signature = get_u4le(p);
   if (signature == LOCAL_FILE_HEADER_SIGNATURE) {
-    if (ProcessLocalFileEntry(compressed, uncompressed) < 0) {
+    if (ProcessLocalFileEntry(compressed, uncompressed,
+                              processor->Accept(filename, attr)) < 0) {
       return false;
     }
   } else {
@@ -344,11 +355,56 @@ bool InputZipFile::ProcessNext() {
     return false;
   }
 
+  size_t bytes_processed = p - zipdata_in_;
+  if (bytes_processed > bytes_unmapped_ + MAX_MAPPED_REGION) {
+    input_file_->Discard(MAX_MAPPED_REGION);
+    bytes_unmapped_ += MAX_MAPPED_REGION;
+  }
+
   return true;
 }
 
+int InputZipFile::ListAll() {
+  const u1* current = central_dir_;
+  size_t compressed, uncompressed;
+  u4 offset;
+  while (ProcessCentralDirEntry(current, &compressed, &uncompressed, filename,
+                                PATH_MAX, &attr, &offset)) {
+    processor->Accept(filename, attr);
+  }
+  if (GetError() != NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+int InputZipFile::ProcessEntry(const char* entry) {
+  const u1* current = central_dir_;
+  size_t compressed, uncompressed;
+  u4 offset;
+  while (ProcessCentralDirEntry(current, &compressed, &uncompressed, filename,
+                                PATH_MAX, &attr, &offset)) {
+    if (strcmp(filename, entry) != 0) {
+      continue;
+    }
+    p = zipdata_in_ + in_offset_ + offset;
+    if (EnsureRemaining(4, "signature") < 0) {
+      return -1;
+    }
+    if (get_u4le(p) != LOCAL_FILE_HEADER_SIGNATURE) {
+      return error("local file header signature for file %s not found\n",
+                   filename);
+    }
+    return ProcessLocalFileEntry(compressed, uncompressed, true);
+  }
+  if (GetError() != NULL) {
+    return -1;
+  }
+  return error("%s not found in the zip file\n", entry);
+}
+
 int InputZipFile::ProcessLocalFileEntry(
-    size_t compressed_size, size_t uncompressed_size) {
+    size_t compressed_size, size_t uncompressed_size, bool accept) {
   if (EnsureRemaining(26, "extract_version") < 0) {
     return -1;
   }
@@ -409,7 +465,7 @@ int InputZipFile::ProcessLocalFileEntry(
     }
   }
 
-  if (processor->Accept(filename, attr)) {
+  if (accept) {
     if (ProcessFile(is_compressed) < 0) {
       return -1;
     }
@@ -432,12 +488,6 @@ int InputZipFile::ProcessLocalFileEntry(
     }
   }
 
-  size_t bytes_processed = p - zipdata_in_;
-  if (bytes_processed > bytes_unmapped_ + MAX_MAPPED_REGION) {
-    input_file_->Discard(MAX_MAPPED_REGION);
-    bytes_unmapped_ += MAX_MAPPED_REGION;
-  }
-
   return 0;
 }
 
@@ -793,7 +843,13 @@ int ZipExtractor::ProcessAll() {
 
 ZipExtractor* ZipExtractor::Create(const char* filename,
                                    ZipExtractorProcessor *processor) {
-  InputZipFile* result = new InputZipFile(processor, filename);
+  return Create(filename, processor, NULL);
+}
+
+ZipExtractor* ZipExtractor::Create(const char* filename,
+                                   ZipExtractorProcessor *processor,
+                                   Decompressor *decompressor) {
+  InputZipFile* result = new InputZipFile(processor, filename, decompressor);
   if (!result->Open()) {
     fprintf(stderr, "%s\n", result->GetError());
     delete result;
@@ -806,10 +862,14 @@ ZipExtractor* ZipExtractor::Create(const char* filename,
 // zipdata_in_, in_offset_, p, central_dir_current_
 
 InputZipFile::InputZipFile(ZipExtractorProcessor *processor,
-                           const char* filename)
+                           const char* filename,
+                           Decompressor *decompressor)
     : processor(processor), filename_(filename), input_file_(NULL),
-      bytes_unmapped_(0) {
-  decompressor_ = new Decompressor();
+      bytes_unmapped_(0), decompressor_(decompressor),
+      owns_decompressor_(decompressor == NULL) {
+  if (owns_decompressor_) {
+    decompressor_ = new Decompressor();
+  }
   errmsg[0] = 0;
 }
 
@@ -848,7 +908,9 @@ bool InputZipFile::Open() {
 }
 
 InputZipFile::~InputZipFile() {
-  delete decompressor_;
+  if (owns_decompressor_) {
+    delete decompressor_;
+  }
   if (input_file_ != NULL) {
     input_file_->Close();
     delete input_file_;
@@ -1009,25 +1071,20 @@ u1* OutputZipFile::WriteLocalFileHeader(const char* filename, const u4 attr) {
   return header_ptr;
 }
 
-size_t OutputZipFile::WriteFileSizeInLocalFileHeader(u1 *header_ptr,
-                                                     size_t out_length,
-                                                     bool compress,
-                                                     const u4 crc) {
-  size_t compressed_size = out_length;
-  if (compress) {
-    compressed_size = TryDeflate(q, out_length);
-  }
+void OutputZipFile::WriteFileSizeInLocalFileHeader(u1 *header_ptr,
+                                                   size_t compressed_length,
+                                                   size_t uncompressed_length,
+                                                   const u4 crc) {
   // compression method
-  if (compressed_size < out_length) {
+  if (compressed_length < uncompressed_length) {
     put_u2le(header_ptr, COMPRESSION_METHOD_DEFLATED);
   } else {
     put_u2le(header_ptr, COMPRESSION_METHOD_STORED);
   }
   header_ptr += 4;
-  put_u4le(header_ptr, crc);              // crc32
-  put_u4le(header_ptr, compressed_size);  // compressed_size
-  put_u4le(header_ptr, out_length);       // uncompressed_size
-  return compressed_size;
+  put_u4le(header_ptr, crc);                  // crc32
+  put_u4le(header_ptr, compressed_length);    // compressed_size
+  put_u4le(header_ptr, uncompressed_length);  // uncompressed_size
 }
 
 int OutputZipFile::Finish() {
@@ -1061,23 +1118,37 @@ int OutputZipFile::FinishFile(size_t filelength, bool compress,
       return -1;
     }
   }
-  size_t compressed_size =
-      WriteFileSizeInLocalFileHeader(header_ptr, filelength, compress, crc);
+  size_t compressed_size = filelength;
+  if (compress) {
+    compressed_size = TryDeflate(q, filelength);
+  }
 
   if (compressed_size == 0 && filelength > 0) {
     fprintf(stderr, "Error compressing files.\n");
     return -1;
   }
 
+  return FinishCompressedFile(compressed_size, filelength, crc);
+}
+
+int OutputZipFile::FinishCompressedFile(size_t compressed_length,
+                                        size_t uncompressed_length, u4 crc) {
+  if (compressed_length > uncompressed_length) {
+    return error("compressed size (%zd) > uncompressed size (%zd).\n",
+                 compressed_length, uncompressed_length);
+  }
+  WriteFileSizeInLocalFileHeader(header_ptr, compressed_length,
+                                 uncompressed_length, crc);
+
   entries_.back()->crc32 = crc;
-  entries_.back()->compressed_length = compressed_size;
-  entries_.back()->uncompressed_length = filelength;
-  if (compressed_size < filelength) {
+  entries_.back()->compressed_length = compressed_length;
+  entries_.back()->uncompressed_length = uncompressed_length;
+  if (compressed_length < uncompressed_length) {
     entries_.back()->compression_method = COMPRESSION_METHOD_DEFLATED;
   } else {
     entries_.back()->compression_method = COMPRESSION_METHOD_STORED;
   }
-  q += compressed_size;
+  q += compressed_length;
   return 0;
 }
 
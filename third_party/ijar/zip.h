@@ -26,6 +26,8 @@
 
 namespace devtools_ijar {
 
+class Decompressor;
+
 // Tells if this is a directory entry from the mode. This method
 // is safer than zipattr_to_mode(attr) & S_IFDIR because the unix
 // mode might not be set in DOS zip files.
@@ -65,6 +67,17 @@ class ZipBuilder {
                          bool compress = false,
                          bool compute_crc = false) = 0;
 
+  // Finish writing a file whose data was already compressed by the caller
+  // using TryDeflate(), e.g. to compress several files in parallel before
+  // writing them in order. "compressed_length" is the size of the data
+  // written to the pointer given by NewFile, "uncompressed_length" is the
+  // size of the original file and "crc" its CRC32 (or 0). The file is
+  // recorded as stored when both lengths are equal.
+  // On failure, returns -1 and GetError() will return an non-empty message.
+  virtual int FinishCompressedFile(size_t compressed_length,
+                                   size_t uncompressed_length,
+                                   u4 crc = 0) = 0;
+
   // Write an empty file, it is equivalent to:
   //   NewFile(filename, 0);
   //   FinishFile(0);
@@ -143,6 +156,20 @@ class ZipExtractor {
   // on error).
   virtual int ProcessAll();
 
+  // Call the processor's Accept() for every file of the ZIP, in order, by
+  // reading only the central directory: neither the local file headers nor
+  // the file contents are touched and Process() is never called. This is much
+  // cheaper than ProcessAll() on a big archive when only the list of files is
+  // needed. Returns -1 on error (GetError() will be populated on error).
+  virtual int ListAll() = 0;
+
+  // Process the file "filename" only: its local file header is located
+  // through the central directory and its content is given to the processor's
+  // Process() method without calling Accept() first. The other files are not
+  // read. Returns -1 if there is no such file or on error (GetError() will be
+  // populated on error). Call Reset() before calling ProcessNext() again.
+  virtual int ProcessEntry(const char* filename) = 0;
+
   // Reset the file pointer to the beginning.
   virtual void Reset() = 0;
 
@@ -162,6 +189,15 @@ class ZipExtractor {
   // checked.
   static ZipExtractor* Create(const char* filename,
                               ZipExtractorProcessor *processor);
+
+  // Same as above, but decompresses entries with "decompressor" instead of
+  // allocating a new one. The decompressor is not owned by the ZipExtractor
+  // and must outlive it. Reusing a decompressor across several ZipExtractors
+  // avoids reallocating its (potentially large) output buffer for every zip
+  // file when processing many files in the same process.
+  static ZipExtractor* Create(const char* filename,
+                              ZipExtractorProcessor *processor,
+                              Decompressor *decompressor);
 };
 
 }  // namespace devtools_ijar
@@ -27,15 +27,40 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <set>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "third_party/ijar/platform_utils.h"
 #include "third_party/ijar/zip.h"
+#include "third_party/ijar/zlib_client.h"
 
 namespace devtools_ijar {
 
+// Upper bound on the amount of file content buffered in memory before it is
+// handed over to the worker threads, both when extracting and creating.
+static const size_t kMaxPendingBytes = 64 * 1024 * 1024;
+
+// Runs "worker" on "jobs" threads and waits for all of them to finish. The
+// worker is run on the calling thread if "jobs" is 1 or less.
+static void RunOnThreads(int jobs, const std::function<void()>& worker) {
+  if (jobs <= 1) {
+    worker();
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (int i = 0; i < jobs; ++i) {
+    threads.push_back(std::thread(worker));
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
 //
 // A ZipExtractorProcessor that extract files in the ZIP file.
 //
@@ -43,11 +68,14 @@ class UnzipProcessor : public ZipExtractorProcessor {
  public:
   // Create a processor who will extract the given files (or all files if NULL)
   // into output_root if "extract" is set to true and will print the list of
-  // files and their unix modes if "verbose" is set to true.
+  // files and their unix modes if "verbose" is set to true. Files are written
+  // by "jobs" threads.
   UnzipProcessor(const char *output_root, char **files, bool verbose,
-                 bool extract) : output_root_(output_root),
-                                 verbose_(verbose),
-                                 extract_(extract) {
+                 bool extract, int jobs) : output_root_(output_root),
+                                           verbose_(verbose),
+                                           extract_(extract),
+                                           jobs_(jobs),
+                                           pending_bytes_(0) {
     if (files != NULL) {
       for (int i = 0; files[i] != NULL; i++) {
         file_names.insert(std::string(files[i]));
@@ -60,20 +88,50 @@ class UnzipProcessor : public ZipExtractorProcessor {
   virtual void Process(const char* filename, const u4 attr,
                        const u1* data, const size_t size);
   virtual bool Accept(const char* filename, const u4 attr) {
-    // All entry files are accepted by default.
-    if (file_names.empty()) {
-      return true;
-    } else {
-      // If users have specified file entries, only accept those files.
-      return file_names.count(std::string(filename)) == 1;
+    // All entry files are accepted by default. If users have specified file
+    // entries, only accept those files.
+    bool accepted =
+        file_names.empty() || file_names.count(std::string(filename)) == 1;
+    // Files are only listed from the central directory when not extracting,
+    // so Process() won't be called for them.
+    if (accepted && verbose_ && !extract_) {
+      Print(filename, attr);
     }
+    return accepted;
   }
 
+  // Writes the files still buffered by Process(). Returns false if any of them
+  // could not be written.
+  bool Flush();
+
  private:
+  // A file whose content is waiting to be written by the worker threads. The
+  // content is copied because the extractor reuses its buffer for the next
+  // deflated entry.
+  struct PendingFile {
+    std::string path;
+    mode_t perm;
+    std::vector<u1> data;
+  };
+
+  // Prints the type, unix mode and name of a file.
+  void Print(const char* filename, const u4 attr);
+
+  // Creates the directories leading to "path", skipping the ones already
+  // created for a previous entry.
+  bool MakeParentDirs(const char *path, mode_t perm);
+
   const char *output_root_;
   const bool verbose_;
   const bool extract_;
+  const int jobs_;
   std::set<std::string> file_names;
+  // Directories already created, so that the many entries of a directory
+  // don't stat all of its ancestors again.
+  std::set<std::string> created_dirs_;
+  std::vector<PendingFile> pending_files_;
+  std::set<std::string> pending_paths_;
+  size_t pending_bytes_;
 };
 
 // Concatene 2 path, path1 and path2, using / as a directory separator and
@@ -94,26 +152,103 @@ void concat_path(char* out, const size_t size,
   }
 }
 
-void UnzipProcessor::Process(const char* filename, const u4 attr,
-                             const u1* data, const size_t size) {
-  mode_t perm = zipattr_to_perm(attr);
-  bool isdir = zipattr_is_dir(attr);
+// Computes the unix permissions of a file of the zip and whether it is a
+// directory from its external attributes "attr".
+static void get_file_mode(const char* filename, const u4 attr, mode_t *perm,
+                          bool *isdir) {
+  *perm = zipattr_to_perm(attr);
+  *isdir = zipattr_is_dir(attr);
   if (attr == 0) {
     // Fallback when the external attribute is not set.
-    isdir = filename[strlen(filename)-1] == '/';
-    perm = 0777;
+    *isdir = filename[strlen(filename)-1] == '/';
+    *perm = 0777;
   }
+}
+
+void UnzipProcessor::Print(const char* filename, const u4 attr) {
+  mode_t perm;
+  bool isdir;
+  get_file_mode(filename, attr, &perm, &isdir);
+  printf("%c %o %s\n", isdir ? 'd' : 'f', perm, filename);
+}
+
+void UnzipProcessor::Process(const char* filename, const u4 attr,
+                             const u1* data, const size_t size) {
+  mode_t perm;
+  bool isdir;
+  get_file_mode(filename, attr, &perm, &isdir);
   if (verbose_) {
-    printf("%c %o %s\n", isdir ? 'd' : 'f', perm, filename);
+    Print(filename, attr);
   }
   if (extract_) {
     char path[PATH_MAX];
     concat_path(path, PATH_MAX, output_root_, filename);
-    if (!make_dirs(path, perm) ||
-        (!isdir && !write_file(path, perm, data, size))) {
+    if (!MakeParentDirs(path, perm)) {
       abort();
     }
+    if (isdir) {
+      return;
+    }
+    if (jobs_ <= 1) {
+      if (!write_file(path, perm, data, size)) {
+        abort();
+      }
+      return;
+    }
+    // Flush the entries already pending if one of them has the same path, so
+    // that the last one wins like when extracting serially.
+    if (!pending_paths_.insert(path).second) {
+      if (!Flush()) {
+        abort();
+      }
+      pending_paths_.insert(path);
+    }
+    PendingFile pending;
+    pending.path = path;
+    pending.perm = perm;
+    pending.data.assign(data, data + size);
+    pending_files_.push_back(std::move(pending));
+    pending_bytes_ += size;
+    if (pending_bytes_ > kMaxPendingBytes && !Flush()) {
+      abort();
+    }
+  }
+}
+
+bool UnzipProcessor::MakeParentDirs(const char *path, mode_t perm) {
+  const char *last_slash = strrchr(path, '/');
+  if (last_slash == NULL) {
+    return true;
+  }
+  std::string dir(path, last_slash - path);
+  if (created_dirs_.count(dir) == 1) {
+    return true;
   }
+  if (!make_dirs(path, perm)) {
+    return false;
+  }
+  created_dirs_.insert(dir);
+  return true;
+}
+
+bool UnzipProcessor::Flush() {
+  // Directories were created by Process(), so files can be written in any
+  // order.
+  std::atomic<size_t> next_file(0);
+  std::atomic<bool> ok(true);
+  RunOnThreads(jobs_, [this, &next_file, &ok]() {
+    for (size_t i = next_file++; i < pending_files_.size(); i = next_file++) {
+      const PendingFile& pending = pending_files_[i];
+      if (!write_file(pending.path.c_str(), pending.perm, pending.data.data(),
+                      pending.data.size())) {
+        ok = false;
+      }
+    }
+  });
+  pending_files_.clear();
+  pending_paths_.clear();
+  pending_bytes_ = 0;
+  return ok;
 }
 
 // Get the basename of path and store it in output. output_size
@@ -131,7 +266,7 @@ void basename(const char *path, char *output, size_t output_size) {
 
 // Execute the extraction (or just listing if just v is provided)
 int extract(char *zipfile, char* exdir, char **files, bool verbose,
-            bool extract) {
+            bool extract, int jobs) {
   std::string cwd = get_cwd();
   if (cwd.empty()) {
     return -1;
@@ -144,7 +279,7 @@ int extract(char *zipfile, char* exdir, char **files, bool verbose,
     strncpy(output_root, cwd.c_str(), PATH_MAX);
   }
 
-  UnzipProcessor processor(output_root, files, verbose, extract);
+  UnzipProcessor processor(output_root, files, verbose, extract, jobs);
   std::unique_ptr<ZipExtractor> extractor(ZipExtractor::Create(zipfile,
                                                                &processor));
   if (extractor.get() == NULL) {
@@ -153,16 +288,39 @@ int extract(char *zipfile, char* exdir, char **files, bool verbose,
     return -1;
   }
 
-  if (extractor->ProcessAll() < 0) {
+  // Listing the files only needs the central directory.
+  int result = extract ? extractor->ProcessAll() : extractor->ListAll();
+  if (result < 0) {
     fprintf(stderr, "%s.\n", extractor->GetError());
     return -1;
   }
+  if (!processor.Flush()) {
+    return -1;
+  }
   return 0;
 }
 
-// add a file to the zip
-int add_file(std::unique_ptr<ZipBuilder> const &builder, char *file,
-             char *zip_path, bool flatten, bool verbose, bool compress) {
+// An entry of the zip file being created.
+struct ZipEntry {
+  // Path of the entry in the zip file.
+  std::string path;
+  u4 attr;
+  // File providing the content of the entry, NULL for an empty file.
+  char *file;
+  // Size of the content, 0 for directories.
+  size_t size;
+  // Content of the entry, possibly deflated, when it is added by
+  // add_entries().
+  std::vector<u1> data;
+  size_t compressed_size;
+  u4 crc;
+};
+
+// Stat the file and compute the path of its entry in the zip. Returns -1 on
+// error, 0 if the file must not be added (directories when flattening) and 1
+// otherwise.
+int prepare_entry(char *file, char *zip_path, bool flatten, bool verbose,
+                  ZipEntry *entry) {
   Stat file_stat = {0, 0666, false};
   if (file != NULL) {
     if (!stat_file(file, &file_stat)) {
@@ -202,18 +360,91 @@ int add_file(std::unique_ptr<ZipBuilder> const &builder, char *file,
     printf("%c %o %s\n", isdir ? 'd' : 'f', perm, path);
   }
 
-  u1 *buffer = builder->NewFile(path, stat_to_zipattr(file_stat));
-  if (isdir || file_stat.total_size == 0) {
+  entry->path = path;
+  entry->attr = stat_to_zipattr(file_stat);
+  entry->file = file;
+  entry->size = isdir ? 0 : file_stat.total_size;
+  return 1;
+}
+
+// add a file to the zip
+int add_file(std::unique_ptr<ZipBuilder> const &builder, char *file,
+             char *zip_path, bool flatten, bool verbose, bool compress) {
+  ZipEntry entry;
+  int result = prepare_entry(file, zip_path, flatten, verbose, &entry);
+  if (result <= 0) {
+    return result;
+  }
+
+  u1 *buffer = builder->NewFile(entry.path.c_str(), entry.attr);
+  if (entry.size == 0) {
     builder->FinishFile(0);
   } else {
-    if (!read_file(file, buffer, file_stat.total_size)) {
+    if (!read_file(file, buffer, entry.size)) {
       return -1;
     }
-    builder->FinishFile(file_stat.total_size, compress, true);
+    builder->FinishFile(entry.size, compress, true);
   }
   return 0;
 }
 
+// Add the entries to the zip. Files are read, checksummed and compressed by
+// "jobs" threads, then written to the zip in the order of "entries" so that
+// the output does not depend on the number of threads.
+int add_entries(std::unique_ptr<ZipBuilder> const &builder,
+                std::vector<ZipEntry> *entries, bool compress, int jobs) {
+  std::atomic<size_t> next_entry(0);
+  std::atomic<bool> ok(true);
+  RunOnThreads(jobs, [entries, compress, &next_entry, &ok]() {
+    for (size_t i = next_entry++; i < entries->size(); i = next_entry++) {
+      ZipEntry &entry = (*entries)[i];
+      if (entry.size == 0) {
+        continue;
+      }
+      entry.data.resize(entry.size);
+      if (!read_file(entry.file, entry.data.data(), entry.size)) {
+        ok = false;
+        continue;
+      }
+      entry.crc = ComputeCrcChecksum(entry.data.data(), entry.size);
+      if (entry.crc == 0) {
+        fprintf(stderr, "Error calculating CRC32 checksum.\n");
+        ok = false;
+        continue;
+      }
+      entry.compressed_size = entry.size;
+      if (compress) {
+        entry.compressed_size = TryDeflate(entry.data.data(), entry.size);
+        if (entry.compressed_size == 0) {
+          fprintf(stderr, "Error compressing files.\n");
+          ok = false;
+        }
+      }
+    }
+  });
+  if (!ok) {
+    return -1;
+  }
+
+  for (ZipEntry &entry : *entries) {
+    u1 *buffer = builder->NewFile(entry.path.c_str(), entry.attr);
+    int result;
+    if (entry.size == 0) {
+      result = builder->FinishFile(0);
+    } else {
+      memcpy(buffer, entry.data.data(), entry.compressed_size);
+      result = builder->FinishCompressedFile(entry.compressed_size, entry.size,
+                                             entry.crc);
+    }
+    if (result < 0) {
+      fprintf(stderr, "%s\n", builder->GetError());
+      return -1;
+    }
+  }
+  entries->clear();
+  return 0;
+}
+
 // Read a list of files separated by newlines. The resulting array can be
 // freed using the free method.
 char **read_filelist(char *filename) {
@@ -295,7 +526,7 @@ char **parse_filelist(char *zipfile, char **file_entries, int nb_entries,
 
 // Execute the create operation
 int create(char *zipfile, char **file_entries, bool flatten, bool verbose,
-           bool compress) {
+           bool compress, int jobs) {
   int nb_entries = 0;
   while (file_entries[nb_entries] != NULL) {
     nb_entries++;
@@ -317,9 +548,35 @@ int create(char *zipfile, char **file_entries, bool flatten, bool verbose,
     return -1;
   }
 
-  for (int i = 0; i < nb_entries; i++) {
-    if (add_file(builder, files[i], zip_paths[i], flatten, verbose, compress) <
-        0) {
+  if (jobs <= 1) {
+    for (int i = 0; i < nb_entries; i++) {
+      if (add_file(builder, files[i], zip_paths[i], flatten, verbose,
+                   compress) < 0) {
+        return -1;
+      }
+    }
+  } else {
+    std::vector<ZipEntry> entries;
+    size_t pending_bytes = 0;
+    for (int i = 0; i < nb_entries; i++) {
+      ZipEntry entry;
+      int result = prepare_entry(files[i], zip_paths[i], flatten, verbose,
+                                 &entry);
+      if (result < 0) {
+        return -1;
+      } else if (result == 0) {
+        continue;
+      }
+      pending_bytes += entry.size;
+      entries.push_back(std::move(entry));
+      if (pending_bytes > kMaxPendingBytes) {
+        if (add_entries(builder, &entries, compress, jobs) < 0) {
+          return -1;
+        }
+        pending_bytes = 0;
+      }
+    }
+    if (add_entries(builder, &entries, compress, jobs) < 0) {
       return -1;
     }
   }
@@ -337,7 +594,8 @@ int create(char *zipfile, char **file_entries, bool flatten, bool verbose,
 //
 static void usage(char *progname) {
   fprintf(stderr,
-          "Usage: %s [vxc[fC]] x.zip [-d exdir] [[zip_path1=]file1 ... "
+          "Usage: %s [vxc[fC]] x.zip [-d exdir] [-j jobs] "
+          "[[zip_path1=]file1 ... "
           "[zip_pathn=]filen]\n",
           progname);
   fprintf(stderr, "  v verbose - list all file in x.zip\n");
@@ -349,6 +607,9 @@ static void usage(char *progname) {
   fprintf(stderr, "  f flatten - flatten files to use with create operation\n");
   fprintf(stderr,
           "  C compress - compress files when using the create operation\n");
+  fprintf(stderr,
+          "  -j jobs - number of threads writing the extracted files, or\n"
+          "    reading and compressing the files of the create operation\n");
   fprintf(stderr, "x and c cannot be used in the same command-line.\n");
   fprintf(stderr,
           "\nFor every file, a path in the zip can be specified. Examples:\n");
@@ -402,12 +663,23 @@ int main(int argc, char **argv) {
     usage(argv[0]);
   }
 
-  // Calculate the argument index of the first entry file.
-  int filelist_start_index;
-  if (argc > 3 && strcmp(argv[3], "-d") == 0) {
-    filelist_start_index = 5;
-  } else {
-    filelist_start_index = 3;
+  // Parse the options following the zip file, and calculate the argument
+  // index of the first entry file.
+  char* exdir = NULL;
+  int jobs = 1;
+  int filelist_start_index = 3;
+  while (argc > filelist_start_index + 1) {
+    if (strcmp(argv[filelist_start_index], "-d") == 0) {
+      exdir = argv[filelist_start_index + 1];
+    } else if (strcmp(argv[filelist_start_index], "-j") == 0) {
+      jobs = atoi(argv[filelist_start_index + 1]);
+      if (jobs < 1) {
+        usage(argv[0]);
+      }
+    } else {
+      break;
+    }
+    filelist_start_index += 2;
   }
 
   char** filelist = NULL;
@@ -436,18 +708,15 @@ int main(int argc, char **argv) {
 
   if (create) {
     // Create a zip
-    return devtools_ijar::create(argv[2], filelist, flatten, verbose, compress);
+    return devtools_ijar::create(argv[2], filelist, flatten, verbose, compress,
+                                 jobs);
   } else {
     if (flatten) {
       usage(argv[0]);
     }
 
-    char* exdir = NULL;
-    if (argc > 3 && strcmp(argv[3], "-d") == 0) {
-      exdir = argv[4];
-    }
-
     // Extraction / list mode
-    return devtools_ijar::extract(argv[2], exdir, filelist, verbose, extract);
+    return devtools_ijar::extract(argv[2], exdir, filelist, verbose, extract,
+                                  jobs);
   }
 }
@@ -27,42 +27,73 @@ u4 ComputeCrcChecksum(u1 *buf, size_t length) {
 }
 
 size_t TryDeflate(u1 *buf, size_t length) {
-  u1 *outbuf = reinterpret_cast<u1 *>(malloc(length));
-  z_stream stream;
+  static thread_local Compressor compressor;
+  return compressor.TryDeflate(buf, length);
+}
 
-  // Initialize the z_stream strcut for reading from buf and wrinting in outbuf.
-  stream.zalloc = Z_NULL;
-  stream.zfree = Z_NULL;
-  stream.opaque = Z_NULL;
-  stream.total_in = length;
-  stream.avail_in = length;
-  stream.total_out = length;
-  stream.avail_out = length;
-  stream.next_in = buf;
-  stream.next_out = outbuf;
+Compressor::Compressor()
+    : stream_(new z_stream), compressed_data_(NULL),
+      compressed_data_allocated_(0) {
+  stream_->zalloc = Z_NULL;
+  stream_->zfree = Z_NULL;
+  stream_->opaque = Z_NULL;
 
   // deflateInit2 negative windows size prevent the zlib wrapper to be used.
-  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+  if (deflateInit2(stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
                    Z_DEFAULT_STRATEGY) != Z_OK) {
-    // Failure to compress => return the buffer uncompressed
-    free(outbuf);
-    return length;
+    delete stream_;
+    stream_ = NULL;
+  }
+}
+
+Compressor::~Compressor() {
+  if (stream_ != NULL) {
+    deflateEnd(stream_);
+    delete stream_;
   }
+  free(compressed_data_);
+}
 
-  if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
-    // Compression successful and fits in outbuf, let's copy the result in buf.
-    length = stream.total_out;
-    memcpy(buf, outbuf, length);
+size_t Compressor::TryDeflate(u1 *buf, size_t length) {
+  if (stream_ == NULL || length == 0) {
+    // Failure to initialize => return the buffer uncompressed
+    return length;
+  }
+  if (length > compressed_data_allocated_) {
+    u1 *compressed_data =
+        reinterpret_cast<u1 *>(realloc(compressed_data_, length));
+    if (compressed_data == NULL) {
+      // Out of memory => return the buffer uncompressed
+      return length;
+    }
+    compressed_data_ = compressed_data;
+    compressed_data_allocated_ = length;
   }
 
-  deflateEnd(&stream);
-  free(outbuf);
+  // Set up the z_stream struct for reading from buf and writing in
+  // compressed_data_. Output is limited to one byte less than the input size,
+  // so that compression fails if it would not make the file smaller: a result
+  // as large as the input is stored, and must not hold deflated data.
+  deflateReset(stream_);
+  stream_->avail_in = length;
+  stream_->avail_out = length - 1;
+  stream_->next_in = buf;
+  stream_->next_out = compressed_data_;
+
+  if (deflate(stream_, Z_FINISH) == Z_STREAM_END &&
+      stream_->total_out < length) {
+    // Compression successful and fits in the output buffer, let's copy the
+    // result in buf.
+    length = stream_->total_out;
+    memcpy(buf, compressed_data_, length);
+  }
 
   // Return the length of the resulting buffer
   return length;
 }
 
 Decompressor::Decompressor() {
+  errmsg[0] = 0;
   uncompressed_data_allocated_ = INITIAL_BUFFER_SIZE;
   uncompressed_data_ =
       reinterpret_cast<u1 *>(malloc(uncompressed_data_allocated_));
@@ -123,13 +154,20 @@ DecompressedFile *Decompressor::UncompressFile(const u1 *buffer,
           return NULL;
         }
 
-        uncompressed_data_allocated_ *= 2;
-        if (uncompressed_data_allocated_ > MAX_BUFFER_SIZE) {
-          uncompressed_data_allocated_ = MAX_BUFFER_SIZE;
+        size_t allocated = uncompressed_data_allocated_ * 2;
+        if (allocated > MAX_BUFFER_SIZE) {
+          allocated = MAX_BUFFER_SIZE;
         }
 
-        uncompressed_data_ = reinterpret_cast<u1 *>(
-            realloc(uncompressed_data_, uncompressed_data_allocated_));
+        u1 *uncompressed_data =
+            reinterpret_cast<u1 *>(realloc(uncompressed_data_, allocated));
+        if (uncompressed_data == NULL) {
+          error("ijar ran out of memory decompressing a file.\n");
+          inflateEnd(&stream);
+          return NULL;
+        }
+        uncompressed_data_ = uncompressed_data;
+        uncompressed_data_allocated_ = allocated;
         break;
       }
 
@@ -16,14 +16,19 @@
 #define THIRD_PARTY_IJAR_ZLIB_CLIENT_H_
 
 #include <limits.h>
+#include <limits>
 
 #include "third_party/ijar/common.h"
 
+struct z_stream_s;
+
 namespace devtools_ijar {
 // Try to compress a file entry in memory using the deflate algorithm.
 // It will compress buf (of size length) unless the compressed size is bigger
 // than the input size. The result will overwrite the content of buf and the
 // final size is returned.
+// This uses a Compressor private to the calling thread, so it is safe to call
+// concurrently from several threads.
 size_t TryDeflate(u1* buf, size_t length);
 
 u4 ComputeCrcChecksum(u1* buf, size_t length);
@@ -34,6 +39,24 @@ struct DecompressedFile {
   u4 compressed_size;
 };
 
+class Compressor {
+ public:
+  Compressor();
+  ~Compressor();
+  // Same as the TryDeflate() function above.
+  size_t TryDeflate(u1* buf, size_t length);
+
+ private:
+  // The deflate stream is initialized once and reset between files to avoid
+  // the cost of deflateInit2() for each file. NULL if initialization failed,
+  // in which case files are left uncompressed.
+  z_stream_s* stream_;
+  // Administration of memory receiving the compressed data, reused for each
+  // file like in Decompressor.
+  u1* compressed_data_;
+  size_t compressed_data_allocated_;
+};
+
 class Decompressor {
  public:
   Decompressor();